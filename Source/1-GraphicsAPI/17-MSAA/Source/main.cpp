@@ -1,142 +1,422 @@
 ﻿#include <QApplication>
 #include <QDesktopServices>
+#include <QElapsedTimer>
 #include <QUrl>
+#include <QVulkanInstance>
 #include "Render/RHI/QRhiHelper.h"
+#include "QFrameTimeBenchmark.h"
+#include "QTextureFormatInfo.h"
 
-static float VertexData[] = {
-	//position(xy)	
-	 0.0f,   0.5f,
-	-0.5f,  -0.5f,
-	 0.5f,  -0.5f,
+static const QSize RenderSize(1280, 720);
+static const QRhiTexture::Format SceneFormat = QRhiTexture::RGBA32F;		//与PBR G-Buffer相同的格式，MSAA在这种格式下代价很高
+static const int FrameCount = 64;
+static const int SpokeCount = 24;
+
+struct UniformBlock {
+	QVector4D rotation;			//x：当前帧角度  y：上一帧角度  z：宽高比
+	QVector4D jitter;			//xy：NDC空间下的子像素抖动
 };
 
+static QVector<float> createSpokeVertexData() {		//细长的辐条，边缘走样非常明显
+	QVector<float> vertices;
+	for (int i = 0; i < SpokeCount; i++) {
+		const float angle = 2.0f * M_PI * i / SpokeCount;
+		const float halfWidth = 0.012f;
+		const QVector2D dir(qCos(angle), qSin(angle));
+		const QVector2D side(-dir.y() * halfWidth, dir.x() * halfWidth);
+		const QVector2D inner = dir * 0.1f;
+		const QVector2D outer = dir * 0.9f;
+		vertices << inner.x() + side.x() << inner.y() + side.y()
+			<< outer.x() << outer.y()
+			<< inner.x() - side.x() << inner.y() - side.y();
+	}
+	return vertices;
+}
+
+static float halton(int index, int base) {
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0) {
+		result += fraction * (index % base);
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
+
+static void saveReadback(const QRhiReadbackResult& result, QRhi* rhi, const QString& path) {
+	if (result.data.isEmpty())
+		return;
+	const uchar* p = reinterpret_cast<const uchar*>(result.data.constData());
+	QImage image = QImage(p, result.pixelSize.width(), result.pixelSize.height(), QImage::Format_RGBA32FPx4).convertToFormat(QImage::Format_RGBA8888);
+	if (rhi->isYUpInFramebuffer())
+		image.mirrored().save(path);
+	else
+		image.save(path);
+}
+
 int main(int argc, char **argv)
 {
 	qputenv("QSG_INFO", "1");
 	QApplication app(argc, argv);
 
-    QSharedPointer<QRhi> rhi = QRhiHelper::create();
+	// 自己创建QRhi以开启时间戳，GPU时间才有数值
+	QVulkanInstance vulkanInstance;
+	vulkanInstance.setExtensions(QRhiVulkanInitParams::preferredInstanceExtensions());
+	if (!vulkanInstance.create())
+		return -1;
+	QRhiVulkanInitParams initParams;
+	initParams.inst = &vulkanInstance;
+	QSharedPointer<QRhi> rhi(QRhi::create(QRhi::Vulkan, &initParams, QRhi::EnableTimestamps));
+	if (!rhi)
+		return -1;
 
 	if (!rhi->isFeatureSupported(QRhi::Feature::MultisampleTexture)) {
 		return -1;
 	}
 
-	QScopedPointer<QRhiTexture> msaaTexture;
-	QScopedPointer<QRhiTexture> msaaResolveTexture;
-	QScopedPointer<QRhiTexture> renderTargetTexture;
-	QScopedPointer<QRhiTextureRenderTarget> renderTarget;
-	QScopedPointer<QRhiRenderPassDescriptor> renderTargetDesc;
-
-	msaaTexture.reset(rhi->newTexture(QRhiTexture::RGBA8, QSize(1280, 720), 8, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
-	msaaTexture->create();
-	msaaResolveTexture.reset(rhi->newTexture(QRhiTexture::RGBA8, QSize(1280, 720), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
-	msaaResolveTexture->create();
-	QRhiColorAttachment colorAttachment;
-	colorAttachment.setTexture(msaaTexture.get());
-	colorAttachment.setResolveTexture(msaaResolveTexture.get());
-	renderTarget.reset(rhi->newTextureRenderTarget({ colorAttachment }));
-	renderTargetDesc.reset(renderTarget->newCompatibleRenderPassDescriptor());
-	renderTarget->setRenderPassDescriptor(renderTargetDesc.get());
-	renderTarget->create();
-	
-	QScopedPointer<QRhiBuffer> vertexBuffer;
-	QScopedPointer<QRhiShaderResourceBindings> shaderBindings;
-	QScopedPointer<QRhiGraphicsPipeline> mPipeline;
-
-	{
-		vertexBuffer.reset(rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(VertexData)));
-		vertexBuffer->create();
+	const QVector<int> sampleCounts = rhi->supportedSampleCounts();
+	const int msaaSampleCount = sampleCounts.contains(8) ? 8 : sampleCounts.last();
 
-		shaderBindings.reset(rhi->newShaderResourceBindings());
-		shaderBindings->create();
+	const QVector<float> vertexData = createSpokeVertexData();
+	QScopedPointer<QRhiBuffer> vertexBuffer(rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, vertexData.size() * sizeof(float)));
+	vertexBuffer->create();
+	QScopedPointer<QRhiBuffer> uniformBuffer(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock)));
+	uniformBuffer->create();
 
-		mPipeline.reset(rhi->newGraphicsPipeline());
+	QShader sceneVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 440
+		layout(location = 0) in vec2 position;
+		layout(binding = 0) uniform UniformBlock {
+			vec4 rotation;
+			vec4 jitter;
+		}UBO;
+		layout(location = 0) out vec2 vCurrentNDC;
+		layout(location = 1) out vec2 vPreviousNDC;
+		out gl_PerVertex { 
+			vec4 gl_Position;
+		};
+		vec2 rotate(vec2 p, float angle) {
+			vec2 r = vec2(cos(angle) * p.x - sin(angle) * p.y, sin(angle) * p.x + cos(angle) * p.y);
+			return vec2(r.x / UBO.rotation.z, r.y);
+		}
+		void main(){
+			vCurrentNDC = rotate(position, UBO.rotation.x);
+			vPreviousNDC = rotate(position, UBO.rotation.y);
+			gl_Position = vec4(vCurrentNDC + UBO.jitter.xy, 0.0f, 1.0f);
+		}
+	)");
+	Q_ASSERT(sceneVS.isValid());
 
-		QRhiGraphicsPipeline::TargetBlend targetBlend;
-		targetBlend.enable = false;
-		mPipeline->setTargetBlends({ QRhiGraphicsPipeline::TargetBlend() });
+	QShader msaaFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 440
+		layout(location = 0) in vec2 vCurrentNDC;
+		layout(location = 1) in vec2 vPreviousNDC;
+		layout(location = 0) out vec4 fragColor;
+		void main(){
+			fragColor = vec4(0.1f,0.5f,0.9f,1.0f);
+		}
+	)");
+	Q_ASSERT(msaaFS.isValid());
 
-		mPipeline->setSampleCount(renderTarget->sampleCount());
+	QShader taaSceneFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 440
+		layout(location = 0) in vec2 vCurrentNDC;
+		layout(location = 1) in vec2 vPreviousNDC;
+		layout(location = 0) out vec4 fragColor;
+		layout(location = 1) out vec4 motionVector;
+		void main(){
+			fragColor = vec4(0.1f,0.5f,0.9f,1.0f);
+			motionVector = vec4((vCurrentNDC - vPreviousNDC) * 0.5f, 0.0f, 0.0f);		//UV空间下的位移，不包含抖动；w为0表示有几何体
+		}
+	)");
+	Q_ASSERT(taaSceneFS.isValid());
 
-		mPipeline->setDepthTest(false);
-		mPipeline->setDepthOp(QRhiGraphicsPipeline::Always);
-		mPipeline->setDepthWrite(false);
+	QShader fullScreenVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 440
+		out gl_PerVertex { 
+			vec4 gl_Position;
+		};
+		void main(){
+			vec2 position = vec2((gl_VertexIndex & 1) * 2.0f - 1.0f, (gl_VertexIndex & 2) - 1.0f);
+			gl_Position = vec4(position, 0.0f, 1.0f);
+		}
+	)");
+	Q_ASSERT(fullScreenVS.isValid());
 
-		QShader vs = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 440
-			layout(location = 0) in vec2 position;
-			out gl_PerVertex { 
-				vec4 gl_Position;
-			};
-			void main(){
-				gl_Position = vec4(position,0.0f,1.0f);
+	QShader resolveFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 440
+		layout(binding = 0) uniform sampler2D uCurrent;
+		layout(binding = 1) uniform sampler2D uHistory;
+		layout(binding = 2) uniform sampler2D uMotionVector;
+		layout(binding = 3) uniform ResolveBlock {
+			vec4 params;			//x：历史权重  y：历史是否有效
+		}RBO;
+		layout(location = 0) out vec4 fragColor;
+		vec3 toYCoCg(vec3 c) {
+			return vec3(0.25f * c.r + 0.5f * c.g + 0.25f * c.b, 0.5f * c.r - 0.5f * c.b, -0.25f * c.r + 0.5f * c.g - 0.25f * c.b);
+		}
+		vec3 fromYCoCg(vec3 c) {
+			return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+		}
+		void main(){
+			ivec2 pixel = ivec2(gl_FragCoord.xy);
+			vec2 size = vec2(textureSize(uCurrent, 0));
+			vec3 current = texelFetch(uCurrent, pixel, 0).rgb;
+			if (RBO.params.y < 0.5f) {
+				fragColor = vec4(current, 1.0f);
+				return;
 			}
-		)");
-		Q_ASSERT(vs.isValid());
-
-		QShader fs = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 440
-			layout(location = 0) out vec4 fragColor;
-			void main(){
-				fragColor = vec4(0.1f,0.5f,0.9f,1.0f);
+			vec3 neighborhoodMin = vec3(1e9f);
+			vec3 neighborhoodMax = vec3(-1e9f);
+			vec2 motion = vec2(0.0f);
+			float closestLength = -1.0f;
+			for (int y = -1; y <= 1; y++) {
+				for (int x = -1; x <= 1; x++) {
+					ivec2 coord = clamp(pixel + ivec2(x, y), ivec2(0), ivec2(size) - 1);
+					vec3 neighbor = toYCoCg(texelFetch(uCurrent, coord, 0).rgb);
+					neighborhoodMin = min(neighborhoodMin, neighbor);
+					neighborhoodMax = max(neighborhoodMax, neighbor);
+					vec4 motionSample = texelFetch(uMotionVector, coord, 0);
+					vec2 neighborMotion = motionSample.w > 0.5f ? vec2(0.0f) : motionSample.xy;		//背景被清屏色填充，视为静止
+					if (dot(neighborMotion, neighborMotion) > closestLength) {		//取邻域中位移最大者，避免几何边缘拖影
+						closestLength = dot(neighborMotion, neighborMotion);
+						motion = neighborMotion;
+					}
+				}
 			}
-		)");
-		Q_ASSERT(fs.isValid());
+			vec2 historyUV = gl_FragCoord.xy / size - motion;
+			if (any(lessThan(historyUV, vec2(0.0f))) || any(greaterThan(historyUV, vec2(1.0f)))) {
+				fragColor = vec4(current, 1.0f);
+				return;
+			}
+			vec3 history = toYCoCg(texture(uHistory, historyUV).rgb);
+			history = fromYCoCg(clamp(history, neighborhoodMin, neighborhoodMax));
+			fragColor = vec4(mix(current, history, RBO.params.x), 1.0f);
+		}
+	)");
+	Q_ASSERT(resolveFS.isValid());
 
-		mPipeline->setShaderStages({
-			QRhiShaderStage(QRhiShaderStage::Vertex, vs),
-			QRhiShaderStage(QRhiShaderStage::Fragment, fs)
-			});
+	QRhiVertexInputLayout sceneInputLayout;
+	sceneInputLayout.setBindings({
+		QRhiVertexInputBinding(2 * sizeof(float))
+		});
+	sceneInputLayout.setAttributes({
+		QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float2, 0),
+		});
 
-		QRhiVertexInputLayout inputLayout;
-		inputLayout.setBindings({
-			QRhiVertexInputBinding(2 * sizeof(float))
+	QScopedPointer<QRhiShaderResourceBindings> sceneBindings(rhi->newShaderResourceBindings());
+	sceneBindings->setBindings({
+		QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, uniformBuffer.get())
+		});
+	sceneBindings->create();
+
+	// MSAA：多重采样颜色附件 + 解析纹理
+	QScopedPointer<QRhiTexture> msaaTexture;
+	QScopedPointer<QRhiTexture> msaaResolveTexture;
+	QScopedPointer<QRhiTextureRenderTarget> msaaRenderTarget;
+	QScopedPointer<QRhiRenderPassDescriptor> msaaRenderTargetDesc;
+	QScopedPointer<QRhiGraphicsPipeline> msaaPipeline;
+	{
+		msaaTexture.reset(rhi->newTexture(SceneFormat, RenderSize, msaaSampleCount, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
+		msaaTexture->create();
+		msaaResolveTexture.reset(rhi->newTexture(SceneFormat, RenderSize, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
+		msaaResolveTexture->create();
+		QRhiColorAttachment colorAttachment;
+		colorAttachment.setTexture(msaaTexture.get());
+		colorAttachment.setResolveTexture(msaaResolveTexture.get());
+		msaaRenderTarget.reset(rhi->newTextureRenderTarget({ colorAttachment }));
+		msaaRenderTargetDesc.reset(msaaRenderTarget->newCompatibleRenderPassDescriptor());
+		msaaRenderTarget->setRenderPassDescriptor(msaaRenderTargetDesc.get());
+		msaaRenderTarget->create();
+
+		msaaPipeline.reset(rhi->newGraphicsPipeline());
+		msaaPipeline->setTargetBlends({ QRhiGraphicsPipeline::TargetBlend() });
+		msaaPipeline->setSampleCount(msaaRenderTarget->sampleCount());
+		msaaPipeline->setShaderStages({
+			QRhiShaderStage(QRhiShaderStage::Vertex, sceneVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, msaaFS)
 			});
+		msaaPipeline->setVertexInputLayout(sceneInputLayout);
+		msaaPipeline->setShaderResourceBindings(sceneBindings.get());
+		msaaPipeline->setRenderPassDescriptor(msaaRenderTargetDesc.get());
+		msaaPipeline->create();
+	}
 
-		inputLayout.setAttributes({
-			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float2, 0),
+	// TAA：单采样颜色 + 运动矢量，历史纹理成对交替读写
+	QScopedPointer<QRhiTexture> taaColorTexture;
+	QScopedPointer<QRhiTexture> taaMotionTexture;
+	QScopedPointer<QRhiTextureRenderTarget> taaSceneRenderTarget;
+	QScopedPointer<QRhiRenderPassDescriptor> taaSceneRenderTargetDesc;
+	QScopedPointer<QRhiGraphicsPipeline> taaScenePipeline;
+	QScopedPointer<QRhiTexture> historyTextures[2];
+	QScopedPointer<QRhiTextureRenderTarget> historyRenderTargets[2];
+	QScopedPointer<QRhiRenderPassDescriptor> historyRenderTargetDesc;
+	QScopedPointer<QRhiBuffer> resolveUniformBuffer;
+	QScopedPointer<QRhiSampler> pointSampler;
+	QScopedPointer<QRhiSampler> linearSampler;
+	QScopedPointer<QRhiShaderResourceBindings> resolveBindings[2];
+	QScopedPointer<QRhiGraphicsPipeline> resolvePipeline;
+	{
+		taaColorTexture.reset(rhi->newTexture(SceneFormat, RenderSize, 1, QRhiTexture::RenderTarget));
+		taaColorTexture->create();
+		taaMotionTexture.reset(rhi->newTexture(QRhiTexture::RGBA16F, RenderSize, 1, QRhiTexture::RenderTarget));
+		taaMotionTexture->create();
+		taaSceneRenderTarget.reset(rhi->newTextureRenderTarget({ QRhiColorAttachment(taaColorTexture.get()), QRhiColorAttachment(taaMotionTexture.get()) }));
+		taaSceneRenderTargetDesc.reset(taaSceneRenderTarget->newCompatibleRenderPassDescriptor());
+		taaSceneRenderTarget->setRenderPassDescriptor(taaSceneRenderTargetDesc.get());
+		taaSceneRenderTarget->create();
+
+		taaScenePipeline.reset(rhi->newGraphicsPipeline());
+		taaScenePipeline->setTargetBlends({ QRhiGraphicsPipeline::TargetBlend(), QRhiGraphicsPipeline::TargetBlend() });
+		taaScenePipeline->setSampleCount(taaSceneRenderTarget->sampleCount());
+		taaScenePipeline->setShaderStages({
+			QRhiShaderStage(QRhiShaderStage::Vertex, sceneVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, taaSceneFS)
 			});
+		taaScenePipeline->setVertexInputLayout(sceneInputLayout);
+		taaScenePipeline->setShaderResourceBindings(sceneBindings.get());
+		taaScenePipeline->setRenderPassDescriptor(taaSceneRenderTargetDesc.get());
+		taaScenePipeline->create();
 
-		mPipeline->setVertexInputLayout(inputLayout);
-		mPipeline->setShaderResourceBindings(shaderBindings.get());
-		mPipeline->setRenderPassDescriptor(renderTargetDesc.get());
-		mPipeline->create();
-	}
-	
-	QRhiCommandBuffer* cmdBuffer;
-	if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
-		return 1;
+		for (int i = 0; i < 2; i++) {
+			historyTextures[i].reset(rhi->newTexture(SceneFormat, RenderSize, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource));
+			historyTextures[i]->create();
+			historyRenderTargets[i].reset(rhi->newTextureRenderTarget({ historyTextures[i].get() }));
+		}
+		historyRenderTargetDesc.reset(historyRenderTargets[0]->newCompatibleRenderPassDescriptor());
+		for (int i = 0; i < 2; i++) {
+			historyRenderTargets[i]->setRenderPassDescriptor(historyRenderTargetDesc.get());
+			historyRenderTargets[i]->create();
+		}
+
+		resolveUniformBuffer.reset(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QVector4D)));
+		resolveUniformBuffer->create();
+		pointSampler.reset(rhi->newSampler(QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+		pointSampler->create();
+		linearSampler.reset(rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+		linearSampler->create();
+		for (int i = 0; i < 2; i++) {			//resolveBindings[i] 读取 historyTextures[i]，写入 historyTextures[1 - i]
+			resolveBindings[i].reset(rhi->newShaderResourceBindings());
+			resolveBindings[i]->setBindings({
+				QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, taaColorTexture.get(), pointSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, historyTextures[i].get(), linearSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, taaMotionTexture.get(), pointSampler.get()),
+				QRhiShaderResourceBinding::uniformBuffer(3, QRhiShaderResourceBinding::FragmentStage, resolveUniformBuffer.get()),
+				});
+			resolveBindings[i]->create();
+		}
 
-	QRhiResourceUpdateBatch* resourceUpdates = rhi->nextResourceUpdateBatch();
-	resourceUpdates->uploadStaticBuffer(vertexBuffer.get(), VertexData);
+		resolvePipeline.reset(rhi->newGraphicsPipeline());
+		resolvePipeline->setTargetBlends({ QRhiGraphicsPipeline::TargetBlend() });
+		resolvePipeline->setTopology(QRhiGraphicsPipeline::TriangleStrip);
+		resolvePipeline->setSampleCount(historyRenderTargets[0]->sampleCount());
+		resolvePipeline->setShaderStages({
+			QRhiShaderStage(QRhiShaderStage::Vertex, fullScreenVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, resolveFS)
+			});
+		resolvePipeline->setShaderResourceBindings(resolveBindings[0].get());
+		resolvePipeline->setRenderPassDescriptor(historyRenderTargetDesc.get());
+		resolvePipeline->create();
+	}
 
 	const QColor clearColor = QColor::fromRgbF(0.2f, 0.2f, 0.2f, 1.0f);
 	const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+	const float aspect = float(RenderSize.width()) / RenderSize.height();
+	auto frameRotation = [](int frame) {
+		return frame * 0.01f;
+	};
+	auto drawScene = [&](QRhiCommandBuffer* cmdBuffer, QRhiGraphicsPipeline* pipeline) {
+		cmdBuffer->setGraphicsPipeline(pipeline);
+		cmdBuffer->setViewport(QRhiViewport(0, 0, RenderSize.width(), RenderSize.height()));
+		cmdBuffer->setShaderResources(sceneBindings.get());
+		const QRhiCommandBuffer::VertexInput vertexBindings(vertexBuffer.get(), 0);
+		cmdBuffer->setVertexInput(0, 1, &vertexBindings);
+		cmdBuffer->draw(SpokeCount * 3);
+	};
+
+	QRhiReadbackResult msaaReadback;
+	QRhiReadbackResult taaReadback;
+	double msaaGpuTime = 0.0;
+	double taaGpuTime = 0.0;
+	QElapsedTimer timer;
+
+	timer.start();
+	for (int frame = 0; frame < FrameCount; frame++) {
+		QRhiCommandBuffer* cmdBuffer;
+		if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+			return 1;
+		QRhiResourceUpdateBatch* resourceUpdates = rhi->nextResourceUpdateBatch();
+		if (frame == 0)
+			resourceUpdates->uploadStaticBuffer(vertexBuffer.get(), vertexData.constData());
+		UniformBlock ubo;
+		ubo.rotation = QVector4D(frameRotation(frame), frameRotation(frame - 1), aspect, 0.0f);
+		ubo.jitter = QVector4D();
+		resourceUpdates->updateDynamicBuffer(uniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
 
-	cmdBuffer->beginPass(renderTarget.get(), clearColor, dsClearValue, resourceUpdates);
-
-	cmdBuffer->setGraphicsPipeline(mPipeline.get());
-	cmdBuffer->setViewport(QRhiViewport(0, 0, msaaTexture->pixelSize().width(), msaaTexture->pixelSize().height()));
-	cmdBuffer->setShaderResources();
-	const QRhiCommandBuffer::VertexInput vertexBindings(vertexBuffer.get(), 0);
-	cmdBuffer->setVertexInput(0, 1, &vertexBindings);
-	cmdBuffer->draw(3);
-
-	resourceUpdates = rhi->nextResourceUpdateBatch();
-	QRhiReadbackResult rbResult;
-	QString outputPath = "msaa.png";
-	rbResult.completed = [&rbResult, &rhi, &outputPath] {
-		if (!rbResult.data.isEmpty()) {
-			const uchar* p = reinterpret_cast<const uchar*>(rbResult.data.constData());
-			QImage image(p, rbResult.pixelSize.width(), rbResult.pixelSize.height(), QImage::Format_RGBA8888);
-			if (rhi->isYUpInFramebuffer())
-				image.mirrored().save(outputPath);
-			else
-				image.save(outputPath);
+		cmdBuffer->beginPass(msaaRenderTarget.get(), clearColor, dsClearValue, resourceUpdates);
+		drawScene(cmdBuffer, msaaPipeline.get());
+		resourceUpdates = nullptr;
+		if (frame == FrameCount - 1) {
+			resourceUpdates = rhi->nextResourceUpdateBatch();
+			QRhiReadbackDescription rb(msaaResolveTexture.get());		//回读 msaaResolveTexture 而不是 msaaTexture
+			resourceUpdates->readBackTexture(rb, &msaaReadback);
 		}
-	};
-	QRhiReadbackDescription rb(msaaResolveTexture.get());		//回读 msaaResolveTexture 而不是 msaaTexture
-	resourceUpdates->readBackTexture(rb, &rbResult);
-	cmdBuffer->endPass(resourceUpdates);
-	rhi->endOffscreenFrame();
-	QDesktopServices::openUrl(QUrl("file:" + outputPath, QUrl::TolerantMode));
+		cmdBuffer->endPass(resourceUpdates);
+		rhi->endOffscreenFrame();
+		msaaGpuTime += cmdBuffer->lastCompletedGpuTime();
+	}
+	const double msaaWallTime = timer.nsecsElapsed() / 1e6;
+
+	timer.restart();
+	for (int frame = 0; frame < FrameCount; frame++) {
+		QRhiCommandBuffer* cmdBuffer;
+		if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+			return 1;
+		const int read = frame % 2;
+		const int write = 1 - read;
+		QRhiResourceUpdateBatch* resourceUpdates = rhi->nextResourceUpdateBatch();
+		const int jitterIndex = frame % 8 + 1;		//Halton(2,3) 序列，单位为像素
+		const QVector2D jitterPixels(halton(jitterIndex, 2) - 0.5f, halton(jitterIndex, 3) - 0.5f);
+		UniformBlock ubo;
+		ubo.rotation = QVector4D(frameRotation(frame), frameRotation(frame - 1), aspect, 0.0f);
+		ubo.jitter = QVector4D(jitterPixels.x() * 2.0f / RenderSize.width(), jitterPixels.y() * 2.0f / RenderSize.height(), 0.0f, 0.0f);
+		resourceUpdates->updateDynamicBuffer(uniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		const QVector4D resolveParams(0.9f, frame > 0 ? 1.0f : 0.0f, 0.0f, 0.0f);
+		resourceUpdates->updateDynamicBuffer(resolveUniformBuffer.get(), 0, sizeof(QVector4D), &resolveParams);
+
+		cmdBuffer->beginPass(taaSceneRenderTarget.get(), clearColor, dsClearValue, resourceUpdates);
+		drawScene(cmdBuffer, taaScenePipeline.get());
+		cmdBuffer->endPass();
+
+		cmdBuffer->beginPass(historyRenderTargets[write].get(), clearColor, dsClearValue);
+		cmdBuffer->setGraphicsPipeline(resolvePipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, RenderSize.width(), RenderSize.height()));
+		cmdBuffer->setShaderResources(resolveBindings[read].get());
+		cmdBuffer->draw(4);
+		resourceUpdates = nullptr;
+		if (frame == FrameCount - 1) {
+			resourceUpdates = rhi->nextResourceUpdateBatch();
+			QRhiReadbackDescription rb(historyTextures[write].get());
+			resourceUpdates->readBackTexture(rb, &taaReadback);
+		}
+		cmdBuffer->endPass(resourceUpdates);
+		rhi->endOffscreenFrame();
+		taaGpuTime += cmdBuffer->lastCompletedGpuTime();
+	}
+	const double taaWallTime = timer.nsecsElapsed() / 1e6;
+
+	const qint64 pixelCount = qint64(RenderSize.width()) * RenderSize.height();
+	const qint64 msaaBytes = pixelCount * QTextureFormatInfo::bytesPerPixel(SceneFormat) * (msaaSampleCount + 1);
+	const qint64 taaBytes = pixelCount * (QTextureFormatInfo::bytesPerPixel(SceneFormat) * 3 + QTextureFormatInfo::bytesPerPixel(QRhiTexture::RGBA16F));
+	qDebug().noquote() << QString("[MSAA x%1] %2 MB, %3 ms/frame (gpu %4)")
+		.arg(msaaSampleCount)
+		.arg(msaaBytes / 1048576.0, 0, 'f', 1)
+		.arg(msaaWallTime / FrameCount, 0, 'f', 3)
+		.arg(QFrameTimeBenchmark::formatGpuTime(msaaGpuTime, FrameCount));
+	qDebug().noquote() << QString("[TAA] %1 MB, %2 ms/frame (gpu %3)")
+		.arg(taaBytes / 1048576.0, 0, 'f', 1)
+		.arg(taaWallTime / FrameCount, 0, 'f', 3)
+		.arg(QFrameTimeBenchmark::formatGpuTime(taaGpuTime, FrameCount));
+
+	saveReadback(msaaReadback, rhi.get(), "msaa.png");
+	saveReadback(taaReadback, rhi.get(), "taa.png");
+	QDesktopServices::openUrl(QUrl("file:msaa.png", QUrl::TolerantMode));
+	QDesktopServices::openUrl(QUrl("file:taa.png", QUrl::TolerantMode));
 	return app.exec();
-}
\ No newline at end of file
+}
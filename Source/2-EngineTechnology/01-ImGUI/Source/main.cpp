@@ -1,34 +1,592 @@
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPointer>
+#include <QWheelEvent>
+#include <QWindow>
 #include "Render/IRenderer.h"
 #include "Render/RenderGraph/PassBuilder/QImGUIPassBuilder.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 保留模式的ImGui绘制数据缓存：按ImDrawList计算哈希，未变化的列表复用上一帧在GPU缓冲区中的区间
+class QImGuiDrawCache {
+public:
+	struct Slot {
+		int vertexOffset = 0;
+		int vertexCapacity = 0;
+		int indexOffset = 0;
+		int indexCapacity = 0;
+		size_t hash = 0;
+		int lastFrame = 0;
+	};
+	struct Upload {
+		const ImDrawList* list;
+		int vertexOffset;
+		int indexOffset;
+	};
+	struct Stats {
+		qint64 uploadedBytes = 0;
+		qint64 fullUploadBytes = 0;						//不做缓存时每帧需要上传的字节数，用于对比
+		int uploadedLists = 0;
+		int reusedLists = 0;
+		bool changed = true;
+		bool compacted = false;
+	};
+	// 返回本帧是否有任何变化；没有变化时上一帧的ImGui纹理可以直接复用
+	bool update(const ImDrawData* drawData, bool retained) {
+		mFrame++;
+		mUploads.clear();
+		mStats = Stats();
+		size_t globalHash = qHashMulti(0, drawData->DisplayPos.x, drawData->DisplayPos.y, drawData->DisplaySize.x, drawData->DisplaySize.y, drawData->FramebufferScale.x, drawData->FramebufferScale.y);
+		for (int i = 0; i < drawData->CmdListsCount; i++)
+			globalHash = qHash(quintptr(drawData->CmdLists[i]), globalHash);			//窗口的增减和层级顺序变化
+		mStats.changed = !retained || globalHash != mGlobalHash;
+		mGlobalHash = globalHash;
+
+		bool outOfSpace = false;
+		for (int i = 0; i < drawData->CmdListsCount; i++) {
+			const ImDrawList* list = drawData->CmdLists[i];
+			const int vertexCount = list->VtxBuffer.Size;
+			const int indexCount = list->IdxBuffer.Size;
+			mStats.fullUploadBytes += vertexCount * sizeof(ImDrawVert) + indexCount * sizeof(ImDrawIdx);
+			const size_t hash = hashDrawList(list);
+			auto it = mSlots.find(list);
+			if (it != mSlots.end() && vertexCount <= it->vertexCapacity && indexCount <= it->indexCapacity) {
+				it->lastFrame = mFrame;
+				if (retained && it->hash == hash) {
+					mStats.reusedLists++;
+					continue;
+				}
+				it->hash = hash;
+				mUploads << Upload{ list, it->vertexOffset, it->indexOffset };
+				mStats.changed = true;
+				continue;
+			}
+			mStats.changed = true;
+			Slot slot;
+			slot.hash = hash;
+			slot.lastFrame = mFrame;
+			if (!allocate(slot, vertexCount, indexCount)) {
+				outOfSpace = true;
+				mSlots[list] = slot;
+				continue;
+			}
+			mSlots[list] = slot;
+			mUploads << Upload{ list, slot.vertexOffset, slot.indexOffset };
+		}
+		for (auto it = mSlots.begin(); it != mSlots.end();) {						//关闭的窗口释放区间，空洞在下一次整理时回收
+			if (it->lastFrame != mFrame)
+				it = mSlots.erase(it);
+			else
+				++it;
+		}
+		if (outOfSpace)
+			compact(drawData);
+		for (const Upload& upload : mUploads)
+			mStats.uploadedBytes += upload.list->VtxBuffer.Size * sizeof(ImDrawVert) + upload.list->IdxBuffer.Size * sizeof(ImDrawIdx);
+		mStats.uploadedLists = mUploads.size();
+		return mStats.changed;
+	}
+	const Slot& getSlot(const ImDrawList* list) const { return mSlots.constFind(list).value(); }
+	const QVector<Upload>& getUploads() const { return mUploads; }
+	int getVertexCapacity() const { return mVertexCapacity; }
+	int getIndexCapacity() const { return mIndexCapacity; }
+	const Stats& getStats() const { return mStats; }
+private:
+	static size_t hashDrawList(const ImDrawList* list) {
+		size_t hash = qHashBits(list->VtxBuffer.Data, list->VtxBuffer.Size * sizeof(ImDrawVert));
+		hash = qHashBits(list->IdxBuffer.Data, list->IdxBuffer.Size * sizeof(ImDrawIdx), hash);
+		for (const ImDrawCmd& cmd : list->CmdBuffer) {
+			const struct {
+				ImVec4 clipRect;
+				quintptr textureId;
+				quint32 vertexOffset;
+				quint32 indexOffset;
+				quint32 elementCount;
+			} key = { cmd.ClipRect, quintptr(cmd.TextureId), cmd.VtxOffset, cmd.IdxOffset, cmd.ElemCount };
+			hash = qHashBits(&key, sizeof(key), hash);
+		}
+		return hash;
+	}
+	// 每个列表预留一些余量，窗口内容小幅增长时不需要搬迁
+	static int slack(int count) {
+		return (count + count / 2 + 64 + 1) & ~1;			//索引区间保持偶数，上传偏移按4字节对齐
+	}
+	bool allocate(Slot& slot, int vertexCount, int indexCount) {
+		slot.vertexCapacity = slack(vertexCount);
+		slot.indexCapacity = slack(indexCount);
+		if (mVertexTop + slot.vertexCapacity > mVertexCapacity || mIndexTop + slot.indexCapacity > mIndexCapacity)
+			return false;
+		slot.vertexOffset = mVertexTop;
+		slot.indexOffset = mIndexTop;
+		mVertexTop += slot.vertexCapacity;
+		mIndexTop += slot.indexCapacity;
+		return true;
+	}
+	// 空间不足时按当前的列表顺序重新排布，容量不够则按2的幂增长
+	void compact(const ImDrawData* drawData) {
+		int vertexTotal = 0;
+		int indexTotal = 0;
+		for (int i = 0; i < drawData->CmdListsCount; i++) {
+			vertexTotal += slack(drawData->CmdLists[i]->VtxBuffer.Size);
+			indexTotal += slack(drawData->CmdLists[i]->IdxBuffer.Size);
+		}
+		if (vertexTotal > mVertexCapacity)
+			mVertexCapacity = qNextPowerOfTwo(quint32(qMax(vertexTotal, 1 << 14)));
+		if (indexTotal > mIndexCapacity)
+			mIndexCapacity = qNextPowerOfTwo(quint32(qMax(indexTotal, 1 << 15)));
+		mVertexTop = mIndexTop = 0;
+		mUploads.clear();
+		for (int i = 0; i < drawData->CmdListsCount; i++) {
+			const ImDrawList* list = drawData->CmdLists[i];
+			Slot& slot = mSlots[list];
+			allocate(slot, list->VtxBuffer.Size, list->IdxBuffer.Size);
+			mUploads << Upload{ list, slot.vertexOffset, slot.indexOffset };
+		}
+		mStats.compacted = true;
+		mStats.changed = true;
+	}
+	QHash<const ImDrawList*, Slot> mSlots;
+	QVector<Upload> mUploads;
+	Stats mStats;
+	size_t mGlobalHash = 0;
+	int mVertexCapacity = 0;
+	int mIndexCapacity = 0;
+	int mVertexTop = 0;
+	int mIndexTop = 0;
+	int mFrame = 0;
+};
+
+// 把渲染窗口的输入转发给ImGui，只处理Vulkan表面窗口上的事件，避免与外层控件重复
+class QImGuiInputFilter : public QObject {
+public:
+	QImGuiInputFilter(ImGuiContext* context)
+		: mContext(context)
+	{
+	}
+	QWindow* getWindow() const { return mWindow; }
+protected:
+	bool eventFilter(QObject* watched, QEvent* event) override {
+		QWindow* window = qobject_cast<QWindow*>(watched);
+		if (!window || window->surfaceType() != QSurface::VulkanSurface)
+			return false;
+		mWindow = window;
+		ImGui::SetCurrentContext(mContext);
+		ImGuiIO& io = ImGui::GetIO();
+		switch (event->type()) {
+		case QEvent::MouseMove: {
+			const QPointF pos = static_cast<QMouseEvent*>(event)->position();
+			io.AddMousePosEvent(pos.x(), pos.y());
+			break;
+		}
+		case QEvent::MouseButtonPress:
+		case QEvent::MouseButtonRelease: {
+			QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
+			const int button = mouseEvent->button() == Qt::LeftButton ? 0 : mouseEvent->button() == Qt::RightButton ? 1 : mouseEvent->button() == Qt::MiddleButton ? 2 : -1;
+			io.AddMousePosEvent(mouseEvent->position().x(), mouseEvent->position().y());
+			if (button >= 0)
+				io.AddMouseButtonEvent(button, event->type() == QEvent::MouseButtonPress);
+			break;
+		}
+		case QEvent::Wheel: {
+			const QPoint delta = static_cast<QWheelEvent*>(event)->angleDelta();
+			io.AddMouseWheelEvent(delta.x() / 120.0f, delta.y() / 120.0f);
+			break;
+		}
+		case QEvent::KeyPress:
+		case QEvent::KeyRelease: {
+			QKeyEvent* keyEvent = static_cast<QKeyEvent*>(event);
+			const bool down = event->type() == QEvent::KeyPress;
+			const Qt::KeyboardModifiers modifiers = keyEvent->modifiers();
+			io.AddKeyEvent(ImGuiMod_Ctrl, modifiers & Qt::ControlModifier);
+			io.AddKeyEvent(ImGuiMod_Shift, modifiers & Qt::ShiftModifier);
+			io.AddKeyEvent(ImGuiMod_Alt, modifiers & Qt::AltModifier);
+			const ImGuiKey key = toImGuiKey(keyEvent->key());
+			if (key != ImGuiKey_None)
+				io.AddKeyEvent(key, down);
+			if (down && !keyEvent->text().isEmpty() && keyEvent->text().at(0).isPrint())
+				io.AddInputCharactersUTF8(keyEvent->text().toUtf8().constData());
+			break;
+		}
+		default:
+			break;
+		}
+		return false;
+	}
+private:
+	static ImGuiKey toImGuiKey(int key) {
+		if (key >= Qt::Key_A && key <= Qt::Key_Z)
+			return ImGuiKey(ImGuiKey_A + (key - Qt::Key_A));
+		if (key >= Qt::Key_0 && key <= Qt::Key_9)
+			return ImGuiKey(ImGuiKey_0 + (key - Qt::Key_0));
+		switch (key) {
+		case Qt::Key_Tab: return ImGuiKey_Tab;
+		case Qt::Key_Left: return ImGuiKey_LeftArrow;
+		case Qt::Key_Right: return ImGuiKey_RightArrow;
+		case Qt::Key_Up: return ImGuiKey_UpArrow;
+		case Qt::Key_Down: return ImGuiKey_DownArrow;
+		case Qt::Key_PageUp: return ImGuiKey_PageUp;
+		case Qt::Key_PageDown: return ImGuiKey_PageDown;
+		case Qt::Key_Home: return ImGuiKey_Home;
+		case Qt::Key_End: return ImGuiKey_End;
+		case Qt::Key_Insert: return ImGuiKey_Insert;
+		case Qt::Key_Delete: return ImGuiKey_Delete;
+		case Qt::Key_Backspace: return ImGuiKey_Backspace;
+		case Qt::Key_Space: return ImGuiKey_Space;
+		case Qt::Key_Return: return ImGuiKey_Enter;
+		case Qt::Key_Enter: return ImGuiKey_KeypadEnter;
+		case Qt::Key_Escape: return ImGuiKey_Escape;
+		default: return ImGuiKey_None;
+		}
+	}
+	ImGuiContext* mContext;
+	QPointer<QWindow> mWindow;
+};
+
+// 使用保留模式缓冲区的ImGui绘制：几何数据按列表增量上传，界面没有变化时整帧跳过
+class QRetainedImGuiPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QRetainedImGuiPassBuilder)
+		QRP_INPUT_ATTR(QSize, FramebufferSize);
+		QRP_INPUT_ATTR(ImDrawData*, DrawData);
+		QRP_INPUT_ATTR(QImGuiDrawCache*, DrawCache);
+		QRP_INPUT_ATTR(QImage, FontImage);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QRetainedImGuiPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, ImGuiTexture)
+	QRP_OUTPUT_END()
+public:
+	struct Stats {
+		qint64 uploadedBytes = 0;
+		bool rendered = false;
+	};
+private:
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiTextureRef mFontTexture;
+	QRhiSamplerRef mSampler;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mVertexBuffer;
+	QRhiBufferRef mIndexBuffer;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mVS;
+	QShader mFS;
+	QRhiTexture* mUploadedFontTexture = nullptr;
+	QRhiTexture* mRenderedTexture = nullptr;
+	QRhiBuffer* mUploadedVertexBuffer = nullptr;
+	QRhiBuffer* mUploadedIndexBuffer = nullptr;
+	Stats mStats;
+public:
+	QRetainedImGuiPassBuilder() {
+		mVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec2 inPosition;
+			layout (location = 1) in vec2 inUV;
+			layout (location = 2) in vec4 inColor;
+			layout (std140, binding = 0) uniform UniformBlock {
+				mat4 projection;
+			} ubo;
+			layout (location = 0) out vec2 vUV;
+			layout (location = 1) out vec4 vColor;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				vUV = inUV;
+				vColor = inColor;
+				gl_Position = ubo.projection * vec4(inPosition, 0.0, 1.0);
+			}
+		)");
+		mFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 1) uniform sampler2D uFont;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 1) in vec4 vColor;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = vColor * texture(uFont, vUV);
+			}
+		)");
+	}
+	const Stats& getStats() const { return mStats; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QImGuiDrawCache* cache = mInput._DrawCache;
+		builder.setupTexture(mColorAttachment, "RetainedImGuiColor", QRhiTexture::RGBA8, mInput._FramebufferSize, 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "RetainedImGuiRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupTexture(mFontTexture, "RetainedImGuiFont", QRhiTexture::RGBA8, mInput._FontImage.size(), 1, {});
+		builder.setupSampler(mSampler, "RetainedImGuiSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupBuffer(mUniformBuffer, "RetainedImGuiUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(float) * 16);
+		builder.setupBuffer(mVertexBuffer, "RetainedImGuiVertexBuffer", QRhiBuffer::Static, QRhiBuffer::VertexBuffer, sizeof(ImDrawVert) * qMax(1, cache->getVertexCapacity()));
+		builder.setupBuffer(mIndexBuffer, "RetainedImGuiIndexBuffer", QRhiBuffer::Static, QRhiBuffer::IndexBuffer, sizeof(ImDrawIdx) * qMax(2, cache->getIndexCapacity()));
+
+		builder.setupShaderResourceBindings(mBindings, "RetainedImGuiBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mFontTexture.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipeline::TargetBlend alphaBlend;
+		alphaBlend.enable = true;
+		alphaBlend.srcColor = QRhiGraphicsPipeline::SrcAlpha;
+		alphaBlend.dstColor = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		alphaBlend.srcAlpha = QRhiGraphicsPipeline::One;
+		alphaBlend.dstAlpha = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.targetBlends = { alphaBlend };
+		PSO.flags = QRhiGraphicsPipeline::UsesScissor;
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(sizeof(ImDrawVert)),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float2, offsetof(ImDrawVert, pos)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::Float2, offsetof(ImDrawVert, uv)),
+			QRhiVertexInputAttribute(0, 2, QRhiVertexInputAttribute::UNormByte4, offsetof(ImDrawVert, col)),
+		});
+		PSO.vertexInputLayout = inputLayout;
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mFS),
+		};
+		builder.setupGraphicsPipeline(mPipeline, "RetainedImGuiPipeline", PSO);
+
+		mOutput.ImGuiTexture = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const ImDrawData* drawData = mInput._DrawData;
+		QImGuiDrawCache* cache = mInput._DrawCache;
+		mStats = Stats();
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		if (mUploadedFontTexture != mFontTexture.get()) {
+			batch->uploadTexture(mFontTexture.get(), mInput._FontImage);
+			mUploadedFontTexture = mFontTexture.get();
+			mRenderedTexture = nullptr;
+		}
+		// 缓冲区因增长而重建时，缓存中的所有区间都已失效
+		const bool buffersRecreated = mUploadedVertexBuffer != mVertexBuffer.get() || mUploadedIndexBuffer != mIndexBuffer.get();
+		if (buffersRecreated) {
+			mUploadedVertexBuffer = mVertexBuffer.get();
+			mUploadedIndexBuffer = mIndexBuffer.get();
+		}
+		// 输出纹理依然是上一次绘制的结果，且没有任何列表变化时，整帧跳过
+		if (!cache->getStats().changed && !buffersRecreated && mRenderedTexture == mColorAttachment.get()) {
+			batch->release();
+			return;
+		}
+		auto uploadList = [&](const ImDrawList* list, int vertexOffset, int indexOffset) {
+			if (list->VtxBuffer.Size > 0)
+				batch->uploadStaticBuffer(mVertexBuffer.get(), vertexOffset * sizeof(ImDrawVert), list->VtxBuffer.Size * sizeof(ImDrawVert), list->VtxBuffer.Data);
+			if (list->IdxBuffer.Size > 0)
+				batch->uploadStaticBuffer(mIndexBuffer.get(), indexOffset * sizeof(ImDrawIdx), list->IdxBuffer.Size * sizeof(ImDrawIdx), list->IdxBuffer.Data);
+			mStats.uploadedBytes += list->VtxBuffer.Size * sizeof(ImDrawVert) + list->IdxBuffer.Size * sizeof(ImDrawIdx);
+		};
+		if (buffersRecreated) {
+			for (int i = 0; i < drawData->CmdListsCount; i++) {
+				const QImGuiDrawCache::Slot& slot = cache->getSlot(drawData->CmdLists[i]);
+				uploadList(drawData->CmdLists[i], slot.vertexOffset, slot.indexOffset);
+			}
+		}
+		else {
+			for (const QImGuiDrawCache::Upload& upload : cache->getUploads())
+				uploadList(upload.list, upload.vertexOffset, upload.indexOffset);
+		}
+
+		const float left = drawData->DisplayPos.x;
+		const float top = drawData->DisplayPos.y;
+		QMatrix4x4 projection;
+		projection.ortho(left, left + drawData->DisplaySize.x, top + drawData->DisplaySize.y, top, -1.0f, 1.0f);
+		projection = mRhi->clipSpaceCorrMatrix() * projection;
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(float) * 16, projection.constData());
+
+		const QSize size = mRenderTarget->pixelSize();
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 0.0f), { 1.0f, 0 }, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+		cmdBuffer->setVertexInput(0, 1, &vertexBindings, mIndexBuffer.get(), 0, sizeof(ImDrawIdx) == 2 ? QRhiCommandBuffer::IndexUInt16 : QRhiCommandBuffer::IndexUInt32);
+		const ImVec2 scale = drawData->FramebufferScale;
+		for (int i = 0; i < drawData->CmdListsCount; i++) {
+			const ImDrawList* list = drawData->CmdLists[i];
+			const QImGuiDrawCache::Slot& slot = cache->getSlot(list);
+			for (const ImDrawCmd& cmd : list->CmdBuffer) {
+				if (cmd.UserCallback || cmd.ElemCount == 0)
+					continue;
+				const float clipLeft = qMax(0.0f, (cmd.ClipRect.x - left) * scale.x);
+				const float clipTop = qMax(0.0f, (cmd.ClipRect.y - top) * scale.y);
+				const float clipRight = qMin(float(size.width()), (cmd.ClipRect.z - left) * scale.x);
+				const float clipBottom = qMin(float(size.height()), (cmd.ClipRect.w - top) * scale.y);
+				if (clipRight <= clipLeft || clipBottom <= clipTop)
+					continue;
+				const int scissorY = size.height() - int(clipBottom);			//QRhiScissor 始终使用左下角为原点的坐标，由后端自行翻转
+				cmdBuffer->setScissor(QRhiScissor(int(clipLeft), scissorY, int(clipRight - clipLeft), int(clipBottom - clipTop)));
+				cmdBuffer->drawIndexed(cmd.ElemCount, 1, slot.indexOffset + cmd.IdxOffset, slot.vertexOffset + cmd.VtxOffset);
+			}
+		}
+		cmdBuffer->endPass();
+		mRenderedTexture = mColorAttachment.get();
+		mStats.rendered = true;
+	}
+};
+
+static QImage buildFontImage() {
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+	ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+	return QImage(pixels, width, height, QImage::Format_RGBA8888).copy();
+}
+
+// 不依赖窗口：用ShowDemoWindow作为负载跑若干帧，中间模拟一段鼠标移动，对比全量上传与增量上传的字节数
+static void runImGuiUploadReport() {
+	ImGuiContext* context = ImGui::CreateContext();
+	ImGui::SetCurrentContext(context);
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1600, 900);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.IniFilename = nullptr;
+	io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+	buildFontImage();
+
+	const int frameCount = 600;
+	QImGuiDrawCache cache;
+	qint64 fullBytes = 0;
+	qint64 retainedBytes = 0;
+	int skippedFrames = 0;
+	int compactions = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for (int frame = 0; frame < frameCount; frame++) {
+		if (frame >= 200 && frame < 300)
+			io.AddMousePosEvent(100.0f + (frame - 200) * 4.0f, 80.0f + (frame - 200) * 2.0f);
+		ImGui::NewFrame();
+		ImGui::ShowStyleSelector("Style");
+		ImGui::ShowDemoWindow();
+		ImGui::Render();
+		const bool changed = cache.update(ImGui::GetDrawData(), true);
+		fullBytes += cache.getStats().fullUploadBytes;
+		retainedBytes += changed ? cache.getStats().uploadedBytes : 0;
+		skippedFrames += changed ? 0 : 1;
+		compactions += cache.getStats().compacted ? 1 : 0;
+	}
+	const double hashMs = timer.nsecsElapsed() / 1e6 / frameCount;
+	ImGui::DestroyContext(context);
+
+	qDebug().noquote() << QString("[ImGuiUpload] %1 frames of ShowDemoWindow (frames 200-299 move the mouse)").arg(frameCount);
+	qDebug().noquote() << QString("[ImGuiUpload] full upload: %1 KB/frame, retained: %2 KB/frame (%3%), %4 frames skipped, %5 buffer compactions, %6 ms/frame for UI build + hashing")
+		.arg(fullBytes / frameCount / 1024.0, 0, 'f', 1)
+		.arg(retainedBytes / frameCount / 1024.0, 0, 'f', 1)
+		.arg(100.0 * retainedBytes / qMax<qint64>(1, fullBytes), 0, 'f', 1)
+		.arg(skippedFrames)
+		.arg(compactions)
+		.arg(hashMs, 0, 'f', 3);
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(bool, RetainedBuffers) = true;
+private:
+	ImGuiContext* mContext = nullptr;
+	QImGuiInputFilter* mInputFilter = nullptr;
+	QImage mFontImage;
+	QImGuiDrawCache mDrawCache;
+	QSharedPointer<QRetainedImGuiPassBuilder> mImGuiPass{ new QRetainedImGuiPassBuilder };
+	QElapsedTimer mFrameTimer;
+	int mReportFrameCount = 0;
+	int mReportRenderedFrames = 0;
+	qint64 mReportUploadedBytes = 0;
+	qint64 mReportFullUploadBytes = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
+		mContext = ImGui::CreateContext();
+		ImGui::SetCurrentContext(mContext);
+		ImGui::GetIO().BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;		//允许drawIndexed使用顶点偏移，16位索引也能容纳大列表
+		mFontImage = buildFontImage();
+		mInputFilter = new QImGuiInputFilter(mContext);
+		qApp->installEventFilter(mInputFilter);
+		mFrameTimer.start();
+	}
+	~MyRenderer() {
+		qApp->removeEventFilter(mInputFilter);
+		delete mInputFilter;
+		ImGui::DestroyContext(mContext);
+	}
+private:
+	QSize buildImGuiFrame() {
+		ImGui::SetCurrentContext(mContext);
+		ImGuiIO& io = ImGui::GetIO();
+		QWindow* window = mInputFilter->getWindow();
+		const QSize windowSize = window ? window->size() : QSize(1280, 720);
+		const qreal dpr = window ? window->devicePixelRatio() : 1.0;
+		io.DisplaySize = ImVec2(windowSize.width(), windowSize.height());
+		io.DisplayFramebufferScale = ImVec2(dpr, dpr);
+		io.DeltaTime = qMax(1e-4f, mFrameTimer.restart() / 1000.0f);
+		ImGui::NewFrame();
+		ImGui::ShowStyleSelector("Style");
+		ImGui::ShowDemoWindow();
+		ImGui::Render();
+		mDrawCache.update(ImGui::GetDrawData(), RetainedBuffers);
+		return QSize(qMax(1, int(windowSize.width() * dpr)), qMax(1, int(windowSize.height() * dpr)));
+	}
+	void reportUploadStats() {
+		static const int FramesPerReport = 240;
+		mReportUploadedBytes += mImGuiPass->getStats().uploadedBytes;
+		mReportFullUploadBytes += mDrawCache.getStats().fullUploadBytes;
+		mReportRenderedFrames += mImGuiPass->getStats().rendered ? 1 : 0;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		qDebug().noquote() << QString("[ImGui] %1 KB uploaded per frame (full upload would be %2 KB), %3/%4 frames rendered, %5 draw lists reused last frame")
+			.arg(mReportUploadedBytes / FramesPerReport / 1024.0, 0, 'f', 1)
+			.arg(mReportFullUploadBytes / FramesPerReport / 1024.0, 0, 'f', 1)
+			.arg(mReportRenderedFrames)
+			.arg(FramesPerReport)
+			.arg(mDrawCache.getStats().reusedLists);
+		mReportFrameCount = mReportRenderedFrames = 0;
+		mReportUploadedBytes = mReportFullUploadBytes = 0;
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
-		QImGUIPassBuilder::Output imguiOut = graphBuilder.addPassBuilder<QImGUIPassBuilder>("MeshPass").
-			setPaintFunctor([](ImGuiContext* Ctx) {
-				ImGui::SetCurrentContext(Ctx);
-				ImGui::ShowStyleSelector("Style");
-				ImGui::ShowDemoWindow();
-			});
+		const QSize framebufferSize = buildImGuiFrame();
+
+		QRetainedImGuiPassBuilder::Output imguiOut = graphBuilder.addPassBuilder("ImGuiPass", mImGuiPass)
+			.setFramebufferSize(framebufferSize)
+			.setDrawData(ImGui::GetDrawData())
+			.setDrawCache(&mDrawCache)
+			.setFontImage(mFontImage);
 
 		QOutputPassBuilder::Output ret = graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
 			.setInitialTexture(imguiOut.ImGuiTexture);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportUploadStats();
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--imgui-upload-report")) {
+		runImGuiUploadReport();
+		return 0;
+	}
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
 
+#include "main.moc"
@@ -1,34 +1,657 @@
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
+#include "QtConcurrent/qtconcurrentrun.h"
+#include "QtConcurrent/qtconcurrentmap.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include "Render/IRenderer.h"
 #include "Render/RenderGraph/PassBuilder/QImGUIPassBuilder.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 即时模式的调试绘制：任意线程无锁提交，所有图元都展开为线段实例，每种模式一次实例化绘制
+class QDebugDraw {
+	struct Arena;
+public:
+	enum Mode {
+		DepthTest = 0,									//参与深度测试
+		Overlay = 1,									//始终绘制在最上层
+		ModeCount
+	};
+	struct LineInstance {
+		float start[3];
+		quint32 color;
+		float end[3];
+		float duration;									//提交时为持续时间（秒），转入常驻列表后为过期时间
+	};
+	struct Stats {
+		int frameLines[ModeCount] = {};
+		int persistentLines[ModeCount] = {};
+		qint64 droppedLines = 0;
+		qint64 allocatedBytes = 0;						//两块缓冲区实际分配的内存
+		double flushMs = 0.0;
+	};
+
+	// 写入器在生命周期内持有当前帧的缓冲区，批量提交时只需一次原子预留
+	class Writer {
+	public:
+		Writer(QDebugDraw* debugDraw)
+			: mDebugDraw(debugDraw)
+			, mArena(debugDraw->acquireArena())
+		{
+		}
+		~Writer() {
+			mArena->writers.fetch_sub(1, std::memory_order_release);
+		}
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		// 预留失败（超出已分配的容量）时返回nullptr，调用方直接丢弃这批图元
+		LineInstance* reserve(int count, Mode mode = DepthTest, float duration = 0.0f) {
+			const int list = listIndex(mode, duration);
+			const int capacity = mArena->allocated[list];
+			const int offset = mArena->reserved[list].fetch_add(count, std::memory_order_relaxed);
+			if (offset + count <= capacity)
+				return mArena->lines[list].get() + offset;
+			if (offset < capacity)							//跨越容量边界的部分填充为零长度线段，消费端按容量截断时不会读到未初始化的数据
+				memset(mArena->lines[list].get() + offset, 0, (capacity - offset) * sizeof(LineInstance));
+			mDebugDraw->mDroppedLines.fetch_add(count, std::memory_order_relaxed);
+			return nullptr;
+		}
+		void addLine(const QVector3D& start, const QVector3D& end, quint32 color, float duration = 0.0f, Mode mode = DepthTest) {
+			if (LineInstance* line = reserve(1, mode, duration))
+				setLine(*line, start, end, color, duration);
+		}
+		void addBox(const QVector3D& minimum, const QVector3D& maximum, quint32 color, float duration = 0.0f, Mode mode = DepthTest) {
+			LineInstance* lines = reserve(12, mode, duration);
+			if (!lines)
+				return;
+			QVector3D corners[8];
+			for (int i = 0; i < 8; i++)
+				corners[i] = QVector3D(i & 1 ? maximum.x() : minimum.x(), i & 2 ? maximum.y() : minimum.y(), i & 4 ? maximum.z() : minimum.z());
+			static const int Edges[12][2] = { {0,1},{2,3},{4,5},{6,7},{0,2},{1,3},{4,6},{5,7},{0,4},{1,5},{2,6},{3,7} };
+			for (int i = 0; i < 12; i++)
+				setLine(lines[i], corners[Edges[i][0]], corners[Edges[i][1]], color, duration);
+		}
+		// 三个正交的圆环近似球体
+		void addSphere(const QVector3D& center, float radius, quint32 color, int segments = 16, float duration = 0.0f, Mode mode = DepthTest) {
+			LineInstance* lines = reserve(segments * 3, mode, duration);
+			if (!lines)
+				return;
+			for (int i = 0; i < segments; i++) {
+				const float a0 = 2.0f * float(M_PI) * i / segments;
+				const float a1 = 2.0f * float(M_PI) * (i + 1) / segments;
+				const QVector2D p0(qCos(a0) * radius, qSin(a0) * radius);
+				const QVector2D p1(qCos(a1) * radius, qSin(a1) * radius);
+				setLine(lines[i], center + QVector3D(p0.x(), p0.y(), 0), center + QVector3D(p1.x(), p1.y(), 0), color, duration);
+				setLine(lines[segments + i], center + QVector3D(p0.x(), 0, p0.y()), center + QVector3D(p1.x(), 0, p1.y()), color, duration);
+				setLine(lines[segments * 2 + i], center + QVector3D(0, p0.x(), p0.y()), center + QVector3D(0, p1.x(), p1.y()), color, duration);
+			}
+		}
+		void addAxes(const QMatrix4x4& transform, float size, float duration = 0.0f, Mode mode = Overlay) {
+			LineInstance* lines = reserve(3, mode, duration);
+			if (!lines)
+				return;
+			const QVector3D origin = transform.map(QVector3D(0, 0, 0));
+			setLine(lines[0], origin, transform.map(QVector3D(size, 0, 0)), packColor(Qt::red), duration);
+			setLine(lines[1], origin, transform.map(QVector3D(0, size, 0)), packColor(Qt::green), duration);
+			setLine(lines[2], origin, transform.map(QVector3D(0, 0, size)), packColor(Qt::blue), duration);
+		}
+		static void setLine(LineInstance& line, const QVector3D& start, const QVector3D& end, quint32 color, float duration) {
+			line.start[0] = start.x();
+			line.start[1] = start.y();
+			line.start[2] = start.z();
+			line.color = color;
+			line.end[0] = end.x();
+			line.end[1] = end.y();
+			line.end[2] = end.z();
+			line.duration = duration;
+		}
+	private:
+		QDebugDraw* mDebugDraw;
+		Arena* mArena;
+	};
+
+	// capacity 为单帧列表的上限，缓冲区按实际提交量增长，不会一开始就按上限分配
+	QDebugDraw(int capacity = 1 << 20)
+		: mCapacity(capacity)
+	{
+		for (Arena& arena : mArenas) {
+			for (int list = 0; list < ListCount; list++)
+				growArena(arena, list, InitialCapacity);
+		}
+	}
+	static quint32 packColor(const QColor& color) {
+		return quint32(color.red()) | quint32(color.green()) << 8 | quint32(color.blue()) << 16 | quint32(color.alpha()) << 24;
+	}
+	void addLine(const QVector3D& start, const QVector3D& end, const QColor& color, float duration = 0.0f, Mode mode = DepthTest) {
+		Writer(this).addLine(start, end, packColor(color), duration, mode);
+	}
+	void addBox(const QVector3D& minimum, const QVector3D& maximum, const QColor& color, float duration = 0.0f, Mode mode = DepthTest) {
+		Writer(this).addBox(minimum, maximum, packColor(color), duration, mode);
+	}
+	void addSphere(const QVector3D& center, float radius, const QColor& color, float duration = 0.0f, Mode mode = DepthTest) {
+		Writer(this).addSphere(center, radius, packColor(color), 16, duration, mode);
+	}
+
+	// 由渲染线程每帧调用一次：切换到另一块缓冲区，等待仍在写入旧缓冲区的线程退出，然后合并常驻图元
+	// 即将启用的缓冲区此时没有写入者，上一帧的数据也已上传完毕，按之前观测到的提交量扩容；
+	// 提交量突增时，两块缓冲区各自扩容前的那一帧会丢弃超出的部分
+	void flush(double now) {
+		QElapsedTimer timer;
+		timer.start();
+		const int previous = mActive.load(std::memory_order_relaxed);
+		Arena& next = mArenas[previous ^ 1];
+		for (int list = 0; list < ListCount; list++)
+			growArena(next, list, mDemand[list]);
+		mActive.store(previous ^ 1, std::memory_order_seq_cst);
+		Arena& arena = mArenas[previous];
+		while (arena.writers.load(std::memory_order_acquire) != 0)
+			QThread::yieldCurrentThread();
+
+		for (int list = 0; list < ListCount; list++)
+			mDemand[list] = qMax(mDemand[list], arena.reserved[list].load(std::memory_order_relaxed));
+
+		mFrameArena = &arena;
+		for (int mode = 0; mode < ModeCount; mode++) {
+			mFrameCounts[mode] = qMin(arena.reserved[mode].load(std::memory_order_relaxed), arena.allocated[mode]);
+			arena.reserved[mode].store(0, std::memory_order_relaxed);
+
+			QVector<LineInstance>& persistent = mPersistent[mode];
+			persistent.erase(std::remove_if(persistent.begin(), persistent.end(), [now](const LineInstance& line) {
+				return line.duration <= now;
+			}), persistent.end());
+			const int timedList = mode + ModeCount;
+			const int timedCount = qMin(arena.reserved[timedList].load(std::memory_order_relaxed), arena.allocated[timedList]);
+			arena.reserved[timedList].store(0, std::memory_order_relaxed);
+			for (int i = 0; i < timedCount; i++) {
+				LineInstance line = arena.lines[timedList][i];
+				line.duration = now + line.duration;
+				persistent << line;
+			}
+			mStats.frameLines[mode] = mFrameCounts[mode];
+			mStats.persistentLines[mode] = persistent.size();
+		}
+		mStats.droppedLines = mDroppedLines.exchange(0, std::memory_order_relaxed);
+		mStats.allocatedBytes = 0;
+		for (const Arena& each : mArenas) {
+			for (int list = 0; list < ListCount; list++)
+				mStats.allocatedBytes += qint64(each.allocated[list]) * sizeof(LineInstance);
+		}
+		mStats.flushMs = timer.nsecsElapsed() / 1e6;
+	}
+	// 以下接口只在flush之后、下一次flush之前由渲染线程使用
+	int getLineCount(Mode mode) const {
+		return mFrameCounts[mode] + mPersistent[mode].size();
+	}
+	void copyLines(Mode mode, LineInstance* dst) const {
+		if (mFrameCounts[mode] > 0)
+			memcpy(dst, mFrameArena->lines[mode].get(), mFrameCounts[mode] * sizeof(LineInstance));
+		if (!mPersistent[mode].isEmpty())
+			memcpy(dst + mFrameCounts[mode], mPersistent[mode].constData(), mPersistent[mode].size() * sizeof(LineInstance));
+	}
+	const Stats& getStats() const { return mStats; }
+private:
+	enum {
+		ListCount = ModeCount * 2,						//每种模式分为单帧与带持续时间两个列表，单帧数据可以整块拷贝
+		InitialCapacity = 4096
+	};
+	struct Arena {
+		std::unique_ptr<LineInstance[]> lines[ListCount];
+		int allocated[ListCount] = {};					//只在缓冲区没有写入者时由渲染线程修改
+		std::atomic<int> reserved[ListCount] = {};
+		std::atomic<int> writers{ 0 };
+	};
+	static int listIndex(Mode mode, float duration) {
+		return duration > 0.0f ? mode + ModeCount : mode;
+	}
+	int listCapacity(int list) const {
+		return list < ModeCount ? mCapacity : qMax(1024, mCapacity / 16);
+	}
+	// 按2的幂扩容到 demand，不超过列表上限；旧数据已经无用，不需要拷贝
+	void growArena(Arena& arena, int list, int demand) {
+		const int capacity = qMin(int(qNextPowerOfTwo(quint32(qBound(1, demand, listCapacity(list)) - 1))), listCapacity(list));
+		if (capacity <= arena.allocated[list])
+			return;
+		arena.lines[list].reset(new LineInstance[capacity]);
+		arena.allocated[list] = capacity;
+	}
+	// 先登记写入者再确认缓冲区仍是当前帧的，flush切换后旧缓冲区不会再有新的写入者
+	Arena* acquireArena() {
+		for (;;) {
+			const int index = mActive.load(std::memory_order_seq_cst);
+			Arena& arena = mArenas[index];
+			arena.writers.fetch_add(1, std::memory_order_seq_cst);
+			if (mActive.load(std::memory_order_seq_cst) == index)
+				return &arena;
+			arena.writers.fetch_sub(1, std::memory_order_release);
+		}
+	}
+	const int mCapacity;
+	Arena mArenas[2];
+	std::atomic<int> mActive{ 0 };
+	std::atomic<qint64> mDroppedLines{ 0 };
+	const Arena* mFrameArena = nullptr;
+	int mFrameCounts[ModeCount] = {};
+	int mDemand[ListCount] = {};						//各列表观测到的最大提交量
+	QVector<LineInstance> mPersistent[ModeCount];
+	Stats mStats;
+};
+
+// 先绘制线段，最后把界面合成到最上层，调试线不会盖住界面
+class QDebugDrawPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QDebugDrawPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, UiTexture);		//透明背景上的界面，颜色已预乘alpha
+		QRP_INPUT_ATTR(QDebugDraw*, DebugDraw);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(float, LineWidth);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QDebugDrawPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float viewProjection[16];
+		float viewportSize[2];
+		float lineWidth;
+		float padding;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiRenderBufferRef mDepthStencil;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiSamplerRef mSampler;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mInstanceBuffer;
+	QRhiShaderResourceBindingsRef mUiBindings;
+	QRhiGraphicsPipelineRef mUiPipeline;
+	QRhiShaderResourceBindingsRef mLineBindings;
+	QRhiGraphicsPipelineRef mDepthTestPipeline;
+	QRhiGraphicsPipelineRef mOverlayPipeline;
+	QShader mUiFS;
+	QShader mLineVS;
+	QShader mLineFS;
+	int mInstanceCapacity = 0;
+	double mUploadMs = 0.0;
+public:
+	QDebugDrawPassBuilder() {
+		mUiFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uUi;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = texture(uUi, vUV);
+			}
+		)");
+		mLineVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inStart;
+			layout (location = 1) in vec4 inColor;
+			layout (location = 2) in vec3 inEnd;
+			layout (std140, binding = 0) uniform UniformBlock {
+				mat4 viewProjection;
+				vec2 viewportSize;
+				float lineWidth;
+				float padding;
+			} ubo;
+			layout (location = 0) out vec4 vColor;
+			out gl_PerVertex { vec4 gl_Position; };
+			const vec2 corners[6] = vec2[](vec2(0, -1), vec2(1, -1), vec2(0, 1), vec2(0, 1), vec2(1, -1), vec2(1, 1));
+			const float NearW = 1e-3;
+			void main() {
+				vec2 corner = corners[gl_VertexIndex];
+				vec4 a = ubo.viewProjection * vec4(inStart, 1.0);
+				vec4 b = ubo.viewProjection * vec4(inEnd, 1.0);
+				if (a.w < NearW && b.w < NearW) {
+					gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+					return;
+				}
+				if (a.w < NearW)									//穿过相机平面的线段先裁剪，避免透视除法翻转
+					a = mix(a, b, (NearW - a.w) / (b.w - a.w));
+				if (b.w < NearW)
+					b = mix(b, a, (NearW - b.w) / (a.w - b.w));
+				vec2 direction = (b.xy / b.w - a.xy / a.w) * ubo.viewportSize;
+				direction = dot(direction, direction) > 1e-10 ? normalize(direction) : vec2(1.0, 0.0);
+				vec2 normal = vec2(-direction.y, direction.x);
+				vec4 position = corner.x < 0.5 ? a : b;
+				position.xy += normal * corner.y * ubo.lineWidth / ubo.viewportSize * position.w;		//在屏幕空间扩展为固定像素宽度的四边形
+				gl_Position = position;
+				vColor = inColor;
+			}
+		)");
+		mLineFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (location = 0) in vec4 vColor;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = vColor;
+			}
+		)");
+	}
+	double getUploadMs() const { return mUploadMs; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QDebugDraw* debugDraw = mInput._DebugDraw;
+		const int lineCount = debugDraw->getLineCount(QDebugDraw::DepthTest) + debugDraw->getLineCount(QDebugDraw::Overlay);
+		if (mInstanceCapacity < lineCount || mInstanceCapacity == 0)			//按2的幂增长，避免每帧重建缓冲区
+			mInstanceCapacity = qNextPowerOfTwo(quint32(qMax(lineCount, 4096)));
+		const QSize size = mInput._UiTexture->pixelSize();
+
+		builder.setupTexture(mColorAttachment, "DebugDrawColor", mInput._UiTexture->format(), size, 1, QRhiTexture::RenderTarget);
+		builder.setupRenderBuffer(mDepthStencil, "DebugDrawDepthStencil", QRhiRenderBuffer::DepthStencil, size);
+		QRhiTextureRenderTargetDescription renderTargetDesc(mColorAttachment.get());
+		renderTargetDesc.setDepthStencilBuffer(mDepthStencil.get());
+		builder.setupRenderTarget(mRenderTarget, "DebugDrawRT", renderTargetDesc);
+		builder.setupSampler(mSampler, "DebugDrawSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupBuffer(mUniformBuffer, "DebugDrawUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mInstanceBuffer, "DebugDrawInstanceBuffer", QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, sizeof(QDebugDraw::LineInstance) * mInstanceCapacity);
+
+		builder.setupShaderResourceBindings(mUiBindings, "DebugDrawUiBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mInput._UiTexture.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipeline::TargetBlend premultipliedBlend;
+		premultipliedBlend.enable = true;
+		premultipliedBlend.srcColor = QRhiGraphicsPipeline::One;
+		premultipliedBlend.dstColor = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		premultipliedBlend.srcAlpha = QRhiGraphicsPipeline::One;
+		premultipliedBlend.dstAlpha = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		QRhiGraphicsPipelineState uiPSO;
+		uiPSO.shaderResourceBindings = mUiBindings.get();
+		uiPSO.sampleCount = mRenderTarget->sampleCount();
+		uiPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		uiPSO.targetBlends = { premultipliedBlend };
+		uiPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mUiFS),
+		};
+		builder.setupGraphicsPipeline(mUiPipeline, "DebugDrawUiPipeline", uiPSO);
+
+		builder.setupShaderResourceBindings(mLineBindings, "DebugDrawLineBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mUniformBuffer.get()),
+		});
+		QRhiGraphicsPipelineState linePSO;
+		linePSO.shaderResourceBindings = mLineBindings.get();
+		linePSO.sampleCount = mRenderTarget->sampleCount();
+		linePSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(sizeof(QDebugDraw::LineInstance), QRhiVertexInputBinding::PerInstance),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, offsetof(QDebugDraw::LineInstance, start)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::UNormByte4, offsetof(QDebugDraw::LineInstance, color)),
+			QRhiVertexInputAttribute(0, 2, QRhiVertexInputAttribute::Float3, offsetof(QDebugDraw::LineInstance, end)),
+		});
+		linePSO.vertexInputLayout = inputLayout;
+		linePSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mLineVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mLineFS),
+		};
+		linePSO.depthTest = true;
+		linePSO.depthWrite = true;
+		builder.setupGraphicsPipeline(mDepthTestPipeline, "DebugDrawDepthTestPipeline", linePSO);
+		linePSO.depthTest = false;
+		linePSO.depthWrite = false;
+		builder.setupGraphicsPipeline(mOverlayPipeline, "DebugDrawOverlayPipeline", linePSO);
+
+		mOutput.Result = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QDebugDraw* debugDraw = mInput._DebugDraw;
+		const int depthTestCount = debugDraw->getLineCount(QDebugDraw::DepthTest);
+		const int overlayCount = debugDraw->getLineCount(QDebugDraw::Overlay);
+		const QSize size = mRenderTarget->pixelSize();
+
+		UniformBlock ubo;
+		const QMatrix4x4 viewProjection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+		memcpy(ubo.viewProjection, viewProjection.constData(), sizeof(ubo.viewProjection));
+		ubo.viewportSize[0] = size.width();
+		ubo.viewportSize[1] = size.height();
+		ubo.lineWidth = mInput._LineWidth;
+		ubo.padding = 0.0f;
+
+		// 直接写入当前帧槽位的映射内存（Dynamic缓冲区在每个飞行帧各有一份，构成环形缓冲），省去中间拷贝
+		QElapsedTimer timer;
+		timer.start();
+		if (depthTestCount + overlayCount > 0) {
+			QDebugDraw::LineInstance* mapped = reinterpret_cast<QDebugDraw::LineInstance*>(mInstanceBuffer->beginFullDynamicBufferUpdateForCurrentFrame());
+			debugDraw->copyLines(QDebugDraw::DepthTest, mapped);
+			debugDraw->copyLines(QDebugDraw::Overlay, mapped + depthTestCount);
+			mInstanceBuffer->endFullDynamicBufferUpdateForCurrentFrame();
+		}
+		mUploadMs = timer.nsecsElapsed() / 1e6;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f), { 1.0f, 0 }, batch);
+		cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+		const QRhiCommandBuffer::VertexInput instanceInput(mInstanceBuffer.get(), 0);
+		if (depthTestCount > 0) {
+			cmdBuffer->setGraphicsPipeline(mDepthTestPipeline.get());
+			cmdBuffer->setShaderResources(mLineBindings.get());
+			cmdBuffer->setVertexInput(0, 1, &instanceInput);
+			cmdBuffer->draw(6, depthTestCount);
+		}
+		if (overlayCount > 0) {
+			cmdBuffer->setGraphicsPipeline(mOverlayPipeline.get());
+			cmdBuffer->setShaderResources(mLineBindings.get());
+			cmdBuffer->setVertexInput(0, 1, &instanceInput);
+			cmdBuffer->draw(6, overlayCount, 0, depthTestCount);
+		}
+		cmdBuffer->setGraphicsPipeline(mUiPipeline.get());
+		cmdBuffer->setShaderResources(mUiBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+// 生成一段用于演示和基准测试的螺旋线，每个工作线程负责其中一段
+static void submitSpiral(QDebugDraw::Writer& writer, int first, int count, int total, float time) {
+	QDebugDraw::LineInstance* lines = writer.reserve(count);
+	if (!lines)
+		return;
+	for (int i = 0; i < count; i++) {
+		const int index = first + i;
+		const float t0 = float(index) / total;
+		const float t1 = float(index + 1) / total;
+		const float angle0 = t0 * 200.0f + time;
+		const float angle1 = t1 * 200.0f + time;
+		const QVector3D start(qCos(angle0) * (2.0f + t0 * 20.0f), t0 * 30.0f - 15.0f, qSin(angle0) * (2.0f + t0 * 20.0f));
+		const QVector3D end(qCos(angle1) * (2.0f + t1 * 20.0f), t1 * 30.0f - 15.0f, qSin(angle1) * (2.0f + t1 * 20.0f));
+		const quint32 color = 0xFF000000 | quint32(t0 * 255) | quint32((1.0f - t0) * 255) << 16 | 0x8000;
+		QDebugDraw::Writer::setLine(lines[i], start, end, color, 0.0f);
+	}
+}
+
+// 不依赖窗口的CPU基准：多线程每帧提交100万条线段，统计提交、切换与拷贝到映射内存的耗时
+static void runDebugDrawBenchmark() {
+	const int lineCount = 1000000;
+	const int frameCount = 30;
+	const int warmupFrames = 2;												//两块缓冲区各需一帧扩容到实际提交量，不计入统计
+	const int threadCount = qMax(1, QThread::idealThreadCount());
+	QDebugDraw debugDraw(1 << 20);
+	QByteArray mapped(lineCount * sizeof(QDebugDraw::LineInstance), Qt::Uninitialized);
+	QVector<int> chunks;
+	const int chunkSize = (lineCount + threadCount - 1) / threadCount;
+	for (int first = 0; first < lineCount; first += chunkSize)
+		chunks << first;
+
+	for (int bulk = 1; bulk >= 0; bulk--) {
+		double submitMs = 0.0;
+		double flushMs = 0.0;
+		double copyMs = 0.0;
+		for (int frame = -warmupFrames; frame < frameCount; frame++) {
+			if (frame == 0)
+				submitMs = flushMs = copyMs = 0.0;
+			QElapsedTimer timer;
+			timer.start();
+			QtConcurrent::blockingMap(chunks, [&](int first) {
+				const int count = qMin(chunkSize, lineCount - first);
+				if (bulk) {
+					QDebugDraw::Writer writer(&debugDraw);
+					submitSpiral(writer, first, count, lineCount, frame * 0.1f);
+				}
+				else {
+					for (int i = 0; i < count; i++)
+						debugDraw.addLine(QVector3D(first + i, 0, 0), QVector3D(first + i, 1, 0), Qt::white);
+				}
+			});
+			submitMs += timer.nsecsElapsed() / 1e6;
+			timer.restart();
+			debugDraw.flush((frame + warmupFrames) / 60.0);
+			flushMs += timer.nsecsElapsed() / 1e6;
+			timer.restart();
+			debugDraw.copyLines(QDebugDraw::DepthTest, reinterpret_cast<QDebugDraw::LineInstance*>(mapped.data()));
+			copyMs += timer.nsecsElapsed() / 1e6;
+		}
+		qDebug().noquote() << QString("[DebugDrawBenchmark] %1 lines/frame from %2 threads (%3): submit %4 ms, flush %5 ms, copy %6 ms (%7 MB), %8 dropped, %9 MB allocated")
+			.arg(debugDraw.getLineCount(QDebugDraw::DepthTest))
+			.arg(chunks.size())
+			.arg(bulk ? "bulk reserve" : "addLine per segment")
+			.arg(submitMs / frameCount, 0, 'f', 2)
+			.arg(flushMs / frameCount, 0, 'f', 3)
+			.arg(copyMs / frameCount, 0, 'f', 2)
+			.arg(debugDraw.getLineCount(QDebugDraw::DepthTest) * sizeof(QDebugDraw::LineInstance) / 1048576.0, 0, 'f', 1)
+			.arg(debugDraw.getStats().droppedLines)
+			.arg(debugDraw.getStats().allocatedBytes / 1048576.0, 0, 'f', 1);
+	}
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, SpiralLines) = 100000;
+	Q_PROPERTY_VAR(int, WorkerThreads) = 4;
+	Q_PROPERTY_VAR(float, LineWidth) = 1.5f;
+	Q_PROPERTY_VAR(bool, DrawBounds) = true;
+
+	Q_CLASSINFO("SpiralLines", "Min=0,Max=1000000")
+	Q_CLASSINFO("WorkerThreads", "Min=1,Max=16")
+	Q_CLASSINFO("LineWidth", "Min=1,Max=8")
+private:
+	QDebugDraw mDebugDraw;
+	QSharedPointer<QDebugDrawPassBuilder> mDebugDrawPass{ new QDebugDrawPassBuilder };
+	QElapsedTimer mTimer;
+	double mNextTimedPrimitive = 0.0;
+	double mSubmitMs = 0.0;
+	int mReportFrameCount = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
+		getCamera()->setPosition(QVector3D(0, 10, 60));
+		mTimer.start();
+	}
+private:
+	void submitSceneBounds(double now) {
+		QDebugDraw::Writer writer(&mDebugDraw);
+		if (DrawBounds) {
+			for (int x = -2; x <= 2; x++) {
+				for (int z = -2; z <= 2; z++) {
+					const QVector3D center(x * 12.0f, -18.0f, z * 12.0f);
+					writer.addBox(center - QVector3D(4, 2, 4), center + QVector3D(4, 2, 4), QDebugDraw::packColor(QColor(80, 200, 255)));
+					writer.addSphere(center + QVector3D(0, 4, 0), 2.0f + qSin(now + x + z), QDebugDraw::packColor(QColor(255, 200, 80)));
+				}
+			}
+		}
+		writer.addAxes(QMatrix4x4(), 10.0f);
+		if (now >= mNextTimedPrimitive) {											//带持续时间的图元只提交一次，由调试绘制负责保留和过期
+			const QVector3D center(qCos(now) * 20.0f, 20.0f, qSin(now) * 20.0f);
+			writer.addSphere(center, 1.5f, QDebugDraw::packColor(Qt::magenta), 12, 3.0f, QDebugDraw::Overlay);
+			mNextTimedPrimitive = now + 0.25;
+		}
+	}
+	// 工作线程与渲染线程同时提交，flush之前全部完成
+	void submitDebugPrimitives() {
+		const double now = mTimer.elapsed() / 1000.0;
+		QElapsedTimer timer;
+		timer.start();
+		const int lineCount = qBound(0, SpiralLines, 1000000);
+		const int threadCount = qBound(1, WorkerThreads, 16);
+		QVector<int> chunks;
+		const int chunkSize = qMax(1, (lineCount + threadCount - 1) / threadCount);
+		for (int first = 0; first < lineCount; first += chunkSize)
+			chunks << first;
+		QFuture<void> future = QtConcurrent::map(chunks, [this, lineCount, chunkSize, now](int first) {
+			QDebugDraw::Writer writer(&mDebugDraw);
+			submitSpiral(writer, first, qMin(chunkSize, lineCount - first), lineCount, now);
+		});
+
+		submitSceneBounds(now);
+		future.waitForFinished();
+		mSubmitMs = timer.nsecsElapsed() / 1e6;
+		mDebugDraw.flush(now);
+	}
+	void reportDebugDrawStats() {
+		static const int FramesPerReport = 240;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		mReportFrameCount = 0;
+		const QDebugDraw::Stats& stats = mDebugDraw.getStats();
+		qDebug().noquote() << QString("[DebugDraw] %1 depth-tested + %2 overlay lines (%3 persistent) in 2 draws, submit %4 ms, flush %5 ms, upload %6 ms, %7 dropped, %8 MB allocated")
+			.arg(mDebugDraw.getLineCount(QDebugDraw::DepthTest))
+			.arg(mDebugDraw.getLineCount(QDebugDraw::Overlay))
+			.arg(stats.persistentLines[QDebugDraw::DepthTest] + stats.persistentLines[QDebugDraw::Overlay])
+			.arg(mSubmitMs, 0, 'f', 2)
+			.arg(stats.flushMs, 0, 'f', 3)
+			.arg(mDebugDrawPass->getUploadMs(), 0, 'f', 2)
+			.arg(stats.droppedLines)
+			.arg(stats.allocatedBytes / 1048576.0, 0, 'f', 1);
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		submitDebugPrimitives();
+
 		QImGUIPassBuilder::Output imguiOut = graphBuilder.addPassBuilder<QImGUIPassBuilder>("MeshPass").
-			setPaintFunctor([](ImGuiContext* Ctx) {
+			setPaintFunctor([this](ImGuiContext* Ctx) {
 				ImGui::SetCurrentContext(Ctx);
 				ImGui::ShowStyleSelector("Style");
-				ImGui::ShowDemoWindow();
+				const QDebugDraw::Stats& stats = mDebugDraw.getStats();
+				ImGui::Begin("DebugDraw");
+				ImGui::Text("Depth-tested lines: %d", mDebugDraw.getLineCount(QDebugDraw::DepthTest));
+				ImGui::Text("Overlay lines: %d", mDebugDraw.getLineCount(QDebugDraw::Overlay));
+				ImGui::Text("Persistent lines: %d", stats.persistentLines[QDebugDraw::DepthTest] + stats.persistentLines[QDebugDraw::Overlay]);
+				ImGui::Text("Submit: %.2f ms  Flush: %.3f ms  Upload: %.2f ms", mSubmitMs, stats.flushMs, mDebugDrawPass->getUploadMs());
+				ImGui::Text("Dropped: %lld  Allocated: %.1f MB", stats.droppedLines, stats.allocatedBytes / 1048576.0);
+				ImGui::End();
 			});
 
+		QDebugDrawPassBuilder::Output debugOut = graphBuilder.addPassBuilder("DebugDrawPass", mDebugDrawPass)
+			.setUiTexture(imguiOut.ImGuiTexture)
+			.setDebugDraw(&mDebugDraw)
+			.setViewMatrix(getCamera()->getViewMatrix())
+			.setProjectionMatrix(getCamera()->getProjectionMatrix())
+			.setLineWidth(LineWidth);
+
 		QOutputPassBuilder::Output ret = graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(imguiOut.ImGuiTexture);
+			.setInitialTexture(debugOut.Result);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportDebugDrawStats();
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--debug-draw-benchmark")) {
+		runDebugDrawBenchmark();
+		return 0;
+	}
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
 
+#include "main.moc"
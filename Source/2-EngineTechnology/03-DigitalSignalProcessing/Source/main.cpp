@@ -1,42 +1,1541 @@
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
 #include "QtConcurrent/qtconcurrentrun.h"
-#include "Render/Component/Derived/QSpectrumRenderComponent.h"
-#include "Render/Component/QStaticMeshRenderComponent.h"
+#include <QAudioDecoder>
+#include <QAudioOutput>
+#include <QElapsedTimer>
+#include <QMediaDevices>
+#include <QMediaPlayer>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include "Render/IRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <immintrin.h>
+#define QFFT_SSE 1
+#else
+#define QFFT_SSE 0
+#endif
+
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 单生产者单消费者的无锁PCM环形缓冲：容量为2的幂，读写位置各自只由一个线程修改
+class QPcmRingBuffer {
+public:
+	QPcmRingBuffer(int capacity) {
+		mCapacity = qNextPowerOfTwo(quint32(capacity - 1));
+		mData.resize(mCapacity);
+	}
+	int push(const float* samples, int count) {
+		const quint64 writePosition = mWrite.load(std::memory_order_relaxed);
+		const quint64 readPosition = mRead.load(std::memory_order_acquire);
+		count = qMin<int>(count, mCapacity - int(writePosition - readPosition));
+		writeAt(writePosition, samples, count);
+		mWrite.store(writePosition + count, std::memory_order_release);
+		return count;
+	}
+	int pop(float* samples, int count) {
+		const quint64 readPosition = mRead.load(std::memory_order_relaxed);
+		const quint64 writePosition = mWrite.load(std::memory_order_acquire);
+		count = qMin<int>(count, int(writePosition - readPosition));
+		readAt(readPosition, samples, count);
+		mRead.store(readPosition + count, std::memory_order_release);
+		return count;
+	}
+	int available() const {
+		return int(mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire));
+	}
+	int capacity() const { return mCapacity; }
+private:
+	// 环绕时分两段拷贝
+	void writeAt(quint64 position, const float* src, int count) {
+		const int begin = int(position & (mCapacity - 1));
+		const int first = qMin(count, mCapacity - begin);
+		memcpy(mData.data() + begin, src, first * sizeof(float));
+		memcpy(mData.data(), src + first, (count - first) * sizeof(float));
+	}
+	void readAt(quint64 position, float* dst, int count) const {
+		const int begin = int(position & (mCapacity - 1));
+		const int first = qMin(count, mCapacity - begin);
+		memcpy(dst, mData.constData() + begin, first * sizeof(float));
+		memcpy(dst + first, mData.constData(), (count - first) * sizeof(float));
+	}
+	int mCapacity = 0;
+	QVector<float> mData;
+	alignas(64) std::atomic<quint64> mWrite{ 0 };			//读写位置放在不同的缓存行，避免伪共享
+	alignas(64) std::atomic<quint64> mRead{ 0 };
+};
+
+// 基2 Stockham自动排序FFT（实部与虚部分开存放），不需要位逆序重排，内层循环连续访问便于SIMD；
+// 实数FFT通过N/2点复数FFT加一次后处理得到
+class QRealFft {
+public:
+	void setSize(int size) {
+		if (size == mSize)
+			return;
+		mSize = size;
+		const int half = size / 2;
+		mTwiddleRe.clear();
+		mTwiddleIm.clear();
+		for (int n = half; n > 1; n /= 2) {							//每一级的旋转因子连续存放
+			for (int p = 0; p < n / 2; p++) {
+				const double angle = 2.0 * M_PI * p / n;
+				mTwiddleRe << float(qCos(angle));
+				mTwiddleIm << float(-qSin(angle));
+			}
+		}
+		mPostRe.resize(half + 1);
+		mPostIm.resize(half + 1);
+		for (int k = 0; k <= half; k++) {
+			const double angle = 2.0 * M_PI * k / size;
+			mPostRe[k] = float(qCos(angle));
+			mPostIm[k] = float(-qSin(angle));
+		}
+		for (QVector<float>& work : mWork)
+			work.resize(half);
+	}
+	int getSize() const { return mSize; }
+
+	// 输入size个实数样本，输出size/2+1个频点的功率|X|²
+	void powerSpectrum(const float* input, float* power, bool simd) {
+		const int half = mSize / 2;
+		float* re = mWork[0].data();
+		float* im = mWork[1].data();
+		for (int i = 0; i < half; i++) {								//偶数样本作实部，奇数样本作虚部
+			re[i] = input[2 * i];
+			im[i] = input[2 * i + 1];
+		}
+		const float* outRe = nullptr;
+		const float* outIm = nullptr;
+		transform(simd, outRe, outIm);
+		for (int k = 0; k <= half; k++) {
+			const int a = k == half ? 0 : k;
+			const int b = k == 0 ? 0 : half - k;
+			const float zr = outRe[a], zi = outIm[a];
+			const float cr = outRe[b], ci = -outIm[b];
+			const float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);				//偶数部分 (Z[k] + conj(Z[M-k])) / 2
+			const float oddRe = 0.5f * (zi - ci), oddIm = -0.5f * (zr - cr);		//奇数部分 -i(Z[k] - conj(Z[M-k])) / 2
+			const float xr = er + mPostRe[k] * oddRe - mPostIm[k] * oddIm;
+			const float xi = ei + mPostRe[k] * oddIm + mPostIm[k] * oddRe;
+			power[k] = xr * xr + xi * xi;
+		}
+	}
+private:
+	void transform(bool simd, const float*& outRe, const float*& outIm) {
+		float* xr = mWork[0].data();
+		float* xi = mWork[1].data();
+		float* yr = mWork[2].data();
+		float* yi = mWork[3].data();
+		const float* twiddleRe = mTwiddleRe.constData();
+		const float* twiddleIm = mTwiddleIm.constData();
+		for (int n = mSize / 2, s = 1; n > 1; n /= 2, s *= 2) {
+			const int m = n / 2;
+			for (int p = 0; p < m; p++) {
+				const float wr = twiddleRe[p];
+				const float wi = twiddleIm[p];
+				const float* ar = xr + s * p;
+				const float* ai = xi + s * p;
+				const float* br = xr + s * (p + m);
+				const float* bi = xi + s * (p + m);
+				float* sumRe = yr + s * 2 * p;
+				float* sumIm = yi + s * 2 * p;
+				float* diffRe = yr + s * (2 * p + 1);
+				float* diffIm = yi + s * (2 * p + 1);
+				int q = 0;
+#if QFFT_SSE
+				if (simd) {														//步长s >= 4之后每次处理4个蝶形
+					const __m128 vwr = _mm_set1_ps(wr);
+					const __m128 vwi = _mm_set1_ps(wi);
+					for (; q + 4 <= s; q += 4) {
+						const __m128 var = _mm_loadu_ps(ar + q), vai = _mm_loadu_ps(ai + q);
+						const __m128 vbr = _mm_loadu_ps(br + q), vbi = _mm_loadu_ps(bi + q);
+						_mm_storeu_ps(sumRe + q, _mm_add_ps(var, vbr));
+						_mm_storeu_ps(sumIm + q, _mm_add_ps(vai, vbi));
+						const __m128 dr = _mm_sub_ps(var, vbr), di = _mm_sub_ps(vai, vbi);
+						_mm_storeu_ps(diffRe + q, _mm_sub_ps(_mm_mul_ps(dr, vwr), _mm_mul_ps(di, vwi)));
+						_mm_storeu_ps(diffIm + q, _mm_add_ps(_mm_mul_ps(dr, vwi), _mm_mul_ps(di, vwr)));
+					}
+				}
+#endif
+				for (; q < s; q++) {
+					const float dr = ar[q] - br[q], di = ai[q] - bi[q];
+					sumRe[q] = ar[q] + br[q];
+					sumIm[q] = ai[q] + bi[q];
+					diffRe[q] = dr * wr - di * wi;
+					diffIm[q] = dr * wi + di * wr;
+				}
+			}
+			twiddleRe += m;
+			twiddleIm += m;
+			std::swap(xr, yr);
+			std::swap(xi, yi);
+		}
+		outRe = xr;
+		outIm = xi;
+	}
+	int mSize = 0;
+	QVector<float> mTwiddleRe;
+	QVector<float> mTwiddleIm;
+	QVector<float> mPostRe;
+	QVector<float> mPostIm;
+	QVector<float> mWork[4];
+};
+
+// 一帧频谱分析：Hann窗 → 实数FFT → 对数频率分组 → dB归一化
+class QSpectrumAnalysis {
+public:
+	static constexpr float MinFrequency = 20.0f;
+	static constexpr float MinDecibel = -80.0f;
+
+	void setup(int fftSize, int sampleRate, int barCount) {
+		if (fftSize == mFft.getSize() && sampleRate == mSampleRate && barCount == mBars.size())
+			return;
+		mFft.setSize(fftSize);
+		mSampleRate = sampleRate;
+		mWindow.resize(fftSize);
+		float windowSum = 0.0f;
+		for (int i = 0; i < fftSize; i++) {
+			mWindow[i] = 0.5f - 0.5f * qCos(2.0f * float(M_PI) * i / (fftSize - 1));
+			windowSum += mWindow[i];
+		}
+		mPowerScale = 4.0f / (windowSum * windowSum);						//单边幅度谱的归一化，满幅正弦约为0dB
+		mWindowed.resize(fftSize);
+		mPower.resize(fftSize / 2 + 1);
+		mBars.resize(barCount);
+		const float maxFrequency = qMin(20000.0f, sampleRate * 0.5f);
+		const float binWidth = float(sampleRate) / fftSize;
+		for (int b = 0; b < barCount; b++) {								//各频段在对数轴上等宽
+			Bar& bar = mBars[b];
+			const float low = MinFrequency * qPow(maxFrequency / MinFrequency, float(b) / barCount);
+			const float high = MinFrequency * qPow(maxFrequency / MinFrequency, float(b + 1) / barCount);
+			bar.firstBin = qBound(0, int(qCeil(low / binWidth)), fftSize / 2);
+			bar.lastBin = qBound(0, int(high / binWidth), fftSize / 2);
+			bar.center = qSqrt(low * high) / binWidth;
+		}
+	}
+	int getFftSize() const { return mFft.getSize(); }
+	int getBarCount() const { return mBars.size(); }
+
+	void analyze(const float* samples, float* levels, bool simd) {
+		const int size = mFft.getSize();
+		for (int i = 0; i < size; i++)
+			mWindowed[i] = samples[i] * mWindow[i];
+		mFft.powerSpectrum(mWindowed.constData(), mPower.data(), simd);
+		const float* power = mPower.constData();
+		for (int b = 0; b < mBars.size(); b++) {
+			const Bar& bar = mBars[b];
+			float value = 0.0f;
+			if (bar.lastBin >= bar.firstBin) {
+				for (int k = bar.firstBin; k <= bar.lastBin; k++)
+					value = qMax(value, power[k]);
+			}
+			else {																//低频段窄于一个频点，在相邻频点间插值
+				const int k = qMin(int(bar.center), size / 2 - 1);
+				const float t = bar.center - k;
+				value = power[k] + (power[k + 1] - power[k]) * t;
+			}
+			const float decibel = 10.0f * log10f(value * mPowerScale + 1e-12f);
+			levels[b] = qBound(0.0f, 1.0f - decibel / MinDecibel, 1.0f);
+		}
+	}
+private:
+	struct Bar {
+		int firstBin = 0;
+		int lastBin = 0;
+		float center = 0.0f;
+	};
+	QRealFft mFft;
+	int mSampleRate = 0;
+	float mPowerScale = 1.0f;
+	QVector<float> mWindow;
+	QVector<float> mWindowed;
+	QVector<float> mPower;
+	QVector<Bar> mBars;
+};
+
+// 无锁三缓冲：分析线程随时发布最新结果，渲染线程随时取走，双方都不会读写对方正在使用的缓冲
+class QSpectrumTripleBuffer {
+public:
+	QVector<float>& back() { return mBuffers[mBack]; }
+	void publish() {
+		mBack = mMiddle.exchange(mBack | DirtyBit, std::memory_order_acq_rel) & IndexMask;
+	}
+	bool fetch() {
+		if (!(mMiddle.load(std::memory_order_relaxed) & DirtyBit))
+			return false;
+		mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+	const QVector<float>& front() const { return mBuffers[mFront]; }
+private:
+	enum {
+		IndexMask = 3,
+		DirtyBit = 4
+	};
+	QVector<float> mBuffers[3];
+	std::atomic<int> mMiddle{ 1 };
+	int mBack = 0;
+	int mFront = 2;
+};
+
+// 解码线程：QAudioDecoder的结果混为单声道浮点后写入环形缓冲，缓冲写满时先暂存在本线程
+// 暂存超过MaxPendingSamples时推迟read()，由分析线程的消费速度反压解码，而不是把整首曲子解进内存
+class QAudioDecodeThread : public QThread {
+public:
+	static const int MaxPendingSamples = 1 << 17;
+	QAudioDecodeThread(const QString& path, QPcmRingBuffer* ring)
+		: mPath(path)
+		, mRing(ring)
+	{
+	}
+	int getSampleRate() const { return mSampleRate.load(std::memory_order_acquire); }
+	bool isEndOfStream() const { return mEndOfStream.load(std::memory_order_acquire); }
+protected:
+	void run() override {
+		QAudioDecoder decoder;
+		QVector<float> pending;
+		int pendingOffset = 0;
+		bool decoded = false;
+		bool readDeferred = false;
+		auto readBuffer = [&]() {
+			const QAudioBuffer buffer = decoder.read();
+			if (!buffer.isValid())
+				return;
+			appendMono(buffer, pending);
+			mSampleRate.store(buffer.format().sampleRate(), std::memory_order_release);
+		};
+		QObject::connect(&decoder, &QAudioDecoder::bufferReady, [&]() {
+			if (pending.size() - pendingOffset < MaxPendingSamples)
+				readBuffer();
+			else
+				readDeferred = true;												//FFmpeg后端在read()之后才解码下一块，不读即暂停
+		});
+		QObject::connect(&decoder, &QAudioDecoder::finished, [&]() {
+			decoded = true;
+		});
+		QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), [&](QAudioDecoder::Error) {
+			qWarning() << "[Spectrum] decode error:" << decoder.errorString();
+			decoded = true;
+		});
+		QTimer drainTimer;
+		drainTimer.setInterval(2);
+		QObject::connect(&drainTimer, &QTimer::timeout, [&]() {
+			if (isInterruptionRequested()) {
+				quit();
+				return;
+			}
+			pendingOffset += mRing->push(pending.constData() + pendingOffset, pending.size() - pendingOffset);
+			if (pendingOffset >= MaxPendingSamples) {							//定期回收已经写入环形缓冲的部分
+				pending.remove(0, pendingOffset);
+				pendingOffset = 0;
+			}
+			if (readDeferred && pending.size() - pendingOffset < MaxPendingSamples / 2) {
+				readDeferred = false;
+				if (decoder.bufferAvailable())
+					readBuffer();
+			}
+			if (decoded && !readDeferred && !decoder.bufferAvailable() && pendingOffset == pending.size()) {
+				mEndOfStream.store(true, std::memory_order_release);
+				quit();
+			}
+		});
+		decoder.setSource(QUrl::fromLocalFile(mPath));
+		decoder.start();
+		drainTimer.start();
+		exec();
+	}
+private:
+	static void appendMono(const QAudioBuffer& buffer, QVector<float>& output) {
+		const QAudioFormat format = buffer.format();
+		const int channels = qMax(1, format.channelCount());
+		const int frames = buffer.frameCount();
+		const int offset = output.size();
+		output.resize(offset + frames);
+		float* dst = output.data() + offset;
+		auto downmix = [&](auto* src, float scale, float bias) {
+			for (int i = 0; i < frames; i++) {
+				float sum = 0.0f;
+				for (int c = 0; c < channels; c++)
+					sum += float(src[i * channels + c]) * scale + bias;
+				dst[i] = sum / channels;
+			}
+		};
+		switch (format.sampleFormat()) {
+		case QAudioFormat::UInt8: downmix(buffer.constData<quint8>(), 1.0f / 128.0f, -1.0f); break;
+		case QAudioFormat::Int16: downmix(buffer.constData<qint16>(), 1.0f / 32768.0f, 0.0f); break;
+		case QAudioFormat::Int32: downmix(buffer.constData<qint32>(), 1.0f / 2147483648.0f, 0.0f); break;
+		case QAudioFormat::Float: downmix(buffer.constData<float>(), 1.0f, 0.0f); break;
+		default: output.resize(offset); break;
+		}
+	}
+	QString mPath;
+	QPcmRingBuffer* mRing;
+	std::atomic<int> mSampleRate{ 0 };
+	std::atomic<bool> mEndOfStream{ false };
+};
+
+// 分析线程：按播放器的播放位置从环形缓冲中取样，每次前进一个跳步（窗口长度/重叠倍数）
+class QSpectrumAnalyzerThread : public QThread {
+public:
+	struct Stats {
+		std::atomic<qint64> analyzedWindows{ 0 };
+		std::atomic<qint64> analyzeNanoseconds{ 0 };
+		std::atomic<int> ringFill{ 0 };
+	};
+	QSpectrumAnalyzerThread(QAudioDecodeThread* decoder, QPcmRingBuffer* ring)
+		: mDecoder(decoder)
+		, mRing(ring)
+	{
+		mPlaybackClock.start();
+	}
+	// 播放位置由GUI线程从QMediaPlayer写入，两次通知之间按经过的时间外推，暂停时停在原位
+	void setPlaybackPosition(qint64 positionMs, bool playing) {
+		mPlaybackPositionMs.store(positionMs, std::memory_order_relaxed);
+		mPlaybackStampNs.store(mPlaybackClock.nsecsElapsed(), std::memory_order_relaxed);
+		mPlaying.store(playing, std::memory_order_release);
+	}
+	// 播放器不可用时（没有音频设备或解码失败）改用从第一个解码结果开始计时的自由时钟
+	void setFreeRunning(bool freeRunning) { mFreeRunning.store(freeRunning, std::memory_order_release); }
+	void setSettings(int fftSize, int overlap, int barCount, bool simd) {
+		mFftSize.store(fftSize, std::memory_order_relaxed);
+		mOverlap.store(overlap, std::memory_order_relaxed);
+		mBarCount.store(barCount, std::memory_order_relaxed);
+		mSimd.store(simd, std::memory_order_relaxed);
+	}
+	// 分析线程消费过的样本会原样转发给tap，供GPU频谱图使用，tap写满时丢弃
+	void setTap(QPcmRingBuffer* tap) { mTap = tap; }
+	QSpectrumTripleBuffer& getResults() { return mResults; }
+	Stats& getStats() { return mStats; }
+protected:
+	void run() override {
+		QSpectrumAnalysis analysis;
+		QVector<float> history;
+		QVector<float> smoothed;
+		QElapsedTimer clock;
+		qint64 consumed = 0;
+		while (!isInterruptionRequested()) {
+			const int sampleRate = mDecoder->getSampleRate();
+			if (sampleRate <= 0) {
+				msleep(5);
+				continue;
+			}
+			if (!clock.isValid())
+				clock.start();
+			const int fftSize = mFftSize.load(std::memory_order_relaxed);
+			const int hop = qMax(1, fftSize / qMax(1, mOverlap.load(std::memory_order_relaxed)));
+			analysis.setup(fftSize, sampleRate, mBarCount.load(std::memory_order_relaxed));
+			if (history.size() != fftSize)
+				history.fill(0.0f, fftSize);
+			if (smoothed.size() != analysis.getBarCount())
+				smoothed.fill(0.0f, analysis.getBarCount());
+
+			// 落后多个跳步时先全部推进，只分析最新的窗口
+			// 解码是顺序的，播放位置往回跳时环形缓冲无法回退，只能等播放位置追上已消费的样本
+			const qint64 target = mFreeRunning.load(std::memory_order_acquire)
+				? clock.nsecsElapsed() * sampleRate / 1000000000
+				: playbackPositionMs() * sampleRate / 1000;
+			bool analyzed = false;
+			while (consumed + hop <= target && mRing->available() >= hop) {
+				memmove(history.data(), history.constData() + hop, (fftSize - hop) * sizeof(float));
+				mRing->pop(history.data() + fftSize - hop, hop);
+				if (mTap)
+					mTap->push(history.constData() + fftSize - hop, hop);
+				consumed += hop;
+				analyzed = true;
+			}
+			mStats.ringFill.store(mRing->available(), std::memory_order_relaxed);
+			if (!analyzed) {
+				if (mDecoder->isEndOfStream() && mRing->available() < hop)
+					break;
+				msleep(1);
+				continue;
+			}
+			QElapsedTimer timer;
+			timer.start();
+			QVector<float>& levels = mResults.back();
+			levels.resize(analysis.getBarCount());
+			analysis.analyze(history.constData(), levels.data(), mSimd.load(std::memory_order_relaxed));
+			const float decay = qPow(0.05f, float(hop) / sampleRate);					//快起慢落，约一秒衰减到5%
+			for (int b = 0; b < levels.size(); b++) {
+				smoothed[b] = qMax(levels[b], smoothed[b] * decay);
+				levels[b] = smoothed[b];
+			}
+			mResults.publish();
+			mStats.analyzeNanoseconds.fetch_add(timer.nsecsElapsed(), std::memory_order_relaxed);
+			mStats.analyzedWindows.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+private:
+	qint64 playbackPositionMs() const {
+		const qint64 position = mPlaybackPositionMs.load(std::memory_order_relaxed);
+		if (!mPlaying.load(std::memory_order_acquire))
+			return position;
+		const qint64 sinceUpdate = (mPlaybackClock.nsecsElapsed() - mPlaybackStampNs.load(std::memory_order_relaxed)) / 1000000;
+		return position + qBound<qint64>(0, sinceUpdate, MaxExtrapolationMs);		//通知中断时不无限外推
+	}
+	static const int MaxExtrapolationMs = 250;
+	QAudioDecodeThread* mDecoder;
+	QPcmRingBuffer* mRing;
+	QPcmRingBuffer* mTap = nullptr;
+	QElapsedTimer mPlaybackClock;
+	std::atomic<qint64> mPlaybackPositionMs{ 0 };
+	std::atomic<qint64> mPlaybackStampNs{ 0 };
+	std::atomic<bool> mPlaying{ false };
+	std::atomic<bool> mFreeRunning{ false };
+	QSpectrumTripleBuffer mResults;
+	Stats mStats;
+	std::atomic<int> mFftSize{ 8192 };
+	std::atomic<int> mOverlap{ 4 };
+	std::atomic<int> mBarCount{ 1000 };
+	std::atomic<bool> mSimd{ true };
+};
+
+// 频谱柱：每帧从三缓冲取最新结果，在CPU上生成柱状四边形写入动态顶点缓冲
+class QSpectrumBarComponent : public IRenderComponent {
+public:
+	static const int MaxBarCount = 4096;
+	struct Vertex {
+		float position[2];
+		float level;
+	};
+	void setAnalyzer(QSpectrumAnalyzerThread* analyzer) { mAnalyzer = analyzer; }
+	void setWorldMatrix(const QMatrix4x4& matrix) { mWorldMatrix = matrix; }
+private:
+	QSpectrumAnalyzerThread* mAnalyzer = nullptr;
+	QScopedPointer<QRhiBuffer> mVertexBuffer;
+	QSharedPointer<QPrimitiveRenderProxy> mProxy;
+	QVector<Vertex> mVertices;
+	QMatrix4x4 mWorldMatrix;
+	int mVertexCount = 0;
+protected:
+	void onRebuildResource() override {
+		mVertexBuffer.reset(mRhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, sizeof(Vertex) * 6 * MaxBarCount));
+		mVertexBuffer->create();
+
+		mProxy = newPrimitiveRenderProxy();
+		mProxy->addUniformBlock(QRhiShaderStage::Vertex, "Transform")
+			->addParam("MVP", QGenericMatrix<4, 4, float>());
+		mProxy->setInputBindings({
+			QRhiVertexInputBindingEx(mVertexBuffer.get(), sizeof(Vertex))
+		});
+		mProxy->setInputAttribute({
+			QRhiVertexInputAttributeEx("inPosition", 0, 0, QRhiVertexInputAttribute::Float2, offsetof(Vertex, position)),
+			QRhiVertexInputAttributeEx("inLevel", 0, 1, QRhiVertexInputAttribute::Float, offsetof(Vertex, level)),
+		});
+		mProxy->setShaderMainCode(QRhiShaderStage::Vertex, R"(
+			layout (location = 0) out float vLevel;
+			void main(){
+				vLevel = inLevel;
+				gl_Position = Transform.MVP * vec4(inPosition, 0.0f, 1.0f);
+			}
+		)");
+		mProxy->setShaderMainCode(QRhiShaderStage::Fragment, QString(R"(
+			layout (location = 0) in float vLevel;
+			void main(){
+				%1
+			})")
+			.arg(hasColorAttachment("BaseColor") ? "BaseColor = vec4(mix(vec3(0.1f, 0.4f, 1.0f), vec3(1.0f, 0.3f, 0.6f), vLevel), 1.0f);" : "")
+			.toLocal8Bit()
+		);
+		mProxy->setOnUpdate([this](QRhiResourceUpdateBatch* batch, const QPrimitiveRenderProxy::UniformBlocks& blocks, const QPrimitiveRenderProxy::UpdateContext& ctx) {
+			const QMatrix4x4 MVP = ctx.projectionMatrixWithCorr * ctx.viewMatrix * mWorldMatrix;
+			blocks["Transform"]->setParamValue("MVP", QVariant::fromValue(MVP.toGenericMatrix<4, 4>()));
+			if (mAnalyzer && mAnalyzer->getResults().fetch()) {
+				const QVector<float>& levels = mAnalyzer->getResults().front();
+				const int barCount = qMin<int>(levels.size(), MaxBarCount);
+				mVertices.resize(barCount * 6);
+				const float width = 2.0f / qMax(1, barCount);
+				for (int b = 0; b < barCount; b++) {
+					const float left = -1.0f + b * width;
+					const float right = left + width * 0.8f;
+					const float top = qMax(0.005f, levels[b]);
+					const Vertex quad[6] = {
+						{ { left, 0.0f }, 0.0f }, { { right, 0.0f }, 0.0f }, { { left, top }, levels[b] },
+						{ { left, top }, levels[b] }, { { right, 0.0f }, 0.0f }, { { right, top }, levels[b] },
+					};
+					memcpy(mVertices.data() + b * 6, quad, sizeof(quad));
+				}
+				mVertexCount = mVertices.size();
+				if (mVertexCount > 0)
+					batch->updateDynamicBuffer(mVertexBuffer.get(), 0, mVertexCount * sizeof(Vertex), mVertices.constData());
+			}
+		});
+		mProxy->setOnDraw([this](QRhiCommandBuffer* cmdBuffer) {
+			if (mVertexCount == 0)
+				return;
+			const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+			cmdBuffer->setVertexInput(0, 1, &vertexBindings);
+			cmdBuffer->draw(mVertexCount);
+		});
+	}
+};
+
+// 不依赖音频设备的基准：FFT精度校验、各窗口大小的分析吞吐量，以及SPSC环形缓冲的传输速率
+static void runFftBenchmark() {
+	{
+		const int size = 4096;
+		QVector<float> signal(size);
+		for (int i = 0; i < size; i++)
+			signal[i] = qSin(i * 0.37) + 0.5 * qCos(i * 1.3) + (i % 7) * 0.1;
+		QRealFft fft;
+		fft.setSize(size);
+		QVector<float> power(size / 2 + 1);
+		for (int simd = 0; simd < 2; simd++) {
+			fft.powerSpectrum(signal.constData(), power.data(), simd);
+			double maxError = 0.0;
+			double maxPower = 0.0;
+			for (int k = 0; k <= size / 2; k++) {
+				double re = 0.0;
+				double im = 0.0;
+				for (int n = 0; n < size; n++) {
+					re += signal[n] * qCos(2.0 * M_PI * k * n / size);
+					im -= signal[n] * qSin(2.0 * M_PI * k * n / size);
+				}
+				maxPower = qMax(maxPower, re * re + im * im);
+				maxError = qMax(maxError, qAbs(re * re + im * im - power[k]));
+			}
+			qDebug().noquote() << QString("[FftBenchmark] %1 real FFT vs direct DFT (N=%2): max relative error %3")
+				.arg(simd ? "SIMD" : "scalar")
+				.arg(size)
+				.arg(maxError / maxPower, 0, 'g', 3);
+		}
+	}
+	for (int size : { 4096, 8192, 16384 }) {
+		QSpectrumAnalysis analysis;
+		analysis.setup(size, 48000, 1000);
+		QVector<float> samples(size);
+		for (int i = 0; i < size; i++)
+			samples[i] = qSin(i * 0.01) * 0.5f + qSin(i * 0.7) * 0.25f;
+		QVector<float> levels(1000);
+		for (int simd = 0; simd < (QFFT_SSE ? 2 : 1); simd++) {
+			const int iterations = (1 << 24) / size;
+			QElapsedTimer timer;
+			timer.start();
+			for (int i = 0; i < iterations; i++)
+				analysis.analyze(samples.constData(), levels.data(), simd);
+			const double seconds = timer.nsecsElapsed() / 1e9;
+			qDebug().noquote() << QString("[FftBenchmark] N=%1 %2: %3 windows/s (%4 us per window, window + FFT + 1000 log bins)")
+				.arg(size, 5)
+				.arg(simd ? "SIMD  " : "scalar")
+				.arg(iterations / seconds, 0, 'f', 0)
+				.arg(seconds * 1e6 / iterations, 0, 'f', 1);
+		}
+	}
+	{
+		const qint64 total = 50000000;
+		QPcmRingBuffer ring(1 << 16);
+		QElapsedTimer timer;
+		timer.start();
+		QFuture<void> producer = QtConcurrent::run([&]() {
+			float block[1024];
+			qint64 next = 0;
+			while (next < total) {
+				const int count = int(qMin<qint64>(1024, total - next));
+				for (int i = 0; i < count; i++)
+					block[i] = float((next + i) % 1000003);
+				int pushed = 0;
+				while (pushed < count)
+					pushed += ring.push(block + pushed, count - pushed);
+				next += count;
+			}
+		});
+		float block[1024];
+		qint64 received = 0;
+		qint64 errors = 0;
+		while (received < total) {
+			const int count = ring.pop(block, 1024);
+			for (int i = 0; i < count; i++)
+				errors += block[i] != float((received + i) % 1000003) ? 1 : 0;
+			received += count;
+		}
+		producer.waitForFinished();
+		qDebug().noquote() << QString("[FftBenchmark] SPSC ring: %1 M samples/s, %2 out-of-order samples")
+			.arg(total / (timer.nsecsElapsed() / 1e3), 0, 'f', 1)
+			.arg(errors);
+	}
+}
+
+// GPU端的Stockham FFT：每一级一次dispatch，在两块存储缓冲之间来回读写；能用基4时用基4，log2(N)为奇数时最后补一级基2
+struct QGpuFftStage {
+	int size;
+	int stride;
+	int radix;
+};
+
+static QVector<QGpuFftStage> buildGpuFftStages(int fftSize) {
+	QVector<QGpuFftStage> stages;
+	for (int n = fftSize, s = 1; n > 1;) {
+		const int radix = n % 4 == 0 ? 4 : 2;
+		stages.push_back({ n, s, radix });
+		n /= radix;
+		s *= radix;
+	}
+	return stages;
+}
+
+// 旋转因子表 W_N^k，各级的 W_n^p 取 W_N^(p*N/n)
+static QVector<float> buildGpuFftTwiddles(int fftSize) {
+	QVector<float> twiddles(fftSize * 2);
+	for (int k = 0; k < fftSize; k++) {
+		const double angle = 2.0 * M_PI * k / fftSize;
+		twiddles[k * 2] = float(qCos(angle));
+		twiddles[k * 2 + 1] = float(-qSin(angle));
+	}
+	return twiddles;
+}
+
+static float hannPowerScale(int fftSize) {
+	float windowSum = 0.0f;
+	for (int i = 0; i < fftSize; i++)
+		windowSum += 0.5f - 0.5f * qCos(2.0f * float(M_PI) * i / (fftSize - 1));
+	return 4.0f / (windowSum * windowSum);
+}
+
+// 所有FFT相关着色器共用的参数块，每个dispatch绑定其中一段
+struct QGpuFftParams {
+	quint32 fftSize;
+	quint32 windowCount;
+	quint32 channelCount;
+	quint32 stageSize;
+	quint32 stride;
+	quint32 radix;
+	quint32 pcmCapacity;
+	quint32 pcmBase;
+	quint32 hop;
+	quint32 binCount;
+	quint32 historyLength;
+	quint32 firstColumn;
+	float sampleRate;
+	float minFrequency;
+	float maxFrequency;
+	float powerScale;
+};
+
+static const char* GpuFftParamsBlock = R"(
+	layout (std140, binding = 2) uniform Params {
+		uint fftSize;
+		uint windowCount;
+		uint channelCount;
+		uint stageSize;
+		uint stride;
+		uint radix;
+		uint pcmCapacity;
+		uint pcmBase;
+		uint hop;
+		uint binCount;
+		uint historyLength;
+		uint firstColumn;
+		float sampleRate;
+		float minFrequency;
+		float maxFrequency;
+		float powerScale;
+	} params;
+)";
+
+// 参数段依次为：加载、各级蝶形、频段统计，stride为uniform缓冲的对齐大小
+static void fillGpuFftParams(QByteArray& blob, QGpuFftParams params, const QVector<QGpuFftStage>& stages, int stride) {
+	blob.resize(stride * (stages.size() + 2));
+	memcpy(blob.data(), &params, sizeof(params));
+	for (int i = 0; i < stages.size(); i++) {
+		params.stageSize = stages[i].size;
+		params.stride = stages[i].stride;
+		params.radix = stages[i].radix;
+		memcpy(blob.data() + stride * (i + 1), &params, sizeof(params));
+	}
+	memcpy(blob.data() + stride * (stages.size() + 1), &params, sizeof(params));
+}
+
+// PCM按帧交错存放在环形缓冲中（frame * channelCount + channel），加载时加Hann窗并转为复数
+static QShader newGpuFftLoadShader() {
+	return QRhiHelper::newShaderFromCode(QShader::ComputeStage, (QByteArray(R"(#version 450
+		layout (local_size_x = 64) in;
+		layout (std430, binding = 0) readonly buffer PcmBuffer { float pcm[]; };
+		layout (std430, binding = 1) writeonly buffer OutputBuffer { vec2 dst[]; };
+		)") + GpuFftParamsBlock + R"(
+		void main() {
+			uint i = gl_GlobalInvocationID.x;
+			uint w = gl_WorkGroupID.y;
+			if (i >= params.fftSize)
+				return;
+			uint column = w / params.channelCount;
+			uint channel = w % params.channelCount;
+			uint frame = (params.pcmBase + column * params.hop + i) & (params.pcmCapacity - 1u);
+			float window = 0.5 - 0.5 * cos(6.28318530718 * float(i) / float(params.fftSize - 1u));
+			dst[w * params.fftSize + i] = vec2(pcm[frame * params.channelCount + channel] * window, 0.0);
+		}
+	)").constData());
+}
+
+// 一个线程负责一个蝶形，工作组的y维对应一个窗口
+static QShader newGpuFftStageShader() {
+	return QRhiHelper::newShaderFromCode(QShader::ComputeStage, (QByteArray(R"(#version 450
+		layout (local_size_x = 64) in;
+		layout (std430, binding = 0) readonly buffer InputBuffer { vec2 src[]; };
+		layout (std430, binding = 1) writeonly buffer OutputBuffer { vec2 dst[]; };
+		layout (std430, binding = 3) readonly buffer TwiddleBuffer { vec2 twiddles[]; };
+		)") + GpuFftParamsBlock + R"(
+		vec2 cmul(vec2 a, vec2 b) {
+			return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+		}
+		void main() {
+			uint j = gl_GlobalInvocationID.x;
+			uint base = gl_WorkGroupID.y * params.fftSize;
+			uint s = params.stride;
+			uint m = params.stageSize / params.radix;
+			if (j >= m * s)
+				return;
+			uint p = j / s;
+			uint q = j % s;
+			uint step = params.fftSize / params.stageSize;
+			if (params.radix == 4u) {
+				vec2 a = src[base + q + s * p];
+				vec2 b = src[base + q + s * (p + m)];
+				vec2 c = src[base + q + s * (p + 2u * m)];
+				vec2 d = src[base + q + s * (p + 3u * m)];
+				vec2 apc = a + c;
+				vec2 amc = a - c;
+				vec2 bpd = b + d;
+				vec2 jbmd = vec2(d.y - b.y, b.x - d.x);
+				dst[base + q + s * (4u * p)] = apc + bpd;
+				dst[base + q + s * (4u * p + 1u)] = cmul(amc - jbmd, twiddles[p * step]);
+				dst[base + q + s * (4u * p + 2u)] = cmul(apc - bpd, twiddles[2u * p * step]);
+				dst[base + q + s * (4u * p + 3u)] = cmul(amc + jbmd, twiddles[3u * p * step]);
+			}
+			else {
+				vec2 a = src[base + q + s * p];
+				vec2 b = src[base + q + s * (p + m)];
+				dst[base + q + s * (2u * p)] = a + b;
+				dst[base + q + s * (2u * p + 1u)] = cmul(a - b, twiddles[p * step]);
+			}
+		}
+	)").constData());
+}
+
+// 与QSpectrumAnalysis相同的对数频段划分，结果写入频谱图环形纹理的一列
+static QShader newSpectrogramBinShader() {
+	return QRhiHelper::newShaderFromCode(QShader::ComputeStage, (QByteArray(R"(#version 450
+		layout (local_size_x = 64) in;
+		layout (std430, binding = 0) readonly buffer SpectrumBuffer { vec2 spectrum[]; };
+		layout (binding = 1, r32f) uniform writeonly image2D spectrogram;
+		)") + GpuFftParamsBlock + R"(
+		float power(uint base, int k) {
+			vec2 value = spectrum[base + uint(k)];
+			return dot(value, value);
+		}
+		void main() {
+			uint bin = gl_GlobalInvocationID.x;
+			uint w = gl_WorkGroupID.y;
+			if (bin >= params.binCount)
+				return;
+			uint column = w / params.channelCount;
+			uint channel = w % params.channelCount;
+			uint base = w * params.fftSize;
+			int nyquist = int(params.fftSize / 2u);
+			float binWidth = params.sampleRate / float(params.fftSize);
+			float ratio = params.maxFrequency / params.minFrequency;
+			float low = params.minFrequency * pow(ratio, float(bin) / float(params.binCount));
+			float high = params.minFrequency * pow(ratio, float(bin + 1u) / float(params.binCount));
+			int firstBin = clamp(int(ceil(low / binWidth)), 0, nyquist);
+			int lastBin = clamp(int(high / binWidth), 0, nyquist);
+			float value = 0.0;
+			if (lastBin >= firstBin) {
+				for (int k = firstBin; k <= lastBin; k++)
+					value = max(value, power(base, k));
+			}
+			else {
+				float center = sqrt(low * high) / binWidth;
+				int k = min(int(center), nyquist - 1);
+				value = mix(power(base, k), power(base, k + 1), center - float(k));
+			}
+			float decibel = 10.0 * log(value * params.powerScale + 1e-12) / log(10.0);
+			float level = clamp(1.0 + decibel / 80.0, 0.0, 1.0);
+			uint x = (params.firstColumn + column) % params.historyLength;
+			imageStore(spectrogram, ivec2(int(x), int(channel * params.binCount + bin)), vec4(level));
+		}
+	)").constData());
+}
+
+// 录制整条计算链：加载 → 各级蝶形 → 频段统计，返回dispatch次数
+static int dispatchGpuFft(QRhiCommandBuffer* cmdBuffer,
+	QRhiComputePipeline* loadPipeline, QRhiShaderResourceBindings* loadBindings,
+	QRhiComputePipeline* stagePipeline, const QVector<QRhiShaderResourceBindings*>& stageBindings,
+	QRhiComputePipeline* binPipeline, QRhiShaderResourceBindings* binBindings,
+	const QVector<QGpuFftStage>& stages, int fftSize, int windowCount, int binCount) {
+	cmdBuffer->setComputePipeline(loadPipeline);
+	cmdBuffer->setShaderResources(loadBindings);
+	cmdBuffer->dispatch(fftSize / 64, windowCount, 1);
+	cmdBuffer->setComputePipeline(stagePipeline);
+	for (int i = 0; i < stages.size(); i++) {
+		cmdBuffer->setShaderResources(stageBindings[i]);
+		cmdBuffer->dispatch(fftSize / stages[i].radix / 64, windowCount, 1);
+	}
+	cmdBuffer->setComputePipeline(binPipeline);
+	cmdBuffer->setShaderResources(binBindings);
+	cmdBuffer->dispatch((binCount + 63) / 64, windowCount, 1);
+	return stages.size() + 2;
+}
+
+// 多通道PCM来源：0号通道是正在播放的音乐，其余通道用不同速率的扫频信号模拟
+class QSpectrogramFeed {
+public:
+	void setSource(QPcmRingBuffer* tap, QAudioDecodeThread* decoder) {
+		mTap = tap;
+		mDecoder = decoder;
+	}
+	void setChannelCount(int count) {
+		if (count == mChannelCount)
+			return;
+		mChannelCount = count;
+		mPending.clear();
+		mPhases.fill(0.0, count);
+	}
+	int getChannelCount() const { return mChannelCount; }
+	int getSampleRate() const { return mDecoder ? mDecoder->getSampleRate() : 0; }
+	void update() {
+		const int sampleRate = getSampleRate();
+		const int frames = mTap ? mTap->available() : 0;
+		if (frames <= 0 || sampleRate <= 0)
+			return;
+		mMono.resize(frames);
+		mTap->pop(mMono.data(), frames);
+		const int offset = mPending.size();
+		mPending.resize(offset + frames * mChannelCount);
+		float* dst = mPending.data() + offset;
+		for (int i = 0; i < frames; i++)
+			dst[i * mChannelCount] = mMono[i];
+		for (int c = 1; c < mChannelCount; c++) {
+			const double t = mTime * 0.05 + c * 0.618;
+			const double frequency = 60.0 * qPow(2.0, 8.0 * (t - qFloor(t)));
+			const double delta = 2.0 * M_PI * frequency / sampleRate;
+			double phase = mPhases[c];
+			for (int i = 0; i < frames; i++) {
+				dst[i * mChannelCount + c] = float(qSin(phase) * 0.5);
+				phase += delta;
+			}
+			mPhases[c] = std::fmod(phase, 2.0 * M_PI);
+		}
+		mTime += double(frames) / sampleRate;
+	}
+	// 每帧最多取maxColumns个跳步，落后更多时丢弃最旧的样本，保证每帧开销有上限
+	int takeColumns(int hop, int maxColumns, QVector<float>& block, int& droppedColumns) {
+		const int frameFloats = hop * mChannelCount;
+		const int available = mPending.size() / frameFloats;
+		droppedColumns = qMax(0, available - maxColumns);
+		const int columns = available - droppedColumns;
+		const int skip = droppedColumns * frameFloats;
+		block.resize(columns * frameFloats);
+		memcpy(block.data(), mPending.constData() + skip, block.size() * sizeof(float));
+		mPending.remove(0, skip + block.size());
+		return columns;
+	}
+private:
+	QPcmRingBuffer* mTap = nullptr;
+	QAudioDecodeThread* mDecoder = nullptr;
+	int mChannelCount = 0;
+	double mTime = 0.0;
+	QVector<double> mPhases;
+	QVector<float> mMono;
+	QVector<float> mPending;
+};
+
+// 每帧只上传新到达的PCM并录制固定数量的dispatch，CPU开销与频段数、历史长度无关
+class QGpuSpectrogramPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QGpuSpectrogramPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QSpectrogramFeed*, Feed);
+		QRP_INPUT_ATTR(int, FftSize);
+		QRP_INPUT_ATTR(int, Overlap);
+		QRP_INPUT_ATTR(int, BinCount);
+		QRP_INPUT_ATTR(int, HistoryLength);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QGpuSpectrogramPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+public:
+	static const int MaxColumnsPerFrame = 4;
+	struct Stats {
+		int columns = 0;
+		int droppedColumns = 0;
+		int dispatches = 0;
+		qint64 uploadedBytes = 0;
+	};
+private:
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiSamplerRef mSampler;
+	QRhiSamplerRef mSpectrogramSampler;
+	QRhiTextureRef mSpectrogram;
+	QRhiBufferRef mPcmBuffer;
+	QRhiBufferRef mWorkBuffers[2];
+	QRhiBufferRef mTwiddleBuffer;
+	QRhiBufferRef mParamsBuffer;
+	QRhiShaderResourceBindingsRef mLoadBindings;
+	QVector<QRhiShaderResourceBindingsRef> mStageBindings;
+	QRhiShaderResourceBindingsRef mBinBindings;
+	QRhiShaderResourceBindingsRef mCopyBindings;
+	QRhiShaderResourceBindingsRef mDisplayBindings;
+	QRhiComputePipelineRef mLoadPipeline;
+	QRhiComputePipelineRef mStagePipeline;
+	QRhiComputePipelineRef mBinPipeline;
+	QRhiGraphicsPipelineRef mCopyPipeline;
+	QRhiGraphicsPipelineRef mDisplayPipeline;
+	QShader mLoadCS;
+	QShader mStageCS;
+	QShader mBinCS;
+	QShader mCopyFS;
+	QShader mDisplayFS;
+	QVector<QGpuFftStage> mStages;
+	int mFftSize = 0;
+	int mChannelCount = 0;
+	int mBinCount = 0;
+	int mHistoryLength = 0;
+	int mHop = 0;
+	int mPcmCapacity = 0;
+	int mParamsStride = 0;
+	QRhiBuffer* mInitializedPcmBuffer = nullptr;
+	QRhiBuffer* mInitializedTwiddleBuffer = nullptr;
+	QRhiTexture* mInitializedSpectrogram = nullptr;
+	quint64 mWriteTotal = 0;
+	int mHead = 0;
+	QVector<float> mBlock;
+	QByteArray mParams;
+	Stats mStats;
+public:
+	QGpuSpectrogramPassBuilder() {
+		mLoadCS = newGpuFftLoadShader();
+		mStageCS = newGpuFftStageShader();
+		mBinCS = newSpectrogramBinShader();
+		mCopyFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uBaseColor;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = texture(uBaseColor, vUV);
+			}
+		)");
+		// 最旧的一列在左侧，每个通道占一条横带
+		mDisplayFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, (QByteArray(R"(#version 450
+			layout (binding = 0) uniform sampler2D uSpectrogram;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outColor;
+			)") + GpuFftParamsBlock + R"(
+			void main() {
+				float u = fract(vUV.x + float(params.firstColumn) / float(params.historyLength));
+				float level = texture(uSpectrogram, vec2(u, vUV.y)).r;
+				vec3 color = level < 0.5
+					? mix(vec3(0.0, 0.0, 0.05), vec3(0.1, 0.2, 0.9), level * 2.0)
+					: mix(vec3(0.1, 0.2, 0.9), vec3(1.0, 0.9, 0.3), level * 2.0 - 1.0);
+				if (fract(vUV.y * float(params.channelCount)) < 0.02)
+					color = vec3(0.3);
+				outColor = vec4(color, 1.0);
+			}
+		)").constData());
+	}
+	const Stats& getStats() const { return mStats; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		mFftSize = mInput._FftSize;
+		mChannelCount = qMax(1, mInput._Feed->getChannelCount());
+		mBinCount = mInput._BinCount;
+		mHistoryLength = mInput._HistoryLength;
+		mHop = qMax(1, mFftSize / mInput._Overlap);
+		mPcmCapacity = qNextPowerOfTwo(quint32(mFftSize + MaxColumnsPerFrame * mHop - 1));
+		mStages = buildGpuFftStages(mFftSize);
+		mParamsStride = mRhi->ubufAligned(sizeof(QGpuFftParams));
+		const int maxWindowCount = mChannelCount * MaxColumnsPerFrame;
+
+		builder.setupTexture(mColorAttachment, "SpectrogramColor", mInput._BaseColor->format(), mInput._BaseColor->pixelSize(), 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "SpectrogramRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupSampler(mSampler, "SpectrogramCopySampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mSpectrogramSampler, "SpectrogramSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::Repeat, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupTexture(mSpectrogram, "Spectrogram", QRhiTexture::R32F, QSize(mHistoryLength, mChannelCount * mBinCount), 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupBuffer(mPcmBuffer, "SpectrogramPcmBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * mPcmCapacity * mChannelCount);
+		builder.setupBuffer(mWorkBuffers[0], "GpuFftWorkBuffer0", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * mFftSize * maxWindowCount);
+		builder.setupBuffer(mWorkBuffers[1], "GpuFftWorkBuffer1", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * mFftSize * maxWindowCount);
+		builder.setupBuffer(mTwiddleBuffer, "GpuFftTwiddleBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * mFftSize);
+		builder.setupBuffer(mParamsBuffer, "GpuFftParamsBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, mParamsStride * (mStages.size() + 3));
+
+		builder.setupShaderResourceBindings(mLoadBindings, "GpuFftLoadBindings", {
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, mPcmBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, mWorkBuffers[0].get()),
+			QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, mParamsBuffer.get(), 0, sizeof(QGpuFftParams)),
+		});
+		mStageBindings.resize(mStages.size());
+		for (int i = 0; i < mStages.size(); i++) {
+			builder.setupShaderResourceBindings(mStageBindings[i], QByteArray("GpuFftStageBindings") + QByteArray::number(i), {
+				QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, mWorkBuffers[i % 2].get()),
+				QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, mWorkBuffers[(i + 1) % 2].get()),
+				QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, mParamsBuffer.get(), mParamsStride * (i + 1), sizeof(QGpuFftParams)),
+				QRhiShaderResourceBinding::bufferLoad(3, QRhiShaderResourceBinding::ComputeStage, mTwiddleBuffer.get()),
+			});
+		}
+		builder.setupShaderResourceBindings(mBinBindings, "SpectrogramBinBindings", {
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, mWorkBuffers[mStages.size() % 2].get()),
+			QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, mSpectrogram.get(), 0),
+			QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, mParamsBuffer.get(), mParamsStride * (mStages.size() + 1), sizeof(QGpuFftParams)),
+		});
+		builder.setupComputePipeline(mLoadPipeline, "GpuFftLoadPipeline", QRhiComputePipelineState{ mLoadBindings.get(), mLoadCS });
+		builder.setupComputePipeline(mStagePipeline, "GpuFftStagePipeline", QRhiComputePipelineState{ mStageBindings[0].get(), mStageCS });
+		builder.setupComputePipeline(mBinPipeline, "SpectrogramBinPipeline", QRhiComputePipelineState{ mBinBindings.get(), mBinCS });
+
+		builder.setupShaderResourceBindings(mCopyBindings, "SpectrogramCopyBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState copyPSO;
+		copyPSO.shaderResourceBindings = mCopyBindings.get();
+		copyPSO.sampleCount = mRenderTarget->sampleCount();
+		copyPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		copyPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCopyFS),
+		};
+		builder.setupGraphicsPipeline(mCopyPipeline, "SpectrogramCopyPipeline", copyPSO);
+
+		builder.setupShaderResourceBindings(mDisplayBindings, "SpectrogramDisplayBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mSpectrogram.get(), mSpectrogramSampler.get()),
+			QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::FragmentStage, mParamsBuffer.get(), mParamsStride * (mStages.size() + 2), sizeof(QGpuFftParams)),
+		});
+		QRhiGraphicsPipelineState displayPSO;
+		displayPSO.shaderResourceBindings = mDisplayBindings.get();
+		displayPSO.sampleCount = mRenderTarget->sampleCount();
+		displayPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		displayPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mDisplayFS),
+		};
+		builder.setupGraphicsPipeline(mDisplayPipeline, "SpectrogramDisplayPipeline", displayPSO);
+
+		mOutput.Result = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		mStats = Stats();
+		QSpectrogramFeed* feed = mInput._Feed;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+
+		// 资源重建后内容未定义，PCM环和频谱图都先清零
+		if (mInitializedPcmBuffer != mPcmBuffer.get()) {
+			const QByteArray zeros(mPcmBuffer->size(), 0);
+			batch->uploadStaticBuffer(mPcmBuffer.get(), zeros.constData());
+			mInitializedPcmBuffer = mPcmBuffer.get();
+			mWriteTotal = 0;
+		}
+		if (mInitializedTwiddleBuffer != mTwiddleBuffer.get()) {
+			batch->uploadStaticBuffer(mTwiddleBuffer.get(), buildGpuFftTwiddles(mFftSize).constData());
+			mInitializedTwiddleBuffer = mTwiddleBuffer.get();
+		}
+		if (mInitializedSpectrogram != mSpectrogram.get()) {
+			const QSize size = mSpectrogram->pixelSize();
+			const QRhiTextureSubresourceUploadDescription zeros(QByteArray(size.width() * size.height() * sizeof(float), 0));
+			batch->uploadTexture(mSpectrogram.get(), QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, zeros)));
+			mInitializedSpectrogram = mSpectrogram.get();
+			mHead = 0;
+		}
+
+		int columns = 0;
+		if (feed->getChannelCount() == mChannelCount) {
+			feed->update();
+			columns = feed->takeColumns(mHop, MaxColumnsPerFrame, mBlock, mStats.droppedColumns);
+		}
+		if (columns > 0) {													//新样本写入环形缓冲，环绕时分两段上传
+			const int frameBytes = sizeof(float) * mChannelCount;
+			const int frames = columns * mHop;
+			const int begin = int(mWriteTotal & (mPcmCapacity - 1));
+			const int first = qMin(frames, mPcmCapacity - begin);
+			batch->uploadStaticBuffer(mPcmBuffer.get(), begin * frameBytes, first * frameBytes, mBlock.constData());
+			if (first < frames)
+				batch->uploadStaticBuffer(mPcmBuffer.get(), 0, (frames - first) * frameBytes, mBlock.constData() + first * mChannelCount);
+			mWriteTotal += frames;
+			mStats.uploadedBytes = qint64(frames) * frameBytes;
+		}
+
+		const int sampleRate = feed->getSampleRate() > 0 ? feed->getSampleRate() : 48000;
+		QGpuFftParams params = {};
+		params.fftSize = mFftSize;
+		params.windowCount = columns * mChannelCount;
+		params.channelCount = mChannelCount;
+		params.pcmCapacity = mPcmCapacity;
+		params.pcmBase = quint32((mWriteTotal - mFftSize - quint64(qMax(0, columns - 1)) * mHop) & (mPcmCapacity - 1));
+		params.hop = mHop;
+		params.binCount = mBinCount;
+		params.historyLength = mHistoryLength;
+		params.firstColumn = mHead;
+		params.sampleRate = sampleRate;
+		params.minFrequency = QSpectrumAnalysis::MinFrequency;
+		params.maxFrequency = qMin(20000.0f, sampleRate * 0.5f);
+		params.powerScale = hannPowerScale(mFftSize);
+		fillGpuFftParams(mParams, params, mStages, mParamsStride);
+		mHead = (mHead + columns) % mHistoryLength;
+		params.firstColumn = mHead;
+		mParams.resize(mParamsStride * (mStages.size() + 3));
+		memcpy(mParams.data() + mParamsStride * (mStages.size() + 2), &params, sizeof(params));
+		batch->updateDynamicBuffer(mParamsBuffer.get(), 0, mParams.size(), mParams.constData());
+
+		cmdBuffer->beginComputePass(batch);
+		if (columns > 0) {
+			QVector<QRhiShaderResourceBindings*> stageBindings;
+			for (const QRhiShaderResourceBindingsRef& bindings : mStageBindings)
+				stageBindings << bindings.get();
+			mStats.dispatches = dispatchGpuFft(cmdBuffer, mLoadPipeline.get(), mLoadBindings.get(), mStagePipeline.get(), stageBindings,
+				mBinPipeline.get(), mBinBindings.get(), mStages, mFftSize, params.windowCount, mBinCount);
+		}
+		cmdBuffer->endComputePass();
+		mStats.columns = columns;
+
+		const QSize size = mRenderTarget->pixelSize();
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f), { 1.0f, 0 });
+		cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+		cmdBuffer->setGraphicsPipeline(mCopyPipeline.get());
+		cmdBuffer->setShaderResources(mCopyBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->setGraphicsPipeline(mDisplayPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, size.height() * 0.55f, size.width(), size.height() * 0.45f));		//频谱图占画面上方
+		cmdBuffer->setShaderResources(mDisplayBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+// 不依赖窗口和音频设备：离屏跑GPU FFT，与CPU的QRealFft / QSpectrumAnalysis逐窗口比较
+static int runGpuFftCheck() {
+	QSharedPointer<QRhi> rhi = QRhiHelper::create();
+	if (!rhi || !rhi->isFeatureSupported(QRhi::Compute)) {
+		qWarning() << "[GpuFftCheck] compute is not supported, GPU comparison skipped";
+		return 0;
+	}
+	const int channelCount = 16;
+	const int binCount = 256;
+	const int sampleRate = 48000;
+	const int iterations = 20;
+	bool passed = true;
+	for (int fftSize : { 4096, 8192 }) {
+		const QVector<QGpuFftStage> stages = buildGpuFftStages(fftSize);
+		const int paramsStride = rhi->ubufAligned(sizeof(QGpuFftParams));
+		QVector<float> pcm(fftSize * channelCount);
+		for (int i = 0; i < fftSize; i++) {
+			for (int c = 0; c < channelCount; c++)
+				pcm[i * channelCount + c] = float(qSin(i * (0.01 + 0.013 * c)) * 0.6 + qSin(i * 0.9 + c) * 0.3 + ((i * 7919 + c * 104729) % 1000 / 1000.0 - 0.5) * 0.05);
+		}
+
+		QScopedPointer<QRhiBuffer> pcmBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, pcm.size() * sizeof(float)));
+		QScopedPointer<QRhiBuffer> workBuffers[2];
+		workBuffers[0].reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * fftSize * channelCount));
+		workBuffers[1].reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * fftSize * channelCount));
+		QScopedPointer<QRhiBuffer> twiddleBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(float) * 2 * fftSize));
+		QScopedPointer<QRhiBuffer> paramsBuffer(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, paramsStride * (stages.size() + 2)));
+		QScopedPointer<QRhiTexture> spectrogram(rhi->newTexture(QRhiTexture::R32F, QSize(1, channelCount * binCount), 1, QRhiTexture::UsedWithLoadStore));
+		pcmBuffer->create();
+		workBuffers[0]->create();
+		workBuffers[1]->create();
+		twiddleBuffer->create();
+		paramsBuffer->create();
+		spectrogram->create();
+
+		QScopedPointer<QRhiShaderResourceBindings> loadBindings(rhi->newShaderResourceBindings());
+		loadBindings->setBindings({
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, pcmBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, workBuffers[0].get()),
+			QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, paramsBuffer.get(), 0, sizeof(QGpuFftParams)),
+		});
+		loadBindings->create();
+		QVector<QSharedPointer<QRhiShaderResourceBindings>> stageBindingsHolder;
+		QVector<QRhiShaderResourceBindings*> stageBindings;
+		for (int i = 0; i < stages.size(); i++) {
+			QSharedPointer<QRhiShaderResourceBindings> bindings(rhi->newShaderResourceBindings());
+			bindings->setBindings({
+				QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, workBuffers[i % 2].get()),
+				QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, workBuffers[(i + 1) % 2].get()),
+				QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, paramsBuffer.get(), paramsStride * (i + 1), sizeof(QGpuFftParams)),
+				QRhiShaderResourceBinding::bufferLoad(3, QRhiShaderResourceBinding::ComputeStage, twiddleBuffer.get()),
+			});
+			bindings->create();
+			stageBindingsHolder << bindings;
+			stageBindings << bindings.get();
+		}
+		QRhiBuffer* resultBuffer = workBuffers[stages.size() % 2].get();
+		QScopedPointer<QRhiShaderResourceBindings> binBindings(rhi->newShaderResourceBindings());
+		binBindings->setBindings({
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, resultBuffer),
+			QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, spectrogram.get(), 0),
+			QRhiShaderResourceBinding::uniformBuffer(2, QRhiShaderResourceBinding::ComputeStage, paramsBuffer.get(), paramsStride * (stages.size() + 1), sizeof(QGpuFftParams)),
+		});
+		binBindings->create();
+		auto newPipeline = [&](const QShader& shader, QRhiShaderResourceBindings* bindings) {
+			QRhiComputePipeline* pipeline = rhi->newComputePipeline();
+			pipeline->setShaderStage(QRhiShaderStage(QRhiShaderStage::Compute, shader));
+			pipeline->setShaderResourceBindings(bindings);
+			pipeline->create();
+			return pipeline;
+		};
+		QScopedPointer<QRhiComputePipeline> loadPipeline(newPipeline(newGpuFftLoadShader(), loadBindings.get()));
+		QScopedPointer<QRhiComputePipeline> stagePipeline(newPipeline(newGpuFftStageShader(), stageBindings[0]));
+		QScopedPointer<QRhiComputePipeline> binPipeline(newPipeline(newSpectrogramBinShader(), binBindings.get()));
+
+		QGpuFftParams params = {};
+		params.fftSize = fftSize;
+		params.windowCount = channelCount;
+		params.channelCount = channelCount;
+		params.pcmCapacity = fftSize;
+		params.hop = fftSize;
+		params.binCount = binCount;
+		params.historyLength = 1;
+		params.sampleRate = sampleRate;
+		params.minFrequency = QSpectrumAnalysis::MinFrequency;
+		params.maxFrequency = qMin(20000.0f, sampleRate * 0.5f);
+		params.powerScale = hannPowerScale(fftSize);
+		QByteArray paramsBlob;
+		fillGpuFftParams(paramsBlob, params, stages, paramsStride);
+
+		QRhiReadbackResult spectrumReadback;
+		QRhiReadbackResult spectrogramReadback;
+		double gpuMs = 0.0;
+		for (int i = 0; i <= iterations; i++) {
+			QRhiCommandBuffer* cmdBuffer = nullptr;
+			if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+				return 1;
+			QElapsedTimer frameTimer;
+			frameTimer.start();
+			QRhiResourceUpdateBatch* batch = rhi->nextResourceUpdateBatch();
+			batch->updateDynamicBuffer(paramsBuffer.get(), 0, paramsBlob.size(), paramsBlob.constData());
+			batch->uploadStaticBuffer(pcmBuffer.get(), pcm.constData());
+			if (i == 0)
+				batch->uploadStaticBuffer(twiddleBuffer.get(), buildGpuFftTwiddles(fftSize).constData());
+			cmdBuffer->beginComputePass(batch);
+			dispatchGpuFft(cmdBuffer, loadPipeline.get(), loadBindings.get(), stagePipeline.get(), stageBindings,
+				binPipeline.get(), binBindings.get(), stages, fftSize, channelCount, binCount);
+			QRhiResourceUpdateBatch* readbackBatch = nullptr;
+			if (i == iterations) {
+				readbackBatch = rhi->nextResourceUpdateBatch();
+				readbackBatch->readBackBuffer(resultBuffer, 0, sizeof(float) * 2 * fftSize * channelCount, &spectrumReadback);
+				readbackBatch->readBackTexture(QRhiReadbackDescription(spectrogram.get()), &spectrogramReadback);
+			}
+			cmdBuffer->endComputePass(readbackBatch);
+			rhi->endOffscreenFrame();
+			if (i > 0 && i < iterations)
+				gpuMs += frameTimer.nsecsElapsed() / 1e6;
+		}
+		gpuMs /= iterations - 1;
+		if (spectrumReadback.data.size() < int(sizeof(float) * 2 * fftSize * channelCount)
+			|| spectrogramReadback.data.size() < int(sizeof(float) * channelCount * binCount)) {
+			qWarning() << "[GpuFftCheck] readback failed";
+			return 1;
+		}
+
+		// CPU参考：同样的窗口、实数FFT与频段划分
+		QRealFft fft;
+		fft.setSize(fftSize);
+		QSpectrumAnalysis analysis;
+		analysis.setup(fftSize, sampleRate, binCount);
+		QVector<float> window(fftSize);
+		QVector<float> windowed(fftSize);
+		QVector<float> power(fftSize / 2 + 1);
+		QVector<float> levels(binCount);
+		for (int i = 0; i < fftSize; i++)
+			window[i] = 0.5f - 0.5f * qCos(2.0f * float(M_PI) * i / (fftSize - 1));
+		const float* gpuSpectrum = reinterpret_cast<const float*>(spectrumReadback.data.constData());
+		const float* gpuLevels = reinterpret_cast<const float*>(spectrogramReadback.data.constData());
+		double maxPowerError = 0.0;
+		int levelMismatches = 0;
+		QElapsedTimer cpuTimer;
+		qint64 cpuNanoseconds = 0;
+		for (int c = 0; c < channelCount; c++) {
+			QVector<float> samples(fftSize);
+			for (int i = 0; i < fftSize; i++) {
+				samples[i] = pcm[i * channelCount + c];
+				windowed[i] = samples[i] * window[i];
+			}
+			fft.powerSpectrum(windowed.constData(), power.data(), true);
+			double maxPower = 0.0;
+			double maxError = 0.0;
+			for (int k = 0; k <= fftSize / 2; k++) {
+				const float re = gpuSpectrum[(c * fftSize + k) * 2];
+				const float im = gpuSpectrum[(c * fftSize + k) * 2 + 1];
+				maxPower = qMax<double>(maxPower, power[k]);
+				maxError = qMax<double>(maxError, qAbs(re * re + im * im - power[k]));
+			}
+			maxPowerError = qMax(maxPowerError, maxError / maxPower);
+			cpuTimer.start();
+			analysis.analyze(samples.constData(), levels.data(), true);
+			cpuNanoseconds += cpuTimer.nsecsElapsed();
+			for (int b = 0; b < binCount; b++) {
+				if (qAbs(gpuLevels[c * binCount + b] - levels[b]) > 0.01f)
+					levelMismatches++;
+			}
+		}
+		const bool sizePassed = maxPowerError < 1e-4 && levelMismatches <= channelCount * binCount / 100;
+		passed = passed && sizePassed;
+		qDebug().noquote() << QString("[GpuFftCheck] N=%1, %2 channels, %3 stages: GPU %4 ms per frame, CPU %5 ms; max relative power error %6, %7 of %8 bins differ by more than 1%: %9")
+			.arg(fftSize)
+			.arg(channelCount)
+			.arg(stages.size())
+			.arg(gpuMs, 0, 'f', 2)
+			.arg(cpuNanoseconds / 1e6, 0, 'f', 2)
+			.arg(maxPowerError, 0, 'g', 3)
+			.arg(levelMismatches)
+			.arg(channelCount * binCount)
+			.arg(sizePassed ? "PASSED" : "FAILED");
+	}
+	return passed ? 0 : 1;
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, FftSize) = 8192;
+	Q_PROPERTY_VAR(int, Overlap) = 4;
+	Q_PROPERTY_VAR(int, BarCount) = 1000;
+	Q_PROPERTY_VAR(bool, UseSimd) = true;
+	Q_PROPERTY_VAR(int, GpuFftSize) = 4096;
+	Q_PROPERTY_VAR(int, SpectrogramChannels) = 8;
+	Q_PROPERTY_VAR(int, SpectrogramBins) = 256;
+	Q_PROPERTY_VAR(int, SpectrogramHistory) = 512;
+
+	Q_CLASSINFO("FftSize", "Min=1024,Max=16384")
+	Q_CLASSINFO("Overlap", "Min=1,Max=8")
+	Q_CLASSINFO("BarCount", "Min=16,Max=4096")
+	Q_CLASSINFO("GpuFftSize", "Min=1024,Max=16384")
+	Q_CLASSINFO("SpectrogramChannels", "Min=1,Max=64")
+	Q_CLASSINFO("SpectrogramBins", "Min=32,Max=1024")
+	Q_CLASSINFO("SpectrogramHistory", "Min=64,Max=2048")
 private:
-	QSpectrumRenderComponent mSpectrumComp;
+	QPcmRingBuffer mRing{ 1 << 18 };
+	QPcmRingBuffer mTapRing{ 1 << 18 };
+	QAudioDecodeThread mDecodeThread{ "Resources/Audio/MySunset.mp3", &mRing };
+	QSpectrumAnalyzerThread mAnalyzerThread{ &mDecodeThread, &mRing };
+	QMediaPlayer mPlayer;
+	QAudioOutput mAudioOutput;
+	QSpectrumBarComponent mSpectrumComp;
 	QSharedPointer<QMeshPassBuilder> mMeshPass{ new QMeshPassBuilder };
+	QSharedPointer<QGpuSpectrogramPassBuilder> mSpectrogramPass{ new QGpuSpectrogramPassBuilder };
+	QSpectrogramFeed mSpectrogramFeed;
+	int mReportFrameCount = 0;
+	QGpuSpectrogramPassBuilder::Stats mReportSpectrogramStats;
+	qint64 mLastAnalyzedWindows = 0;
+	qint64 mLastAnalyzeNanoseconds = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
-		mSpectrumComp.setAudio("Resources/Audio/MySunset.mp3");
-		mSpectrumComp.setBarCount(1000);
-		mSpectrumComp.setTranslate(QVector3D(0, -0.5, 0));
-
+		QMatrix4x4 worldMatrix;
+		worldMatrix.translate(0, -0.5, 0);
+		mSpectrumComp.setWorldMatrix(worldMatrix);
+		mSpectrumComp.setAnalyzer(&mAnalyzerThread);
 		addComponent(&mSpectrumComp);
+
+		mAnalyzerThread.setTap(&mTapRing);
+		mSpectrogramFeed.setSource(&mTapRing, &mDecodeThread);
+
+		updateAnalyzerSettings();
+		auto syncPlayback = [this]() {
+			mAnalyzerThread.setPlaybackPosition(mPlayer.position(), mPlayer.playbackState() == QMediaPlayer::PlayingState);
+		};
+		QObject::connect(&mPlayer, &QMediaPlayer::positionChanged, syncPlayback);
+		QObject::connect(&mPlayer, &QMediaPlayer::playbackStateChanged, syncPlayback);
+		QObject::connect(&mPlayer, &QMediaPlayer::errorOccurred, [this](QMediaPlayer::Error, const QString& errorString) {
+			qWarning() << "[Spectrum] playback error, analysis falls back to a free-running clock:" << errorString;
+			mAnalyzerThread.setFreeRunning(true);
+		});
+		if (QMediaDevices::audioOutputs().isEmpty()) {							//没有音频设备时播放位置不前进，分析按自己的时钟继续
+			qWarning() << "[Spectrum] no audio output device, analysis uses a free-running clock";
+			mAnalyzerThread.setFreeRunning(true);
+		}
+
+		mDecodeThread.start();
+		mAnalyzerThread.start(QThread::HighPriority);
+		mPlayer.setAudioOutput(&mAudioOutput);
+		mPlayer.setSource(QUrl::fromLocalFile("Resources/Audio/MySunset.mp3"));
+		mPlayer.play();
+	}
+	~MyRenderer() {
+		mAnalyzerThread.requestInterruption();
+		mDecodeThread.requestInterruption();
+		mAnalyzerThread.wait();
+		mDecodeThread.wait();
+	}
+private:
+	void updateAnalyzerSettings() {
+		const int fftSize = qBound(1024, int(qNextPowerOfTwo(quint32(FftSize - 1))), 16384);		//FFT长度取2的幂
+		mAnalyzerThread.setSettings(fftSize, qBound(1, Overlap, 8), qBound(16, BarCount, QSpectrumBarComponent::MaxBarCount), UseSimd);
+	}
+	void reportSpectrumStats() {
+		static const int FramesPerReport = 240;
+		const QGpuSpectrogramPassBuilder::Stats& spectrogramStats = mSpectrogramPass->getStats();
+		mReportSpectrogramStats.columns += spectrogramStats.columns;
+		mReportSpectrogramStats.droppedColumns += spectrogramStats.droppedColumns;
+		mReportSpectrogramStats.dispatches += spectrogramStats.dispatches;
+		mReportSpectrogramStats.uploadedBytes += spectrogramStats.uploadedBytes;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		mReportFrameCount = 0;
+		QSpectrumAnalyzerThread::Stats& stats = mAnalyzerThread.getStats();
+		const qint64 windows = stats.analyzedWindows.load(std::memory_order_relaxed);
+		const qint64 nanoseconds = stats.analyzeNanoseconds.load(std::memory_order_relaxed);
+		const qint64 frameWindows = windows - mLastAnalyzedWindows;
+		qDebug().noquote() << QString("[Spectrum] %1 windows analyzed in the last %2 frames, %3 us per window, %4 samples buffered")
+			.arg(frameWindows)
+			.arg(FramesPerReport)
+			.arg((nanoseconds - mLastAnalyzeNanoseconds) / 1000.0 / qMax<qint64>(1, frameWindows), 0, 'f', 1)
+			.arg(stats.ringFill.load(std::memory_order_relaxed));
+		mLastAnalyzedWindows = windows;
+		mLastAnalyzeNanoseconds = nanoseconds;
+		qDebug().noquote() << QString("[Spectrogram] %1 channels, %2 GPU columns and %3 dispatches per frame, %4 KB uploaded per frame, %5 columns dropped")
+			.arg(mSpectrogramFeed.getChannelCount())
+			.arg(double(mReportSpectrogramStats.columns) / FramesPerReport, 0, 'f', 2)
+			.arg(double(mReportSpectrogramStats.dispatches) / FramesPerReport, 0, 'f', 1)
+			.arg(mReportSpectrogramStats.uploadedBytes / 1024.0 / FramesPerReport, 0, 'f', 1)
+			.arg(mReportSpectrogramStats.droppedColumns);
+		mReportSpectrogramStats = QGpuSpectrogramPassBuilder::Stats();
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		updateAnalyzerSettings();
 
 		QMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder("MeshPass", mMeshPass);
 
+		const int spectrogramChannels = qBound(1, SpectrogramChannels, 64);
+		mSpectrogramFeed.setChannelCount(spectrogramChannels);
+		QGpuSpectrogramPassBuilder::Output spectrogramOut
+			= graphBuilder.addPassBuilder("GpuSpectrogramPass", mSpectrogramPass)
+			.setBaseColor(meshOut.BaseColor)
+			.setFeed(&mSpectrogramFeed)
+			.setFftSize(qBound(1024, int(qNextPowerOfTwo(quint32(GpuFftSize - 1))), 16384))
+			.setOverlap(qBound(1, Overlap, 8))
+			.setBinCount(qBound(32, SpectrogramBins, 8192 / spectrogramChannels))		//纹理高度为通道数×频段数
+			.setHistoryLength(qBound(64, SpectrogramHistory, 2048));
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(meshOut.BaseColor);
+			.setInitialTexture(spectrogramOut.Result);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportSpectrumStats();
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--fft-benchmark")) {
+		runFftBenchmark();
+		return 0;
+	}
+	if (app.arguments().contains("--gpu-fft-check"))
+		return runGpuFftCheck();
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
+
+#include "main.moc"
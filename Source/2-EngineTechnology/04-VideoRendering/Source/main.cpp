@@ -1,17 +1,958 @@
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QMediaPlayer>
+#include <QMutex>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include <QVideoFrame>
+#include <QVideoSink>
+#include <atomic>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QMediaCaptureSession>
+#include <QMediaFormat>
+#include <QMediaRecorder>
+#include <QVideoFrameInput>
+#endif
 #include "QRenderWidget.h"
 #include "Render/Component/QStaticMeshRenderComponent.h"
+#include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "QtConcurrent/qtconcurrentrun.h"
 
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 着色器中的平面排布：半平面（UV交错）、半平面（VU交错）、三平面、已经是RGB的打包格式
+enum class QVideoPlaneLayout {
+	SemiPlanarUV = 0,
+	SemiPlanarVU = 1,
+	Planar = 2,
+	Packed = 3,
+};
+
+struct QVideoConvertUniformBlock {
+	float colorMatrix[16];
+	qint32 layout;
+	qint32 padding[3];
+};
+
+// YUV → RGB 矩阵，按帧格式的色彩空间与范围计算，作用在 vec4(Y, U, V, 1) 上
+static QMatrix4x4 videoColorMatrix(const QVideoFrameFormat& format) {
+	float kr = 0.299f;
+	float kb = 0.114f;
+	switch (format.colorSpace()) {
+	case QVideoFrameFormat::ColorSpace_BT709: kr = 0.2126f; kb = 0.0722f; break;
+	case QVideoFrameFormat::ColorSpace_BT2020: kr = 0.2627f; kb = 0.0593f; break;
+	default: break;
+	}
+	const float kg = 1.0f - kr - kb;
+	const bool fullRange = format.colorRange() == QVideoFrameFormat::ColorRange_Full;
+	const float yScale = fullRange ? 1.0f : 255.0f / 219.0f;
+	const float yOffset = fullRange ? 0.0f : 16.0f / 255.0f;
+	const float cScale = fullRange ? 1.0f : 255.0f / 224.0f;
+	const float rv = cScale * 2.0f * (1.0f - kr);
+	const float gu = -cScale * 2.0f * (1.0f - kb) * kb / kg;
+	const float gv = -cScale * 2.0f * (1.0f - kr) * kr / kg;
+	const float bu = cScale * 2.0f * (1.0f - kb);
+	return QMatrix4x4(
+		yScale, 0.0f, rv, -yScale * yOffset - rv * 0.5f,
+		yScale, gu, gv, -yScale * yOffset - (gu + gv) * 0.5f,
+		yScale, bu, 0.0f, -yScale * yOffset - bu * 0.5f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	);
+}
+
+static QShader newVideoConvertShader() {
+	return QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+		layout (binding = 0) uniform sampler2D uPlane0;
+		layout (binding = 1) uniform sampler2D uPlane1;
+		layout (binding = 2) uniform sampler2D uPlane2;
+		layout (std140, binding = 3) uniform UniformBlock {
+			mat4 colorMatrix;
+			int layout;
+		} ubo;
+		layout (location = 0) in vec2 vUV;
+		layout (location = 0) out vec4 outColor;
+		void main() {
+			if (ubo.layout == 3) {
+				outColor = vec4(texture(uPlane0, vUV).rgb, 1.0);
+				return;
+			}
+			float y = texture(uPlane0, vUV).r;
+			vec2 uv;
+			if (ubo.layout == 0)
+				uv = texture(uPlane1, vUV).rg;
+			else if (ubo.layout == 1)
+				uv = texture(uPlane1, vUV).gr;
+			else
+				uv = vec2(texture(uPlane1, vUV).r, texture(uPlane2, vUV).r);
+			outColor = vec4(clamp((ubo.colorMatrix * vec4(y, uv, 1.0)).rgb, 0.0, 1.0), 1.0);
+		}
+	)");
+}
+
+// 把QVideoFrame的各个平面直接上传为纹理：映射后的平面内存以fromRawData交给QRhi，
+// 按行跨度拷入QRhi自己的暂存缓冲，中间不经过QImage；被引用的帧保留在一个小的帧池里，直到对应的上传必然已经完成
+class QVideoFrameUploader {
+public:
+	struct Stats {
+		qint64 uploadedFrames = 0;
+		qint64 uploadedBytes = 0;
+		qint64 convertedFrames = 0;											//不支持直接上传、退回QImage转换的帧数
+	};
+	QVideoFrameUploader(QRhi* rhi)
+		: mRhi(rhi)
+		, mFramePool(rhi->resourceLimit(QRhi::FramesInFlight) + 1)
+	{
+		prepare(QVideoFrameFormat(QSize(16, 16), QVideoFrameFormat::Format_NV12));
+	}
+	~QVideoFrameUploader() {
+		for (QVideoFrame& frame : mFramePool) {
+			if (frame.isMapped())
+				frame.unmap();
+		}
+	}
+	// 平面格式或尺寸变化时重建纹理，返回true表示需要重建SRB
+	bool prepare(const QVideoFrameFormat& format) {
+		QVideoFrameFormat::PixelFormat pixelFormat = format.pixelFormat();
+		QVideoPlaneLayout layout = QVideoPlaneLayout::Packed;
+		QRhiTexture::Format packedFormat = QRhiTexture::RGBA8;
+		bool swapChroma = false;
+		switch (pixelFormat) {
+		case QVideoFrameFormat::Format_NV12: layout = QVideoPlaneLayout::SemiPlanarUV; break;
+		case QVideoFrameFormat::Format_NV21: layout = QVideoPlaneLayout::SemiPlanarVU; break;
+		case QVideoFrameFormat::Format_YUV420P: layout = QVideoPlaneLayout::Planar; break;
+		case QVideoFrameFormat::Format_YV12: layout = QVideoPlaneLayout::Planar; swapChroma = true; break;
+		case QVideoFrameFormat::Format_BGRA8888:
+		case QVideoFrameFormat::Format_BGRX8888: packedFormat = QRhiTexture::BGRA8; break;
+		case QVideoFrameFormat::Format_RGBA8888:
+		case QVideoFrameFormat::Format_RGBX8888: break;
+		default: pixelFormat = QVideoFrameFormat::Format_Invalid; break;			//其它格式走QImage转换，上传为RGBA8
+		}
+		const QSize size = format.frameSize();
+		if (pixelFormat == mPixelFormat && size == mFrameSize && !mPlanes[0].isNull())
+			return false;
+		mPixelFormat = pixelFormat;
+		mFrameSize = size;
+		mLayout = layout;
+		mSwapChroma = swapChroma;
+		const QSize chromaSize((size.width() + 1) / 2, (size.height() + 1) / 2);
+		for (QScopedPointer<QRhiTexture>& plane : mPlanes)
+			plane.reset();
+		switch (layout) {
+		case QVideoPlaneLayout::SemiPlanarUV:
+		case QVideoPlaneLayout::SemiPlanarVU:
+			mPlanes[0].reset(mRhi->newTexture(QRhiTexture::R8, size));
+			mPlanes[1].reset(mRhi->newTexture(QRhiTexture::RG8, chromaSize));
+			break;
+		case QVideoPlaneLayout::Planar:
+			mPlanes[0].reset(mRhi->newTexture(QRhiTexture::R8, size));
+			mPlanes[1].reset(mRhi->newTexture(QRhiTexture::R8, chromaSize));
+			mPlanes[2].reset(mRhi->newTexture(QRhiTexture::R8, chromaSize));
+			break;
+		case QVideoPlaneLayout::Packed:
+			mPlanes[0].reset(mRhi->newTexture(packedFormat, size));
+			break;
+		}
+		for (QScopedPointer<QRhiTexture>& plane : mPlanes) {
+			if (plane)
+				plane->create();
+		}
+		return true;
+	}
+	// 调用方需保证帧格式已经prepare过
+	void upload(QRhiResourceUpdateBatch* batch, const QVideoFrame& frame) {
+		QVideoFrame& slot = mFramePool[mFramePoolIndex];
+		mFramePoolIndex = (mFramePoolIndex + 1) % mFramePool.size();
+		if (slot.isMapped())
+			slot.unmap();
+		slot = QVideoFrame();
+		if (mPixelFormat == QVideoFrameFormat::Format_Invalid) {
+			mConvertedImage = frame.toImage().convertToFormat(QImage::Format_RGBA8888);
+			batch->uploadTexture(mPlanes[0].get(), mConvertedImage);
+			mStats.convertedFrames++;
+			mStats.uploadedFrames++;
+			mStats.uploadedBytes += mConvertedImage.sizeInBytes();
+			return;
+		}
+		slot = frame;
+		if (!slot.map(QVideoFrame::ReadOnly))
+			return;
+		const int chromaHeight = (mFrameSize.height() + 1) / 2;
+		for (int i = 0; i < slot.planeCount() && i < 3; i++) {
+			const int target = mSwapChroma && i > 0 ? 3 - i : i;
+			if (!mPlanes[target])
+				continue;
+			const int rows = i == 0 ? mFrameSize.height() : chromaHeight;
+			const int bytes = qMin(slot.mappedBytes(i), slot.bytesPerLine(i) * rows);
+			QRhiTextureSubresourceUploadDescription desc(QByteArray::fromRawData(reinterpret_cast<const char*>(slot.bits(i)), bytes));
+			desc.setDataStride(slot.bytesPerLine(i));
+			batch->uploadTexture(mPlanes[target].get(), QRhiTextureUploadEntry(0, 0, desc));
+			mStats.uploadedBytes += bytes;
+		}
+		mStats.uploadedFrames++;
+	}
+	// 未使用的平面绑定已有纹理占位，保证SRB布局一致
+	QVector<QRhiShaderResourceBinding> getBindings(QRhiSampler* sampler, QRhiBuffer* uniformBuffer) const {
+		QRhiTexture* plane0 = mPlanes[0].get();
+		QRhiTexture* plane1 = mPlanes[1] ? mPlanes[1].get() : plane0;
+		QRhiTexture* plane2 = mPlanes[2] ? mPlanes[2].get() : plane1;
+		return {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, plane0, sampler),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, plane1, sampler),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, plane2, sampler),
+			QRhiShaderResourceBinding::uniformBuffer(3, QRhiShaderResourceBinding::FragmentStage, uniformBuffer),
+		};
+	}
+	void fillUniform(QVideoConvertUniformBlock& block, const QVideoFrameFormat& format) const {
+		const QMatrix4x4 matrix = videoColorMatrix(format);
+		memcpy(block.colorMatrix, matrix.constData(), sizeof(block.colorMatrix));
+		block.layout = int(mLayout);
+	}
+	QSize getFrameSize() const { return mFrameSize; }
+	const Stats& getStats() const { return mStats; }
+private:
+	QRhi* mRhi;
+	QScopedPointer<QRhiTexture> mPlanes[3];
+	QVideoFrameFormat::PixelFormat mPixelFormat = QVideoFrameFormat::Format_Invalid;
+	QVideoPlaneLayout mLayout = QVideoPlaneLayout::Packed;
+	QSize mFrameSize;
+	bool mSwapChroma = false;
+	QVector<QVideoFrame> mFramePool;
+	int mFramePoolIndex = 0;
+	QImage mConvertedImage;
+	Stats mStats;
+};
+
+static QVideoFrame newTestVideoFrame(QVideoFrameFormat::PixelFormat pixelFormat, const QSize& size, int index) {
+	QVideoFrame frame(QVideoFrameFormat(size, pixelFormat));
+	if (!frame.map(QVideoFrame::WriteOnly))
+		return QVideoFrame();
+	for (int plane = 0; plane < frame.planeCount(); plane++) {
+		uchar* bits = frame.bits(plane);
+		const int rows = plane == 0 ? size.height() : (size.height() + 1) / 2;
+		for (int y = 0; y < rows; y++) {
+			for (int x = 0; x < frame.bytesPerLine(plane); x++)
+				bits[y * frame.bytesPerLine(plane) + x] = uchar((x + y * (plane + 1) + index * 4) & 0xFF);
+		}
+	}
+	frame.unmap();
+	return frame;
+}
+
+// 有界的预解码队列：解码线程写入，渲染线程按时间戳取帧
+class QVideoFrameQueue {
+public:
+	static const qint64 DiscontinuityUs = 500000;							//时间戳回退超过该值视为循环播放或跳转
+	struct Entry {
+		QVideoFrame frame;
+		qint64 pts = 0;
+		qint64 arrivalNs = 0;
+	};
+	struct Stats {
+		qint64 pushedFrames = 0;
+		qint64 overflowFrames = 0;
+		qint64 decodeIntervalNs = 0;
+		qint64 maxDecodeIntervalNs = 0;
+		int maxDepth = 0;
+	};
+	QVideoFrameQueue(int capacity)
+		: mCapacity(capacity)
+	{
+		mClock.start();
+	}
+	int getCapacity() const { return mCapacity; }
+	qint64 nowNs() const { return mClock.nsecsElapsed(); }
+	// 解码线程在队列满时会暂停，这里的硬上限（两倍容量）只防止暂停生效前的突发，超出时丢弃最旧的帧
+	void push(const QVideoFrame& frame) {
+		const qint64 now = nowNs();
+		QMutexLocker locker(&mMutex);
+		if (mLastArrivalNs > 0) {
+			const qint64 interval = now - mLastArrivalNs;
+			mStats.decodeIntervalNs += interval;
+			mStats.maxDecodeIntervalNs = qMax(mStats.maxDecodeIntervalNs, interval);
+		}
+		mLastArrivalNs = now;
+		const qint64 pts = frame.startTime() >= 0 ? frame.startTime() : mLastPts + 33333;
+		mLastPts = pts;
+		while (mEntries.size() >= mCapacity * 2) {
+			mEntries.removeFirst();
+			mStats.overflowFrames++;
+		}
+		mEntries.append({ frame, pts, now });
+		mStats.pushedFrames++;
+		mStats.maxDepth = qMax(mStats.maxDepth, int(mEntries.size()));
+	}
+	int getDepth() const {
+		QMutexLocker locker(&mMutex);
+		return mEntries.size();
+	}
+	bool peekFirstPts(qint64& pts) const {
+		QMutexLocker locker(&mMutex);
+		if (mEntries.isEmpty())
+			return false;
+		pts = mEntries.first().pts;
+		return true;
+	}
+	// 取出时间戳不晚于mediaTimeUs的最新一帧，排在它前面的过期帧一并丢弃，返回丢弃的帧数；遇到时间戳回退时停下
+	int takeDue(qint64 mediaTimeUs, Entry& entry) {
+		QMutexLocker locker(&mMutex);
+		int due = 0;
+		while (due < mEntries.size() && mEntries[due].pts <= mediaTimeUs
+			&& (due == 0 || mEntries[due].pts + DiscontinuityUs >= mEntries[due - 1].pts))
+			due++;
+		if (due == 0)
+			return 0;
+		entry = mEntries[due - 1];
+		mEntries.remove(0, due);
+		return due - 1;
+	}
+	Stats getStats() const {
+		QMutexLocker locker(&mMutex);
+		return mStats;
+	}
+private:
+	const int mCapacity;
+	QElapsedTimer mClock;
+	mutable QMutex mMutex;
+	QList<Entry> mEntries;
+	qint64 mLastArrivalNs = 0;
+	qint64 mLastPts = 0;
+	Stats mStats;
+};
+
+// 解码线程：QMediaPlayer以高于实时的速率解码，队列满时暂停、降到一半时恢复；没有视频文件时生成30fps的测试图案
+class QVideoDecodeThread : public QThread {
+public:
+	QVideoDecodeThread(QVideoFrameQueue* queue)
+		: mQueue(queue)
+	{
+	}
+	void setSource(const QString& path) { mPath = path; }
+	void setDecodeRate(double rate) { mDecodeRate.store(rate, std::memory_order_relaxed); }
+	bool isPaused() const { return mPaused.load(std::memory_order_relaxed); }
+protected:
+	void run() override {
+		QObject context;
+		QMediaPlayer player;
+		QVideoSink sink;
+		QTimer gateTimer;
+		QTimer patternTimer;
+		bool paused = false;
+		double rate = 0.0;
+		int patternIndex = 0;
+		qint64 lastPts = -1;
+		auto push = [&](const QVideoFrame& frame) {
+			if (!frame.isValid() || frame.startTime() == lastPts)			//暂停和恢复时sink可能重复送出当前帧
+				return;
+			lastPts = frame.startTime();
+			mQueue->push(frame);
+		};
+		if (!mPath.isEmpty()) {
+			player.setVideoSink(&sink);
+			QObject::connect(&sink, &QVideoSink::videoFrameChanged, &context, push);
+			player.setLoops(QMediaPlayer::Infinite);
+			player.setSource(QUrl::fromLocalFile(QFileInfo(mPath).absoluteFilePath()));
+			player.play();
+		}
+		else {
+			QObject::connect(&patternTimer, &QTimer::timeout, &context, [&]() {
+				QVideoFrame frame = newTestVideoFrame(QVideoFrameFormat::Format_NV12, QSize(640, 360), patternIndex);
+				frame.setStartTime(qint64(patternIndex) * 1000000 / 30);
+				frame.setEndTime(qint64(patternIndex + 1) * 1000000 / 30);
+				patternIndex++;
+				push(frame);
+			});
+		}
+		QObject::connect(&gateTimer, &QTimer::timeout, &context, [&]() {
+			if (isInterruptionRequested()) {
+				quit();
+				return;
+			}
+			const double targetRate = mDecodeRate.load(std::memory_order_relaxed);
+			const int depth = mQueue->getDepth();
+			const bool shouldPause = paused ? depth > mQueue->getCapacity() / 2 : depth >= mQueue->getCapacity();
+			if (shouldPause == paused && targetRate == rate)
+				return;
+			paused = shouldPause;
+			rate = targetRate;
+			mPaused.store(paused, std::memory_order_relaxed);
+			if (!mPath.isEmpty()) {
+				player.setPlaybackRate(rate);
+				if (paused)
+					player.pause();
+				else
+					player.play();
+			}
+			else if (paused) {
+				patternTimer.stop();
+			}
+			else {
+				patternTimer.start(qMax(1, int(1000.0 / 30.0 / rate)));
+			}
+		});
+		gateTimer.start(2);
+		exec();
+	}
+private:
+	QVideoFrameQueue* mQueue;
+	QString mPath;
+	std::atomic<double> mDecodeRate{ 2.0 };
+	std::atomic<bool> mPaused{ false };
+};
+
+// 渲染线程的帧调度：展示时钟随渲染节拍推进，每个节拍显示时间戳已到的最新一帧，
+// 来不及显示的帧直接丢弃；队列空时时钟停住等待解码，遇到循环或跳转时时钟重新对齐
+class QVideoFrameScheduler {
+public:
+	struct Stats {
+		qint64 presentedFrames = 0;
+		qint64 droppedFrames = 0;
+		qint64 underrunTicks = 0;
+		qint64 queueLatencyNs = 0;
+	};
+	QVideoFrameScheduler(QVideoFrameQueue* queue)
+		: mQueue(queue)
+	{
+	}
+	void setSpeed(double speed) { mSpeed = speed; }
+	const Stats& getStats() const { return mStats; }
+	qint64 getMediaTime() const { return mMediaTimeUs; }
+
+	bool take(QVideoFrame& frame, quint64& serial) {
+		const qint64 now = mQueue->nowNs();
+		const qint64 elapsedNs = mLastTickNs >= 0 ? now - mLastTickNs : 0;
+		mLastTickNs = now;
+		qint64 firstPts = 0;
+		if (!mQueue->peekFirstPts(firstPts)) {
+			if (mStarted)
+				mStats.underrunTicks++;
+			return false;
+		}
+		const bool discontinuity = mLastPresentedPts >= 0 && firstPts + QVideoFrameQueue::DiscontinuityUs < mLastPresentedPts;
+		if (!mStarted || discontinuity || firstPts > mMediaTimeUs + QVideoFrameQueue::DiscontinuityUs) {
+			mMediaTimeUs = firstPts;
+			mStarted = true;
+		}
+		else {
+			mMediaTimeUs += qint64(elapsedNs / 1000.0 * mSpeed);
+		}
+		QVideoFrameQueue::Entry entry;
+		const int dropped = mQueue->takeDue(mMediaTimeUs, entry);
+		if (!entry.frame.isValid())
+			return false;
+		mStats.droppedFrames += dropped;
+		mStats.presentedFrames++;
+		mStats.queueLatencyNs += now - entry.arrivalNs;
+		mLastPresentedPts = entry.pts;
+		frame = entry.frame;
+		serial++;
+		return true;
+	}
+private:
+	QVideoFrameQueue* mQueue;
+	double mSpeed = 1.0;
+	bool mStarted = false;
+	qint64 mLastTickNs = -1;
+	qint64 mMediaTimeUs = 0;
+	qint64 mLastPresentedPts = -1;
+	Stats mStats;
+};
+
+class QVideoPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QVideoPassBuilder)
+		QRP_INPUT_ATTR(QVideoFrameScheduler*, FrameSource);
+		QRP_INPUT_ATTR(QSize, OutputSize);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QVideoPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+private:
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiSamplerRef mSampler;
+	QRhiBufferRef mUniformBuffer;
+	QRhiShaderResourceBindingsRef mLayoutBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QScopedPointer<QRhiShaderResourceBindings> mBindings;
+	QRhiSampler* mBoundSampler = nullptr;
+	QRhiBuffer* mBoundUniformBuffer = nullptr;
+	QScopedPointer<QVideoFrameUploader> mUploader;
+	QShader mConvertFS;
+	QVideoFrame mFrame;
+	quint64 mFrameSerial = 0;
+	qint64 mUploadNanoseconds = 0;
+public:
+	QVideoPassBuilder() {
+		mConvertFS = newVideoConvertShader();
+	}
+	const QVideoFrameUploader::Stats* getStats() const { return mUploader ? &mUploader->getStats() : nullptr; }
+	qint64 getUploadNanoseconds() const { return mUploadNanoseconds; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		if (mRhi != builder.rhi()) {
+			mRhi = builder.rhi();
+			mUploader.reset(new QVideoFrameUploader(mRhi));
+		}
+		builder.setupTexture(mColorAttachment, "VideoColor", QRhiTexture::RGBA8, mInput._OutputSize, 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "VideoRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupSampler(mSampler, "VideoSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupBuffer(mUniformBuffer, "VideoUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QVideoConvertUniformBlock));
+		// 平面纹理随帧格式重建，管线只依赖绑定布局
+		builder.setupShaderResourceBindings(mLayoutBindings, "VideoLayoutBindings", mUploader->getBindings(mSampler.get(), mUniformBuffer.get()));
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mLayoutBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mConvertFS),
+		};
+		builder.setupGraphicsPipeline(mPipeline, "VideoPipeline", PSO);
+		if (mBoundSampler != mSampler.get() || mBoundUniformBuffer != mUniformBuffer.get())
+			mBindings.reset();
+		mOutput.Result = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		QElapsedTimer timer;
+		timer.start();
+		QVideoFrame frame;
+		if (mInput._FrameSource->take(frame, mFrameSerial)) {
+			if (mUploader->prepare(frame.surfaceFormat()))
+				mBindings.reset();
+			mUploader->upload(batch, frame);
+			mFrame = frame;
+		}
+		mUploadNanoseconds = timer.nsecsElapsed();
+		if (!mBindings) {
+			const QVector<QRhiShaderResourceBinding> bindings = mUploader->getBindings(mSampler.get(), mUniformBuffer.get());
+			mBindings.reset(mRhi->newShaderResourceBindings());
+			mBindings->setBindings(bindings.cbegin(), bindings.cend());
+			mBindings->create();
+			mBoundSampler = mSampler.get();
+			mBoundUniformBuffer = mUniformBuffer.get();
+		}
+		QVideoConvertUniformBlock ubo = {};
+		mUploader->fillUniform(ubo, mFrame.isValid() ? mFrame.surfaceFormat() : QVideoFrameFormat());
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(ubo), &ubo);
+
+		const QSize size = mRenderTarget->pixelSize();
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f), { 1.0f, 0 }, batch);
+		if (mFrame.isValid()) {											//保持宽高比居中显示
+			const QSize frameSize = mUploader->getFrameSize().scaled(size, Qt::KeepAspectRatio);
+			cmdBuffer->setViewport(QRhiViewport((size.width() - frameSize.width()) * 0.5f, (size.height() - frameSize.height()) * 0.5f, frameSize.width(), frameSize.height()));
+			cmdBuffer->setGraphicsPipeline(mPipeline.get());
+			cmdBuffer->setShaderResources(mBindings.get());
+			cmdBuffer->draw(4);
+		}
+		cmdBuffer->endPass();
+	}
+};
+
+// 不依赖窗口：解码本地文件（没有文件时生成NV12/I420测试帧），用离屏QRhi反复上传并转换，统计每秒上传帧数，并与QImage转换路径对比
+static QVector<QVideoFrame> decodeVideoFrames(const QString& path, int maxFrames, double& decodeFps) {
+	QVector<QVideoFrame> frames;
+	decodeFps = 0.0;
+	if (path.isEmpty() || !QFileInfo::exists(path))
+		return frames;
+	QMediaPlayer player;
+	QVideoSink sink;
+	QEventLoop loop;
+	QElapsedTimer timer;
+	player.setVideoSink(&sink);
+	QObject::connect(&sink, &QVideoSink::videoFrameChanged, &loop, [&](const QVideoFrame& frame) {
+		if (frames.isEmpty())
+			timer.start();
+		if (frame.isValid() && frames.size() < maxFrames)
+			frames << frame;
+		if (frames.size() >= maxFrames)
+			loop.quit();
+	});
+	QObject::connect(&player, &QMediaPlayer::mediaStatusChanged, &loop, [&](QMediaPlayer::MediaStatus status) {
+		if (status == QMediaPlayer::EndOfMedia || status == QMediaPlayer::InvalidMedia)
+			loop.quit();
+	});
+	QTimer::singleShot(20000, &loop, &QEventLoop::quit);
+	player.setSource(QUrl::fromLocalFile(QFileInfo(path).absoluteFilePath()));
+	player.play();
+	loop.exec();
+	player.stop();
+	if (frames.size() > 1)
+		decodeFps = (frames.size() - 1) / (timer.nsecsElapsed() / 1e9);
+	return frames;
+}
+
+static int runVideoUploadBenchmark(const QString& path) {
+	const int maxFrames = 60;
+	const int uploadsPerPath = 300;
+	double decodeFps = 0.0;
+	QVector<QVector<QVideoFrame>> frameSets;
+	QVector<QVideoFrame> decoded = decodeVideoFrames(path, maxFrames, decodeFps);
+	if (!decoded.isEmpty()) {
+		qDebug().noquote() << QString("[VideoBenchmark] decoded %1 frames of %2 (%3x%4, %5) at %6 fps")
+			.arg(decoded.size())
+			.arg(path)
+			.arg(decoded.first().width())
+			.arg(decoded.first().height())
+			.arg(QVideoFrameFormat::pixelFormatToString(decoded.first().pixelFormat()))
+			.arg(decodeFps, 0, 'f', 1);
+		frameSets << decoded;
+	}
+	else {
+		qDebug().noquote() << QString("[VideoBenchmark] no decodable file%1, using generated 1920x1080 test frames")
+			.arg(path.isEmpty() ? QString() : " at " + path);
+		for (QVideoFrameFormat::PixelFormat pixelFormat : { QVideoFrameFormat::Format_NV12, QVideoFrameFormat::Format_YUV420P }) {
+			QVector<QVideoFrame> frames;
+			for (int i = 0; i < 8; i++)
+				frames << newTestVideoFrame(pixelFormat, QSize(1920, 1080), i);
+			frameSets << frames;
+		}
+	}
+
+	QSharedPointer<QRhi> rhi = QRhiHelper::create();
+	if (!rhi) {
+		qWarning() << "[VideoBenchmark] failed to create QRhi";
+		return 1;
+	}
+	const QShader vertexShader = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+		layout (location = 0) out vec2 vUV;
+		out gl_PerVertex { vec4 gl_Position; };
+		void main() {
+			vUV = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+			gl_Position = vec4(vUV * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)");
+	const QShader convertShader = newVideoConvertShader();
+	const QShader copyShader = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+		layout (binding = 0) uniform sampler2D uImage;
+		layout (location = 0) in vec2 vUV;
+		layout (location = 0) out vec4 outColor;
+		void main() {
+			outColor = texture(uImage, vUV);
+		}
+	)");
+	for (const QVector<QVideoFrame>& frames : frameSets) {
+		const QVideoFrameFormat format = frames.first().surfaceFormat();
+		const QSize size = format.frameSize();
+		QScopedPointer<QRhiTexture> colorTexture(rhi->newTexture(QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget));
+		colorTexture->create();
+		QScopedPointer<QRhiTextureRenderTarget> renderTarget(rhi->newTextureRenderTarget({ colorTexture.get() }));
+		QScopedPointer<QRhiRenderPassDescriptor> renderPassDesc(renderTarget->newCompatibleRenderPassDescriptor());
+		renderTarget->setRenderPassDescriptor(renderPassDesc.get());
+		renderTarget->create();
+		QScopedPointer<QRhiSampler> sampler(rhi->newSampler(QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge));
+		sampler->create();
+		QScopedPointer<QRhiBuffer> uniformBuffer(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QVideoConvertUniformBlock)));
+		uniformBuffer->create();
+		QScopedPointer<QRhiTexture> imageTexture(rhi->newTexture(QRhiTexture::RGBA8, size));
+		imageTexture->create();
+
+		QVideoFrameUploader uploader(rhi.get());
+		uploader.prepare(format);
+		const QVector<QRhiShaderResourceBinding> convertBindingList = uploader.getBindings(sampler.get(), uniformBuffer.get());
+		QScopedPointer<QRhiShaderResourceBindings> convertBindings(rhi->newShaderResourceBindings());
+		convertBindings->setBindings(convertBindingList.cbegin(), convertBindingList.cend());
+		convertBindings->create();
+		QScopedPointer<QRhiShaderResourceBindings> copyBindings(rhi->newShaderResourceBindings());
+		copyBindings->setBindings({
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, imageTexture.get(), sampler.get()),
+		});
+		copyBindings->create();
+		auto newPipeline = [&](const QShader& fragmentShader, QRhiShaderResourceBindings* bindings) {
+			QRhiGraphicsPipeline* pipeline = rhi->newGraphicsPipeline();
+			pipeline->setShaderStages({
+				QRhiShaderStage(QRhiShaderStage::Vertex, vertexShader),
+				QRhiShaderStage(QRhiShaderStage::Fragment, fragmentShader),
+			});
+			pipeline->setShaderResourceBindings(bindings);
+			pipeline->setRenderPassDescriptor(renderPassDesc.get());
+			pipeline->create();
+			return pipeline;
+		};
+		QScopedPointer<QRhiGraphicsPipeline> convertPipeline(newPipeline(convertShader, convertBindings.get()));
+		QScopedPointer<QRhiGraphicsPipeline> copyPipeline(newPipeline(copyShader, copyBindings.get()));
+		QVideoConvertUniformBlock ubo = {};
+		uploader.fillUniform(ubo, format);
+
+		// 直接上传平面 + 着色器转换 与 QImage转换 + RGBA上传 两条路径各跑一遍
+		for (int imagePath = 0; imagePath < 2; imagePath++) {
+			QElapsedTimer timer;
+			qint64 bytes = 0;
+			for (int i = 0; i <= uploadsPerPath; i++) {
+				if (i == 1)
+					timer.start();													//第一帧包含管线与纹理的首次使用
+				const QVideoFrame& frame = frames[i % frames.size()];
+				QRhiCommandBuffer* cmdBuffer = nullptr;
+				if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+					return 1;
+				QRhiResourceUpdateBatch* batch = rhi->nextResourceUpdateBatch();
+				if (imagePath) {
+					const QImage image = frame.toImage().convertToFormat(QImage::Format_RGBA8888);
+					batch->uploadTexture(imageTexture.get(), image);
+					bytes += i > 0 ? image.sizeInBytes() : 0;
+				}
+				else {
+					const qint64 uploadedBytes = uploader.getStats().uploadedBytes;
+					uploader.upload(batch, frame);
+					batch->updateDynamicBuffer(uniformBuffer.get(), 0, sizeof(ubo), &ubo);
+					bytes += i > 0 ? uploader.getStats().uploadedBytes - uploadedBytes : 0;
+				}
+				cmdBuffer->beginPass(renderTarget.get(), Qt::black, { 1.0f, 0 }, batch);
+				cmdBuffer->setGraphicsPipeline(imagePath ? copyPipeline.get() : convertPipeline.get());
+				cmdBuffer->setShaderResources(imagePath ? copyBindings.get() : convertBindings.get());
+				cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+				cmdBuffer->draw(3);
+				cmdBuffer->endPass();
+				rhi->endOffscreenFrame();											//离屏帧结束时会等待GPU完成
+			}
+			const double seconds = timer.nsecsElapsed() / 1e9;
+			qDebug().noquote() << QString("[VideoBenchmark] %1 %2x%3 via %4: %5 frames uploaded/s, %6 MB per frame")
+				.arg(QVideoFrameFormat::pixelFormatToString(format.pixelFormat()))
+				.arg(size.width())
+				.arg(size.height())
+				.arg(imagePath ? "QImage conversion" : "direct plane upload")
+				.arg(uploadsPerPath / seconds, 0, 'f', 1)
+				.arg(bytes / 1048576.0 / uploadsPerPath, 0, 'f', 2);
+		}
+	}
+	return 0;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+// 用QVideoFrameInput把测试图案编码成H.264短片，测试不依赖外部素材
+static bool generateTestClip(const QString& path, int frameCount, const QSize& size) {
+	QMediaCaptureSession session;
+	QVideoFrameInput input;
+	QMediaRecorder recorder;
+	session.setVideoFrameInput(&input);
+	session.setRecorder(&recorder);
+	QMediaFormat format(QMediaFormat::MPEG4);
+	format.setVideoCodec(QMediaFormat::VideoCodec::H264);
+	recorder.setMediaFormat(format);
+	recorder.setVideoFrameRate(30);
+	recorder.setVideoResolution(size);
+	recorder.setOutputLocation(QUrl::fromLocalFile(path));
+	QEventLoop loop;
+	int sent = 0;
+	bool stopping = false;
+	auto sendFrames = [&]() {
+		while (sent < frameCount) {
+			QVideoFrame frame = newTestVideoFrame(QVideoFrameFormat::Format_NV12, size, sent);
+			frame.setStartTime(qint64(sent) * 1000000 / 30);
+			frame.setEndTime(qint64(sent + 1) * 1000000 / 30);
+			if (!input.sendVideoFrame(frame))
+				return;
+			sent++;
+		}
+		if (!stopping) {
+			stopping = true;
+			recorder.stop();
+		}
+	};
+	QObject::connect(&input, &QVideoFrameInput::readyToSendVideoFrame, &loop, sendFrames);
+	QObject::connect(&recorder, &QMediaRecorder::recorderStateChanged, &loop, [&](QMediaRecorder::RecorderState state) {
+		if (state == QMediaRecorder::StoppedState)
+			loop.quit();
+	});
+	QObject::connect(&recorder, &QMediaRecorder::errorOccurred, &loop, [&](QMediaRecorder::Error, const QString& error) {
+		qWarning() << "[VideoPacing] failed to record the test clip:" << error;
+		loop.quit();
+	});
+	QTimer::singleShot(30000, &loop, &QEventLoop::quit);
+	recorder.record();
+	sendFrames();
+	loop.exec();
+	return sent == frameCount && QFileInfo(path).size() > 0;
+}
+#endif
+
+// 不依赖显示：对本地视频（或现场生成的测试短片）跑预解码队列，用模拟的渲染节拍检查帧选择、丢帧和队列深度
+static int runVideoPacingTest(const QString& path) {
+	QTemporaryDir tempDir;
+	QString source = QFileInfo::exists(path) ? path : QString();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+	if (source.isEmpty() && tempDir.isValid()) {
+		const QString clipPath = tempDir.filePath("PacingTest.mp4");
+		if (generateTestClip(clipPath, 150, QSize(640, 360)))
+			source = clipPath;
+	}
+#endif
+	qDebug().noquote() << QString("[VideoPacing] source: %1").arg(source.isEmpty() ? "generated test pattern" : source);
+
+	QVideoFrameQueue queue(8);
+	QVideoDecodeThread decoder(&queue);
+	decoder.setSource(source);
+	decoder.setDecodeRate(2.0);
+	decoder.start();
+	QVideoFrameScheduler scheduler(&queue);
+
+	QElapsedTimer startTimer;
+	startTimer.start();
+	while (queue.getDepth() == 0 && startTimer.elapsed() < 10000)
+		QThread::msleep(5);
+
+	struct Phase {
+		const char* name;
+		int tickMs;
+		int durationMs;
+	};
+	const Phase phases[] = {
+		{ "60 Hz ticks", 16, 2000 },
+		{ "70 ms ticks (render under load)", 70, 1500 },
+		{ "60 Hz ticks", 16, 1500 },
+	};
+	quint64 serial = 0;
+	qint64 lastPts = -1;
+	int nonMonotonic = 0;
+	qint64 loadDrops = 0;
+	for (const Phase& phase : phases) {
+		const QVideoFrameScheduler::Stats before = scheduler.getStats();
+		qint64 depthSum = 0;
+		int maxDepth = 0;
+		int ticks = 0;
+		QElapsedTimer timer;
+		timer.start();
+		while (timer.elapsed() < phase.durationMs) {
+			QVideoFrame frame;
+			if (scheduler.take(frame, serial)) {
+				const qint64 pts = frame.startTime();
+				if (lastPts >= 0 && pts < lastPts && pts + QVideoFrameQueue::DiscontinuityUs >= lastPts)
+					nonMonotonic++;												//循环回到开头之外，展示时间戳不应回退
+				lastPts = pts;
+			}
+			const int depth = queue.getDepth();
+			depthSum += depth;
+			maxDepth = qMax(maxDepth, depth);
+			ticks++;
+			QThread::msleep(phase.tickMs);
+		}
+		const QVideoFrameScheduler::Stats& after = scheduler.getStats();
+		const qint64 presented = after.presentedFrames - before.presentedFrames;
+		const qint64 dropped = after.droppedFrames - before.droppedFrames;
+		if (phase.tickMs > 40)
+			loadDrops += dropped;
+		qDebug().noquote() << QString("[VideoPacing] %1: %2 ticks, %3 frames presented, %4 dropped, %5 underrun ticks, queue depth avg %6 max %7, %8 ms average queue latency")
+			.arg(phase.name)
+			.arg(ticks)
+			.arg(presented)
+			.arg(dropped)
+			.arg(after.underrunTicks - before.underrunTicks)
+			.arg(double(depthSum) / qMax(1, ticks), 0, 'f', 1)
+			.arg(maxDepth)
+			.arg((after.queueLatencyNs - before.queueLatencyNs) / 1e6 / qMax<qint64>(1, presented), 0, 'f', 1);
+	}
+	decoder.requestInterruption();
+	decoder.wait();
+
+	const QVideoFrameQueue::Stats queueStats = queue.getStats();
+	const bool passed = scheduler.getStats().presentedFrames > 0 && nonMonotonic == 0 && loadDrops > 0 && queueStats.maxDepth <= queue.getCapacity() * 2;
+	qDebug().noquote() << QString("[VideoPacing] %1 frames decoded, %2 ms average / %3 ms max decode interval, max queue depth %4 of %5, %6 overflow drops, %7 out-of-order presentations: %8")
+		.arg(queueStats.pushedFrames)
+		.arg(queueStats.decodeIntervalNs / 1e6 / qMax<qint64>(1, queueStats.pushedFrames - 1), 0, 'f', 1)
+		.arg(queueStats.maxDecodeIntervalNs / 1e6, 0, 'f', 1)
+		.arg(queueStats.maxDepth)
+		.arg(queue.getCapacity())
+		.arg(queueStats.overflowFrames)
+		.arg(nonMonotonic)
+		.arg(passed ? "PASSED" : "FAILED");
+	return passed ? 0 : 1;
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(double, DecodeAheadRate) = 2.0;
+	Q_PROPERTY_VAR(double, PlaybackSpeed) = 1.0;
+
+	Q_CLASSINFO("DecodeAheadRate", "Min=1,Max=8")
+	Q_CLASSINFO("PlaybackSpeed", "Min=0.25,Max=4")
 private:
+	QVideoFrameQueue mFrameQueue{ 8 };
+	QVideoDecodeThread mDecodeThread{ &mFrameQueue };
+	QVideoFrameScheduler mScheduler{ &mFrameQueue };
+	QSharedPointer<QVideoPassBuilder> mVideoPass{ new QVideoPassBuilder };
+	int mReportFrameCount = 0;
+	qint64 mReportUploadNanoseconds = 0;
+	qint64 mReportDepthSum = 0;
+	QVideoFrameUploader::Stats mLastStats;
+	QVideoFrameScheduler::Stats mLastSchedulerStats;
+	QVideoFrameQueue::Stats mLastQueueStats;
 public:
-	MyRenderer()
+	MyRenderer(const QString& videoPath)
 		: IRenderer({QRhi::Vulkan}) {
+		mDecodeThread.setSource(videoPath);
+		mDecodeThread.setDecodeRate(DecodeAheadRate);
+		mDecodeThread.start();
+	}
+	~MyRenderer() {
+		mDecodeThread.requestInterruption();
+		mDecodeThread.wait();
+	}
+private:
+	void reportVideoStats() {
+		static const int FramesPerReport = 240;
+		mReportUploadNanoseconds += mVideoPass->getUploadNanoseconds();
+		mReportDepthSum += mFrameQueue.getDepth();
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		const QVideoFrameUploader::Stats* stats = mVideoPass->getStats();
+		if (stats) {
+			const qint64 frames = stats->uploadedFrames - mLastStats.uploadedFrames;
+			qDebug().noquote() << QString("[Video] %1 frames uploaded in the last %2 render frames, %3 MB per video frame, %4 us CPU per render frame, %5 frames converted through QImage")
+				.arg(frames)
+				.arg(FramesPerReport)
+				.arg((stats->uploadedBytes - mLastStats.uploadedBytes) / 1048576.0 / qMax<qint64>(1, frames), 0, 'f', 2)
+				.arg(mReportUploadNanoseconds / 1000.0 / FramesPerReport, 0, 'f', 1)
+				.arg(stats->convertedFrames - mLastStats.convertedFrames);
+			mLastStats = *stats;
+		}
+		const QVideoFrameScheduler::Stats& schedulerStats = mScheduler.getStats();
+		const QVideoFrameQueue::Stats queueStats = mFrameQueue.getStats();
+		const qint64 presented = schedulerStats.presentedFrames - mLastSchedulerStats.presentedFrames;
+		const qint64 decoded = queueStats.pushedFrames - mLastQueueStats.pushedFrames;
+		qDebug().noquote() << QString("[VideoPacing] %1 presented, %2 dropped, %3 underrun ticks, queue depth %4 of %5%6, %7 ms decode interval, %8 ms queue latency")
+			.arg(presented)
+			.arg(schedulerStats.droppedFrames - mLastSchedulerStats.droppedFrames)
+			.arg(schedulerStats.underrunTicks - mLastSchedulerStats.underrunTicks)
+			.arg(double(mReportDepthSum) / FramesPerReport, 0, 'f', 1)
+			.arg(mFrameQueue.getCapacity())
+			.arg(mDecodeThread.isPaused() ? " (decoder paused)" : "")
+			.arg((queueStats.decodeIntervalNs - mLastQueueStats.decodeIntervalNs) / 1e6 / qMax<qint64>(1, decoded), 0, 'f', 1)
+			.arg((schedulerStats.queueLatencyNs - mLastSchedulerStats.queueLatencyNs) / 1e6 / qMax<qint64>(1, presented), 0, 'f', 1);
+		mLastSchedulerStats = schedulerStats;
+		mLastQueueStats = queueStats;
+		mReportFrameCount = 0;
+		mReportUploadNanoseconds = 0;
+		mReportDepthSum = 0;
 	}
 public:
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		const double playbackSpeed = qBound(0.25, PlaybackSpeed, 4.0);
+		mScheduler.setSpeed(playbackSpeed);
+		mDecodeThread.setDecodeRate(qMax(qBound(1.0, DecodeAheadRate, 8.0), playbackSpeed));		//解码速率不能低于播放速率
+
+		QVideoPassBuilder::Output videoOut
+			= graphBuilder.addPassBuilder("VideoPass", mVideoPass)
+			.setFrameSource(&mScheduler)
+			.setOutputSize(QSize(1920, 1080));
+
+		QOutputPassBuilder::Output cout
+			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
+			.setInitialTexture(videoOut.Result);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportVideoStats();
+		});
 	}
 };
 
@@ -20,8 +961,24 @@ int main(int argc, char** argv) {
 	QRhiHelper::InitParams initParams;
 	initParams.backend = QRhi::Implementation::Vulkan;
 
-	QRenderWidget widget(new MyRenderer());
+	// 用法：04-VideoRendering [视频文件] [--video-upload-benchmark | --video-pacing-test]
+	QString videoPath;															//不指定文件时播放生成的测试图案
+	for (const QString& argument : app.arguments().mid(1)) {
+		if (!argument.startsWith("--"))
+			videoPath = argument;
+	}
+	if (app.arguments().contains("--video-upload-benchmark"))
+		return runVideoUploadBenchmark(videoPath);
+	if (app.arguments().contains("--video-pacing-test"))
+		return runVideoPacingTest(videoPath);
+	if (!videoPath.isEmpty() && !QFileInfo::exists(videoPath)) {
+		qWarning() << "[Video] video file not found:" << videoPath << ", playing a test pattern instead";
+		videoPath.clear();
+	}
+
+	QRenderWidget widget(new MyRenderer(videoPath));
 	widget.showMaximized();
 	return app.exec();
 }
 
+#include "main.moc"
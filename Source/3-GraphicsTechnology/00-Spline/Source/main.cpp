@@ -1,14 +1,581 @@
 #include "QEngineApplication.h"
 #include "QtConcurrent/qtconcurrentrun.h"
 #include "QRenderWidget.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
 #include "Render/Component/QSplineRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
 
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 紧凑的控制点与样条描述，CPU只维护这两块数据，曲线求值和描边展开都在计算着色器中完成
+struct QGpuSplinePoint {
+	float position[3];
+	float width;
+};
+
+struct QGpuSplineDesc {
+	quint32 firstPoint;
+	quint32 pointCount;
+	quint32 firstVertex;
+	quint32 segmentsPerSpan;
+	quint32 color;
+	quint32 padding[3];
+};
+
+struct QGpuSplineVertex {
+	float position[3];
+	quint32 color;
+};
+
+class QGpuSplineSet {
+public:
+	static int sampleCount(int pointCount, int segmentsPerSpan) {
+		return segmentsPerSpan * (pointCount - 1) + 1;
+	}
+	void clear() {
+		mPoints.clear();
+		mDescs.clear();
+		mIndices.clear();
+		mVertexCount = 0;
+		mLayoutVersion++;
+		mPointsVersion++;
+	}
+	void addSpline(const QVector<QGpuSplinePoint>& points, const QColor& color, int segmentsPerSpan) {
+		if (points.size() < 2)
+			return;
+		QGpuSplineDesc desc = {};
+		desc.firstPoint = mPoints.size();
+		desc.pointCount = points.size();
+		desc.firstVertex = mVertexCount;
+		desc.segmentsPerSpan = qMax(1, segmentsPerSpan);
+		desc.color = quint32(color.red()) | quint32(color.green()) << 8 | quint32(color.blue()) << 16 | quint32(color.alpha()) << 24;
+		mPoints << points;
+		mDescs << desc;
+
+		// 索引只依赖拓扑，控制点移动时不需要重建
+		const int samples = sampleCount(desc.pointCount, desc.segmentsPerSpan);
+		for (int i = 0; i < samples - 1; i++) {
+			const quint32 a = desc.firstVertex + i * 2;
+			mIndices << a << a + 1 << a + 2 << a + 2 << a + 1 << a + 3;
+		}
+		mVertexCount += samples * 2;
+		mLayoutVersion++;
+		mPointsVersion++;
+	}
+	QGpuSplinePoint* beginUpdatePoints() {
+		mPointsVersion++;
+		return mPoints.data();
+	}
+	const QVector<QGpuSplinePoint>& getPoints() const { return mPoints; }
+	const QVector<QGpuSplineDesc>& getDescs() const { return mDescs; }
+	const QVector<quint32>& getIndices() const { return mIndices; }
+	int getSplineCount() const { return mDescs.size(); }
+	int getVertexCount() const { return mVertexCount; }
+	int getLayoutVersion() const { return mLayoutVersion; }
+	int getPointsVersion() const { return mPointsVersion; }
+private:
+	QVector<QGpuSplinePoint> mPoints;
+	QVector<QGpuSplineDesc> mDescs;
+	QVector<quint32> mIndices;
+	int mVertexCount = 0;
+	int mLayoutVersion = 0;
+	int mPointsVersion = 0;
+};
+
+// CPU参考实现：与计算着色器逐行对应，用于校验GPU结果以及作为吞吐量对比的基准
+class QSplineEvaluator {
+public:
+	// 均匀Catmull-Rom，首尾使用镜像的虚拟控制点，保证曲线穿过所有控制点
+	static void evaluate(const QGpuSplinePoint* points, int pointCount, int span, float t, QVector3D& position, QVector3D& tangent, float& width) {
+		const QVector3D p1 = toVector(points[span]);
+		const QVector3D p2 = toVector(points[span + 1]);
+		const QVector3D p0 = span > 0 ? toVector(points[span - 1]) : 2.0f * p1 - p2;
+		const QVector3D p3 = span + 2 < pointCount ? toVector(points[span + 2]) : 2.0f * p2 - p1;
+		const QVector3D a = 2.0f * p1;
+		const QVector3D b = p2 - p0;
+		const QVector3D c = 2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3;
+		const QVector3D d = -p0 + 3.0f * p1 - 3.0f * p2 + p3;
+		position = 0.5f * (a + (b + (c + d * t) * t) * t);
+		tangent = 0.5f * (b + (2.0f * c + 3.0f * d * t) * t);
+		width = points[span].width + (points[span + 1].width - points[span].width) * t;
+	}
+	static void expand(const QGpuSplineSet& set, const QVector3D& cameraPosition, QVector<QGpuSplineVertex>& vertices) {
+		vertices.resize(set.getVertexCount());
+		for (const QGpuSplineDesc& desc : set.getDescs()) {
+			const QGpuSplinePoint* points = set.getPoints().constData() + desc.firstPoint;
+			const int samples = QGpuSplineSet::sampleCount(desc.pointCount, desc.segmentsPerSpan);
+			for (int i = 0; i < samples; i++) {
+				const int span = qMin(i / int(desc.segmentsPerSpan), int(desc.pointCount) - 2);
+				const float t = float(i - span * int(desc.segmentsPerSpan)) / desc.segmentsPerSpan;
+				QVector3D position, tangent;
+				float width;
+				evaluate(points, desc.pointCount, span, t, position, tangent, width);
+				const QVector3D side = strokeSide(tangent, position - cameraPosition) * (width * 0.5f);
+				QGpuSplineVertex& left = vertices[desc.firstVertex + i * 2];
+				QGpuSplineVertex& right = vertices[desc.firstVertex + i * 2 + 1];
+				setVertex(left, position - side, desc.color);
+				setVertex(right, position + side, desc.color);
+			}
+		}
+	}
+	// 描边方向同时垂直于切线和视线，条带始终朝向相机
+	static QVector3D strokeSide(const QVector3D& tangent, const QVector3D& viewDirection) {
+		QVector3D side = QVector3D::crossProduct(tangent, viewDirection);
+		if (side.lengthSquared() < 1e-12f)
+			side = QVector3D(-tangent.y(), tangent.x(), 0.0f);
+		if (side.lengthSquared() < 1e-12f)
+			return QVector3D(0.0f, 1.0f, 0.0f);
+		return side.normalized();
+	}
+private:
+	static QVector3D toVector(const QGpuSplinePoint& point) {
+		return QVector3D(point.position[0], point.position[1], point.position[2]);
+	}
+	static void setVertex(QGpuSplineVertex& vertex, const QVector3D& position, quint32 color) {
+		vertex.position[0] = position.x();
+		vertex.position[1] = position.y();
+		vertex.position[2] = position.z();
+		vertex.color = color;
+	}
+};
+
+// 一个工作组负责一条样条，组内线程按采样点跨步展开
+static QShader newSplineExpandShader() {
+	return QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+		layout (local_size_x = 64) in;
+		struct SplineDesc {
+			uint firstPoint;
+			uint pointCount;
+			uint firstVertex;
+			uint segmentsPerSpan;
+			uint color;
+			uint padding0;
+			uint padding1;
+			uint padding2;
+		};
+		struct SplineVertex {
+			vec3 position;
+			uint color;
+		};
+		layout (std430, binding = 0) readonly buffer PointBuffer { vec4 points[]; };
+		layout (std430, binding = 1) readonly buffer DescBuffer { SplineDesc descs[]; };
+		layout (std430, binding = 2) writeonly buffer VertexBuffer { SplineVertex vertices[]; };
+		layout (std140, binding = 3) uniform UniformBlock {
+			vec4 cameraPosition;
+			int splineCount;
+		} ubo;
+		vec3 strokeSide(vec3 tangent, vec3 viewDirection) {
+			vec3 side = cross(tangent, viewDirection);
+			if (dot(side, side) < 1e-12)
+				side = vec3(-tangent.y, tangent.x, 0.0);
+			if (dot(side, side) < 1e-12)
+				return vec3(0.0, 1.0, 0.0);
+			return normalize(side);
+		}
+		void main() {
+			if (int(gl_WorkGroupID.x) >= ubo.splineCount)
+				return;
+			SplineDesc desc = descs[gl_WorkGroupID.x];
+			uint samples = desc.segmentsPerSpan * (desc.pointCount - 1) + 1;
+			for (uint i = gl_LocalInvocationIndex; i < samples; i += 64) {
+				int span = min(int(i / desc.segmentsPerSpan), int(desc.pointCount) - 2);
+				float t = float(int(i) - span * int(desc.segmentsPerSpan)) / float(desc.segmentsPerSpan);
+				vec4 q1 = points[desc.firstPoint + span];
+				vec4 q2 = points[desc.firstPoint + span + 1];
+				vec3 p1 = q1.xyz;
+				vec3 p2 = q2.xyz;
+				vec3 p0 = span > 0 ? points[desc.firstPoint + span - 1].xyz : 2.0 * p1 - p2;
+				vec3 p3 = span + 2 < int(desc.pointCount) ? points[desc.firstPoint + span + 2].xyz : 2.0 * p2 - p1;
+				vec3 a = 2.0 * p1;
+				vec3 b = p2 - p0;
+				vec3 c = 2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3;
+				vec3 d = -p0 + 3.0 * p1 - 3.0 * p2 + p3;
+				vec3 position = 0.5 * (a + (b + (c + d * t) * t) * t);
+				vec3 tangent = 0.5 * (b + (2.0 * c + 3.0 * d * t) * t);
+				float width = q1.w + (q2.w - q1.w) * t;
+				vec3 side = strokeSide(tangent, position - ubo.cameraPosition.xyz) * (width * 0.5);
+				uint vertex = desc.firstVertex + i * 2;
+				vertices[vertex].position = position - side;
+				vertices[vertex].color = desc.color;
+				vertices[vertex + 1].position = position + side;
+				vertices[vertex + 1].color = desc.color;
+			}
+		}
+	)");
+}
+
+struct QSplineExpandUniformBlock {
+	float cameraPosition[4];
+	qint32 splineCount;
+	qint32 padding[3];
+};
+
+class QGpuSplinePassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QGpuSplinePassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QGpuSplineSet*, SplineSet);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(QVector3D, CameraPosition);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QGpuSplinePassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+public:
+	struct Stats {
+		qint64 uploadedBytes = 0;
+	};
+private:
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiSamplerRef mSampler;
+	QRhiBufferRef mExpandUniformBuffer;
+	QRhiBufferRef mDrawUniformBuffer;
+	QRhiBufferRef mPointBuffer;
+	QRhiBufferRef mDescBuffer;
+	QRhiBufferRef mVertexBuffer;
+	QRhiBufferRef mIndexBuffer;
+	QRhiShaderResourceBindingsRef mExpandBindings;
+	QRhiComputePipelineRef mExpandPipeline;
+	QRhiShaderResourceBindingsRef mCopyBindings;
+	QRhiGraphicsPipelineRef mCopyPipeline;
+	QRhiShaderResourceBindingsRef mDrawBindings;
+	QRhiGraphicsPipelineRef mDrawPipeline;
+	QShader mExpandCS;
+	QShader mCopyFS;
+	QShader mDrawVS;
+	QShader mDrawFS;
+	QRhiBuffer* mUploadedPointBuffer = nullptr;
+	QRhiBuffer* mUploadedDescBuffer = nullptr;
+	int mUploadedLayoutVersion = -1;
+	int mUploadedPointsVersion = -1;
+	Stats mStats;
+public:
+	QGpuSplinePassBuilder() {
+		mExpandCS = newSplineExpandShader();
+		mCopyFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uBaseColor;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = texture(uBaseColor, vUV);
+			}
+		)");
+		mDrawVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inPosition;
+			layout (location = 1) in vec4 inColor;
+			layout (std140, binding = 0) uniform UniformBlock {
+				mat4 viewProjection;
+			} ubo;
+			layout (location = 0) out vec4 vColor;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				vColor = inColor;
+				gl_Position = ubo.viewProjection * vec4(inPosition, 1.0);
+			}
+		)");
+		mDrawFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (location = 0) in vec4 vColor;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = vColor;
+			}
+		)");
+	}
+	const Stats& getStats() const { return mStats; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QGpuSplineSet* set = mInput._SplineSet;
+		const int pointCount = qMax(1, set->getPoints().size());
+		const int splineCount = qMax(1, set->getSplineCount());
+		const int vertexCount = qMax(1, set->getVertexCount());
+		const int indexCount = qMax(1, set->getIndices().size());
+
+		builder.setupTexture(mColorAttachment, "SplineColor", mInput._BaseColor->format(), mInput._BaseColor->pixelSize(), 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "SplineRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupSampler(mSampler, "SplineSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupBuffer(mExpandUniformBuffer, "SplineExpandUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QSplineExpandUniformBlock));
+		builder.setupBuffer(mDrawUniformBuffer, "SplineDrawUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(float) * 16);
+		builder.setupBuffer(mPointBuffer, "SplinePointBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(QGpuSplinePoint) * pointCount);
+		builder.setupBuffer(mDescBuffer, "SplineDescBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(QGpuSplineDesc) * splineCount);
+		builder.setupBuffer(mVertexBuffer, "SplineVertexBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, sizeof(QGpuSplineVertex) * vertexCount);
+		builder.setupBuffer(mIndexBuffer, "SplineIndexBuffer", QRhiBuffer::Static, QRhiBuffer::IndexBuffer, sizeof(quint32) * indexCount);
+
+		builder.setupShaderResourceBindings(mExpandBindings, "SplineExpandBindings", {
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, mPointBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, mDescBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(2, QRhiShaderResourceBinding::ComputeStage, mVertexBuffer.get()),
+			QRhiShaderResourceBinding::uniformBuffer(3, QRhiShaderResourceBinding::ComputeStage, mExpandUniformBuffer.get()),
+		});
+		builder.setupComputePipeline(mExpandPipeline, "SplineExpandPipeline", QRhiComputePipelineState{ mExpandBindings.get(), mExpandCS });
+
+		builder.setupShaderResourceBindings(mCopyBindings, "SplineCopyBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState copyPSO;
+		copyPSO.shaderResourceBindings = mCopyBindings.get();
+		copyPSO.sampleCount = mRenderTarget->sampleCount();
+		copyPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		copyPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCopyFS),
+		};
+		builder.setupGraphicsPipeline(mCopyPipeline, "SplineCopyPipeline", copyPSO);
+
+		builder.setupShaderResourceBindings(mDrawBindings, "SplineDrawBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mDrawUniformBuffer.get()),
+		});
+		QRhiGraphicsPipelineState drawPSO;
+		drawPSO.shaderResourceBindings = mDrawBindings.get();
+		drawPSO.sampleCount = mRenderTarget->sampleCount();
+		drawPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(sizeof(QGpuSplineVertex)),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, offsetof(QGpuSplineVertex, position)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::UNormByte4, offsetof(QGpuSplineVertex, color)),
+		});
+		drawPSO.vertexInputLayout = inputLayout;
+		drawPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mDrawVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mDrawFS),
+		};
+		builder.setupGraphicsPipeline(mDrawPipeline, "SplineDrawPipeline", drawPSO);
+
+		mOutput.Result = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QGpuSplineSet* set = mInput._SplineSet;
+		mStats = Stats();
+
+		QSplineExpandUniformBlock expandUbo = {};
+		memcpy(expandUbo.cameraPosition, &mInput._CameraPosition, sizeof(QVector3D));
+		expandUbo.cameraPosition[3] = 1.0f;
+		expandUbo.splineCount = set->getSplineCount();
+		const QMatrix4x4 viewProjection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mExpandUniformBuffer.get(), 0, sizeof(QSplineExpandUniformBlock), &expandUbo);
+		batch->updateDynamicBuffer(mDrawUniformBuffer.get(), 0, sizeof(float) * 16, viewProjection.constData());
+		// 拓扑（描述与索引）只在样条增删时上传，每帧只有控制点变化
+		if (mUploadedLayoutVersion != set->getLayoutVersion() || mUploadedDescBuffer != mDescBuffer.get()) {
+			if (!set->getDescs().isEmpty()) {
+				batch->uploadStaticBuffer(mDescBuffer.get(), 0, set->getDescs().size() * sizeof(QGpuSplineDesc), set->getDescs().constData());
+				batch->uploadStaticBuffer(mIndexBuffer.get(), 0, set->getIndices().size() * sizeof(quint32), set->getIndices().constData());
+				mStats.uploadedBytes += set->getDescs().size() * sizeof(QGpuSplineDesc) + set->getIndices().size() * sizeof(quint32);
+			}
+			mUploadedLayoutVersion = set->getLayoutVersion();
+			mUploadedDescBuffer = mDescBuffer.get();
+		}
+		if (mUploadedPointsVersion != set->getPointsVersion() || mUploadedPointBuffer != mPointBuffer.get()) {
+			if (!set->getPoints().isEmpty()) {
+				batch->uploadStaticBuffer(mPointBuffer.get(), 0, set->getPoints().size() * sizeof(QGpuSplinePoint), set->getPoints().constData());
+				mStats.uploadedBytes += set->getPoints().size() * sizeof(QGpuSplinePoint);
+			}
+			mUploadedPointsVersion = set->getPointsVersion();
+			mUploadedPointBuffer = mPointBuffer.get();
+		}
+
+		cmdBuffer->beginComputePass(batch);
+		if (set->getSplineCount() > 0) {
+			cmdBuffer->setComputePipeline(mExpandPipeline.get());
+			cmdBuffer->setShaderResources(mExpandBindings.get());
+			cmdBuffer->dispatch(set->getSplineCount(), 1, 1);
+		}
+		cmdBuffer->endComputePass();
+
+		const QSize size = mRenderTarget->pixelSize();
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f), { 1.0f, 0 });
+		cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+		cmdBuffer->setGraphicsPipeline(mCopyPipeline.get());
+		cmdBuffer->setShaderResources(mCopyBindings.get());
+		cmdBuffer->draw(4);
+		if (!set->getIndices().isEmpty()) {
+			cmdBuffer->setGraphicsPipeline(mDrawPipeline.get());
+			cmdBuffer->setShaderResources(mDrawBindings.get());
+			const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+			cmdBuffer->setVertexInput(0, 1, &vertexBindings, mIndexBuffer.get(), 0, QRhiCommandBuffer::IndexUInt32);
+			cmdBuffer->drawIndexed(set->getIndices().size());
+		}
+		cmdBuffer->endPass();
+	}
+};
+
+static void buildDemoSplines(QGpuSplineSet& set, int splineCount, int pointsPerSpline, int segmentsPerSpan, float lineWidth) {
+	set.clear();
+	const int columns = qMax(1, int(qSqrt(splineCount * 2.0)));
+	QVector<QGpuSplinePoint> points(pointsPerSpline);
+	for (int i = 0; i < splineCount; i++) {
+		const float originX = (i % columns - columns * 0.5f) * 12.0f;
+		const float originY = (i / columns) * -4.0f - 20.0f;
+		for (int j = 0; j < pointsPerSpline; j++) {
+			points[j] = { { originX + j * 10.0f / (pointsPerSpline - 1), originY, -200.0f }, lineWidth };
+		}
+		set.addSpline(points, QColor::fromHsvF((i % 16) / 16.0f, 0.6f, 1.0f), segmentsPerSpan);
+	}
+}
+
+static void animateDemoSplines(QGpuSplineSet& set, float time) {
+	QGpuSplinePoint* points = set.beginUpdatePoints();
+	for (const QGpuSplineDesc& desc : set.getDescs()) {
+		for (quint32 j = 0; j < desc.pointCount; j++) {
+			QGpuSplinePoint& point = points[desc.firstPoint + j];
+			point.position[2] = -200.0f + qSin(time * 2.0f + desc.firstPoint * 0.05f + j * 0.8f) * 1.5f;
+		}
+	}
+}
+
+// 不依赖窗口：用离屏QRhi跑一次展开，与CPU参考逐顶点比较，再统计两者的吞吐量
+static int runSplineCheck() {
+	QGpuSplineSet set;
+	QRandomGenerator random(1024);
+	for (int i = 0; i < 4096; i++) {
+		QVector<QGpuSplinePoint> points(2 + random.bounded(14));
+		for (QGpuSplinePoint& point : points)
+			point = { { float(random.bounded(200.0) - 100.0), float(random.bounded(200.0) - 100.0), float(random.bounded(200.0) - 100.0) }, float(random.bounded(4.0) + 0.5) };
+		set.addSpline(points, QColor::fromHsvF(random.bounded(1.0), 0.6, 1.0), 1 + random.bounded(16));
+	}
+	const QVector3D cameraPosition(0.0f, 0.0f, 500.0f);
+
+	const int iterations = 20;
+	QVector<QGpuSplineVertex> reference;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < iterations; i++)
+		QSplineEvaluator::expand(set, cameraPosition, reference);
+	const double cpuMs = timer.nsecsElapsed() / 1e6 / iterations;
+	qDebug().noquote() << QString("[SplineCheck] %1 splines, %2 control points, %3 vertices")
+		.arg(set.getSplineCount())
+		.arg(set.getPoints().size())
+		.arg(set.getVertexCount());
+	qDebug().noquote() << QString("[SplineCheck] CPU reference expansion: %1 ms, %2 M vertices/s")
+		.arg(cpuMs, 0, 'f', 2)
+		.arg(set.getVertexCount() / cpuMs / 1000.0, 0, 'f', 1);
+
+	QSharedPointer<QRhi> rhi = QRhiHelper::create();
+	if (!rhi || !rhi->isFeatureSupported(QRhi::Compute)) {
+		qWarning() << "[SplineCheck] compute is not supported, GPU comparison skipped";
+		return 0;
+	}
+	QScopedPointer<QRhiBuffer> pointBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, set.getPoints().size() * sizeof(QGpuSplinePoint)));
+	QScopedPointer<QRhiBuffer> descBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, set.getDescs().size() * sizeof(QGpuSplineDesc)));
+	QScopedPointer<QRhiBuffer> vertexBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, set.getVertexCount() * sizeof(QGpuSplineVertex)));
+	QScopedPointer<QRhiBuffer> uniformBuffer(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QSplineExpandUniformBlock)));
+	pointBuffer->create();
+	descBuffer->create();
+	vertexBuffer->create();
+	uniformBuffer->create();
+	QScopedPointer<QRhiShaderResourceBindings> bindings(rhi->newShaderResourceBindings());
+	bindings->setBindings({
+		QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, pointBuffer.get()),
+		QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, descBuffer.get()),
+		QRhiShaderResourceBinding::bufferStore(2, QRhiShaderResourceBinding::ComputeStage, vertexBuffer.get()),
+		QRhiShaderResourceBinding::uniformBuffer(3, QRhiShaderResourceBinding::ComputeStage, uniformBuffer.get()),
+	});
+	bindings->create();
+	QScopedPointer<QRhiComputePipeline> pipeline(rhi->newComputePipeline());
+	pipeline->setShaderStage(QRhiShaderStage(QRhiShaderStage::Compute, newSplineExpandShader()));
+	pipeline->setShaderResourceBindings(bindings.get());
+	pipeline->create();
+
+	QSplineExpandUniformBlock ubo = {};
+	memcpy(ubo.cameraPosition, &cameraPosition, sizeof(QVector3D));
+	ubo.cameraPosition[3] = 1.0f;
+	ubo.splineCount = set.getSplineCount();
+
+	QRhiReadbackResult readback;
+	double gpuMs = 0.0;
+	for (int i = 0; i <= iterations; i++) {
+		QRhiCommandBuffer* cmdBuffer = nullptr;
+		if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+			return 1;
+		QElapsedTimer frameTimer;
+		frameTimer.start();
+		QRhiResourceUpdateBatch* batch = rhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(uniformBuffer.get(), 0, sizeof(ubo), &ubo);
+		batch->uploadStaticBuffer(pointBuffer.get(), set.getPoints().constData());
+		if (i == 0)
+			batch->uploadStaticBuffer(descBuffer.get(), set.getDescs().constData());
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(pipeline.get());
+		cmdBuffer->setShaderResources(bindings.get());
+		cmdBuffer->dispatch(set.getSplineCount(), 1, 1);
+		QRhiResourceUpdateBatch* readbackBatch = nullptr;
+		if (i == iterations) {
+			readbackBatch = rhi->nextResourceUpdateBatch();
+			readbackBatch->readBackBuffer(vertexBuffer.get(), 0, set.getVertexCount() * sizeof(QGpuSplineVertex), &readback);
+		}
+		cmdBuffer->endComputePass(readbackBatch);
+		rhi->endOffscreenFrame();											//离屏帧结束时会等待GPU完成
+		if (i > 0 && i < iterations)										//第一帧包含管线创建和描述上传
+			gpuMs += frameTimer.nsecsElapsed() / 1e6;
+	}
+	gpuMs /= iterations - 1;
+
+	const QGpuSplineVertex* gpuVertices = reinterpret_cast<const QGpuSplineVertex*>(readback.data.constData());
+	if (readback.data.size() < int(set.getVertexCount() * sizeof(QGpuSplineVertex))) {
+		qWarning() << "[SplineCheck] readback failed";
+		return 1;
+	}
+	float maxError = 0.0f;
+	int mismatches = 0;
+	for (int i = 0; i < set.getVertexCount(); i++) {
+		for (int j = 0; j < 3; j++) {
+			const float error = qAbs(gpuVertices[i].position[j] - reference[i].position[j]);
+			maxError = qMax(maxError, error);
+		}
+		if (gpuVertices[i].color != reference[i].color)
+			mismatches++;
+	}
+	const bool passed = maxError < 1e-2f && mismatches == 0;
+	qDebug().noquote() << QString("[SplineCheck] GPU expansion: %1 ms per frame including point upload, %2 M vertices/s")
+		.arg(gpuMs, 0, 'f', 2)
+		.arg(set.getVertexCount() / gpuMs / 1000.0, 0, 'f', 1);
+	qDebug().noquote() << QString("[SplineCheck] max position error %1, %2 color mismatches: %3")
+		.arg(maxError, 0, 'g', 3)
+		.arg(mismatches)
+		.arg(passed ? "PASSED" : "FAILED");
+	return passed ? 0 : 1;
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, SplineCount) = 2000;
+	Q_PROPERTY_VAR(int, PointsPerSpline) = 8;
+	Q_PROPERTY_VAR(int, SegmentsPerSpan) = 8;
+	Q_PROPERTY_VAR(float, GpuLineWidth) = 0.6f;
+	Q_PROPERTY_VAR(bool, AnimateSplines) = true;
+
+	Q_CLASSINFO("SplineCount", "Min=0,Max=20000")
+	Q_CLASSINFO("PointsPerSpline", "Min=2,Max=64")
+	Q_CLASSINFO("SegmentsPerSpan", "Min=1,Max=64")
+	Q_CLASSINFO("GpuLineWidth", "Min=0.05,Max=5")
 private:
 	QSplineRenderComponent mSplineComp;
 	QSharedPointer<QMeshPassBuilder> mMeshPass{ new QMeshPassBuilder };
+	QSharedPointer<QGpuSplinePassBuilder> mGpuSplinePass{ new QGpuSplinePassBuilder };
+	QGpuSplineSet mGpuSplines;
+	QElapsedTimer mTimer;
+	int mBuiltSplineCount = -1;
+	int mBuiltPointsPerSpline = -1;
+	int mBuiltSegmentsPerSpan = -1;
+	float mBuiltLineWidth = -1.0f;
+	int mReportFrameCount = 0;
+	double mReportAnimateMs = 0.0;
+	qint64 mReportUploadedBytes = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -34,22 +601,76 @@ public:
 
 		getCamera()->setRotation(QVector3D(0, 90, 0));
 		getCamera()->setPosition(QVector3D(0, 0, 150));
+
+		mTimer.start();
+	}
+private:
+	void updateGpuSplines() {
+		const int splineCount = qBound(0, SplineCount, 20000);
+		const int pointsPerSpline = qBound(2, PointsPerSpline, 64);
+		const int segmentsPerSpan = qBound(1, SegmentsPerSpan, 64);
+		if (splineCount != mBuiltSplineCount || pointsPerSpline != mBuiltPointsPerSpline || segmentsPerSpan != mBuiltSegmentsPerSpan || GpuLineWidth != mBuiltLineWidth) {
+			buildDemoSplines(mGpuSplines, splineCount, pointsPerSpline, segmentsPerSpan, GpuLineWidth);
+			mBuiltSplineCount = splineCount;
+			mBuiltPointsPerSpline = pointsPerSpline;
+			mBuiltSegmentsPerSpan = segmentsPerSpan;
+			mBuiltLineWidth = GpuLineWidth;
+		}
+		if (AnimateSplines) {
+			QElapsedTimer timer;
+			timer.start();
+			animateDemoSplines(mGpuSplines, mTimer.elapsed() / 1000.0f);
+			mReportAnimateMs += timer.nsecsElapsed() / 1e6;
+		}
+	}
+	void reportSplineStats() {
+		static const int FramesPerReport = 240;
+		mReportUploadedBytes += mGpuSplinePass->getStats().uploadedBytes;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		qDebug().noquote() << QString("[Spline] %1 GPU splines, %2 control points expanded to %3 vertices, %4 ms CPU animation and %5 KB uploaded per frame")
+			.arg(mGpuSplines.getSplineCount())
+			.arg(mGpuSplines.getPoints().size())
+			.arg(mGpuSplines.getVertexCount())
+			.arg(mReportAnimateMs / FramesPerReport, 0, 'f', 3)
+			.arg(mReportUploadedBytes / FramesPerReport / 1024.0, 0, 'f', 1);
+		mReportFrameCount = 0;
+		mReportAnimateMs = 0.0;
+		mReportUploadedBytes = 0;
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		updateGpuSplines();
+
 		QMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder("MeshPass", mMeshPass);
 
+		QGpuSplinePassBuilder::Output splineOut
+			= graphBuilder.addPassBuilder("GpuSplinePass", mGpuSplinePass)
+			.setBaseColor(meshOut.BaseColor)
+			.setSplineSet(&mGpuSplines)
+			.setViewMatrix(getCamera()->getViewMatrix())
+			.setProjectionMatrix(getCamera()->getProjectionMatrix())
+			.setCameraPosition(getCamera()->getPosition());
+
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(meshOut.BaseColor);
+			.setInitialTexture(splineOut.Result);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportSplineStats();
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--spline-check"))
+		return runSplineCheck();
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
-}
\ No newline at end of file
+}
+
+#include "main.moc"
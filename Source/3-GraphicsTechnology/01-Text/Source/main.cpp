@@ -1,22 +1,768 @@
 #include "QEngineApplication.h"
 #include "QtConcurrent/qtconcurrentrun.h"
 #include "QRenderWidget.h"
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPainterPath>
+#include <QRawFont>
+#include <QTextLayout>
 #include "Render/Component/QStaticMeshRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
 
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 有向距离场（SDF）字形图集：字形按需光栅化后插入，只上传新增的区域
+class QSdfGlyphAtlas {
+public:
+	static const int AtlasSize = 1024;
+	static const int SdfPixelSize = 32;					//生成距离场时的字号，绘制时按需缩放
+	static const int Spread = 4;						//距离场覆盖的像素范围
+
+	struct Glyph {
+		QRectF uvRect;
+		QPointF offset;									//相对于笔触位置的左上角偏移（SdfPixelSize下的像素）
+		QSizeF size;
+		bool empty = true;
+	};
+	QSdfGlyphAtlas() {
+		mImage = QImage(AtlasSize, AtlasSize, QImage::Format_Grayscale8);
+		mImage.fill(0);
+	}
+	const QImage& getImage() const { return mImage; }
+	int getGeneration() const { return mGeneration; }	//图集被清空重建时递增，引用旧UV的文本需要重新生成
+	int getGlyphCount() const { return mGlyphs.size(); }
+	int getInsertedThisFrame() const { return mInsertedThisFrame; }
+	void beginFrame() { mResetThisFrame = false; }
+
+	quint64 glyphKey(const QRawFont& rawFont, quint32 glyphIndex) {
+		const QString fontName = rawFont.familyName() + "/" + rawFont.styleName();
+		auto it = mFontIds.find(fontName);
+		if (it == mFontIds.end()) {
+			it = mFontIds.insert(fontName, mFonts.size());
+			QRawFont font = rawFont;
+			font.setPixelSize(SdfPixelSize);
+			mFonts << font;
+		}
+		return quint64(it.value()) << 32 | glyphIndex;
+	}
+	const Glyph* glyph(quint64 key) {
+		auto it = mGlyphs.constFind(key);
+		if (it != mGlyphs.constEnd())
+			return &it.value();
+		return insert(key);
+	}
+	QVector<QRect> takeDirtyRects() {
+		mInsertedThisFrame = 0;
+		return std::exchange(mDirtyRects, {});
+	}
+private:
+	const Glyph* insert(quint64 key) {
+		const QRawFont& font = mFonts[int(key >> 32)];
+		const QPainterPath path = font.pathForGlyph(quint32(key));
+		Glyph glyph;
+		if (path.isEmpty())
+			return &mGlyphs.insert(key, glyph).value();
+		const QRect bounds = path.boundingRect().toAlignedRect();
+		const QSize cellSize = bounds.size() + QSize(Spread * 2, Spread * 2);
+		if (mShelfX + cellSize.width() > AtlasSize) {				//按行（Shelf）装箱
+			mShelfX = 0;
+			mShelfY += mShelfHeight;
+			mShelfHeight = 0;
+		}
+		if (mShelfY + cellSize.height() > AtlasSize) {
+			if (mResetThisFrame) {
+				qWarning() << "[Text] glyph atlas overflow, glyph skipped";
+				return &mEmptyGlyph;
+			}
+			reset();
+		}
+		const QRect cell(QPoint(mShelfX, mShelfY), cellSize);
+		mShelfX += cellSize.width() + 1;
+		mShelfHeight = qMax(mShelfHeight, cellSize.height() + 1);
+
+		rasterize(path, bounds, cell);
+		glyph.uvRect = QRectF(cell.x() / float(AtlasSize), cell.y() / float(AtlasSize), cell.width() / float(AtlasSize), cell.height() / float(AtlasSize));
+		glyph.offset = QPointF(bounds.left() - Spread, bounds.top() - Spread);
+		glyph.size = cellSize;
+		glyph.empty = false;
+		mDirtyRects << cell;
+		mInsertedThisFrame++;
+		return &mGlyphs.insert(key, glyph).value();
+	}
+	void reset() {
+		mGlyphs.clear();
+		mImage.fill(0);
+		mShelfX = mShelfY = mShelfHeight = 0;
+		mDirtyRects = { QRect(0, 0, AtlasSize, AtlasSize) };
+		mGeneration++;
+		mResetThisFrame = true;
+	}
+	// 先绘制覆盖率遮罩，再分别求内部与外部像素到边界的精确欧氏距离
+	void rasterize(const QPainterPath& path, const QRect& bounds, const QRect& cell) {
+		QImage mask(cell.size(), QImage::Format_Grayscale8);
+		mask.fill(0);
+		QPainter painter(&mask);
+		painter.setRenderHint(QPainter::Antialiasing);
+		painter.translate(Spread - bounds.left(), Spread - bounds.top());
+		painter.fillPath(path, Qt::white);
+		painter.end();
+
+		const int width = cell.width();
+		const int height = cell.height();
+		QVector<float> outside(width * height);
+		QVector<float> inside(width * height);
+		for (int y = 0; y < height; y++) {
+			const uchar* line = mask.constScanLine(y);
+			for (int x = 0; x < width; x++) {
+				const bool isInside = line[x] >= 128;
+				outside[y * width + x] = isInside ? 0.0f : Infinity;
+				inside[y * width + x] = isInside ? Infinity : 0.0f;
+			}
+		}
+		distanceTransform(outside, width, height);
+		distanceTransform(inside, width, height);
+		for (int y = 0; y < height; y++) {
+			uchar* line = mImage.scanLine(cell.y() + y) + cell.x();
+			for (int x = 0; x < width; x++) {
+				const float distance = qSqrt(outside[y * width + x]) - qSqrt(inside[y * width + x]);		//外部为正
+				line[x] = uchar(qBound(0.0f, 0.5f - distance / (2.0f * Spread), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+	// Felzenszwalb & Huttenlocher：可分离的平方距离变换，先按行再按列
+	static void distanceTransform(QVector<float>& grid, int width, int height) {
+		const int length = qMax(width, height);
+		QVector<float> f(length);
+		QVector<float> d(length);
+		QVector<int> v(length);
+		QVector<float> z(length + 1);
+		for (int x = 0; x < width; x++) {
+			for (int y = 0; y < height; y++)
+				f[y] = grid[y * width + x];
+			distanceTransform1D(f.constData(), height, d.data(), v.data(), z.data());
+			for (int y = 0; y < height; y++)
+				grid[y * width + x] = d[y];
+		}
+		for (int y = 0; y < height; y++) {
+			memcpy(f.data(), grid.constData() + y * width, width * sizeof(float));
+			distanceTransform1D(f.constData(), width, d.data(), v.data(), z.data());
+			memcpy(grid.data() + y * width, d.constData(), width * sizeof(float));
+		}
+	}
+	static void distanceTransform1D(const float* f, int n, float* d, int* v, float* z) {
+		int k = 0;
+		v[0] = 0;
+		z[0] = -Infinity;
+		z[1] = Infinity;
+		for (int q = 1; q < n; q++) {
+			float s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			while (s <= z[k]) {
+				k--;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = Infinity;
+		}
+		k = 0;
+		for (int q = 0; q < n; q++) {
+			while (z[k + 1] < q)
+				k++;
+			d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+		}
+	}
+	static constexpr float Infinity = 1e20f;
+	QImage mImage;
+	QHash<quint64, Glyph> mGlyphs;
+	QHash<QString, int> mFontIds;
+	QVector<QRawFont> mFonts;
+	QVector<QRect> mDirtyRects;
+	Glyph mEmptyGlyph;
+	int mShelfX = 0;
+	int mShelfY = 0;
+	int mShelfHeight = 0;
+	int mGeneration = 0;
+	int mInsertedThisFrame = 0;
+	bool mResetThisFrame = false;
+};
+
+// 按单词缓存排版结果：标签文本每帧都在变，但组成它们的单词（前缀、数字）高度重复
+class QTextRunCache {
+public:
+	static const int Capacity = 16384;
+	struct Run {
+		QVector<quint64> glyphKeys;
+		QVector<QPointF> positions;						//基线上的笔触位置
+		float width = 0.0f;
+	};
+	QTextRunCache(QSdfGlyphAtlas* atlas, const QFont& font)
+		: mAtlas(atlas)
+		, mFont(font)
+	{
+		mFont.setPixelSize(QSdfGlyphAtlas::SdfPixelSize);
+		mSpaceAdvance = QFontMetricsF(mFont).horizontalAdvance(' ');
+	}
+	float getSpaceAdvance() const { return mSpaceAdvance; }
+	int getHits() const { return mHits; }
+	int getMisses() const { return mMisses; }
+	void resetStats() { mHits = mMisses = 0; }
+
+	const Run& shape(const QString& word) {
+		auto it = mRuns.constFind(word);
+		if (it != mRuns.constEnd()) {
+			mHits++;
+			return it.value();
+		}
+		mMisses++;
+		if (mRuns.size() >= Capacity)					//简单的整体淘汰，避免维护LRU链表的开销
+			mRuns.clear();
+		Run run;
+		QTextLayout layout(word, mFont);
+		layout.setCacheEnabled(true);
+		layout.beginLayout();
+		QTextLine line = layout.createLine();
+		layout.endLayout();
+		for (const QGlyphRun& glyphRun : layout.glyphRuns()) {
+			const QRawFont rawFont = glyphRun.rawFont();			//字体回退时每段的字体可能不同
+			const QVector<quint32> indexes = glyphRun.glyphIndexes();
+			const QVector<QPointF> positions = glyphRun.positions();
+			for (int i = 0; i < indexes.size(); i++) {
+				run.glyphKeys << mAtlas->glyphKey(rawFont, indexes[i]);
+				run.positions << positions[i];
+			}
+		}
+		run.width = line.isValid() ? line.naturalTextWidth() : 0.0f;
+		return mRuns.insert(word, run).value();
+	}
+private:
+	QSdfGlyphAtlas* mAtlas;
+	QFont mFont;
+	float mSpaceAdvance = 0.0f;
+	QHash<QString, Run> mRuns;
+	int mHits = 0;
+	int mMisses = 0;
+};
+
+// 所有标签的字形实例合并到同一个实例缓冲，一次实例化绘制画完
+// 每个标签在缓冲中占据固定的槽位区间（预留少量余量），文本变化时原地改写并只上传该区间；
+// 只有标签数量变化或某个标签超出余量时才重新分配槽位并整体上传
+class QTextLabelBatch {
+public:
+	static const int SlotSlack = 4;						//每个标签额外预留的实例数，数字位数变化时不必重新分配
+	static const int MergeGap = 32;						//间隔不超过该实例数的脏区间合并上传，减少上传条目
+	struct GlyphInstance {
+		float anchor[3];								//标签锚点（世界空间）
+		float offset[2];								//屏幕像素偏移，y向下
+		float size[2];
+		float uvRect[4];
+		quint32 color;
+	};
+	struct InstanceRange {
+		int first = 0;
+		int count = 0;
+	};
+	struct Stats {
+		int rebuiltLabels = 0;
+		int glyphInstances = 0;
+		bool relayout = false;
+		double updateMs = 0.0;
+	};
+	QTextLabelBatch(const QFont& font)
+		: mRunCache(&mAtlas, font)
+	{
+	}
+	QSdfGlyphAtlas& getAtlas() { return mAtlas; }
+	QTextRunCache& getRunCache() { return mRunCache; }
+	const QVector<GlyphInstance>& getInstances() const { return mInstances; }
+	int getLabelCount() const { return mLabels.size(); }
+	const Stats& getStats() const { return mStats; }
+	QVector<InstanceRange> takeDirtyRanges() {			//自上次调用以来需要上传的实例区间
+		return std::exchange(mDirtyRanges, {});
+	}
+
+	void resize(int count) {
+		mLabels.resize(count);
+		mStructureChanged = true;
+	}
+	void setLabel(int index, const QString& text, const QVector3D& anchor, float pixelSize, const QColor& color) {
+		Label& label = mLabels[index];
+		const quint32 packedColor = quint32(color.red()) | quint32(color.green()) << 8 | quint32(color.blue()) << 16 | quint32(color.alpha()) << 24;
+		if (label.text == text && label.anchor == anchor && label.pixelSize == pixelSize && label.color == packedColor)
+			return;
+		label.text = text;
+		label.anchor = anchor;
+		label.pixelSize = pixelSize;
+		label.color = packedColor;
+		label.dirty = true;
+	}
+	// 只重新生成变化过的标签，能放进原槽位的原地改写，否则重新分配全部槽位
+	void update() {
+		QElapsedTimer timer;
+		timer.start();
+		mStats.rebuiltLabels = 0;
+		mAtlas.beginFrame();
+		const int generation = mAtlas.getGeneration();
+		bool relayout = mStructureChanged;
+		QVector<int> rebuilt;
+		for (int i = 0; i < mLabels.size(); i++) {
+			Label& label = mLabels[i];
+			if (!label.dirty && label.atlasGeneration == generation)
+				continue;
+			buildLabel(label);
+			rebuilt << i;
+		}
+		if (mAtlas.getGeneration() != generation) {			//图集在本帧被重建，之前生成的标签UV全部失效
+			rebuilt.clear();
+			for (int i = 0; i < mLabels.size(); i++) {
+				buildLabel(mLabels[i]);
+				rebuilt << i;
+			}
+		}
+		for (int index : rebuilt) {
+			if (mLabels[index].instances.size() > mLabels[index].slotCapacity)
+				relayout = true;
+		}
+		if (relayout) {
+			layoutSlots();
+		}
+		else {
+			for (int index : rebuilt) {
+				writeSlot(mLabels[index]);
+				markDirty(mLabels[index].firstSlot, mLabels[index].slotCapacity);
+			}
+		}
+		mStructureChanged = false;
+		mStats.relayout = relayout;
+		mStats.glyphInstances = 0;
+		for (const Label& label : mLabels)
+			mStats.glyphInstances += label.instances.size();
+		mStats.updateMs = timer.nsecsElapsed() / 1e6;
+	}
+private:
+	struct Label {
+		QString text;
+		QVector3D anchor;
+		float pixelSize = 16.0f;
+		quint32 color = 0xFFFFFFFF;
+		QVector<GlyphInstance> instances;
+		int firstSlot = 0;
+		int slotCapacity = 0;
+		int atlasGeneration = -1;
+		bool dirty = true;
+	};
+	void layoutSlots() {
+		int slotCount = 0;
+		for (Label& label : mLabels) {
+			label.firstSlot = slotCount;
+			label.slotCapacity = (label.instances.size() + SlotSlack + 3) & ~3;
+			slotCount += label.slotCapacity;
+		}
+		mInstances.resize(slotCount);
+		for (const Label& label : mLabels)
+			writeSlot(label);
+		mDirtyRanges = { InstanceRange{ 0, slotCount } };
+	}
+	// 槽位中未使用的部分填充尺寸为0的实例，光栅化时不产生任何像素
+	void writeSlot(const Label& label) {
+		GlyphInstance* dst = mInstances.data() + label.firstSlot;
+		memcpy(dst, label.instances.constData(), label.instances.size() * sizeof(GlyphInstance));
+		memset(dst + label.instances.size(), 0, (label.slotCapacity - label.instances.size()) * sizeof(GlyphInstance));
+	}
+	void markDirty(int first, int count) {
+		if (!mDirtyRanges.isEmpty()) {
+			InstanceRange& last = mDirtyRanges.back();
+			const int lastEnd = last.first + last.count;
+			if (first >= last.first && first - lastEnd <= MergeGap) {
+				last.count = qMax(lastEnd, first + count) - last.first;
+				return;
+			}
+		}
+		mDirtyRanges << InstanceRange{ first, count };
+	}
+	void buildLabel(Label& label) {
+		mStats.rebuiltLabels++;
+		label.instances.clear();
+		label.dirty = false;
+		label.atlasGeneration = mAtlas.getGeneration();
+		const float scale = label.pixelSize / QSdfGlyphAtlas::SdfPixelSize;
+		const QStringList words = label.text.split(' ');
+		float width = 0.0f;
+		QVarLengthArray<const QTextRunCache::Run*, 8> runs;
+		for (const QString& word : words) {
+			runs.append(&mRunCache.shape(word));
+			width += runs.back()->width;
+		}
+		width += mRunCache.getSpaceAdvance() * (words.size() - 1);
+		float penX = -width * 0.5f;												//水平居中于锚点
+		for (const QTextRunCache::Run* run : runs) {
+			for (int i = 0; i < run->glyphKeys.size(); i++) {
+				const QSdfGlyphAtlas::Glyph* glyph = mAtlas.glyph(run->glyphKeys[i]);
+				if (glyph->empty)
+					continue;
+				GlyphInstance instance;
+				instance.anchor[0] = label.anchor.x();
+				instance.anchor[1] = label.anchor.y();
+				instance.anchor[2] = label.anchor.z();
+				instance.offset[0] = (penX + run->positions[i].x() + glyph->offset.x()) * scale;
+				instance.offset[1] = (run->positions[i].y() + glyph->offset.y()) * scale;
+				instance.size[0] = glyph->size.width() * scale;
+				instance.size[1] = glyph->size.height() * scale;
+				instance.uvRect[0] = glyph->uvRect.left();
+				instance.uvRect[1] = glyph->uvRect.top();
+				instance.uvRect[2] = glyph->uvRect.right();
+				instance.uvRect[3] = glyph->uvRect.bottom();
+				instance.color = label.color;
+				label.instances << instance;
+			}
+			penX += run->width + mRunCache.getSpaceAdvance();
+		}
+	}
+	QSdfGlyphAtlas mAtlas;
+	QTextRunCache mRunCache;
+	QVector<Label> mLabels;
+	QVector<GlyphInstance> mInstances;					//按槽位排列，包含各标签的预留余量
+	QVector<InstanceRange> mDirtyRanges;
+	Stats mStats;
+	bool mStructureChanged = true;
+};
+
+class QSdfTextPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QSdfTextPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QTextLabelBatch*, Batch);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QSdfTextPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+public:
+	struct Stats {
+		qint64 uploadedInstanceBytes = 0;
+		qint64 uploadedAtlasBytes = 0;
+	};
+private:
+	struct UniformBlock {
+		float viewProjection[16];
+		float viewportSize[2];
+		float ndcYSign;
+		float padding;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiTextureRef mAtlas;
+	QRhiSamplerRef mSampler;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mInstanceBuffer;
+	QRhiShaderResourceBindingsRef mCopyBindings;
+	QRhiGraphicsPipelineRef mCopyPipeline;
+	QRhiShaderResourceBindingsRef mTextBindings;
+	QRhiGraphicsPipelineRef mTextPipeline;
+	QShader mCopyFS;
+	QShader mTextVS;
+	QShader mTextFS;
+	QRhiTexture* mUploadedAtlas = nullptr;
+	QRhiBuffer* mUploadedInstanceBuffer = nullptr;
+	int mInstanceCapacity = 0;
+	Stats mStats;
+public:
+	QSdfTextPassBuilder() {
+		mCopyFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uBaseColor;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				outColor = texture(uBaseColor, vUV);
+			}
+		)");
+		mTextVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inAnchor;
+			layout (location = 1) in vec2 inOffset;
+			layout (location = 2) in vec2 inSize;
+			layout (location = 3) in vec4 inUVRect;
+			layout (location = 4) in vec4 inColor;
+			layout (std140, binding = 0) uniform UniformBlock {
+				mat4 viewProjection;
+				vec2 viewportSize;
+				float ndcYSign;
+				float padding;
+			} ubo;
+			layout (location = 0) out vec2 vUV;
+			layout (location = 1) out vec4 vColor;
+			out gl_PerVertex { vec4 gl_Position; };
+			const vec2 corners[6] = vec2[](vec2(0, 0), vec2(1, 0), vec2(0, 1), vec2(0, 1), vec2(1, 0), vec2(1, 1));
+			void main() {
+				vec2 corner = corners[gl_VertexIndex];
+				vec4 clip = ubo.viewProjection * vec4(inAnchor, 1.0);
+				vec2 pixel = inOffset + corner * inSize;
+				clip.xy += vec2(pixel.x, pixel.y * ubo.ndcYSign) * 2.0 / ubo.viewportSize * clip.w;		//像素偏移在裁剪空间中乘以w，保持屏幕上的大小不变
+				gl_Position = clip.w > 0.0 ? clip : vec4(2.0, 2.0, 2.0, 1.0);
+				vUV = mix(inUVRect.xy, inUVRect.zw, corner);
+				vColor = inColor;
+			}
+		)");
+		mTextFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 1) uniform sampler2D uAtlas;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 1) in vec4 vColor;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				float distance = texture(uAtlas, vUV).r;
+				float width = max(fwidth(distance), 1e-4);				//按屏幕空间导数取边缘宽度，任意缩放下都保持一个像素左右的抗锯齿
+				float alpha = smoothstep(0.5 - width, 0.5 + width, distance);
+				if (alpha <= 0.0)
+					discard;
+				outColor = vec4(vColor.rgb, vColor.a * alpha);
+			}
+		)");
+	}
+	const Stats& getStats() const { return mStats; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		QTextLabelBatch* batch = mInput._Batch;
+		while (mInstanceCapacity < batch->getInstances().size())
+			mInstanceCapacity = qMax(1024, mInstanceCapacity * 2);
+		mInstanceCapacity = qMax(mInstanceCapacity, 1024);
+
+		builder.setupTexture(mColorAttachment, "SdfTextColor", mInput._BaseColor->format(), mInput._BaseColor->pixelSize(), 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "SdfTextRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupTexture(mAtlas, "SdfGlyphAtlas", QRhiTexture::R8, QSize(QSdfGlyphAtlas::AtlasSize, QSdfGlyphAtlas::AtlasSize), 1, {});
+		builder.setupSampler(mSampler, "SdfTextSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupBuffer(mUniformBuffer, "SdfTextUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mInstanceBuffer, "SdfTextInstanceBuffer", QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, sizeof(QTextLabelBatch::GlyphInstance) * mInstanceCapacity);
+
+		builder.setupShaderResourceBindings(mCopyBindings, "SdfTextCopyBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState copyPSO;
+		copyPSO.shaderResourceBindings = mCopyBindings.get();
+		copyPSO.sampleCount = mRenderTarget->sampleCount();
+		copyPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		copyPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCopyFS),
+		};
+		builder.setupGraphicsPipeline(mCopyPipeline, "SdfTextCopyPipeline", copyPSO);
+
+		builder.setupShaderResourceBindings(mTextBindings, "SdfTextBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mAtlas.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipeline::TargetBlend alphaBlend;
+		alphaBlend.enable = true;
+		alphaBlend.srcColor = QRhiGraphicsPipeline::SrcAlpha;
+		alphaBlend.dstColor = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		alphaBlend.srcAlpha = QRhiGraphicsPipeline::One;
+		alphaBlend.dstAlpha = QRhiGraphicsPipeline::OneMinusSrcAlpha;
+		QRhiGraphicsPipelineState textPSO;
+		textPSO.shaderResourceBindings = mTextBindings.get();
+		textPSO.sampleCount = mRenderTarget->sampleCount();
+		textPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		textPSO.targetBlends = { alphaBlend };
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(sizeof(QTextLabelBatch::GlyphInstance), QRhiVertexInputBinding::PerInstance),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, offsetof(QTextLabelBatch::GlyphInstance, anchor)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::Float2, offsetof(QTextLabelBatch::GlyphInstance, offset)),
+			QRhiVertexInputAttribute(0, 2, QRhiVertexInputAttribute::Float2, offsetof(QTextLabelBatch::GlyphInstance, size)),
+			QRhiVertexInputAttribute(0, 3, QRhiVertexInputAttribute::Float4, offsetof(QTextLabelBatch::GlyphInstance, uvRect)),
+			QRhiVertexInputAttribute(0, 4, QRhiVertexInputAttribute::UNormByte4, offsetof(QTextLabelBatch::GlyphInstance, color)),
+		});
+		textPSO.vertexInputLayout = inputLayout;
+		textPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mTextVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mTextFS),
+		};
+		builder.setupGraphicsPipeline(mTextPipeline, "SdfTextPipeline", textPSO);
+
+		mOutput.Result = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		QTextLabelBatch* labelBatch = mInput._Batch;
+		const QVector<QTextLabelBatch::GlyphInstance>& instances = labelBatch->getInstances();
+		const QSize size = mRenderTarget->pixelSize();
+		mStats = Stats();
+
+		UniformBlock ubo;
+		const QMatrix4x4 viewProjection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+		memcpy(ubo.viewProjection, viewProjection.constData(), sizeof(ubo.viewProjection));
+		ubo.viewportSize[0] = size.width();
+		ubo.viewportSize[1] = size.height();
+		ubo.ndcYSign = mRhi->isYUpInNDC() ? -1.0f : 1.0f;
+		ubo.padding = 0.0f;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		// 图集只上传新插入字形所在的区域；纹理重建时整张上传
+		QVector<QRect> dirtyRects = labelBatch->getAtlas().takeDirtyRects();
+		if (mUploadedAtlas != mAtlas.get()) {
+			dirtyRects = { QRect(0, 0, QSdfGlyphAtlas::AtlasSize, QSdfGlyphAtlas::AtlasSize) };
+			mUploadedAtlas = mAtlas.get();
+		}
+		if (!dirtyRects.isEmpty()) {
+			QVector<QRhiTextureUploadEntry> entries;
+			for (const QRect& rect : dirtyRects) {
+				QRhiTextureSubresourceUploadDescription subresource(labelBatch->getAtlas().getImage());
+				subresource.setSourceTopLeft(rect.topLeft());
+				subresource.setSourceSize(rect.size());
+				subresource.setDestinationTopLeft(rect.topLeft());
+				entries << QRhiTextureUploadEntry(0, 0, subresource);
+				mStats.uploadedAtlasBytes += rect.width() * rect.height();
+			}
+			QRhiTextureUploadDescription uploadDesc;
+			uploadDesc.setEntries(entries.cbegin(), entries.cend());
+			batch->uploadTexture(mAtlas.get(), uploadDesc);
+		}
+		// 实例缓冲只写入变化过的标签区间，缓冲重建时整体写入（QRhi会把动态缓冲的更新同步到每个飞行帧的槽位）
+		QVector<QTextLabelBatch::InstanceRange> dirtyRanges = labelBatch->takeDirtyRanges();
+		if (mUploadedInstanceBuffer != mInstanceBuffer.get()) {
+			dirtyRanges = { QTextLabelBatch::InstanceRange{ 0, int(instances.size()) } };
+			mUploadedInstanceBuffer = mInstanceBuffer.get();
+		}
+		for (const QTextLabelBatch::InstanceRange& range : dirtyRanges) {
+			if (range.count <= 0)
+				continue;
+			const int offset = range.first * sizeof(QTextLabelBatch::GlyphInstance);
+			const int bytes = range.count * sizeof(QTextLabelBatch::GlyphInstance);
+			batch->updateDynamicBuffer(mInstanceBuffer.get(), offset, bytes, instances.constData() + range.first);
+			mStats.uploadedInstanceBytes += bytes;
+		}
+
+		cmdBuffer->beginPass(mRenderTarget.get(), QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f), { 1.0f, 0 }, batch);
+		cmdBuffer->setViewport(QRhiViewport(0, 0, size.width(), size.height()));
+		cmdBuffer->setGraphicsPipeline(mCopyPipeline.get());
+		cmdBuffer->setShaderResources(mCopyBindings.get());
+		cmdBuffer->draw(4);
+		if (!instances.isEmpty()) {
+			cmdBuffer->setGraphicsPipeline(mTextPipeline.get());
+			cmdBuffer->setShaderResources(mTextBindings.get());
+			const QRhiCommandBuffer::VertexInput instanceInput(mInstanceBuffer.get(), 0);
+			cmdBuffer->setVertexInput(0, 1, &instanceInput);
+			cmdBuffer->draw(6, instances.size());
+		}
+		cmdBuffer->endPass();
+	}
+};
+
+// 每行标签的血量每 refreshPeriod 帧刷新一次，各行错开；默认8帧，每帧约有1/8的标签变化，为1时每帧全部变化
+static QString labelText(int index, int frame, int refreshPeriod = 8) {
+	static const char* Names[] = { "Scout", "Tank", "Healer", "Archer", "Mage", "Rogue", "Knight", "Drone" };
+	const int tick = (frame + index / 100) / refreshPeriod;
+	return QString("%1-%2 HP %3 / 1000").arg(QLatin1String(Names[index % 8])).arg(index % 100).arg((index * 37 + tick * 3) % 1000);
+}
+
+static QVector3D labelAnchor(int index) {
+	const int columns = 100;
+	return QVector3D((index % columns - columns / 2) * 12.0f, (index / columns - 50) * 6.0f, 0.0f);
+}
+
+// 不依赖窗口的CPU基准：每帧对全部标签调用 setLabel，按 refreshPeriod 决定其中有多少标签的文本真正变化
+static void runBatchBenchmark(int labelCount, int refreshPeriod, const QString& mode) {
+	const int frameCount = 120;
+	QTextLabelBatch batch(QFont("Microsoft YaHei"));
+	batch.resize(labelCount);
+	double totalMs = 0.0;
+	qint64 glyphInstances = 0;
+	qint64 uploadedInstances = 0;
+	int relayoutFrames = 0;
+	for (int frame = 0; frame < frameCount; frame++) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < labelCount; i++)
+			batch.setLabel(i, labelText(i, frame, refreshPeriod), labelAnchor(i), 14.0f, Qt::white);
+		batch.update();
+		batch.getAtlas().takeDirtyRects();
+		const QVector<QTextLabelBatch::InstanceRange> dirtyRanges = batch.takeDirtyRanges();
+		if (frame > 0) {													//第一帧包含字形光栅化与槽位分配，单独统计
+			totalMs += timer.nsecsElapsed() / 1e6;
+			for (const QTextLabelBatch::InstanceRange& range : dirtyRanges)
+				uploadedInstances += range.count;
+			relayoutFrames += batch.getStats().relayout ? 1 : 0;
+		}
+		glyphInstances = batch.getStats().glyphInstances;
+	}
+	const int runHits = batch.getRunCache().getHits();
+	const int runMisses = batch.getRunCache().getMisses();
+
+	qDebug().noquote() << QString("[TextBenchmark] %1: %2 labels, %3 glyph instances, %4 glyphs in atlas")
+		.arg(mode)
+		.arg(labelCount)
+		.arg(glyphInstances)
+		.arg(batch.getAtlas().getGlyphCount());
+	qDebug().noquote() << QString("[TextBenchmark] %1: SDF batch update %2 ms/frame, run cache hit rate %3%, instance upload %4 KB/frame of %5 KB, %6 relayouts in %7 frames")
+		.arg(mode)
+		.arg(totalMs / (frameCount - 1), 0, 'f', 2)
+		.arg(100.0 * runHits / qMax(1, runHits + runMisses), 0, 'f', 1)
+		.arg(uploadedInstances * sizeof(QTextLabelBatch::GlyphInstance) / 1024.0 / (frameCount - 1), 0, 'f', 1)
+		.arg(batch.getInstances().size() * sizeof(QTextLabelBatch::GlyphInstance) / 1024.0, 0, 'f', 1)
+		.arg(relayoutFrames)
+		.arg(frameCount - 1);
+}
+
+static void runTextBenchmark(int labelCount) {
+	runBatchBenchmark(labelCount, 8, "staggered (each label changes every 8 frames)");
+	runBatchBenchmark(labelCount, 1, "every label changes every frame");
+
+	// 基线逐个生成全部标签的纹理，实测一帧而不是按少量标签外推
+	QElapsedTimer timer;
+	timer.start();
+	const QFont font("Microsoft YaHei", 14);
+	const QFontMetrics metrics(font);
+	for (int i = 0; i < labelCount; i++) {
+		const QString text = labelText(i, 0);
+		QImage image(metrics.size(0, text), QImage::Format_ARGB32_Premultiplied);
+		image.fill(Qt::transparent);
+		QPainter painter(&image);
+		painter.setFont(font);
+		painter.setPen(Qt::white);
+		painter.drawText(image.rect(), Qt::AlignLeft | Qt::AlignTop, text);
+	}
+	const double baselineMs = timer.nsecsElapsed() / 1e6;
+	qDebug().noquote() << QString("[TextBenchmark] per-string QPainter textures, all labels re-rendered: %1 ms/frame (measured over all %2 labels)")
+		.arg(baselineMs, 0, 'f', 2)
+		.arg(labelCount);
+}
+
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, LabelCount) = 2000;
+	Q_PROPERTY_VAR(bool, AnimateLabels) = true;
+	Q_PROPERTY_VAR(float, LabelPixelSize) = 14.0f;
+
+	Q_CLASSINFO("LabelCount", "Min=0,Max=20000")
+	Q_CLASSINFO("LabelPixelSize", "Min=6,Max=96")
 private:
 	QStaticMeshRenderComponent mTextTextureComp;
 	QStaticMeshRenderComponent mTextMeshComp;
 	QSharedPointer<QMeshPassBuilder> mMeshPass{ new QMeshPassBuilder };
+	QSharedPointer<QSdfTextPassBuilder> mTextPass{ new QSdfTextPassBuilder };
+	QTextLabelBatch mLabelBatch{ QFont("微软雅黑") };
+	int mFrameIndex = 0;
+	int mReportFrameCount = 0;
+	double mReportUpdateMs = 0.0;
+	qint64 mReportRebuiltLabels = 0;
+	qint64 mReportUploadedBytes = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
 		mTextMeshComp.setStaticMesh(QStaticMesh::CreateFromText("TextMesh", QFont("微软雅黑", 64), Qt::white, Qt::Horizontal, 2, false));
 		addComponent(&mTextMeshComp);
-		
+
 		mTextTextureComp.setStaticMesh(QStaticMesh::CreateFromText("TextTexture", QFont("微软雅黑", 64), Qt::white, Qt::Horizontal, 2, true));
 		mTextTextureComp.setTranslate(QVector3D(0.0f, -100.0f, 0.0f));
 		addComponent(&mTextTextureComp);
@@ -26,23 +772,75 @@ public:
 		getCamera()->setRotation(QVector3D(0, 90, 0));
 		getCamera()->setPosition(QVector3D(0, 0, 500));
 	}
+private:
+	void updateLabels() {
+		const int labelCount = qBound(0, LabelCount, 20000);
+		if (mLabelBatch.getLabelCount() != labelCount)
+			mLabelBatch.resize(labelCount);
+		if (AnimateLabels)
+			mFrameIndex++;
+		for (int i = 0; i < labelCount; i++) {
+			const QColor color = QColor::fromHsvF((i % 8) / 8.0f, 0.5f, 1.0f);
+			mLabelBatch.setLabel(i, labelText(i, mFrameIndex), labelAnchor(i), LabelPixelSize, color);
+		}
+		mLabelBatch.update();
+	}
+	void reportTextStats() {
+		static const int FramesPerReport = 240;
+		const QTextLabelBatch::Stats& stats = mLabelBatch.getStats();
+		mReportUpdateMs += stats.updateMs;
+		mReportRebuiltLabels += stats.rebuiltLabels;
+		mReportUploadedBytes += mTextPass->getStats().uploadedInstanceBytes + mTextPass->getStats().uploadedAtlasBytes;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		QTextRunCache& runCache = mLabelBatch.getRunCache();
+		qDebug().noquote() << QString("[Text] %1 labels, %2 glyph instances in one draw, %3 labels rebuilt and %4 ms CPU per frame, run cache hit rate %5%, %6 glyphs in atlas, %7 KB uploaded per frame")
+			.arg(mLabelBatch.getLabelCount())
+			.arg(stats.glyphInstances)
+			.arg(mReportRebuiltLabels / FramesPerReport)
+			.arg(mReportUpdateMs / FramesPerReport, 0, 'f', 2)
+			.arg(100.0 * runCache.getHits() / qMax(1, runCache.getHits() + runCache.getMisses()), 0, 'f', 1)
+			.arg(mLabelBatch.getAtlas().getGlyphCount())
+			.arg(mReportUploadedBytes / FramesPerReport / 1024.0, 0, 'f', 1);
+		runCache.resetStats();
+		mReportFrameCount = 0;
+		mReportUpdateMs = 0.0;
+		mReportRebuiltLabels = mReportUploadedBytes = 0;
+	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		updateLabels();
 
 		QMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder("MeshPass", mMeshPass);
 
+		QSdfTextPassBuilder::Output textOut
+			= graphBuilder.addPassBuilder("SdfTextPass", mTextPass)
+			.setBaseColor(meshOut.BaseColor)
+			.setBatch(&mLabelBatch)
+			.setViewMatrix(getCamera()->getViewMatrix())
+			.setProjectionMatrix(getCamera()->getProjectionMatrix());
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(meshOut.BaseColor);
+			.setInitialTexture(textOut.Result);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportTextStats();
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--text-benchmark")) {
+		runTextBenchmark(10000);
+		return 0;
+	}
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
+
+#include "main.moc"
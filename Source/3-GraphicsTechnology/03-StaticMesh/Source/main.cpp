@@ -1,50 +1,1705 @@
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
 #include "QtConcurrent/qtconcurrentrun.h"
+#include "QtConcurrent/qtconcurrentmap.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <qfloat16.h>
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include <numeric>
+#include <queue>
+#include "private/qrhivulkan_p.h"
+#include "qvulkanfunctions.h"
+#include "Render/IRenderComponent.h"
 #include "Render/Component/QStaticMeshRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
+#include "QMeshGeometry.h"
+
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// ڶQEMİ۵򻯣۵ڰλúӺϽУȻԭʼԶ㣬
+// 򻯽Լʹԭʼ㻺壬UV/߽ӷӲĶ㲻ᱻϲ
+class QMeshSimplifier {
+public:
+	static QVector<quint32> simplify(const QVector<QMeshGeometry::Vertex>& vertices, const quint32* indices, int indexCount, int targetIndexCount, float* outError = nullptr) {
+		// λúӶ㣬ӷĶΪͬһ㣻corners ¼ÿνʵõԶ
+		QVector<quint32> weld(vertices.size(), UINT_MAX);
+		QHash<QByteArray, quint32> positionMap;
+		for (int i = 0; i < indexCount; i++) {
+			const quint32 index = indices[i];
+			if (weld[index] != UINT_MAX)
+				continue;
+			const QByteArray key(reinterpret_cast<const char*>(&vertices[index].position), sizeof(QVector3D));
+			auto it = positionMap.find(key);
+			if (it == positionMap.end())
+				it = positionMap.insert(key, index);
+			weld[index] = it.value();
+		}
+
+		const int triangleCount = indexCount / 3;
+		QVector<quint32> corners(indices, indices + triangleCount * 3);
+		QVector<quint32> triangles(triangleCount * 3);
+		for (int i = 0; i < triangleCount * 3; i++)
+			triangles[i] = weld[corners[i]];
+		QVector<bool> triangleRemoved(triangleCount, false);
+		int liveTriangles = 0;
+		for (int t = 0; t < triangleCount; t++) {
+			if (triangles[t * 3] == triangles[t * 3 + 1] || triangles[t * 3 + 1] == triangles[t * 3 + 2] || triangles[t * 3] == triangles[t * 3 + 2])
+				triangleRemoved[t] = true;
+			else
+				liveTriangles++;
+		}
+
+		QVector<QVector<int>> adjacency(vertices.size());
+		QVector<Quadric> quadrics(vertices.size());
+		QHash<quint64, int> edgeUsage;
+		QHash<quint64, quint64> edgeCorners;
+		QSet<quint64> seamEdges;												//˲ͬԶı
+		for (int t = 0; t < triangleCount; t++) {
+			if (triangleRemoved[t])
+				continue;
+			const quint32* tri = triangles.constData() + t * 3;
+			const Quadric quadric = Quadric::fromTriangle(vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position);
+			for (int k = 0; k < 3; k++) {
+				adjacency[tri[k]] << t;
+				quadrics[tri[k]] += quadric;
+				const quint64 key = edgeKey(tri[k], tri[(k + 1) % 3]);
+				edgeUsage[key]++;
+				const quint64 cornerPair = tri[k] < tri[(k + 1) % 3]
+					? edgeKey(corners[t * 3 + k], corners[t * 3 + (k + 1) % 3], false)
+					: edgeKey(corners[t * 3 + (k + 1) % 3], corners[t * 3 + k], false);
+				auto it = edgeCorners.find(key);
+				if (it == edgeCorners.end())
+					edgeCorners.insert(key, cornerPair);
+				else if (it.value() != cornerPair)
+					seamEdges.insert(key);
+			}
+		}
+		// ű߽ԽӷϴֱεԼƽ棬ӷڱƯ
+		for (int t = 0; t < triangleCount; t++) {
+			if (triangleRemoved[t])
+				continue;
+			const quint32* tri = triangles.constData() + t * 3;
+			const QVector3D normal = QVector3D::crossProduct(vertices[tri[1]].position - vertices[tri[0]].position, vertices[tri[2]].position - vertices[tri[0]].position);
+			for (int k = 0; k < 3; k++) {
+				const quint32 a = tri[k];
+				const quint32 b = tri[(k + 1) % 3];
+				const quint64 key = edgeKey(a, b);
+				if (edgeUsage.value(key) != 1 && !seamEdges.contains(key))
+					continue;
+				const QVector3D edge = vertices[b].position - vertices[a].position;
+				const QVector3D planeNormal = QVector3D::crossProduct(edge, normal).normalized();
+				const Quadric boundary = Quadric::fromPlane(planeNormal, -QVector3D::dotProduct(planeNormal, vertices[a].position), edge.lengthSquared() * BoundaryWeight);
+				quadrics[a] += boundary;
+				quadrics[b] += boundary;
+			}
+		}
+
+		QVector<int> versions(vertices.size(), 0);
+		QVector<bool> vertexRemoved(vertices.size(), false);
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+		auto pushEdge = [&](quint32 a, quint32 b) {
+			const Quadric quadric = quadrics[a] + quadrics[b];
+			const float costToB = quadric.evaluate(vertices[b].position);
+			const float costToA = quadric.evaluate(vertices[a].position);
+			Collapse collapse;
+			collapse.from = costToB <= costToA ? a : b;
+			collapse.to = costToB <= costToA ? b : a;
+			collapse.cost = qMin(costToA, costToB);
+			collapse.fromVersion = versions[collapse.from];
+			collapse.toVersion = versions[collapse.to];
+			queue.push(collapse);
+		};
+		for (auto it = edgeUsage.constBegin(); it != edgeUsage.constEnd(); ++it)
+			pushEdge(quint32(it.key() >> 32), quint32(it.key()));
+
+		float maxError = 0.0f;
+		QHash<quint32, quint32> attributeMap;
+		while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+			const Collapse collapse = queue.top();
+			queue.pop();
+			if (vertexRemoved[collapse.from] || vertexRemoved[collapse.to]
+				|| versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion)
+				continue;
+			if (!canCollapse(vertices, triangles, triangleRemoved, adjacency[collapse.from], collapse.from, collapse.to))
+				continue;
+			if (!mapAttributes(triangles, corners, triangleRemoved, adjacency[collapse.from], collapse.from, collapse.to, attributeMap))
+				continue;
+			const QVector<int> fromAdjacency = std::move(adjacency[collapse.from]);
+			adjacency[collapse.from].clear();
+			QVector<int>& toAdjacency = adjacency[collapse.to];
+			for (int t : fromAdjacency) {
+				if (triangleRemoved[t])
+					continue;
+				quint32* tri = triangles.data() + t * 3;
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to) {
+					triangleRemoved[t] = true;
+					liveTriangles--;
+					continue;
+				}
+				for (int k = 0; k < 3; k++) {
+					if (tri[k] == collapse.from) {
+						tri[k] = collapse.to;
+						corners[t * 3 + k] = attributeMap.value(corners[t * 3 + k]);
+					}
+				}
+				toAdjacency << t;
+			}
+			toAdjacency.removeIf([&triangleRemoved](int t) { return triangleRemoved[t]; });
+			vertexRemoved[collapse.from] = true;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			versions[collapse.to]++;
+			maxError = qMax(maxError, collapse.cost);
+
+			// Ŀ궥Ķıˣ¼ΧбߵĴ
+			QVector<quint32> neighbors;
+			for (int t : toAdjacency) {
+				for (int k = 0; k < 3; k++) {
+					const quint32 neighbor = triangles[t * 3 + k];
+					if (neighbor != collapse.to && !neighbors.contains(neighbor))
+						neighbors << neighbor;
+				}
+			}
+			for (quint32 neighbor : neighbors)
+				pushEdge(qMin(neighbor, collapse.to), qMax(neighbor, collapse.to));
+		}
+
+		QVector<quint32> result;
+		result.reserve(liveTriangles * 3);
+		for (int t = 0; t < triangleCount; t++) {
+			if (!triangleRemoved[t])
+				result << corners[t * 3] << corners[t * 3 + 1] << corners[t * 3 + 2];
+		}
+		if (outError)
+			*outError = qSqrt(maxError);
+		return result;
+	}
+private:
+	static constexpr float BoundaryWeight = 10.0f;
+	struct Quadric {
+		double a[10] = {};										//Գ4x4
+		static Quadric fromPlane(const QVector3D& n, float d, float weight) {
+			Quadric q;
+			const double x = n.x(), y = n.y(), z = n.z(), w = d;
+			q.a[0] = x * x * weight; q.a[1] = x * y * weight; q.a[2] = x * z * weight; q.a[3] = x * w * weight;
+			q.a[4] = y * y * weight; q.a[5] = y * z * weight; q.a[6] = y * w * weight;
+			q.a[7] = z * z * weight; q.a[8] = z * w * weight;
+			q.a[9] = w * w * weight;
+			return q;
+		}
+		static Quadric fromTriangle(const QVector3D& p0, const QVector3D& p1, const QVector3D& p2) {
+			const QVector3D cross = QVector3D::crossProduct(p1 - p0, p2 - p0);
+			const float area = cross.length() * 0.5f;
+			if (area <= 0.0f)
+				return Quadric();
+			const QVector3D n = cross.normalized();
+			return fromPlane(n, -QVector3D::dotProduct(n, p0), area);
+		}
+		float evaluate(const QVector3D& p) const {
+			const double x = p.x(), y = p.y(), z = p.z();
+			return float(qMax(0.0, a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+				+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+				+ a[7] * z * z + 2 * a[8] * z + a[9]));
+		}
+		Quadric& operator+=(const Quadric& other) {
+			for (int i = 0; i < 10; i++)
+				a[i] += other.a[i];
+			return *this;
+		}
+		Quadric operator+(const Quadric& other) const {
+			Quadric q = *this;
+			q += other;
+			return q;
+		}
+	};
+	struct Collapse {
+		float cost;
+		quint32 from;
+		quint32 to;
+		int fromVersion;
+		int toVersion;
+		bool operator>(const Collapse& other) const {					//ͬʱ򣬳˳˳޹أɸ
+			if (cost != other.cost)
+				return cost > other.cost;
+			if (from != other.from)
+				return from > other.from;
+			return to > other.to;
+		}
+	};
+	static quint64 edgeKey(quint32 a, quint32 b, bool sorted = true) {
+		return sorted ? quint64(qMin(a, b)) << 32 | qMax(a, b) : quint64(a) << 32 | b;
+	}
+	// ۵ϵθ from ÿԶ to ĶӦ㣻 from ԶҲΨһĶӦ
+	// ӷϵĶ뿪ӷķ۵۵˺Ĩƽӷ죬ֱӷ
+	static bool mapAttributes(const QVector<quint32>& triangles, const QVector<quint32>& corners, const QVector<bool>& triangleRemoved, const QVector<int>& fromAdjacency, quint32 from, quint32 to, QHash<quint32, quint32>& attributeMap) {
+		attributeMap.clear();
+		for (int t : fromAdjacency) {
+			if (triangleRemoved[t])
+				continue;
+			const quint32* tri = triangles.constData() + t * 3;
+			int fromCorner = -1;
+			int toCorner = -1;
+			for (int k = 0; k < 3; k++) {
+				if (tri[k] == from)
+					fromCorner = k;
+				else if (tri[k] == to)
+					toCorner = k;
+			}
+			if (toCorner < 0)
+				continue;
+			const quint32 source = corners[t * 3 + fromCorner];
+			const quint32 target = corners[t * 3 + toCorner];
+			auto it = attributeMap.find(source);
+			if (it == attributeMap.end())
+				attributeMap.insert(source, target);
+			else if (it.value() != target)
+				return false;
+		}
+		for (int t : fromAdjacency) {
+			if (triangleRemoved[t])
+				continue;
+			for (int k = 0; k < 3; k++) {
+				if (triangles[t * 3 + k] == from && !attributeMap.contains(corners[t * 3 + k]))
+					return false;
+			}
+		}
+		return true;
+	}
+	static bool canCollapse(const QVector<QMeshGeometry::Vertex>& vertices, const QVector<quint32>& triangles, const QVector<bool>& triangleRemoved, const QVector<int>& fromAdjacency, quint32 from, quint32 to) {
+		for (int t : fromAdjacency) {											//۵βܷת˻
+			if (triangleRemoved[t])
+				continue;
+			const quint32* tri = triangles.constData() + t * 3;
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+				continue;
+			QVector3D before[3];
+			QVector3D after[3];
+			for (int k = 0; k < 3; k++) {
+				before[k] = vertices[tri[k]].position;
+				after[k] = tri[k] == from ? vertices[to].position : before[k];
+			}
+			const QVector3D normalBefore = QVector3D::crossProduct(before[1] - before[0], before[2] - before[0]);
+			const QVector3D normalAfter = QVector3D::crossProduct(after[1] - after[0], after[2] - after[0]);
+			if (QVector3D::dotProduct(normalBefore, normalAfter) <= 0.2f * normalBefore.length() * normalAfter.length())
+				return false;
+		}
+		return true;
+	}
+};
+
+// ڵ/ţTipsifyŻ任Уس̶ٹȻƣٰ״ʹ˳Ŷ߶ȡֲ
+class QMeshOptimizer {
+public:
+	static const int CacheSize = 16;
+	static constexpr float OverdrawThreshold = 1.05f;				//ΪٹȻACMR
+	static const int MaxClusterTriangles = 128;
+
+	struct CacheStats {
+		float acmr = 0.0f;											//ƽÿεĻδ
+		float atvr = 0.0f;											//δʵʹö֮ȣֵΪ1
+	};
+	struct Report {
+		CacheStats before;
+		CacheStats after;
+		int overdrawSortedSubmeshes = 0;
+		int submeshCount = 0;
+		qint64 vertexBytesBefore = 0;
+		qint64 vertexBytesAfter = 0;
+		qint64 quantizedVertexBytes = 0;
+		bool fromCache = false;									//ѾŻݣûŻǰͳ
+		QString toString() const {
+			QString result = fromCache
+				? QString("cached geometry: ACMR %1, ATVR %2, vertex buffer %3 KB").arg(after.acmr, 0, 'f', 3).arg(after.atvr, 0, 'f', 3).arg(vertexBytesAfter / 1024.0, 0, 'f', 1)
+				: QString("ACMR %1 -> %2, ATVR %3 -> %4, overdraw order kept for %5/%6 submeshes, vertex buffer %7 KB -> %8 KB")
+				.arg(before.acmr, 0, 'f', 3)
+				.arg(after.acmr, 0, 'f', 3)
+				.arg(before.atvr, 0, 'f', 3)
+				.arg(after.atvr, 0, 'f', 3)
+				.arg(overdrawSortedSubmeshes)
+				.arg(submeshCount)
+				.arg(vertexBytesBefore / 1024.0, 0, 'f', 1)
+				.arg(vertexBytesAfter / 1024.0, 0, 'f', 1);
+			if (quantizedVertexBytes > 0)
+				result += QString(" (%1 KB quantized)").arg(quantizedVertexBytes / 1024.0, 0, 'f', 1);
+			return result;
+		}
+	};
+
+	// ģFIFO任
+	static CacheStats analyzeVertexCache(const quint32* indices, int indexCount, int vertexCount) {
+		QVector<int> cacheTime(vertexCount, -CacheSize - 1);
+		QVector<bool> used(vertexCount, false);
+		int time = 0;
+		int misses = 0;
+		int uniqueVertices = 0;
+		for (int i = 0; i < indexCount; i++) {
+			const quint32 vertex = indices[i];
+			if (time - cacheTime[vertex] > CacheSize) {
+				cacheTime[vertex] = time++;
+				misses++;
+			}
+			if (!used[vertex]) {
+				used[vertex] = true;
+				uniqueVertices++;
+			}
+		}
+		CacheStats stats;
+		stats.acmr = misses / float(qMax(1, indexCount / 3));
+		stats.atvr = misses / float(qMax(1, uniqueVertices));
+		return stats;
+	}
+
+	static Report optimize(QMeshGeometry& geometry) {
+		Report report;
+		report.submeshCount = geometry.submeshes.size();
+		report.vertexBytesBefore = geometry.vertices.size() * sizeof(QMeshGeometry::Vertex);
+		report.before = analyzeVertexCache(geometry.indices.constData(), geometry.indices.size(), geometry.vertices.size());
+		for (const QMeshGeometry::Submesh& submesh : geometry.submeshes) {
+			quint32* indices = geometry.indices.data() + submesh.indexOffset;
+			QVector<int> clusterStarts;
+			const QVector<quint32> cacheOrder = optimizeVertexCache(indices, submesh.indexCount, geometry.vertices.size(), &clusterStarts);
+			QVector<quint32> overdrawOrder = optimizeOverdraw(geometry.vertices, cacheOrder, clusterStarts);
+			const float cacheAcmr = analyzeVertexCache(cacheOrder.constData(), cacheOrder.size(), geometry.vertices.size()).acmr;
+			const float overdrawAcmr = analyzeVertexCache(overdrawOrder.constData(), overdrawOrder.size(), geometry.vertices.size()).acmr;
+			const bool keepOverdrawOrder = overdrawAcmr <= cacheAcmr * OverdrawThreshold;
+			const QVector<quint32>& result = keepOverdrawOrder ? overdrawOrder : cacheOrder;
+			memcpy(indices, result.constData(), result.size() * sizeof(quint32));
+			report.overdrawSortedSubmeshes += keepOverdrawOrder ? 1 : 0;
+		}
+		optimizeVertexFetch(geometry);
+		report.after = analyzeVertexCache(geometry.indices.constData(), geometry.indices.size(), geometry.vertices.size());
+		report.vertexBytesAfter = geometry.vertices.size() * sizeof(QMeshGeometry::Vertex);
+		return report;
+	}
+
+	// Tipsify (Sander et al. 2007)ΧƵǰչδΣȻڻеڶѡһչ
+	static QVector<quint32> optimizeVertexCache(const quint32* indices, int indexCount, int vertexCount, QVector<int>* clusterStarts = nullptr) {
+		const int triangleCount = indexCount / 3;
+		QVector<int> liveTriangles(vertexCount, 0);
+		for (int i = 0; i < triangleCount * 3; i++)
+			liveTriangles[indices[i]]++;
+		QVector<int> adjacencyOffsets(vertexCount + 1, 0);
+		for (int v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		QVector<int> adjacency(adjacencyOffsets[vertexCount]);
+		QVector<int> fill = adjacencyOffsets;
+		for (int t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++)
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+		}
+
+		QVector<quint32> result;
+		result.reserve(triangleCount * 3);
+		QVector<int> cacheTime(vertexCount, 0);
+		QVector<bool> emitted(triangleCount, false);
+		QVector<quint32> deadEnd;
+		QVector<quint32> candidates;
+		int time = CacheSize + 1;
+		int cursor = 0;
+		auto nextUnfinishedVertex = [&]() -> qint64 {						//·ȻĶ㣬ٰ˳
+			if (clusterStarts)
+				clusterStarts->append(result.size() / 3);
+			while (!deadEnd.isEmpty()) {
+				const quint32 vertex = deadEnd.takeLast();
+				if (liveTriangles[vertex] > 0)
+					return vertex;
+			}
+			while (cursor < triangleCount * 3) {
+				const quint32 vertex = indices[cursor++];
+				if (liveTriangles[vertex] > 0)
+					return vertex;
+			}
+			return -1;
+		};
+		qint64 fanning = triangleCount > 0 ? nextUnfinishedVertex() : -1;
+		while (fanning >= 0) {
+			candidates.clear();
+			for (int i = adjacencyOffsets[fanning]; i < adjacencyOffsets[fanning + 1]; i++) {
+				const int t = adjacency[i];
+				if (emitted[t])
+					continue;
+				emitted[t] = true;
+				for (int k = 0; k < 3; k++) {
+					const quint32 vertex = indices[t * 3 + k];
+					result << vertex;
+					deadEnd << vertex;
+					candidates << vertex;
+					liveTriangles[vertex]--;
+					if (time - cacheTime[vertex] > CacheSize)
+						cacheTime[vertex] = time++;
+				}
+			}
+			qint64 best = -1;
+			int bestPriority = -1;
+			for (quint32 vertex : candidates) {
+				if (liveTriangles[vertex] <= 0)
+					continue;
+				int priority = 0;
+				if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= CacheSize)		//չԻڻ
+					priority = time - cacheTime[vertex];
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					best = vertex;
+				}
+			}
+			fanning = best >= 0 ? best : nextUnfinishedVertex();
+		}
+		return result;
+	}
+
+	// TipsifyĶϵηִأڱֻ˳򣬴֮䰴̶ȴӴСȻ
+	static QVector<quint32> optimizeOverdraw(const QVector<QMeshGeometry::Vertex>& vertices, const QVector<quint32>& indices, QVector<int> clusterStarts) {
+		const int triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return indices;
+		QVector<int> starts;
+		clusterStarts << triangleCount;
+		std::sort(clusterStarts.begin(), clusterStarts.end());
+		for (int i = 0; i + 1 < clusterStarts.size(); i++) {
+			for (int start = clusterStarts[i]; start < clusterStarts[i + 1]; start += MaxClusterTriangles) {
+				if (starts.isEmpty() || starts.back() != start)
+					starts << start;
+			}
+		}
+		if (starts.isEmpty() || starts.front() != 0)
+			starts.prepend(0);
+		starts << triangleCount;
+
+		auto triangleNormal = [&](int t) {
+			const QVector3D& p0 = vertices[indices[t * 3]].position;
+			return QVector3D::crossProduct(vertices[indices[t * 3 + 1]].position - p0, vertices[indices[t * 3 + 2]].position - p0);
+		};
+		auto triangleCentroid = [&](int t) {
+			return (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position + vertices[indices[t * 3 + 2]].position) / 3.0f;
+		};
+		QVector3D meshCentroid;
+		float meshArea = 0.0f;
+		for (int t = 0; t < triangleCount; t++) {
+			const float area = triangleNormal(t).length();
+			meshCentroid += triangleCentroid(t) * area;
+			meshArea += area;
+		}
+		meshCentroid /= qMax(meshArea, 1e-12f);
+
+		struct Cluster {
+			int start;
+			int end;
+			float sortKey;
+		};
+		QVector<Cluster> clusters;
+		for (int i = 0; i + 1 < starts.size(); i++) {
+			Cluster cluster = { starts[i], starts[i + 1], 0.0f };
+			QVector3D centroid;
+			QVector3D normal;
+			float area = 0.0f;
+			for (int t = cluster.start; t < cluster.end; t++) {
+				const QVector3D n = triangleNormal(t);
+				const float triangleArea = n.length();
+				centroid += triangleCentroid(t) * triangleArea;
+				normal += n;
+				area += triangleArea;
+			}
+			centroid /= qMax(area, 1e-12f);
+			cluster.sortKey = QVector3D::dotProduct(centroid - meshCentroid, normal.normalized());
+			clusters << cluster;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+		QVector<quint32> result;
+		result.reserve(indices.size());
+		for (const Cluster& cluster : clusters)
+			result << indices.mid(cluster.start * 3, (cluster.end - cluster.start) * 3);
+		return result;
+	}
+
+	// ״α˳Ŷ㣬ûбõĶ
+	static void optimizeVertexFetch(QMeshGeometry& geometry) {
+		QVector<quint32> remap(geometry.vertices.size(), UINT_MAX);
+		QVector<QMeshGeometry::Vertex> vertices;
+		vertices.reserve(geometry.vertices.size());
+		for (quint32& index : geometry.indices) {
+			if (remap[index] == UINT_MAX) {
+				remap[index] = vertices.size();
+				vertices << geometry.vertices[index];
+			}
+			index = remap[index];
+		}
+		geometry.vertices = vertices;
+	}
+};
+
+// ѡĶ16λλãΧйһ뷨ߣ2x16λ뾫UVÿ32ֽڽ16ֽ
+struct QQuantizedVertex {
+	quint32 positionXY;
+	quint32 positionZ;
+	quint32 normal;				//GLSL unpackSnorm2x16 Ӧ
+	quint32 texCoord;			//GLSL unpackHalf2x16 Ӧ
+
+	static QVector<QQuantizedVertex> quantize(const QVector<QMeshGeometry::Vertex>& vertices, QVector3D* outOffset, QVector3D* outScale) {
+		QVector3D boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		QVector3D boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const QMeshGeometry::Vertex& vertex : vertices) {
+			boundsMin = QVector3D(qMin(boundsMin.x(), vertex.position.x()), qMin(boundsMin.y(), vertex.position.y()), qMin(boundsMin.z(), vertex.position.z()));
+			boundsMax = QVector3D(qMax(boundsMax.x(), vertex.position.x()), qMax(boundsMax.y(), vertex.position.y()), qMax(boundsMax.z(), vertex.position.z()));
+		}
+		const QVector3D extent = boundsMax - boundsMin;
+		const QVector3D scale(qMax(extent.x(), 1e-6f), qMax(extent.y(), 1e-6f), qMax(extent.z(), 1e-6f));
+		*outOffset = boundsMin;
+		*outScale = scale / 65535.0f;
+
+		auto unorm16 = [](float value) { return quint32(qBound(0, qRound(value * 65535.0f), 65535)); };
+		auto snorm16 = [](float value) { return quint32(quint16(qint16(qRound(qBound(-1.0f, value, 1.0f) * 32767.0f)))); };
+		auto half = [](float value) {
+			const qfloat16 h(value);
+			quint16 bits;
+			memcpy(&bits, &h, sizeof(bits));
+			return quint32(bits);
+		};
+		QVector<QQuantizedVertex> result(vertices.size());
+		for (int i = 0; i < vertices.size(); i++) {
+			const QMeshGeometry::Vertex& vertex = vertices[i];
+			const QVector3D p = (vertex.position - boundsMin) / scale;
+			const QVector2D n = octahedralEncode(vertex.normal);
+			result[i].positionXY = unorm16(p.x()) | unorm16(p.y()) << 16;
+			result[i].positionZ = unorm16(p.z());
+			result[i].normal = snorm16(n.x()) | snorm16(n.y()) << 16;
+			result[i].texCoord = half(vertex.texCoord.x()) | half(vertex.texCoord.y()) << 16;
+		}
+		return result;
+	}
+	static QVector2D octahedralEncode(const QVector3D& normal) {
+		const float l1 = qAbs(normal.x()) + qAbs(normal.y()) + qAbs(normal.z());
+		if (l1 <= 0.0f)
+			return QVector2D(0.0f, 0.0f);
+		QVector2D result(normal.x() / l1, normal.y() / l1);
+		if (normal.z() < 0.0f) {
+			result = QVector2D((1.0f - qAbs(result.y())) * (result.x() >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - qAbs(result.x())) * (result.y() >= 0.0f ? 1.0f : -1.0f));
+		}
+		return result;
+	}
+};
+
+// LODԭʼιһ㻺壬ÿֻԼ
+struct QMeshLodChain {
+	static const int LodCount = 4;
+	static constexpr float LodRatios[LodCount] = { 1.0f, 0.5f, 0.25f, 0.1f };
+	struct Level {
+		QVector<QMeshGeometry::Submesh> submeshes;				//indexOffset ָ indices
+		int triangleCount = 0;
+		float error = 0.0f;
+	};
+	QVector<quint32> indices;
+	Level levels[LodCount];
+
+	// ÿ𼶼򻯣֮䲢У˽̵߳޹
+	static QMeshLodChain build(const QMeshGeometry& geometry) {
+		struct SubmeshChain {
+			QVector<quint32> indices[LodCount];
+			float error[LodCount] = {};
+		};
+		QVector<SubmeshChain> chains(geometry.submeshes.size());
+		QVector<int> submeshIndices(geometry.submeshes.size());
+		std::iota(submeshIndices.begin(), submeshIndices.end(), 0);
+		QtConcurrent::blockingMap(submeshIndices, [&](int submeshIndex) {
+			const QMeshGeometry::Submesh& submesh = geometry.submeshes[submeshIndex];
+			SubmeshChain& chain = chains[submeshIndex];
+			chain.indices[0] = QVector<quint32>(geometry.indices.begin() + submesh.indexOffset, geometry.indices.begin() + submesh.indexOffset + submesh.indexCount);
+			for (int lod = 1; lod < LodCount; lod++) {
+				const int target = int(submesh.indexCount / 3 * LodRatios[lod]) * 3;
+				const QVector<quint32>& source = chain.indices[lod - 1];
+				const QVector<quint32> simplified = QMeshSimplifier::simplify(geometry.vertices, source.constData(), source.size(), target, &chain.error[lod]);
+				chain.indices[lod] = QMeshOptimizer::optimizeVertexCache(simplified.constData(), simplified.size(), geometry.vertices.size());
+				chain.error[lod] = qMax(chain.error[lod], chain.error[lod - 1]);
+			}
+		});
+		QMeshLodChain lodChain;
+		for (int lod = 0; lod < LodCount; lod++) {
+			Level& level = lodChain.levels[lod];
+			for (int submeshIndex = 0; submeshIndex < chains.size(); submeshIndex++) {
+				const SubmeshChain& chain = chains[submeshIndex];
+				QMeshGeometry::Submesh submesh;
+				submesh.indexOffset = lodChain.indices.size();
+				submesh.indexCount = chain.indices[lod].size();
+				submesh.materialIndex = geometry.submeshes[submeshIndex].materialIndex;
+				lodChain.indices << chain.indices[lod];
+				level.submeshes << submesh;
+				level.triangleCount += submesh.indexCount / 3;
+				level.error = qMax(level.error, chain.error[lod]);
+			}
+		}
+		return lodChain;
+	}
+	QByteArray hash() const {
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(QByteArrayView(reinterpret_cast<const char*>(indices.constData()), indices.size() * sizeof(quint32)));
+		return hash.result().toHex();
+	}
+};
+
+// أMeshlet޵С鼸ΣΪGPU޳Ļλ
+struct QMeshlet {
+	QVector4D sphere;					//xyz: Χģw: 뾶
+	QVector4D cone;						//xyz: ׶w: ޳ֵΪ1ʱʾ޷޳
+	quint32 indexOffset = 0;
+	quint32 indexCount = 0;
+	quint32 vertexCount = 0;
+	quint32 padding = 0;
+};
+
+struct QMeshletSet {
+	static const int MaxVertices = 64;
+	static const int MaxTriangles = 124;
+	QVector<QMeshlet> meshlets;
+	QVector<quint32> indices;			//еȫֶ
+
+	int triangleCount() const { return indices.size() / 3; }
+
+	static QMeshletSet build(const QMeshGeometry& geometry) {
+		QMeshletSet set;
+		for (const QMeshGeometry::Submesh& submesh : geometry.submeshes)				//زԽ
+			buildSubmesh(geometry.vertices, geometry.indices.constData() + submesh.indexOffset, submesh.indexCount, set);
+		return set;
+	}
+private:
+	// ̰ĵչǰأѡڶڡ¶ٵΣûʱԭʼ˳ȡһ
+	static void buildSubmesh(const QVector<QMeshGeometry::Vertex>& vertices, const quint32* indices, int indexCount, QMeshletSet& set) {
+		const int triangleCount = indexCount / 3;
+		QHash<quint32, QVector<int>> adjacency;
+		for (int t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++)
+				adjacency[indices[t * 3 + k]] << t;
+		}
+		QVector<bool> emitted(triangleCount, false);
+		QHash<quint32, int> meshletVertexSet;
+		QVector<quint32> meshletVertices;
+		QVector<int> meshletTriangles;
+		int nextSeed = 0;
+
+		auto newVertexCount = [&](int t) {
+			int count = 0;
+			for (int k = 0; k < 3; k++)
+				count += meshletVertexSet.contains(indices[t * 3 + k]) ? 0 : 1;
+			return count;
+		};
+		auto flush = [&]() {
+			if (meshletTriangles.isEmpty())
+				return;
+			QMeshlet meshlet;
+			meshlet.indexOffset = set.indices.size();
+			meshlet.indexCount = meshletTriangles.size() * 3;
+			meshlet.vertexCount = meshletVertices.size();
+			for (int t : meshletTriangles)
+				set.indices << indices[t * 3] << indices[t * 3 + 1] << indices[t * 3 + 2];
+			computeBounds(vertices, set.indices.constData() + meshlet.indexOffset, meshlet.indexCount, meshlet);
+			set.meshlets << meshlet;
+			meshletVertexSet.clear();
+			meshletVertices.clear();
+			meshletTriangles.clear();
+		};
+
+		while (true) {
+			int candidate = -1;
+			int candidateNewVertices = 4;
+			for (quint32 vertex : meshletVertices) {
+				for (int t : adjacency[vertex]) {
+					if (emitted[t])
+						continue;
+					const int count = newVertexCount(t);
+					if (count < candidateNewVertices) {
+						candidate = t;
+						candidateNewVertices = count;
+					}
+				}
+				if (candidateNewVertices == 0)
+					break;
+			}
+			if (candidate < 0) {
+				while (nextSeed < triangleCount && emitted[nextSeed])
+					nextSeed++;
+				if (nextSeed == triangleCount)
+					break;
+				candidate = nextSeed;
+				candidateNewVertices = newVertexCount(candidate);
+			}
+			if (meshletVertices.size() + candidateNewVertices > MaxVertices || meshletTriangles.size() + 1 > MaxTriangles) {
+				flush();
+				candidateNewVertices = 3;
+			}
+			emitted[candidate] = true;
+			meshletTriangles << candidate;
+			for (int k = 0; k < 3; k++) {
+				const quint32 vertex = indices[candidate * 3 + k];
+				if (!meshletVertexSet.contains(vertex)) {
+					meshletVertexSet.insert(vertex, meshletVertices.size());
+					meshletVertices << vertex;
+				}
+			}
+		}
+		flush();
+	}
+	static void computeBounds(const QVector<QMeshGeometry::Vertex>& vertices, const quint32* indices, int indexCount, QMeshlet& meshlet) {
+		QVector3D boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		QVector3D boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (int i = 0; i < indexCount; i++) {
+			const QVector3D& p = vertices[indices[i]].position;
+			boundsMin = QVector3D(qMin(boundsMin.x(), p.x()), qMin(boundsMin.y(), p.y()), qMin(boundsMin.z(), p.z()));
+			boundsMax = QVector3D(qMax(boundsMax.x(), p.x()), qMax(boundsMax.y(), p.y()), qMax(boundsMax.z(), p.z()));
+		}
+		const QVector3D center = (boundsMin + boundsMax) * 0.5f;
+		float radius = 0.0f;
+		for (int i = 0; i < indexCount; i++)
+			radius = qMax(radius, (vertices[indices[i]].position - center).length());
+		meshlet.sphere = QVector4D(center, radius);
+
+		// ׶ȡηߵƽŽƫԶķ߾
+		QVector<QVector3D> normals;
+		QVector3D axis;
+		for (int i = 0; i < indexCount; i += 3) {
+			const QVector3D& p0 = vertices[indices[i]].position;
+			const QVector3D normal = QVector3D::crossProduct(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+			if (normal.lengthSquared() <= 1e-12f)
+				continue;
+			normals << normal.normalized();
+			axis += normals.back();
+		}
+		meshlet.cone = QVector4D(0.0f, 0.0f, 0.0f, 1.0f);
+		if (normals.isEmpty() || axis.length() < 1e-6f)
+			return;
+		axis.normalize();
+		float minDot = 1.0f;
+		for (const QVector3D& normal : normals)
+			minDot = qMin(minDot, QVector3D::dotProduct(normal, axis));
+		if (minDot <= 0.1f)															//Žǽӽ򳬹90ȣ޳Ч
+			return;
+		meshlet.cone = QVector4D(axis, qSqrt(1.0f - minDot * minDot));
+	}
+};
+
+// ΡLODһ𻺴ԴԱߣԴļʱ봦
+class QMeshLodCache {
+public:
+	static QString cachePath(const QString& assetPath) { return assetPath + ".lodcache"; }
+	static QByteArray sourceHash(const QString& assetPath) {
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		QFile gltf(assetPath);
+		if (gltf.open(QIODevice::ReadOnly)) {
+			const QByteArray content = gltf.readAll();
+			hash.addData(content);
+			const QJsonArray buffers = QJsonDocument::fromJson(content).object()["buffers"].toArray();
+			for (const QJsonValue& buffer : buffers) {
+				QFile bin(QFileInfo(assetPath).dir().filePath(buffer.toObject()["uri"].toString()));
+				if (bin.open(QIODevice::ReadOnly))
+					hash.addData(&bin);
+			}
+		}
+		hash.addData(QByteArray::number(Version));
+		return hash.result();
+	}
+	static bool read(const QString& assetPath, const QByteArray& sourceHash, QMeshGeometry& geometry, QMeshLodChain& lodChain, QMeshletSet& meshlets) {
+		QFile file(cachePath(assetPath));
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+		QDataStream stream(&file);
+		QByteArray storedHash;
+		stream >> storedHash;
+		if (storedHash != sourceHash)
+			return false;
+		qint32 vertexCount = 0;
+		stream >> vertexCount;
+		geometry.vertices.resize(vertexCount);
+		stream.readRawData(reinterpret_cast<char*>(geometry.vertices.data()), vertexCount * sizeof(QMeshGeometry::Vertex));
+		stream >> geometry.indices >> lodChain.indices;
+		auto readSubmeshes = [&stream](QVector<QMeshGeometry::Submesh>& submeshes) {
+			qint32 count = 0;
+			stream >> count;
+			submeshes.resize(count);
+			for (QMeshGeometry::Submesh& submesh : submeshes)
+				stream >> submesh.indexOffset >> submesh.indexCount >> submesh.materialIndex;
+		};
+		qint32 materialCount = 0;
+		stream >> materialCount;
+		geometry.materials.resize(qMax(0, materialCount));
+		for (QMeshGeometry::Material& material : geometry.materials)
+			stream >> material.baseColorFactor >> material.metallicFactor >> material.roughnessFactor >> material.baseColorTexture >> material.metallicRoughnessTexture;
+		readSubmeshes(geometry.submeshes);
+		for (QMeshLodChain::Level& level : lodChain.levels) {
+			readSubmeshes(level.submeshes);
+			stream >> level.triangleCount >> level.error;
+		}
+		qint32 meshletCount = 0;
+		stream >> meshletCount;
+		meshlets.meshlets.resize(meshletCount);
+		stream.readRawData(reinterpret_cast<char*>(meshlets.meshlets.data()), meshletCount * sizeof(QMeshlet));
+		stream >> meshlets.indices;
+		geometry.updateBounds();
+		return stream.status() == QDataStream::Ok;
+	}
+	static void write(const QString& assetPath, const QByteArray& sourceHash, const QMeshGeometry& geometry, const QMeshLodChain& lodChain, const QMeshletSet& meshlets) {
+		QSaveFile file(cachePath(assetPath));
+		if (!file.open(QIODevice::WriteOnly)) {
+			qWarning() << "[MeshLod] cannot write cache" << file.fileName();
+			return;
+		}
+		QDataStream stream(&file);
+		stream << sourceHash << qint32(geometry.vertices.size());
+		stream.writeRawData(reinterpret_cast<const char*>(geometry.vertices.constData()), geometry.vertices.size() * sizeof(QMeshGeometry::Vertex));
+		stream << geometry.indices << lodChain.indices;
+		auto writeSubmeshes = [&stream](const QVector<QMeshGeometry::Submesh>& submeshes) {
+			stream << qint32(submeshes.size());
+			for (const QMeshGeometry::Submesh& submesh : submeshes)
+				stream << submesh.indexOffset << submesh.indexCount << submesh.materialIndex;
+		};
+		stream << qint32(geometry.materials.size());
+		for (const QMeshGeometry::Material& material : geometry.materials)
+			stream << material.baseColorFactor << material.metallicFactor << material.roughnessFactor << material.baseColorTexture << material.metallicRoughnessTexture;
+		writeSubmeshes(geometry.submeshes);
+		for (const QMeshLodChain::Level& level : lodChain.levels) {
+			writeSubmeshes(level.submeshes);
+			stream << level.triangleCount << level.error;
+		}
+		stream << qint32(meshlets.meshlets.size());
+		stream.writeRawData(reinterpret_cast<const char*>(meshlets.meshlets.constData()), meshlets.meshlets.size() * sizeof(QMeshlet));
+		stream << meshlets.indices;
+		file.commit();
+	}
+private:
+	static const int Version = 4;
+};
+
+struct QLodMeshAsset {
+	QMeshGeometry geometry;
+	QMeshLodChain lodChain;
+	QMeshletSet meshlets;
+	QVector<QQuantizedVertex> quantizedVertices;			//ΪʱʹδĶ
+	QVector3D quantizationOffset;
+	QVector3D quantizationScale;
+	QVector<QImage> baseColorImages;						// geometry.materials һһӦûͼʱΪ1x1İɫͼƬ
+	QVector<QImage> metallicRoughnessImages;
+
+	static QSharedPointer<QLodMeshAsset> load(const QString& path, bool quantizeVertices) {
+		QSharedPointer<QLodMeshAsset> asset(new QLodMeshAsset);
+		const QByteArray sourceHash = QMeshLodCache::sourceHash(path);
+		QMeshOptimizer::Report report;
+		if (QMeshLodCache::read(path, sourceHash, asset->geometry, asset->lodChain, asset->meshlets)) {
+			qDebug() << "[MeshLod] loaded LOD chain from" << QMeshLodCache::cachePath(path);
+			report.before = report.after = QMeshOptimizer::analyzeVertexCache(asset->geometry.indices.constData(), asset->geometry.indices.size(), asset->geometry.vertices.size());
+			report.fromCache = true;
+			report.vertexBytesBefore = report.vertexBytesAfter = asset->geometry.vertices.size() * sizeof(QMeshGeometry::Vertex);
+		}
+		else {
+			QString error;
+			asset->geometry = QMeshGeometry::loadGltf(path, &error);
+			if (asset->geometry.vertices.isEmpty()) {
+				qWarning() << "[MeshLod]" << error;
+				return nullptr;
+			}
+			report = QMeshOptimizer::optimize(asset->geometry);			//LODضŻ˳
+			QElapsedTimer timer;
+			timer.start();
+			asset->lodChain = QMeshLodChain::build(asset->geometry);
+			qDebug() << "[MeshLod] simplified" << asset->geometry.triangleCount() << "triangles in" << timer.elapsed() << "ms";
+			asset->meshlets = QMeshletSet::build(asset->geometry);
+			QMeshLodCache::write(path, sourceHash, asset->geometry, asset->lodChain, asset->meshlets);
+		}
+		for (const QMeshGeometry::Material& material : asset->geometry.materials) {
+			asset->baseColorImages << loadImage(material.baseColorTexture);
+			asset->metallicRoughnessImages << loadImage(material.metallicRoughnessTexture);
+		}
+		if (quantizeVertices) {
+			asset->quantizedVertices = QQuantizedVertex::quantize(asset->geometry.vertices, &asset->quantizationOffset, &asset->quantizationScale);
+			report.quantizedVertexBytes = asset->quantizedVertices.size() * sizeof(QQuantizedVertex);
+		}
+		qDebug().noquote() << "[MeshOptimize]" << report.toString();
+		return asset;
+	}
+private:
+	static QImage loadImage(const QString& path) {
+		QImage image;
+		if (!path.isEmpty() && !image.load(path))
+			qWarning() << "[MeshLod] cannot load texture" << path;
+		if (image.isNull()) {
+			image = QImage(1, 1, QImage::Format_RGBA8888);
+			image.fill(Qt::white);
+		}
+		return image.convertToFormat(QImage::Format_RGBA8888);
+	}
+};
+
+class QLodMeshComponent : public IRenderComponent {
+public:
+	void setAsset(QSharedPointer<QLodMeshAsset> asset) { mAsset = asset; }
+	const QSharedPointer<QLodMeshAsset>& getAsset() const { return mAsset; }
+	int getLod() const { return mLod; }
+	void setDrawEnabled(bool enabled) { mDrawEnabled = enabled; }			//޳Passӹܻʱر
+
+	// ݰΧĻϵĸ߶ռѡLODͻ䣬ֵл
+	float updateLod(const QMatrix4x4& view, const QMatrix4x4& projection, float lodBias, float hysteresis, int forcedLod) {
+		if (mAsset.isNull())
+			return 0.0f;
+		const QMeshGeometry& geometry = mAsset->geometry;
+		const QMatrix4x4 worldMatrix = calculateWorldMatrix();
+		const QVector3D center = (view * worldMatrix).map(geometry.boundsCenter);
+		const float scale = worldMatrix.column(0).toVector3D().length();
+		const float coverage = geometry.boundsRadius * scale * projection(1, 1) / qMax(-center.z(), 1e-3f) * lodBias;
+		if (forcedLod >= 0) {
+			mLod = qMin(forcedLod, QMeshLodChain::LodCount - 1);
+			return coverage;
+		}
+		int desired = QMeshLodChain::LodCount - 1;
+		for (int lod = 0; lod < QMeshLodChain::LodCount; lod++) {
+			if (coverage >= LodCoverage[lod]) {
+				desired = lod;
+				break;
+			}
+		}
+		if (desired > mLod && coverage < LodCoverage[mLod] * (1.0f - hysteresis))
+			mLod = desired;
+		else if (desired < mLod && coverage >= LodCoverage[mLod - 1] * (1.0f + hysteresis))
+			mLod = desired;
+		return coverage;
+	}
+	int getDrawnTriangleCount() const { return mAsset.isNull() ? 0 : mAsset->lodChain.levels[mLod].triangleCount; }
+private:
+	static constexpr float LodCoverage[QMeshLodChain::LodCount] = { 0.6f, 0.3f, 0.12f, 0.0f };		//LODҪСĻռ
+	QSharedPointer<QLodMeshAsset> mAsset;
+	QScopedPointer<QRhiBuffer> mVertexBuffer;
+	QScopedPointer<QRhiBuffer> mIndexBuffer;
+	QVector<QSharedPointer<QPrimitiveRenderProxy>> mProxies;			//ÿһֻʹøòʵ
+	int mLod = 0;
+	bool mDrawEnabled = true;
+protected:
+	void onRebuildResource() override {
+		if (mAsset.isNull())
+			return;
+		const QMeshGeometry& geometry = mAsset->geometry;
+		const bool quantized = !mAsset->quantizedVertices.isEmpty();
+		const int vertexStride = quantized ? sizeof(QQuantizedVertex) : sizeof(QMeshGeometry::Vertex);
+		mVertexBuffer.reset(mRhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, vertexStride * geometry.vertices.size()));
+		mVertexBuffer->create();
+		mIndexBuffer.reset(mRhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer, sizeof(quint32) * mAsset->lodChain.indices.size()));
+		mIndexBuffer->create();
+
+		mProxies.clear();
+		for (int materialIndex = 0; materialIndex < geometry.materials.size(); materialIndex++)
+			mProxies << newMaterialProxy(materialIndex, quantized, vertexStride);
+	}
+private:
+	QSharedPointer<QPrimitiveRenderProxy> newMaterialProxy(int materialIndex, bool quantized, int vertexStride) {
+		const QMeshGeometry::Material& material = mAsset->geometry.materials[materialIndex];
+		QSharedPointer<QPrimitiveRenderProxy> proxy = newPrimitiveRenderProxy();
+
+		proxy->addUniformBlock(QRhiShaderStage::Vertex, "Transform")
+			->addParam("M", QGenericMatrix<4, 4, float>())
+			->addParam("MVP", QGenericMatrix<4, 4, float>())
+			->addParam("QuantizationOffset", QVector4D(mAsset->quantizationOffset, 0.0f))
+			->addParam("QuantizationScale", QVector4D(mAsset->quantizationScale, 0.0f));
+
+		proxy->addUniformBlock(QRhiShaderStage::Fragment, "Material")
+			->addParam("BaseColorFactor", material.baseColorFactor)
+			->addParam("MetallicFactor", material.metallicFactor)
+			->addParam("RoughnessFactor", material.roughnessFactor);
+
+		proxy->addTexture(QRhiShaderStage::Fragment, QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::Repeat, QRhiSampler::Repeat, "BaseColorTexture", mAsset->baseColorImages[materialIndex]);
+		proxy->addTexture(QRhiShaderStage::Fragment, QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::Repeat, QRhiSampler::Repeat, "MetallicRoughnessTexture", mAsset->metallicRoughnessImages[materialIndex]);
+
+		proxy->setInputBindings({
+			QRhiVertexInputBindingEx(mVertexBuffer.get(), vertexStride)
+		});
+
+		if (quantized) {
+			proxy->setInputAttribute({
+				QRhiVertexInputAttributeEx("inPosition", 0, 0, QRhiVertexInputAttribute::UInt2, offsetof(QQuantizedVertex, positionXY)),
+				QRhiVertexInputAttributeEx("inNormal", 0, 1, QRhiVertexInputAttribute::UInt, offsetof(QQuantizedVertex, normal)),
+				QRhiVertexInputAttributeEx("inUV", 0, 2, QRhiVertexInputAttribute::UInt, offsetof(QQuantizedVertex, texCoord)),
+			});
+			proxy->setShaderMainCode(QRhiShaderStage::Vertex, R"(
+				layout (location = 0) out vec3 vWorldPosition;
+				layout (location = 1) out vec3 vWorldNormal;
+				layout (location = 2) out vec2 vUV;
+				vec3 octahedralDecode(vec2 e){
+					vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+					float t = max(-n.z, 0.0f);
+					n.x += n.x >= 0.0f ? -t : t;
+					n.y += n.y >= 0.0f ? -t : t;
+					return normalize(n);
+				}
+				void main(){
+					vec3 position = vec3(inPosition.x & 0xFFFFu, inPosition.x >> 16, inPosition.y & 0xFFFFu) * Transform.QuantizationScale.xyz + Transform.QuantizationOffset.xyz;
+					vec3 normal = octahedralDecode(unpackSnorm2x16(inNormal));
+					vWorldPosition = (Transform.M * vec4(position, 1.0f)).xyz;
+					vWorldNormal = mat3(Transform.M) * normal;
+					vUV = unpackHalf2x16(inUV);
+					gl_Position = Transform.MVP * vec4(position, 1.0f);
+				}
+			)");
+		}
+		else {
+			proxy->setInputAttribute({
+				QRhiVertexInputAttributeEx("inPosition", 0, 0, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, position)),
+				QRhiVertexInputAttributeEx("inNormal", 0, 1, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, normal)),
+				QRhiVertexInputAttributeEx("inUV", 0, 2, QRhiVertexInputAttribute::Float2, offsetof(QMeshGeometry::Vertex, texCoord)),
+			});
+			proxy->setShaderMainCode(QRhiShaderStage::Vertex, R"(
+				layout (location = 0) out vec3 vWorldPosition;
+				layout (location = 1) out vec3 vWorldNormal;
+				layout (location = 2) out vec2 vUV;
+				void main(){
+					vWorldPosition = (Transform.M * vec4(inPosition, 1.0f)).xyz;
+					vWorldNormal = mat3(Transform.M) * inNormal;
+					vUV = inUV;
+					gl_Position = Transform.MVP * vec4(inPosition, 1.0f);
+				}
+			)");
+		}
+		proxy->setShaderMainCode(QRhiShaderStage::Fragment, QString(R"(
+			layout (location = 0) in vec3 vWorldPosition;
+			layout (location = 1) in vec3 vWorldNormal;
+			layout (location = 2) in vec2 vUV;
+			void main(){
+				vec4 metallicRoughness = texture(MetallicRoughnessTexture, vUV);		//glTFԼgΪֲڶȣbΪ
+				%1
+				%2
+				%3
+				%4
+				%5
+			})")
+			.arg(hasColorAttachment("BaseColor") ? "BaseColor = texture(BaseColorTexture, vUV) * Material.BaseColorFactor;" : "")
+			.arg(hasColorAttachment("Position") ? "Position = vec4(vWorldPosition, 1.0f);" : "")
+			.arg(hasColorAttachment("Normal") ? "Normal = vec4(normalize(vWorldNormal), 1.0f);" : "")
+			.arg(hasColorAttachment("Metallic") ? "Metallic = vec4(metallicRoughness.b * Material.MetallicFactor);" : "")
+			.arg(hasColorAttachment("Roughness") ? "Roughness = vec4(metallicRoughness.g * Material.RoughnessFactor);" : "")
+			.toLocal8Bit()
+		);
+		if (materialIndex == 0) {											//вʹֻϴһ
+			proxy->setOnUpload([this](QRhiResourceUpdateBatch* batch) {
+				if (mAsset->quantizedVertices.isEmpty())
+					batch->uploadStaticBuffer(mVertexBuffer.get(), mAsset->geometry.vertices.constData());
+				else
+					batch->uploadStaticBuffer(mVertexBuffer.get(), mAsset->quantizedVertices.constData());
+				batch->uploadStaticBuffer(mIndexBuffer.get(), mAsset->lodChain.indices.constData());
+			});
+		}
+		proxy->setOnUpdate([this](QRhiResourceUpdateBatch* batch, const QPrimitiveRenderProxy::UniformBlocks& blocks, const QPrimitiveRenderProxy::UpdateContext& ctx) {
+			const QMatrix4x4 worldMatrix = calculateWorldMatrix();
+			const QMatrix4x4 MVP = ctx.projectionMatrixWithCorr * ctx.viewMatrix * worldMatrix;
+			blocks["Transform"]->setParamValue("M", QVariant::fromValue(worldMatrix.toGenericMatrix<4, 4>()));
+			blocks["Transform"]->setParamValue("MVP", QVariant::fromValue(MVP.toGenericMatrix<4, 4>()));
+		});
+		proxy->setOnDraw([this, materialIndex](QRhiCommandBuffer* cmdBuffer) {
+			if (!mDrawEnabled)
+				return;
+			const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+			cmdBuffer->setVertexInput(0, 1, &vertexBindings, mIndexBuffer.get(), 0, QRhiCommandBuffer::IndexUInt32);
+			for (const QMeshGeometry::Submesh& submesh : mAsset->lodChain.levels[mLod].submeshes) {
+				if (submesh.indexCount > 0 && int(submesh.materialIndex) == materialIndex)
+					cmdBuffer->drawIndexed(submesh.indexCount, 1, submesh.indexOffset);
+			}
+		});
+		return proxy;
+	}
+};
+
+// ޳ɫ׶뷨׶ԣѴصѹһУһμӻƻ
+class QMeshletCullingPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QMeshletCullingPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, SceneColor);				//ֻȷȾߴ
+		QRP_INPUT_ATTR(QLodMeshComponent*, Mesh);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(QVector3D, CameraPosition);
+		QRP_INPUT_ATTR(bool, FrustumCulling);
+		QRP_INPUT_ATTR(bool, ConeCulling);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QMeshletCullingPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, BaseColor)
+	QRP_OUTPUT_END()
+public:
+	struct DrawCommand {								//VkDrawIndexedIndirectCommandĩβͳ
+		quint32 indexCount;
+		quint32 instanceCount;
+		quint32 firstIndex;
+		qint32 vertexOffset;
+		quint32 firstInstance;
+		quint32 visibleClusters;
+		quint32 padding[2];
+	};
+	struct Stats {
+		int visibleClusters = 0;
+		int totalClusters = 0;
+		int visibleTriangles = 0;
+		int totalTriangles = 0;
+	};
+private:
+	struct UniformBlock {
+		float model[16];
+		float viewProjection[16];
+		float frustumPlanes[6][4];
+		float cameraPosition[4];
+		float scale;
+		qint32 meshletCount;
+		qint32 frustumCulling;
+		qint32 coneCulling;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mVertexBuffer;
+	QRhiBufferRef mMeshletBuffer;
+	QRhiBufferRef mSourceIndexBuffer;
+	QRhiBufferRef mCompactIndexBuffer;
+	QScopedPointer<QRhiBuffer> mDrawCommandBuffer;
+	QRhiTextureRef mColorAttachment;
+	QRhiRenderBufferRef mDepthStencil;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiShaderResourceBindingsRef mCullBindings;
+	QRhiComputePipelineRef mCullPipeline;
+	QRhiShaderResourceBindingsRef mDrawBindings;
+	QRhiGraphicsPipelineRef mDrawPipeline;
+	QShader mCullCS;
+	QShader mDrawVS;
+	QShader mDrawFS;
+	const QLodMeshAsset* mUploadedAsset = nullptr;
+	QRhiBuffer* mUploadedVertexBuffer = nullptr;
+	QRhiBufferReadbackResult mReadback;
+	Stats mStats;
+public:
+	QMeshletCullingPassBuilder() {
+		mCullCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 64) in;
+			struct Meshlet {
+				vec4 sphere;
+				vec4 cone;
+				uint indexOffset;
+				uint indexCount;
+				uint vertexCount;
+				uint padding;
+			};
+			layout (std430, binding = 0) readonly buffer MeshletBuffer { Meshlet meshlets[]; };
+			layout (std430, binding = 1) readonly buffer SourceIndexBuffer { uint sourceIndices[]; };
+			layout (std430, binding = 2) writeonly buffer CompactIndexBuffer { uint compactIndices[]; };
+			layout (std430, binding = 3) buffer DrawCommand {
+				uint indexCount;
+				uint instanceCount;
+				uint firstIndex;
+				int vertexOffset;
+				uint firstInstance;
+				uint visibleClusters;
+			} cmd;
+			layout (std140, binding = 4) uniform UniformBlock {
+				mat4 model;
+				mat4 viewProjection;
+				vec4 frustumPlanes[6];
+				vec4 cameraPosition;
+				float scale;
+				int meshletCount;
+				int frustumCulling;
+				int coneCulling;
+			} ubo;
+			shared uint sBase;
+			shared bool sVisible;
+			void main() {
+				Meshlet meshlet = meshlets[gl_WorkGroupID.x];
+				if (gl_LocalInvocationIndex == 0) {
+					vec3 center = (ubo.model * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+					float radius = meshlet.sphere.w * ubo.scale;
+					bool visible = true;
+					if (ubo.frustumCulling != 0) {
+						for (int i = 0; i < 6; i++)
+							visible = visible && dot(ubo.frustumPlanes[i].xyz, center) + ubo.frustumPlanes[i].w >= -radius;
+					}
+					if (ubo.coneCulling != 0 && meshlet.cone.w < 1.0) {
+						vec3 axis = normalize(mat3(ubo.model) * meshlet.cone.xyz);
+						vec3 view = center - ubo.cameraPosition.xyz;
+						visible = visible && dot(view, axis) < meshlet.cone.w * length(view) + radius;		//ζʱ޳
+					}
+					if (visible) {
+						sBase = atomicAdd(cmd.indexCount, meshlet.indexCount);
+						atomicAdd(cmd.visibleClusters, 1);
+					}
+					sVisible = visible;
+				}
+				barrier();
+				if (!sVisible)
+					return;
+				for (uint i = gl_LocalInvocationIndex; i < meshlet.indexCount; i += 64)
+					compactIndices[sBase + i] = sourceIndices[meshlet.indexOffset + i];
+			}
+		)");
+		mDrawVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inPosition;
+			layout (location = 1) in vec3 inNormal;
+			layout (location = 0) out vec3 vWorldNormal;
+			layout (std140, binding = 0) uniform UniformBlock {
+				mat4 model;
+				mat4 viewProjection;
+				vec4 frustumPlanes[6];
+				vec4 cameraPosition;
+				float scale;
+				int meshletCount;
+				int frustumCulling;
+				int coneCulling;
+			} ubo;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				vWorldNormal = mat3(ubo.model) * inNormal;
+				gl_Position = ubo.viewProjection * ubo.model * vec4(inPosition, 1.0);
+			}
+		)");
+		mDrawFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (location = 0) in vec3 vWorldNormal;
+			layout (location = 0) out vec4 outColor;
+			void main() {
+				vec3 N = normalize(vWorldNormal);
+				outColor = vec4(vec3(0.75) * (0.35 + 0.65 * max(dot(N, normalize(vec3(0.3, 1.0, 0.2))), 0.0)), 1.0);
+			}
+		)");
+		mReadback.completed = [this]() {
+			if (mReadback.data.size() < int(sizeof(DrawCommand)))
+				return;
+			DrawCommand command;
+			memcpy(&command, mReadback.data.constData(), sizeof(DrawCommand));
+			mStats.visibleClusters = command.visibleClusters;
+			mStats.visibleTriangles = command.indexCount / 3;
+		};
+	}
+	const Stats& getStats() const { return mStats; }
+
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QLodMeshAsset& asset = *mInput._Mesh->getAsset();
+		const QSize size = mInput._SceneColor->pixelSize();
+		mStats.totalClusters = asset.meshlets.meshlets.size();
+		mStats.totalTriangles = asset.meshlets.triangleCount();
+
+		builder.setupBuffer(mUniformBuffer, "MeshletUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mVertexBuffer, "MeshletVertexBuffer", QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(QMeshGeometry::Vertex) * asset.geometry.vertices.size());
+		builder.setupBuffer(mMeshletBuffer, "MeshletBuffer", QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer, sizeof(QMeshlet) * asset.meshlets.meshlets.size());
+		builder.setupBuffer(mSourceIndexBuffer, "MeshletSourceIndexBuffer", QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer, sizeof(quint32) * asset.meshlets.indices.size());
+		builder.setupBuffer(mCompactIndexBuffer, "MeshletCompactIndexBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer | QRhiBuffer::IndexBuffer, sizeof(quint32) * asset.meshlets.indices.size());
+		if (mDrawCommandBuffer.isNull()) {					//QRhiûмӻ;ο 15-IndirectDraw ֱӴVK
+			mDrawCommandBuffer.reset(QRhiHelper::newVkBuffer(mRhi, QRhiBuffer::Static, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(DrawCommand)));
+			mDrawCommandBuffer->create();
+		}
+
+		builder.setupTexture(mColorAttachment, "MeshletColor", QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget);
+		builder.setupRenderBuffer(mDepthStencil, "MeshletDepthStencil", QRhiRenderBuffer::DepthStencil, size);
+		QRhiTextureRenderTargetDescription renderTargetDesc(mColorAttachment.get());
+		renderTargetDesc.setDepthStencilBuffer(mDepthStencil.get());
+		builder.setupRenderTarget(mRenderTarget, "MeshletRT", renderTargetDesc);
+
+		builder.setupShaderResourceBindings(mCullBindings, "MeshletCullBindings", {
+			QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, mMeshletBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, mSourceIndexBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(2, QRhiShaderResourceBinding::ComputeStage, mCompactIndexBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoadStore(3, QRhiShaderResourceBinding::ComputeStage, mDrawCommandBuffer.get()),
+			QRhiShaderResourceBinding::uniformBuffer(4, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+		});
+		builder.setupComputePipeline(mCullPipeline, "MeshletCullPipeline", QRhiComputePipelineState{ mCullBindings.get(), mCullCS });
+
+		builder.setupShaderResourceBindings(mDrawBindings, "MeshletDrawBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mUniformBuffer.get()),
+		});
+		QRhiGraphicsPipelineState drawPSO;
+		drawPSO.shaderResourceBindings = mDrawBindings.get();
+		drawPSO.sampleCount = mRenderTarget->sampleCount();
+		drawPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		drawPSO.depthTest = true;
+		drawPSO.depthWrite = true;
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(sizeof(QMeshGeometry::Vertex)),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, position)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, normal)),
+		});
+		drawPSO.vertexInputLayout = inputLayout;
+		drawPSO.shaderStages = {
+			{ QRhiShaderStage::Vertex, mDrawVS },
+			{ QRhiShaderStage::Fragment, mDrawFS }
+		};
+		builder.setupGraphicsPipeline(mDrawPipeline, "MeshletDrawPipeline", drawPSO);
+
+		mOutput.BaseColor = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QLodMeshAsset& asset = *mInput._Mesh->getAsset();
+		const QMatrix4x4 model = mInput._Mesh->calculateWorldMatrix();
+		const QMatrix4x4 viewProjection = mInput._ProjectionMatrix * mInput._ViewMatrix;
+		const QMatrix4x4 viewProjectionWithCorr = mRhi->clipSpaceCorrMatrix() * viewProjection;
+
+		UniformBlock ubo;
+		memcpy(ubo.model, model.constData(), sizeof(ubo.model));
+		memcpy(ubo.viewProjection, viewProjectionWithCorr.constData(), sizeof(ubo.viewProjection));
+		for (int i = 0; i < 3; i++) {
+			QVector4D planes[2] = { viewProjection.row(3) + viewProjection.row(i), viewProjection.row(3) - viewProjection.row(i) };
+			for (int j = 0; j < 2; j++) {
+				planes[j] /= planes[j].toVector3D().length();
+				memcpy(ubo.frustumPlanes[i * 2 + j], &planes[j], sizeof(QVector4D));
+			}
+		}
+		memcpy(ubo.cameraPosition, &mInput._CameraPosition, sizeof(QVector3D));
+		ubo.cameraPosition[3] = 1.0f;
+		ubo.scale = model.column(0).toVector3D().length();
+		ubo.meshletCount = asset.meshlets.meshlets.size();
+		ubo.frustumCulling = mInput._FrustumCulling ? 1 : 0;
+		ubo.coneCulling = mInput._ConeCulling ? 1 : 0;
+
+		const DrawCommand resetCommand = { 0, 1, 0, 0, 0, 0, { 0, 0 } };
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		if (mUploadedAsset != &asset || mUploadedVertexBuffer != mVertexBuffer.get()) {
+			batch->uploadStaticBuffer(mVertexBuffer.get(), asset.geometry.vertices.constData());
+			batch->uploadStaticBuffer(mMeshletBuffer.get(), asset.meshlets.meshlets.constData());
+			batch->uploadStaticBuffer(mSourceIndexBuffer.get(), asset.meshlets.indices.constData());
+			mUploadedAsset = &asset;
+			mUploadedVertexBuffer = mVertexBuffer.get();
+		}
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		batch->uploadStaticBuffer(mDrawCommandBuffer.get(), 0, sizeof(DrawCommand), &resetCommand);
+
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mCullPipeline.get());
+		cmdBuffer->setShaderResources(mCullBindings.get());
+		cmdBuffer->dispatch(ubo.meshletCount, 1, 1);							//ÿ鴦һ
+		QRhiResourceUpdateBatch* readbackBatch = mRhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(mDrawCommandBuffer.get(), 0, sizeof(DrawCommand), &mReadback);
+		cmdBuffer->endComputePass(readbackBatch);
+
+		QRhiVulkanNativeHandles* vkHandles = (QRhiVulkanNativeHandles*)mRhi->nativeHandles();
+		QVulkanDeviceFunctions* vkDevFunc = vkHandles->inst->deviceFunctions(vkHandles->dev);
+
+		// ӲѹQRhiԴ׷٣Ҫֶ
+		cmdBuffer->beginExternal();
+		insertBarrier(vkDevFunc, cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+		cmdBuffer->endExternal();
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, nullptr, QRhiCommandBuffer::ExternalContent);
+		cmdBuffer->beginExternal();
+		const VkCommandBuffer vkCmdBuffer = ((QRhiVulkanCommandBufferNativeHandles*)cmdBuffer->nativeHandles())->commandBuffer;
+		vkDevFunc->vkCmdBindPipeline(vkCmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ((QVkGraphicsPipeline*)mDrawPipeline.get())->pipeline);
+		QRhiHelper::setShaderResources(mDrawPipeline.get(), cmdBuffer, mDrawBindings.get());
+		const VkViewport viewport = { 0, 0, float(mRenderTarget->pixelSize().width()), float(mRenderTarget->pixelSize().height()), 0.0f, 1.0f };
+		const VkRect2D scissor = { { 0, 0 }, { quint32(mRenderTarget->pixelSize().width()), quint32(mRenderTarget->pixelSize().height()) } };
+		vkDevFunc->vkCmdSetViewport(vkCmdBuffer, 0, 1, &viewport);
+		vkDevFunc->vkCmdSetScissor(vkCmdBuffer, 0, 1, &scissor);
+		const VkBuffer vertexBuffer = *(VkBuffer*)mVertexBuffer->nativeBuffer().objects[0];
+		const VkDeviceSize vertexOffset = 0;
+		vkDevFunc->vkCmdBindVertexBuffers(vkCmdBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+		vkDevFunc->vkCmdBindIndexBuffer(vkCmdBuffer, *(VkBuffer*)mCompactIndexBuffer->nativeBuffer().objects[0], 0, VK_INDEX_TYPE_UINT32);
+		vkDevFunc->vkCmdDrawIndexedIndirect(vkCmdBuffer, *(VkBuffer*)mDrawCommandBuffer->nativeBuffer().objects[0], 0, 1, sizeof(DrawCommand));
+		cmdBuffer->endExternal();
+		cmdBuffer->endPass();
+
+		// һ֡ļɫḲǼӲҪȱ֡Ļƶȡ
+		cmdBuffer->beginExternal();
+		insertBarrier(vkDevFunc, cmdBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0);
+		cmdBuffer->endExternal();
+	}
+private:
+	static void insertBarrier(QVulkanDeviceFunctions* vkDevFunc, QRhiCommandBuffer* cmdBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+		const VkCommandBuffer vkCmdBuffer = ((QRhiVulkanCommandBufferNativeHandles*)cmdBuffer->nativeHandles())->commandBuffer;
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		vkDevFunc->vkCmdPipelineBarrier(vkCmdBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+};
+
+// ڵCPUԼ죺ÿ㶥/ޣǡóһΣΧ뷨׶Ǵȫ
+static int runMeshletCheck(const QString& path) {
+	QString error;
+	const QMeshGeometry geometry = QMeshGeometry::loadGltf(path, &error);
+	if (geometry.vertices.isEmpty()) {
+		qWarning() << "[MeshletCheck]" << error;
+		return 1;
+	}
+	const QMeshletSet set = QMeshletSet::build(geometry);
+	int limitFailures = 0;
+	int boundsFailures = 0;
+	int coneFailures = 0;
+	int cullableClusters = 0;
+	QHash<QByteArray, int> triangleUsage;
+	auto triangleKey = [](const quint32* tri) {
+		quint32 sorted[3] = { tri[0], tri[1], tri[2] };
+		std::rotate(sorted, std::min_element(sorted, sorted + 3), sorted + 3);		//ֻת
+		return QByteArray(reinterpret_cast<const char*>(sorted), sizeof(sorted));
+	};
+	for (int i = 0; i < geometry.indices.size(); i += 3)
+		triangleUsage[triangleKey(geometry.indices.constData() + i)]++;
+	for (const QMeshlet& meshlet : set.meshlets) {
+		QSet<quint32> uniqueVertices;
+		for (quint32 i = 0; i < meshlet.indexCount; i++)
+			uniqueVertices.insert(set.indices[meshlet.indexOffset + i]);
+		if (uniqueVertices.size() > QMeshletSet::MaxVertices || int(meshlet.vertexCount) != uniqueVertices.size() || meshlet.indexCount > QMeshletSet::MaxTriangles * 3)
+			limitFailures++;
+		const QVector3D center = meshlet.sphere.toVector3D();
+		for (quint32 vertex : uniqueVertices) {
+			if ((geometry.vertices[vertex].position - center).length() > meshlet.sphere.w() * 1.0001f + 1e-5f) {
+				boundsFailures++;
+				break;
+			}
+		}
+		if (meshlet.cone.w() < 1.0f) {
+			cullableClusters++;
+			const float minDot = qSqrt(1.0f - meshlet.cone.w() * meshlet.cone.w());
+			for (quint32 i = 0; i < meshlet.indexCount; i += 3) {
+				const quint32* tri = set.indices.constData() + meshlet.indexOffset + i;
+				const QVector3D& p0 = geometry.vertices[tri[0]].position;
+				const QVector3D normal = QVector3D::crossProduct(geometry.vertices[tri[1]].position - p0, geometry.vertices[tri[2]].position - p0);
+				if (normal.lengthSquared() > 1e-12f && QVector3D::dotProduct(normal.normalized(), meshlet.cone.toVector3D()) < minDot - 1e-4f) {
+					coneFailures++;
+					break;
+				}
+			}
+		}
+		for (quint32 i = 0; i < meshlet.indexCount; i += 3)
+			triangleUsage[triangleKey(set.indices.constData() + meshlet.indexOffset + i)]--;
+	}
+	int coverageFailures = 0;
+	for (int usage : triangleUsage)
+		coverageFailures += usage != 0 ? 1 : 0;
+	const bool passed = limitFailures == 0 && boundsFailures == 0 && coneFailures == 0 && coverageFailures == 0;
+	qDebug().noquote() << QString("[MeshletCheck] %1 meshlets for %2 triangles (%3 tris/meshlet avg), %4 back-face cullable")
+		.arg(set.meshlets.size())
+		.arg(set.triangleCount())
+		.arg(set.triangleCount() / double(qMax(1, set.meshlets.size())), 0, 'f', 1)
+		.arg(cullableClusters);
+	qDebug().noquote() << QString("[MeshletCheck] limit failures %1, bounds failures %2, cone failures %3, triangle coverage failures %4: %5")
+		.arg(limitFailures)
+		.arg(boundsFailures)
+		.arg(coneFailures)
+		.arg(coverageFailures)
+		.arg(passed ? "ok" : "FAILED");
+	return passed ? 0 : 1;
+}
+
+// 棬ֱӶԱȵŻǰĻ붥㻺С
+static int runOptimizeReport(const QString& path) {
+	QString error;
+	QMeshGeometry geometry = QMeshGeometry::loadGltf(path, &error);
+	if (geometry.vertices.isEmpty()) {
+		qWarning() << "[MeshOptimize]" << error;
+		return 1;
+	}
+	QElapsedTimer timer;
+	timer.start();
+	QMeshOptimizer::Report report = QMeshOptimizer::optimize(geometry);
+	const qint64 optimizeMs = timer.elapsed();
+	QVector3D offset;
+	QVector3D scale;
+	report.quantizedVertexBytes = QQuantizedVertex::quantize(geometry.vertices, &offset, &scale).size() * sizeof(QQuantizedVertex);
+	qDebug().noquote() << QString("[MeshOptimize] %1 triangles, %2 submeshes optimized in %3 ms").arg(geometry.triangleCount()).arg(geometry.submeshes.size()).arg(optimizeMs);
+	qDebug().noquote() << "[MeshOptimize]" << report.toString();
+	return 0;
+}
+
+// ڵCPUԼ죺ͬһνһ£ÿݼЧʲ䣻
+// ԭʼаԶͨιUV/ߵ򻯺βܿԽ˵ӷ챻Ĩƽ
+static int runSimplifyCheck(const QString& path) {
+	QString error;
+	const QMeshGeometry geometry = QMeshGeometry::loadGltf(path, &error);
+	if (geometry.vertices.isEmpty()) {
+		qWarning() << "[SimplifyCheck]" << error;
+		return 1;
+	}
+	QVector<quint32> island(geometry.vertices.size());
+	std::iota(island.begin(), island.end(), 0u);
+	auto findIsland = [&island](quint32 vertex) {
+		while (island[vertex] != vertex)
+			vertex = island[vertex] = island[island[vertex]];
+		return vertex;
+	};
+	for (int i = 0; i < geometry.indices.size(); i += 3) {
+		island[findIsland(geometry.indices[i + 1])] = findIsland(geometry.indices[i]);
+		island[findIsland(geometry.indices[i + 2])] = findIsland(geometry.indices[i]);
+	}
+	const QMeshLodChain first = QMeshLodChain::build(geometry);
+	const QMeshLodChain second = QMeshLodChain::build(geometry);
+	bool passed = first.hash() == second.hash();
+	qDebug().noquote() << QString("[SimplifyCheck] deterministic: %1 (%2)").arg(passed ? "yes" : "no").arg(QString(first.hash()));
+	for (int lod = 0; lod < QMeshLodChain::LodCount; lod++) {
+		const QMeshLodChain::Level& level = first.levels[lod];
+		bool valid = lod == 0 || level.triangleCount <= first.levels[lod - 1].triangleCount;
+		int seamFailures = 0;
+		for (int submeshIndex = 0; submeshIndex < level.submeshes.size(); submeshIndex++) {
+			const QMeshGeometry::Submesh& submesh = level.submeshes[submeshIndex];
+			valid &= submesh.materialIndex == geometry.submeshes[submeshIndex].materialIndex;
+			for (quint32 i = 0; i < submesh.indexCount; i++)
+				valid &= first.indices[submesh.indexOffset + i] < quint32(geometry.vertices.size());
+			if (!valid)
+				continue;
+			for (quint32 i = 0; i < submesh.indexCount; i += 3) {
+				const quint32* tri = first.indices.constData() + submesh.indexOffset + i;
+				if (findIsland(tri[0]) != findIsland(tri[1]) || findIsland(tri[0]) != findIsland(tri[2]))
+					seamFailures++;
+			}
+		}
+		valid &= seamFailures == 0;
+		passed &= valid;
+		qDebug().noquote() << QString("[SimplifyCheck] LOD%1: %2 triangles (target ratio %3), error %4, %5 triangles across attribute seams, %6")
+			.arg(lod)
+			.arg(level.triangleCount)
+			.arg(QMeshLodChain::LodRatios[lod])
+			.arg(level.error, 0, 'g', 4)
+			.arg(seamFailures)
+			.arg(valid ? "ok" : "INVALID");
+	}
+	return passed ? 0 : 1;
+}
 
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(float, LodBias) = 1.0f;
+	Q_PROPERTY_VAR(float, LodHysteresis) = 0.15f;
+	Q_PROPERTY_VAR(int, ForcedLod) = -1;
+	Q_PROPERTY_VAR(bool, MeshletCulling) = false;
+	Q_PROPERTY_VAR(bool, FrustumCulling) = true;
+	Q_PROPERTY_VAR(bool, ConeCulling) = true;
+
+	Q_CLASSINFO("LodBias", "Min=0.1,Max=4")
+	Q_CLASSINFO("LodHysteresis", "Min=0,Max=0.5")
+	Q_CLASSINFO("ForcedLod", "Min=-1,Max=3")
 private:
-	QStaticMeshRenderComponent mStaticComp;
-	QSharedPointer<QStaticMesh> StaitcMeshAsyncLoader;
+	QLodMeshComponent mLodComp;
+	QSharedPointer<QLodMeshAsset> mLodAssetAsyncLoader;
 	QSharedPointer<QMeshPassBuilder> mMeshPass{ new QMeshPassBuilder };
+	QSharedPointer<QMeshletCullingPassBuilder> mMeshletPass{ new QMeshletCullingPassBuilder };
+	int mReportFrameCount = 0;
+	qint64 mReportTriangles = 0;
+	qint64 mReportVisibleClusters = 0;
+	int mReportLodSwitches = 0;
+	int mLastLod = 0;
+	float mLastCoverage = 0.0f;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
-		QFuture future = QtConcurrent::run([this]() {
-			StaitcMeshAsyncLoader = QStaticMesh::CreateFromFile("Resources/Model/mandalorian_ship/scene.gltf");
+		const bool quantizeVertices = QCoreApplication::arguments().contains("--quantize-vertices");
+		QFuture future = QtConcurrent::run([this, quantizeVertices]() {
+			mLodAssetAsyncLoader = QLodMeshAsset::load("Resources/Model/mandalorian_ship/scene.gltf", quantizeVertices);
 		});
 		future.then(this, [this]() {			// thisΪ߳лContextص߳н
-			mStaticComp.setStaticMesh(StaitcMeshAsyncLoader);
+			if (mLodAssetAsyncLoader.isNull())
+				return;
+			mLodComp.setAsset(mLodAssetAsyncLoader);
+			addComponent(&mLodComp);
+			setCurrentObject(&mLodComp);
 		});
-		
-		mStaticComp.setRotation(QVector3D(-90, 0, 0));
-
-		addComponent(&mStaticComp);
 
-		setCurrentObject(&mStaticComp);
+		mLodComp.setRotation(QVector3D(-90, 0, 0));
 
 		getCamera()->setPosition(QVector3D(20, 15, 12));
 		getCamera()->setRotation(QVector3D(-30, 145, 0));
 	}
+private:
+	void reportMeshStats(bool meshletCulling) {
+		static const int FramesPerReport = 240;
+		if (meshletCulling) {
+			const QMeshletCullingPassBuilder::Stats& stats = mMeshletPass->getStats();		//ضһ֡ӳ
+			mReportTriangles += stats.visibleTriangles;
+			mReportVisibleClusters += stats.visibleClusters;
+		}
+		else {
+			mReportTriangles += mLodComp.getDrawnTriangleCount();
+		}
+		if (mLodComp.getLod() != mLastLod) {
+			mReportLodSwitches++;
+			mLastLod = mLodComp.getLod();
+		}
+		if (++mReportFrameCount < FramesPerReport || mLodComp.getAsset().isNull())
+			return;
+		if (meshletCulling) {
+			const QMeshletCullingPassBuilder::Stats& stats = mMeshletPass->getStats();
+			qDebug().noquote() << QString("[Meshlet] %1 of %2 clusters visible, %3 of %4 triangles drawn per frame (frustum culling %5, cone culling %6)")
+				.arg(mReportVisibleClusters / FramesPerReport)
+				.arg(stats.totalClusters)
+				.arg(mReportTriangles / FramesPerReport)
+				.arg(stats.totalTriangles)
+				.arg(FrustumCulling ? "on" : "off")
+				.arg(ConeCulling ? "on" : "off");
+		}
+		else {
+			qDebug().noquote() << QString("[MeshLod] LOD%1 at %2 screen coverage: %3 of %4 triangles drawn per frame, %5 LOD switches")
+				.arg(mLodComp.getLod())
+				.arg(mLastCoverage, 0, 'f', 3)
+				.arg(mReportTriangles / FramesPerReport)
+				.arg(mLodComp.getAsset()->geometry.triangleCount())
+				.arg(mReportLodSwitches);
+		}
+		mReportFrameCount = mReportLodSwitches = 0;
+		mReportTriangles = mReportVisibleClusters = 0;
+	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		mLastCoverage = mLodComp.updateLod(getCamera()->getViewMatrix(), getCamera()->getProjectionMatrix(), LodBias, LodHysteresis, ForcedLod);
+
+		const bool meshletCulling = MeshletCulling && !mLodComp.getAsset().isNull();
+		mLodComp.setDrawEnabled(!meshletCulling);
+
 		QMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder("MeshPass", mMeshPass);
 
+		QRhiTextureRef sceneColor = meshOut.BaseColor;
+		if (meshletCulling) {
+			QMeshletCullingPassBuilder::Output meshletOut
+				= graphBuilder.addPassBuilder("MeshletCullingPass", mMeshletPass)
+				.setSceneColor(meshOut.BaseColor)
+				.setMesh(&mLodComp)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setCameraPosition(getCamera()->getPosition())
+				.setFrustumCulling(FrustumCulling)
+				.setConeCulling(ConeCulling);
+			sceneColor = meshletOut.BaseColor;
+		}
+
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(meshOut.BaseColor);
+			.setInitialTexture(sceneColor);
+
+		graphBuilder.addPass([this, meshletCulling](QRhiCommandBuffer* cmdBuffer) {
+			reportMeshStats(meshletCulling);
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--mesh-optimize-report"))
+		return runOptimizeReport("Resources/Model/mandalorian_ship/scene.gltf");
+	if (app.arguments().contains("--simplify-check"))
+		return runSimplifyCheck("Resources/Model/mandalorian_ship/scene.gltf");
+	if (app.arguments().contains("--meshlet-check"))
+		return runMeshletCheck("Resources/Model/mandalorian_ship/scene.gltf");
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
+
+#include "main.moc"
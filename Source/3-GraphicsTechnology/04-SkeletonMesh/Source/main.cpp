@@ -1,42 +1,1280 @@
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
 #include "QtConcurrent/qtconcurrentrun.h"
+#include "QtConcurrent/qtconcurrentmap.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include "Render/IRenderComponent.h"
 #include "Render/Component/QSkeletalMeshRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
-#include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
+#include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
+#include "QFrameTimeBenchmark.h"
+#include "QMotionVectorPassBuilder.h"
+
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+// 程序化生成的蒙皮网格：沿Y轴的圆管，由一条骨骼链驱动，每个顶点受相邻两根骨骼影响
+struct QSkinnedTubeMesh {
+	static const int BoneCount = 8;
+	static const int RingsPerBone = 4;
+	static const int Slices = 16;
+	static constexpr float BoneLength = 20.0f;
+	static constexpr float Radius = 8.0f;
+
+	struct RestVertex {
+		QVector4D position;
+		QVector4D normal;
+		QVector4D boneIndices;								//GLSL中转换为int
+		QVector4D boneWeights;
+	};
+	QVector<RestVertex> vertices;
+	QVector<quint32> indices;
+	QMatrix4x4 inverseBindPose[BoneCount];
+
+	static const QSkinnedTubeMesh& instance() {
+		static QSkinnedTubeMesh mesh = build();
+		return mesh;
+	}
+private:
+	static QSkinnedTubeMesh build() {
+		QSkinnedTubeMesh mesh;
+		const int ringCount = BoneCount * RingsPerBone + 1;
+		for (int ring = 0; ring < ringCount; ring++) {
+			const float height = ring * BoneLength / RingsPerBone;
+			const float bonePosition = qBound(0.0f, height / BoneLength - 0.5f, BoneCount - 1.0f);		//骨骼中点处权重为1，两根骨骼之间线性过渡
+			const int bone0 = qMin(int(bonePosition), BoneCount - 1);
+			const int bone1 = qMin(bone0 + 1, BoneCount - 1);
+			const float blend = bonePosition - bone0;
+			for (int slice = 0; slice < Slices; slice++) {
+				const float angle = slice * 2.0f * M_PI / Slices;
+				RestVertex vertex;
+				vertex.position = QVector4D(qCos(angle) * Radius, height, qSin(angle) * Radius, 1.0f);
+				vertex.normal = QVector4D(qCos(angle), 0.0f, qSin(angle), 0.0f);
+				vertex.boneIndices = QVector4D(bone0, bone1, 0.0f, 0.0f);
+				vertex.boneWeights = QVector4D(1.0f - blend, blend, 0.0f, 0.0f);
+				mesh.vertices << vertex;
+			}
+		}
+		for (int ring = 0; ring + 1 < ringCount; ring++) {
+			for (int slice = 0; slice < Slices; slice++) {
+				const quint32 a = ring * Slices + slice;
+				const quint32 b = ring * Slices + (slice + 1) % Slices;
+				const quint32 c = a + Slices;
+				const quint32 d = b + Slices;
+				mesh.indices << a << c << b << b << c << d;
+			}
+		}
+		for (int i = 0; i < BoneCount; i++) {
+			mesh.inverseBindPose[i].translate(0.0f, -i * BoneLength, 0.0f);
+		}
+		return mesh;
+	}
+};
+
+// 关键帧按SoA存储：[key][channel][bone]，同一通道的骨骼连续存放，一次可以处理4根骨骼
+struct QAnimationClip {
+	static const int ChannelCount = 7;						//qx qy qz qw tx ty tz
+	static const int BoneCount = QSkinnedTubeMesh::BoneCount;
+	int keyCount = 0;
+	float sampleRate = 30.0f;
+	QVector<float> keys;
+	QVector<qint16> quantizedKeys;							//与keys布局相同，每个通道按自身的值域量化到16位
+	QVector<float> dequantizeScale;							//[channel][bone]，解码：value = quantized * scale + bias
+	QVector<float> dequantizeBias;
+
+	float duration() const { return (keyCount - 1) / sampleRate; }
+	int byteSize(bool quantized) const {
+		if (quantized)
+			return quantizedKeys.size() * sizeof(qint16) + (dequantizeScale.size() + dequantizeBias.size()) * sizeof(float);
+		return keys.size() * sizeof(float);
+	}
+
+	// 把程序化的摆动烘焙成循环的关键帧动画，首尾两帧相同
+	static QAnimationClip bakeSway(float phase, int keyCount = 61, float sampleRate = 30.0f) {
+		QAnimationClip clip;
+		clip.keyCount = keyCount;
+		clip.sampleRate = sampleRate;
+		clip.keys.resize(keyCount * ChannelCount * BoneCount);
+		const float omega = 2.0f * M_PI / clip.duration();
+		QQuaternion previous[BoneCount];
+		for (int key = 0; key < keyCount; key++) {
+			const float time = key / sampleRate;
+			float* channels = clip.keys.data() + key * ChannelCount * BoneCount;
+			for (int i = 0; i < BoneCount; i++) {
+				QQuaternion rotation = QQuaternion::fromAxisAndAngle(0.0f, 0.0f, 1.0f, 18.0f * qSin(omega * time + phase + i * 0.6f))
+					* QQuaternion::fromAxisAndAngle(1.0f, 0.0f, 0.0f, 10.0f * qSin(omega * time + phase * 0.5f + i * 0.9f));
+				if (key > 0 && QQuaternion::dotProduct(rotation, previous[i]) < 0.0f)		//保证相邻关键帧在同一半球，才能直接线性插值
+					rotation = -rotation;
+				previous[i] = rotation;
+				channels[0 * BoneCount + i] = rotation.x();
+				channels[1 * BoneCount + i] = rotation.y();
+				channels[2 * BoneCount + i] = rotation.z();
+				channels[3 * BoneCount + i] = rotation.scalar();
+				channels[4 * BoneCount + i] = 0.0f;
+				channels[5 * BoneCount + i] = i > 0 ? QSkinnedTubeMesh::BoneLength : 0.0f;
+				channels[6 * BoneCount + i] = 0.0f;
+			}
+		}
+		clip.quantize();
+		return clip;
+	}
+	void quantize() {
+		const int stride = ChannelCount * BoneCount;
+		quantizedKeys.resize(keys.size());
+		dequantizeScale.resize(stride);
+		dequantizeBias.resize(stride);
+		for (int channel = 0; channel < stride; channel++) {
+			float minValue = FLT_MAX;
+			float maxValue = -FLT_MAX;
+			for (int key = 0; key < keyCount; key++) {
+				minValue = qMin(minValue, keys[key * stride + channel]);
+				maxValue = qMax(maxValue, keys[key * stride + channel]);
+			}
+			const float extent = maxValue - minValue;
+			dequantizeScale[channel] = extent / 65535.0f;
+			dequantizeBias[channel] = minValue + 32768.0f * dequantizeScale[channel];
+			for (int key = 0; key < keyCount; key++) {
+				const float normalized = extent > 0.0f ? (keys[key * stride + channel] - minValue) / extent : 0.0f;
+				quantizedKeys[key * stride + channel] = qint16(qBound(-32768, qRound(normalized * 65535.0f) - 32768, 32767));
+			}
+		}
+	}
+};
+
+struct QLocalPose {
+	alignas(16) float channels[QAnimationClip::ChannelCount][QAnimationClip::BoneCount];
+};
+static_assert(QAnimationClip::BoneCount % 4 == 0, "SoA sampling processes bones in groups of 4");
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+class QAnimationSystem {
+public:
+	struct Request {
+		int clip = 0;
+		float time = 0.0f;
+		int activeBones = QAnimationClip::BoneCount;		//只采样前activeBones根骨骼（4的倍数），其余保持绑定姿势
+		float blend = 1.0f;									//在上一次与本次采样的姿势之间混合，1表示直接使用本次采样
+	};
+	struct Settings {
+		bool quantized = false;
+		bool simd = true;
+		bool multithreaded = true;
+	};
+	static const int PaletteStride = 5;
+	static const int PaletteSize = QAnimationClip::BoneCount * PaletteStride;
+	// 最近两次采样的调色板和混合系数，混合在蒙皮计算着色器中完成，降频角色在两次采样之间没有CPU开销
+	struct Pose {
+		QVector<QVector4D> palette;							//最近一次采样，布局与 QSkinnedCharacterComponent::PaletteStride 一致
+		QVector<QVector4D> previousPalette;					//上一次采样，只在 blend < 1 时有效
+		quint64 revision = 0;
+		quint64 previousRevision = 0;
+		float blend = 1.0f;
+	};
+	// 每个角色最近两次采样得到的调色板，只由负责该角色的工作线程读写
+	struct Keyframes {
+		QVector4D palettes[2][PaletteSize];
+		quint64 revisions[2] = { 0, 0 };
+		int latest = 0;
+	};
+	static const int ChunkSize = 16;						//每个任务处理的骨架数，避免任务粒度过细
+
+	void setClips(const QVector<QAnimationClip>& clips) { mClips = clips; }
+	const QVector<QAnimationClip>& getClips() const { return mClips; }
+
+	// 在线程池中把姿势计算到后台缓冲，渲染线程不等待
+	void beginEvaluate(const QVector<Request>& requests, const Settings& settings) {
+		mFuture.waitForFinished();
+		mRequests = requests;
+		mSettings = settings;
+		mPoses[1 - mFront].resize(requests.size());
+		mKeyframes.resize(requests.size());
+		mChunks.clear();
+		for (int first = 0; first < requests.size(); first += ChunkSize)
+			mChunks << first;
+		mEvaluateNanoseconds = 0;
+		mEvaluatedCount = 0;
+		mBlendedCount = 0;
+		auto job = [this](int first) {
+			QElapsedTimer timer;
+			timer.start();
+			int blended = 0;
+			const int count = evaluateRange(mClips, mRequests, mSettings, mKeyframes, mPoses[1 - mFront], first, qMin(first + ChunkSize, int(mRequests.size())), false, &blended);
+			mEvaluatedCount += count;
+			mBlendedCount += blended;
+			mEvaluateNanoseconds += timer.nsecsElapsed();
+		};
+		if (settings.multithreaded) {
+			mFuture = QtConcurrent::map(mChunks, job);
+		}
+		else {
+			for (int first : mChunks)
+				job(first);
+			mFuture = QFuture<void>();
+		}
+		mPending = true;
+	}
+
+	// 等待后台计算完成并交换前后台缓冲，返回渲染线程的等待时间（ms）
+	double sync() {
+		QElapsedTimer timer;
+		timer.start();
+		mFuture.waitForFinished();
+		if (mPending) {
+			mFront = 1 - mFront;
+			mPending = false;
+		}
+		return timer.nsecsElapsed() / 1e6;
+	}
+	const Pose* getPose(int index) const {
+		const QVector<Pose>& front = mPoses[mFront];
+		return index < front.size() ? &front[index] : nullptr;
+	}
+	double getLastEvaluateCpuMs() const { return mEvaluateNanoseconds / 1e6; }		//所有工作线程耗时之和
+	int getLastEvaluatedCount() const { return mEvaluatedCount; }					//采样动画轨道的角色数
+	int getLastBlendedCount() const { return mBlendedCount; }						//需要在GPU上混合两次采样的角色数
+
+	static quint64 poseRevision(const Request& request, const Settings& settings) {		//同一片段同一时刻的姿势相同，不需要重复计算
+		quint32 timeBits;
+		memcpy(&timeBits, &request.time, sizeof(timeBits));
+		return (quint64(settings.quantized) << 63 | quint64(request.activeBones) << 48 | quint64(request.clip) << 32 | timeBits) + 1;
+	}
+
+	// 采样时间变化才重新采样轨道并生成调色板，结果轮换进Keyframes，这部分开销计入 evaluated 并由预算限制；
+	// blend < 1 时只记录前后两次采样和混合系数，混合交给蒙皮计算着色器，两次采样之间的帧只有拷贝判断
+	static int evaluateRange(const QVector<QAnimationClip>& clips, const QVector<Request>& requests, const Settings& settings, QVector<Keyframes>& keyframes, QVector<Pose>& poses, int first, int last, bool force, int* blendedCount = nullptr) {
+		int evaluated = 0;
+		QLocalPose sampledPose;
+		for (int i = first; i < last; i++) {
+			const Request& request = requests[i];
+			Keyframes& keys = keyframes[i];
+			const quint64 sampleRevision = poseRevision(request, settings);
+			if (force || keys.revisions[keys.latest] != sampleRevision) {
+				keys.latest = 1 - keys.latest;
+				sampleClip(clips[request.clip], request.time, request.activeBones, settings, sampledPose);
+				buildPalette(sampledPose, keys.palettes[keys.latest]);
+				keys.revisions[keys.latest] = sampleRevision;
+				evaluated++;
+			}
+			const quint64 previousRevision = keys.revisions[1 - keys.latest];
+			const bool blending = request.blend < 1.0f && previousRevision != 0;
+			Pose& pose = poses[i];
+			if (force || pose.revision != sampleRevision) {				//双缓冲的另一半可能落后两次采样，只在采样变化后拷贝
+				pose.palette.resize(PaletteSize);
+				memcpy(pose.palette.data(), keys.palettes[keys.latest], sizeof(QVector4D) * PaletteSize);
+				pose.revision = sampleRevision;
+			}
+			if (blending && (force || pose.previousRevision != previousRevision)) {
+				pose.previousPalette.resize(PaletteSize);
+				memcpy(pose.previousPalette.data(), keys.palettes[1 - keys.latest], sizeof(QVector4D) * PaletteSize);
+				pose.previousRevision = previousRevision;
+			}
+			pose.blend = blending ? request.blend : 1.0f;
+			if (blending && blendedCount != nullptr)
+				(*blendedCount)++;
+		}
+		return evaluated;
+	}
+
+	static void sampleClip(const QAnimationClip& clip, float time, int activeBones, const Settings& settings, QLocalPose& pose) {
+		const int BoneCount = QAnimationClip::BoneCount;
+		activeBones = qBound(0, activeBones, BoneCount);
+		const int stride = QAnimationClip::ChannelCount * BoneCount;
+		const float keyPosition = std::fmod(qMax(time, 0.0f), clip.duration()) * clip.sampleRate;
+		const int key0 = qMin(int(keyPosition), clip.keyCount - 2);
+		const float alpha = keyPosition - key0;
+#ifdef ANIMATION_USE_SSE2
+		if (settings.simd) {
+			const __m128 alphaV = _mm_set1_ps(alpha);
+			for (int bone = 0; bone < activeBones; bone += 4) {
+				__m128 channels[QAnimationClip::ChannelCount];
+				for (int c = 0; c < QAnimationClip::ChannelCount; c++) {
+					const int index = key0 * stride + c * BoneCount + bone;
+					__m128 a, b;
+					if (settings.quantized) {
+						const __m128 scale = _mm_loadu_ps(clip.dequantizeScale.constData() + c * BoneCount + bone);
+						const __m128 bias = _mm_loadu_ps(clip.dequantizeBias.constData() + c * BoneCount + bone);
+						a = _mm_add_ps(_mm_mul_ps(loadQuantized(clip.quantizedKeys.constData() + index), scale), bias);
+						b = _mm_add_ps(_mm_mul_ps(loadQuantized(clip.quantizedKeys.constData() + index + stride), scale), bias);
+					}
+					else {
+						a = _mm_loadu_ps(clip.keys.constData() + index);
+						b = _mm_loadu_ps(clip.keys.constData() + index + stride);
+					}
+					channels[c] = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), alphaV));
+				}
+				__m128 lengthSquared = _mm_mul_ps(channels[0], channels[0]);
+				for (int c = 1; c < 4; c++)
+					lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(channels[c], channels[c]));
+				const __m128 inverseLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared));
+				for (int c = 0; c < 4; c++)
+					channels[c] = _mm_mul_ps(channels[c], inverseLength);
+				for (int c = 0; c < QAnimationClip::ChannelCount; c++)
+					_mm_store_ps(pose.channels[c] + bone, channels[c]);
+			}
+			fillInactiveBones(clip, activeBones, pose);
+			return;
+		}
+#endif
+		for (int c = 0; c < QAnimationClip::ChannelCount; c++) {
+			for (int bone = 0; bone < activeBones; bone++) {
+				const int index = key0 * stride + c * BoneCount + bone;
+				float a, b;
+				if (settings.quantized) {
+					const float scale = clip.dequantizeScale[c * BoneCount + bone];
+					const float bias = clip.dequantizeBias[c * BoneCount + bone];
+					a = clip.quantizedKeys[index] * scale + bias;
+					b = clip.quantizedKeys[index + stride] * scale + bias;
+				}
+				else {
+					a = clip.keys[index];
+					b = clip.keys[index + stride];
+				}
+				pose.channels[c][bone] = a + (b - a) * alpha;
+			}
+		}
+		for (int bone = 0; bone < activeBones; bone++) {
+			const float inverseLength = 1.0f / qSqrt(pose.channels[0][bone] * pose.channels[0][bone] + pose.channels[1][bone] * pose.channels[1][bone]
+				+ pose.channels[2][bone] * pose.channels[2][bone] + pose.channels[3][bone] * pose.channels[3][bone]);
+			for (int c = 0; c < 4; c++)
+				pose.channels[c][bone] *= inverseLength;
+		}
+		fillInactiveBones(clip, activeBones, pose);
+	}
+	static void fillInactiveBones(const QAnimationClip& clip, int activeBones, QLocalPose& pose) {		//未采样的骨骼不旋转，平移取第一帧
+		for (int bone = activeBones; bone < QAnimationClip::BoneCount; bone++) {
+			pose.channels[0][bone] = pose.channels[1][bone] = pose.channels[2][bone] = 0.0f;
+			pose.channels[3][bone] = 1.0f;
+			for (int c = 4; c < QAnimationClip::ChannelCount; c++)
+				pose.channels[c][bone] = clip.keys[c * QAnimationClip::BoneCount + bone];
+		}
+	}
+
+	// 沿骨骼链累积出全局变换，再乘上绑定姿势的逆，同时输出矩阵和对偶四元数两种形式
+	static void buildPalette(const QLocalPose& pose, QVector4D* palette) {
+		const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+		QQuaternion parentRotation;
+		QVector3D parentTranslation;
+		for (int i = 0; i < QAnimationClip::BoneCount; i++) {
+			const QQuaternion localRotation(pose.channels[3][i], pose.channels[0][i], pose.channels[1][i], pose.channels[2][i]);
+			const QVector3D localTranslation(pose.channels[4][i], pose.channels[5][i], pose.channels[6][i]);
+			const QQuaternion rotation = parentRotation * localRotation;
+			const QVector3D translation = parentTranslation + parentRotation.rotatedVector(localTranslation);
+			const QVector3D skinTranslation = translation + rotation.rotatedVector(mesh.inverseBindPose[i].column(3).toVector3D());
+			const QMatrix3x3 skinRotation = rotation.toRotationMatrix();
+			QVector4D* bone = palette + i * PaletteStride;
+			for (int row = 0; row < 3; row++)
+				bone[row] = QVector4D(skinRotation(row, 0), skinRotation(row, 1), skinRotation(row, 2), skinTranslation[row]);
+			bone[3] = rotation.toVector4D();
+			bone[4] = (QQuaternion(0.0f, skinTranslation) * rotation * 0.5f).toVector4D();
+			parentRotation = rotation;
+			parentTranslation = translation;
+		}
+	}
+
+	// 纯CPU的吞吐量测试，不需要创建窗口和QRhi
+	static void runBenchmark() {
+		QVector<QAnimationClip> clips;
+		for (int i = 0; i < 4; i++)
+			clips << QAnimationClip::bakeSway(i * 1.7f);
+		float maxError = 0.0f;
+		const QAnimationClip& clip = clips.front();
+		for (int i = 0; i < clip.keys.size(); i++) {
+			const int channel = i % (QAnimationClip::ChannelCount * QAnimationClip::BoneCount);
+			maxError = qMax(maxError, qAbs(clip.quantizedKeys[i] * clip.dequantizeScale[channel] + clip.dequantizeBias[channel] - clip.keys[i]));
+		}
+		qDebug().noquote() << QString("[AnimationBenchmark] clip size: %1 bytes float, %2 bytes quantized, max error %3")
+			.arg(clip.byteSize(false))
+			.arg(clip.byteSize(true))
+			.arg(maxError, 0, 'g', 3);
+
+		for (int skeletonCount : { 100, 1000, 10000 }) {
+			QVector<Request> requests(skeletonCount);
+			for (int i = 0; i < skeletonCount; i++) {
+				requests[i].clip = i % clips.size();
+				requests[i].time = i * 0.013f;
+			}
+			QVector<int> chunks;
+			for (int first = 0; first < skeletonCount; first += ChunkSize)
+				chunks << first;
+			QVector<Pose> poses(skeletonCount);
+			QVector<Keyframes> keyframes(skeletonCount);
+			const int iterations = qMax(5, 200000 / skeletonCount);
+			for (int mode = 0; mode < 8; mode++) {
+				Settings settings;
+				settings.simd = mode & 1;
+				settings.quantized = mode & 2;
+				settings.multithreaded = mode & 4;
+				QElapsedTimer timer;
+				timer.start();
+				for (int iteration = 0; iteration < iterations; iteration++) {
+					for (Request& request : requests)
+						request.time += 1.0f / 60.0f;
+					if (settings.multithreaded) {
+						QtConcurrent::blockingMap(chunks, [&](int first) {
+							evaluateRange(clips, requests, settings, keyframes, poses, first, qMin(first + ChunkSize, skeletonCount), true);
+						});
+					}
+					else {
+						evaluateRange(clips, requests, settings, keyframes, poses, 0, skeletonCount, true);
+					}
+				}
+				const double msPerFrame = timer.nsecsElapsed() / 1e6 / iterations;
+				qDebug().noquote() << QString("[AnimationBenchmark] %1 skeletons, %2 %3 %4: %5 ms per frame, %6 skeletons/ms")
+					.arg(skeletonCount, 5)
+					.arg(settings.simd ? "simd  " : "scalar")
+					.arg(settings.quantized ? "quantized" : "float    ")
+					.arg(settings.multithreaded ? "thread pool" : "single     ")
+					.arg(msPerFrame, 0, 'f', 3)
+					.arg(skeletonCount / msPerFrame, 0, 'f', 0);
+			}
+		}
+	}
+private:
+#ifdef ANIMATION_USE_SSE2
+	static inline __m128 loadQuantized(const qint16* src) {		//4个int16符号扩展为int32再转为float
+		const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+		return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+	}
+#endif
+	QVector<QAnimationClip> mClips;
+	QVector<Request> mRequests;
+	Settings mSettings;
+	QVector<int> mChunks;
+	QVector<Pose> mPoses[2];								//双缓冲：工作线程写后台，渲染线程只读前台并上传
+	QVector<Keyframes> mKeyframes;
+	int mFront = 0;
+	bool mPending = false;
+	QFuture<void> mFuture;
+	std::atomic<qint64> mEvaluateNanoseconds{ 0 };
+	std::atomic<int> mEvaluatedCount{ 0 };
+	std::atomic<int> mBlendedCount{ 0 };
+};
+
+// 按屏幕占比选择动画LOD，并在每帧的预算内按优先级挑选需要更新的角色
+class QAnimationLodScheduler {
+public:
+	struct Lod {
+		float minScreenCoverage;							//包围球直径占屏幕高度的比例
+		int updateInterval;									//每隔多少帧采样一次，其间在前后两次采样之间混合
+		int activeBones;
+	};
+	static const int LodCount = 3;
+	static constexpr Lod Lods[LodCount] = {
+		{ 0.15f, 1, QAnimationClip::BoneCount },
+		{ 0.05f, 2, QAnimationClip::BoneCount },
+		{ 0.0f, 4, 4 },
+	};
+	struct Character {
+		QVector3D center;
+		float radius = 0.0f;
+		int clip = 0;
+		float time = 0.0f;									//本帧的动画时间
+		bool animated = true;
+		int lod = 0;
+		bool visible = true;
+		bool hasPose = false;
+		int framesSinceUpdate = 0;
+		float previousSampledTime = 0.0f;
+		float sampledTime = 0.0f;							//最近一次提交采样的动画时间
+		int activeBones = QAnimationClip::BoneCount;
+		float blend = 1.0f;
+	};
+	struct Stats {
+		int lodCounts[LodCount] = {};
+		int offscreen = 0;
+		int due = 0;
+		int scheduled = 0;
+		int deferred = 0;
+	};
+
+	// 开启插值时，降频角色按 updateInterval 提前采样到下次更新时的动画时间，其间各帧按经过的时间在上次与本次采样之间混合；
+	// 因预算被推迟而超过采样时间的角色保持最后一次采样的姿势
+	void setInterpolation(bool interpolate) { mInterpolate = interpolate; }
+
+	// 屏幕外的角色冻结姿势；到期的角色按 屏幕占比 * 过期程度 排序，超出 maxEvaluations 的推迟到之后的帧
+	// frameDelta 为每帧推进的动画时间，用于计算提前采样的时间
+	void schedule(QVector<Character>& characters, const QMatrix4x4& viewProjection, float projectionScaleY, float frameDelta, int maxEvaluations, QVector<QAnimationSystem::Request>& requests) {
+		mStats = Stats();
+		QVector4D planes[6];
+		for (int i = 0; i < 3; i++) {
+			planes[i * 2 + 0] = viewProjection.row(3) + viewProjection.row(i);
+			planes[i * 2 + 1] = viewProjection.row(3) - viewProjection.row(i);
+		}
+		for (QVector4D& plane : planes)
+			plane /= plane.toVector3D().length();
+
+		mCandidates.clear();
+		for (int i = 0; i < characters.size(); i++) {
+			Character& character = characters[i];
+			character.framesSinceUpdate++;
+			character.visible = true;
+			for (const QVector4D& plane : planes) {
+				if (QVector3D::dotProduct(plane.toVector3D(), character.center) + plane.w() < -character.radius) {
+					character.visible = false;
+					break;
+				}
+			}
+			if (!character.visible) {
+				mStats.offscreen++;
+				if (character.hasPose)
+					continue;
+			}
+			const float w = QVector4D::dotProduct(viewProjection.row(3), QVector4D(character.center, 1.0f));
+			const float coverage = character.radius * projectionScaleY / qMax(w, 1e-3f);
+			character.lod = LodCount - 1;
+			for (int lod = 0; lod < LodCount; lod++) {
+				if (coverage >= Lods[lod].minScreenCoverage) {
+					character.lod = lod;
+					break;
+				}
+			}
+			if (character.visible)
+				mStats.lodCounts[character.lod]++;
+			const Lod& lod = Lods[character.lod];
+			const bool lodChanged = character.activeBones != lod.activeBones;
+			if (character.hasPose && !lodChanged && (!character.animated || character.framesSinceUpdate < lod.updateInterval))
+				continue;
+			Candidate candidate;
+			candidate.index = i;
+			candidate.priority = character.hasPose ? coverage * character.framesSinceUpdate / lod.updateInterval : FLT_MAX;
+			mCandidates << candidate;
+		}
+		mStats.due = mCandidates.size();
+		if (mCandidates.size() > maxEvaluations) {
+			std::nth_element(mCandidates.begin(), mCandidates.begin() + maxEvaluations, mCandidates.end(), [](const Candidate& a, const Candidate& b) {
+				return a.priority > b.priority;
+			});
+			mCandidates.resize(maxEvaluations);
+		}
+		mStats.scheduled = mCandidates.size();
+		mStats.deferred = mStats.due - mStats.scheduled;
+		for (const Candidate& candidate : mCandidates) {
+			Character& character = characters[candidate.index];
+			const int interval = Lods[character.lod].updateInterval;
+			character.previousSampledTime = character.hasPose ? character.sampledTime : character.time;
+			character.sampledTime = character.time + (mInterpolate && character.animated ? (interval - 1) * frameDelta : 0.0f);
+			character.activeBones = Lods[character.lod].activeBones;
+			character.framesSinceUpdate = 0;
+			character.hasPose = true;
+		}
+
+		requests.resize(characters.size());
+		for (int i = 0; i < characters.size(); i++) {
+			Character& character = characters[i];
+			const float span = character.sampledTime - character.previousSampledTime;
+			character.blend = mInterpolate && span > 0.0f ? qBound(0.0f, (character.time - character.previousSampledTime) / span, 1.0f) : 1.0f;
+			requests[i].clip = character.clip;
+			requests[i].time = character.sampledTime;
+			requests[i].activeBones = character.activeBones;
+			requests[i].blend = character.blend;
+		}
+	}
+	const Stats& getStats() const { return mStats; }
+
+	// 确定性的CPU测试：固定相机和时间步长，比较不限制预算与LOD + 预算调度下的耗时随人群规模的变化
+	static void runBenchmark() {
+		QVector<QAnimationClip> clips;
+		for (int i = 0; i < 4; i++)
+			clips << QAnimationClip::bakeSway(i * 1.7f);
+		QMatrix4x4 view;
+		view.lookAt(QVector3D(0.0f, 170.0f, -300.0f), QVector3D(0.0f, 100.0f, 500.0f), QVector3D(0.0f, 1.0f, 0.0f));
+		QMatrix4x4 projection;
+		projection.perspective(60.0f, 16.0f / 9.0f, 1.0f, 20000.0f);
+		const QMatrix4x4 viewProjection = projection * view;
+		const int FrameCount = 60;
+		const int MaxEvaluations = 256;
+
+		for (int crowdSize : { 100, 1000, 10000, 50000 }) {
+			const int side = qCeil(qSqrt(crowdSize));
+			for (int scheduled = 0; scheduled < 2; scheduled++) {
+				QVector<Character> crowd(crowdSize);
+				for (int i = 0; i < crowdSize; i++) {
+					crowd[i].center = QVector3D(((i % side) - side * 0.5f) * 60.0f, 80.0f, (i / side) * 60.0f);
+					crowd[i].radius = 90.0f;
+					crowd[i].clip = i % clips.size();
+				}
+				QAnimationSystem system;
+				system.setClips(clips);
+				QAnimationLodScheduler scheduler;
+				QAnimationSystem::Settings settings;
+				settings.multithreaded = false;
+				QVector<QAnimationSystem::Request> requests;
+				qint64 evaluatedPoses = 0;
+				qint64 blendedPoses = 0;
+				QElapsedTimer timer;
+				timer.start();
+				for (int frame = 0; frame < FrameCount; frame++) {
+					for (int i = 0; i < crowdSize; i++)
+						crowd[i].time = i * 0.37f + frame / 60.0f;
+					if (scheduled) {
+						scheduler.schedule(crowd, viewProjection, projection(1, 1), 1.0f / 60.0f, MaxEvaluations, requests);
+					}
+					else {
+						requests.resize(crowdSize);
+						for (int i = 0; i < crowdSize; i++) {
+							requests[i].clip = crowd[i].clip;
+							requests[i].time = crowd[i].time;
+						}
+					}
+					system.beginEvaluate(requests, settings);
+					system.sync();
+					evaluatedPoses += system.getLastEvaluatedCount();
+					blendedPoses += system.getLastBlendedCount();
+				}
+				const Stats& stats = scheduler.getStats();
+				qDebug().noquote() << QString("[AnimationLodBenchmark] %1 characters, %2: %3 ms per frame, %4 sampled / %5 GPU-blended poses per frame, LOD %6/%7/%8, %9 offscreen, %10 deferred")
+					.arg(crowdSize, 5)
+					.arg(scheduled ? "lod + budget" : "full rate   ")
+					.arg(timer.nsecsElapsed() / 1e6 / FrameCount, 0, 'f', 3)
+					.arg(evaluatedPoses / double(FrameCount), 0, 'f', 1)
+					.arg(blendedPoses / double(FrameCount), 0, 'f', 1)
+					.arg(stats.lodCounts[0])
+					.arg(stats.lodCounts[1])
+					.arg(stats.lodCounts[2])
+					.arg(stats.offscreen)
+					.arg(stats.deferred);
+			}
+		}
+	}
+private:
+	struct Candidate {
+		int index;
+		float priority;
+	};
+	QVector<Candidate> mCandidates;
+	Stats mStats;
+	bool mInterpolate = true;
+};
+
+class QGpuSkinningPassBuilder;
+
+class QSkinnedCharacterComponent : public IRenderComponent {
+public:
+	// 每根骨骼在调色板中占5个vec4：3x4蒙皮矩阵的三行 + 对偶四元数的实部和对偶部
+	static const int PaletteStride = QAnimationSystem::PaletteStride;
+
+	// 世界矩阵取自组件变换，在 commitFrame 中每帧计算一次
+	const QMatrix4x4& getWorldMatrix() const { return mWorldMatrix; }
+	const QMatrix4x4& getPreviousWorldMatrix() const { return mPreviousWorldMatrix; }
+	void commitFrame() {											//每帧开始时调用，保留上一帧的矩阵用于运动矢量
+		mPreviousWorldMatrix = mWorldMatrix;
+		mWorldMatrix = calculateWorldMatrix();
+	}
+	void setSkinningSource(QGpuSkinningPassBuilder* source, int slot) {
+		mSkinningSource = source;
+		mSlot = slot;
+	}
+	void setPose(const QAnimationSystem::Pose* pose) {			//姿势由动画系统的前台缓冲提供，这里只保存引用
+		mPose = pose != nullptr && !pose->palette.isEmpty() ? pose : nullptr;
+	}
+	const QAnimationSystem::Pose* getPose() const { return mPose; }
+	QRhiBuffer* getIndexBuffer() const { return mIndexBuffer.get(); }
+private:
+	QScopedPointer<QRhiBuffer> mIndexBuffer;
+	QSharedPointer<QPrimitiveRenderProxy> mProxy;
+	QGpuSkinningPassBuilder* mSkinningSource = nullptr;
+	int mSlot = 0;
+	QMatrix4x4 mWorldMatrix;
+	QMatrix4x4 mPreviousWorldMatrix;
+	const QAnimationSystem::Pose* mPose = nullptr;
+protected:
+	void onRebuildResource() override;
+};
+
+class QGpuSkinningPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QGpuSkinningPassBuilder)
+		QRP_INPUT_ATTR(QVector<QSkinnedCharacterComponent*>, Characters);
+		QRP_INPUT_ATTR(bool, UseDualQuaternion);
+		QRP_INPUT_ATTR(bool, PreviousPositions);			//同时蒙皮出上一帧的位置，供运动矢量使用
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QGpuSkinningPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiBufferRef, SkinnedVertices)		//每个角色占 vertexCount * 48 字节：position(vec4) + normal(vec4) + previousPosition(vec4)
+	QRP_OUTPUT_END()
+public:
+	static const int SkinnedVertexStride = 12 * sizeof(float);
+	static const int PreviousPositionOffset = 8 * sizeof(float);
+	struct Stats {
+		int skinnedCharacters = 0;
+		int reusedCharacters = 0;
+		int skinnedVertices = 0;
+		int uploadedPalettes = 0;
+	};
+	static const int PaletteSlots = 3;						//每个角色在GPU上保留最近的3个调色板，混合的两端都能命中而不必重复上传
+private:
+	struct UniformBlock {
+		quint32 vertexCount;
+		quint32 boneCount;
+		quint32 useDualQuaternion;
+		quint32 padding;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mRestBuffer;
+	QRhiBufferRef mPaletteBuffer;
+	QRhiBufferRef mDirtyBuffer;
+	QRhiBufferRef mSkinnedBuffer;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiComputePipelineRef mPipeline;
+	QShader mSkinningCS;
+	struct SkinnedState {									//蒙皮缓存中的结果由哪两次采样、以什么系数混合而来
+		quint64 revision = 0;
+		quint64 previousRevision = 0;
+		float blend = 1.0f;
+		bool operator==(const SkinnedState& other) const { return revision == other.revision && previousRevision == other.previousRevision && blend == other.blend; }
+		bool operator!=(const SkinnedState& other) const { return !(*this == other); }
+	};
+	struct SlotRevisions {									//每个调色板槽位中存放的采样
+		quint64 revisions[PaletteSlots] = {};
+	};
+	int mCapacity = 0;
+	QRhiBuffer* mCachedBuffer = nullptr;					//缓冲重建后缓存内容失效
+	QVector<SkinnedState> mSkinnedStates;
+	QVector<SkinnedState> mSkinnedPreviousStates;			//蒙皮缓存中上一帧位置对应的姿势
+	QVector<SkinnedState> mLastStates;						//上一帧显示的姿势
+	QVector<SlotRevisions> mPaletteSlots;
+	bool mSkinnedWithDualQuaternion = false;
+	Stats mStats;
+public:
+	QGpuSkinningPassBuilder() {
+		mSkinningCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, QByteArray(R"(#version 450
+			layout (local_size_x = 64) in;
+			layout (binding = 0) uniform UniformBlock {
+				uvec4 params;									//x：顶点数 y：骨骼数 z：是否使用对偶四元数
+			}UBO;
+			layout (binding = 1, std430) readonly buffer RestBuffer {
+				vec4 restVertices[];
+			};
+			layout (binding = 2, std430) readonly buffer PaletteBuffer {
+				vec4 palette[];
+			};
+			layout (binding = 3, std430) readonly buffer DirtyBuffer {
+				uvec4 dirtyCharacters[];						//每个角色两项：本帧 x：角色 y：上一次采样的调色板槽位 z：最近一次采样的槽位 w：混合系数（float位）
+			};													//上一帧 xyz：同上 w：上一帧的姿势是否与本帧不同
+			layout (binding = 4, std430) writeonly buffer SkinnedBuffer {
+				vec4 skinnedVertices[];
+			};
+			void skin(uint paletteBase, vec3 position, vec3 normal, ivec4 bones, vec4 weights, out vec3 skinnedPosition, out vec3 skinnedNormal) {
+				skinnedPosition = vec3(0.0);
+				skinnedNormal = vec3(0.0);
+				if (UBO.params.z != 0) {
+					// 对偶四元数混合：避免线性混合在关节扭转处的体积塌陷
+					vec4 pivot = palette[(paletteBase + bones.x) * 5 + 3];
+					vec4 real = vec4(0.0);
+					vec4 dual = vec4(0.0);
+					for (int i = 0; i < 4; i++) {
+						vec4 boneReal = palette[(paletteBase + bones[i]) * 5 + 3];
+						vec4 boneDual = palette[(paletteBase + bones[i]) * 5 + 4];
+						float w = dot(boneReal, pivot) < 0.0 ? -weights[i] : weights[i];
+						real += boneReal * w;
+						dual += boneDual * w;
+					}
+					float len = length(real);
+					real /= len;
+					dual /= len;
+					skinnedPosition = position + 2.0 * cross(real.xyz, cross(real.xyz, position) + real.w * position)
+						+ 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+					skinnedNormal = normal + 2.0 * cross(real.xyz, cross(real.xyz, normal) + real.w * normal);
+				}
+				else {
+					for (int i = 0; i < 4; i++) {
+						uint bone = (paletteBase + bones[i]) * 5;
+						mat3x4 skin = mat3x4(palette[bone + 0], palette[bone + 1], palette[bone + 2]);
+						skinnedPosition += weights[i] * (vec4(position, 1.0) * skin);
+						skinnedNormal += weights[i] * (vec4(normal, 0.0) * skin);
+					}
+				}
+			}
+			// 蒙皮结果对调色板是线性的：线性混合蒙皮下等价于插值两组蒙皮矩阵；
+			// 对偶四元数下是近似，相邻两次采样的差别很小，看不出区别
+			void skinBlended(uint character, uint fromSlot, uint toSlot, float blend, vec3 position, vec3 normal, ivec4 bones, vec4 weights, out vec3 skinnedPosition, out vec3 skinnedNormal) {
+				skin((character * PALETTE_SLOTS + toSlot) * UBO.params.y, position, normal, bones, weights, skinnedPosition, skinnedNormal);
+				if (blend < 1.0) {
+					vec3 fromPosition, fromNormal;
+					skin((character * PALETTE_SLOTS + fromSlot) * UBO.params.y, position, normal, bones, weights, fromPosition, fromNormal);
+					skinnedPosition = mix(fromPosition, skinnedPosition, blend);
+					skinnedNormal = mix(fromNormal, skinnedNormal, blend);
+				}
+			}
+			void main() {
+				uint vertex = gl_GlobalInvocationID.x;
+				if (vertex >= UBO.params.x)
+					return;
+				uvec4 dirty = dirtyCharacters[gl_WorkGroupID.y * 2 + 0];
+				uvec4 previousFrame = dirtyCharacters[gl_WorkGroupID.y * 2 + 1];
+				uint character = dirty.x;
+				vec3 position = restVertices[vertex * 4 + 0].xyz;
+				vec3 normal = restVertices[vertex * 4 + 1].xyz;
+				ivec4 bones = ivec4(restVertices[vertex * 4 + 2]);
+				vec4 weights = restVertices[vertex * 4 + 3];
+				vec3 skinnedPosition, skinnedNormal;
+				skinBlended(character, dirty.y, dirty.z, uintBitsToFloat(dirty.w), position, normal, bones, weights, skinnedPosition, skinnedNormal);
+				vec3 previousPosition = skinnedPosition;
+				if (previousFrame.w != 0) {
+					vec3 previousNormal;
+					skinBlended(character, previousFrame.x, previousFrame.y, uintBitsToFloat(previousFrame.z), position, normal, bones, weights, previousPosition, previousNormal);
+				}
+				uint dst = (character * UBO.params.x + vertex) * 3;
+				skinnedVertices[dst + 0] = vec4(skinnedPosition, 1.0);
+				skinnedVertices[dst + 1] = vec4(normalize(skinnedNormal), 0.0);
+				skinnedVertices[dst + 2] = vec4(previousPosition, 1.0);
+			}
+		)").replace("PALETTE_SLOTS", QByteArray::number(PaletteSlots)));
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+		mCapacity = qMax(mCapacity, qMax(1, int(mInput._Characters.size())));
+		builder.setupBuffer(mUniformBuffer, "GpuSkinningUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mRestBuffer, "GpuSkinningRestBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(QSkinnedTubeMesh::RestVertex) * mesh.vertices.size());
+		builder.setupBuffer(mPaletteBuffer, "GpuSkinningPaletteBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(QVector4D) * QAnimationSystem::PaletteSize * PaletteSlots * mCapacity);
+		builder.setupBuffer(mDirtyBuffer, "GpuSkinningDirtyBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(quint32) * 8 * mCapacity);
+		builder.setupBuffer(mSkinnedBuffer, "GpuSkinnedVertices", QRhiBuffer::Static, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, SkinnedVertexStride * mesh.vertices.size() * mCapacity);
+		builder.setupShaderResourceBindings(mBindings, "GpuSkinningBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, mRestBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(2, QRhiShaderResourceBinding::ComputeStage, mPaletteBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(3, QRhiShaderResourceBinding::ComputeStage, mDirtyBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(4, QRhiShaderResourceBinding::ComputeStage, mSkinnedBuffer.get()),
+		});
+		QRhiComputePipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mSkinningCS);
+		builder.setupComputePipeline(mPipeline, "GpuSkinningPipeline", PSO);
+
+		for (int i = 0; i < mInput._Characters.size(); i++)
+			mInput._Characters[i]->setSkinningSource(this, i);
+		mOutput.SkinnedVertices = mSkinnedBuffer;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+		const QVector<QSkinnedCharacterComponent*>& characters = mInput._Characters;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		const bool bufferChanged = mCachedBuffer != mSkinnedBuffer.get();
+		if (bufferChanged) {
+			batch->uploadStaticBuffer(mRestBuffer.get(), 0, sizeof(QSkinnedTubeMesh::RestVertex) * mesh.vertices.size(), mesh.vertices.constData());
+			mCachedBuffer = mSkinnedBuffer.get();
+		}
+		if (bufferChanged || mSkinnedWithDualQuaternion != mInput._UseDualQuaternion) {
+			mSkinnedStates.fill(SkinnedState());
+			mSkinnedPreviousStates.fill(SkinnedState());
+			mSkinnedWithDualQuaternion = mInput._UseDualQuaternion;
+		}
+		if (bufferChanged)
+			mPaletteSlots.fill(SlotRevisions());
+		mSkinnedStates.resize(characters.size());
+		mSkinnedPreviousStates.resize(characters.size());
+		mLastStates.resize(characters.size());
+		mPaletteSlots.resize(characters.size());
+
+		// 只有姿势、混合系数或上一帧的姿势发生变化的角色才重新蒙皮，其余角色直接复用上一帧的缓存结果
+		// 调色板只在新的采样出现时上传一次，降频角色在两次采样之间只更新混合系数
+		// 角色停下后还需要再蒙皮一次，让上一帧位置追上本帧，运动矢量归零
+		const int paletteSize = sizeof(QVector4D) * QAnimationSystem::PaletteSize;
+		QVector<quint32> dirtyCharacters;
+		mStats.uploadedPalettes = 0;
+		for (int i = 0; i < characters.size(); i++) {
+			const QAnimationSystem::Pose* pose = characters[i]->getPose();
+			if (pose == nullptr) {
+				mLastStates[i] = SkinnedState();
+				continue;
+			}
+			SkinnedState state;
+			state.revision = pose->revision;
+			state.blend = pose->blend;
+			state.previousRevision = pose->blend < 1.0f ? pose->previousRevision : 0;
+			SkinnedState previous = mInput._PreviousPositions && mLastStates[i].revision != 0 ? mLastStates[i] : state;
+			mLastStates[i] = state;
+			if (state == mSkinnedStates[i] && previous == mSkinnedPreviousStates[i])
+				continue;
+
+			// 本帧与上一帧的姿势最多用到3个不同的采样，正好放进3个槽位；放不下时上一帧位置退化为本帧位置
+			SlotRevisions& slots = mPaletteSlots[i];
+			const quint64 kept[] = { state.revision, state.previousRevision, previous.revision, previous.previousRevision };
+			auto findSlot = [&](quint64 revision) {
+				for (int slot = 0; slot < PaletteSlots; slot++) {
+					if (slots.revisions[slot] == revision)
+						return slot;
+				}
+				return -1;
+			};
+			auto acquireSlot = [&](quint64 revision, const QVector<QVector4D>& palette) {
+				int slot = findSlot(revision);
+				if (slot >= 0)
+					return slot;
+				for (int pass = 0; pass < 2 && slot < 0; pass++) {
+					for (int candidate = 0; candidate < PaletteSlots && slot < 0; candidate++) {
+						const quint64 stored = slots.revisions[candidate];
+						const bool keep = pass == 0 ? std::find(std::begin(kept), std::end(kept), stored) != std::end(kept) && stored != 0
+							: stored == state.revision || stored == state.previousRevision;
+						if (!keep)
+							slot = candidate;
+					}
+				}
+				batch->uploadStaticBuffer(mPaletteBuffer.get(), (i * PaletteSlots + slot) * paletteSize, paletteSize, palette.constData());
+				slots.revisions[slot] = revision;
+				mStats.uploadedPalettes++;
+				return slot;
+			};
+			const int slot = acquireSlot(state.revision, pose->palette);
+			const int fromSlot = state.previousRevision != 0 ? acquireSlot(state.previousRevision, pose->previousPalette) : slot;
+			int previousSlot = findSlot(previous.revision);
+			int previousFromSlot = previous.previousRevision != 0 ? findSlot(previous.previousRevision) : previousSlot;
+			if (previousSlot < 0 || previousFromSlot < 0) {
+				previous = state;
+				previousSlot = slot;
+				previousFromSlot = fromSlot;
+			}
+			auto floatBits = [](float value) {
+				quint32 bits;
+				memcpy(&bits, &value, sizeof(bits));
+				return bits;
+			};
+			dirtyCharacters << quint32(i) << quint32(fromSlot) << quint32(slot) << floatBits(state.blend)
+				<< quint32(previousFromSlot) << quint32(previousSlot) << floatBits(previous.blend) << quint32(previous != state ? 1 : 0);
+			mSkinnedStates[i] = state;
+			mSkinnedPreviousStates[i] = previous;
+		}
+		const int dirtyCount = dirtyCharacters.size() / 8;
+		mStats.skinnedCharacters = dirtyCount;
+		mStats.reusedCharacters = characters.size() - dirtyCount;
+		mStats.skinnedVertices = dirtyCount * mesh.vertices.size();
+		if (dirtyCharacters.isEmpty()) {
+			batch->release();
+			return;
+		}
+		UniformBlock ubo;
+		ubo.vertexCount = mesh.vertices.size();
+		ubo.boneCount = QSkinnedTubeMesh::BoneCount;
+		ubo.useDualQuaternion = mInput._UseDualQuaternion ? 1 : 0;
+		ubo.padding = 0;
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		batch->uploadStaticBuffer(mDirtyBuffer.get(), 0, sizeof(quint32) * dirtyCharacters.size(), dirtyCharacters.constData());
+
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mPipeline.get());
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->dispatch((mesh.vertices.size() + 63) / 64, dirtyCount, 1);
+		cmdBuffer->endComputePass();
+	}
+	QRhiBuffer* getSkinnedVertexBuffer() const { return mSkinnedBuffer.get(); }
+	const Stats& getStats() const { return mStats; }
+};
+
+void QSkinnedCharacterComponent::onRebuildResource() {
+	const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+	mIndexBuffer.reset(mRhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer, sizeof(quint32) * mesh.indices.size()));
+	mIndexBuffer->create();
+
+	mProxy = newPrimitiveRenderProxy();
+
+	mProxy->addUniformBlock(QRhiShaderStage::Vertex, "Transform")
+		->addParam("M", QGenericMatrix<4, 4, float>())
+		->addParam("MVP", QGenericMatrix<4, 4, float>());
+
+	mProxy->setInputBindings({
+		QRhiVertexInputBindingEx(nullptr, QGpuSkinningPassBuilder::SkinnedVertexStride)		//顶点来自蒙皮缓存，绘制时再绑定
+	});
+
+	mProxy->setInputAttribute({
+		QRhiVertexInputAttributeEx("inPosition", 0, 0, QRhiVertexInputAttribute::Float3, 0),
+		QRhiVertexInputAttributeEx("inNormal", 0, 1, QRhiVertexInputAttribute::Float3, 4 * sizeof(float)),
+	});
+	mProxy->setShaderMainCode(QRhiShaderStage::Vertex, R"(
+		layout (location = 0) out vec3 vWorldPosition;
+		layout (location = 1) out vec3 vWorldNormal;
+		void main(){
+			vWorldPosition = (Transform.M * vec4(inPosition, 1.0f)).xyz;
+			vWorldNormal = mat3(Transform.M) * inNormal;
+			gl_Position = Transform.MVP * vec4(inPosition, 1.0f);
+		}
+	)");
+	mProxy->setShaderMainCode(QRhiShaderStage::Fragment, QString(R"(
+		layout (location = 0) in vec3 vWorldPosition;
+		layout (location = 1) in vec3 vWorldNormal;
+		void main(){
+			vec3 N = normalize(vWorldNormal);
+			%1
+			%2
+			%3
+			%4
+			%5
+		})")
+		.arg(hasColorAttachment("BaseColor") ? "BaseColor = vec4(vec3(0.9f, 0.6f, 0.3f) * (0.4f + 0.6f * max(N.y, 0.0f)), 1.0f);" : "")
+		.arg(hasColorAttachment("Position") ? "Position = vec4(vWorldPosition, 1.0f);" : "")
+		.arg(hasColorAttachment("Normal") ? "Normal = vec4(N, 1.0f);" : "")
+		.arg(hasColorAttachment("Metallic") ? "Metallic = vec4(0.0f);" : "")
+		.arg(hasColorAttachment("Roughness") ? "Roughness = vec4(0.7f);" : "")
+		.toLocal8Bit()
+	);
+	mProxy->setOnUpload([this](QRhiResourceUpdateBatch* batch) {
+		batch->uploadStaticBuffer(mIndexBuffer.get(), QSkinnedTubeMesh::instance().indices.constData());
+	});
+	mProxy->setOnUpdate([this](QRhiResourceUpdateBatch* batch, const QPrimitiveRenderProxy::UniformBlocks& blocks, const QPrimitiveRenderProxy::UpdateContext& ctx) {
+		const QMatrix4x4 MVP = ctx.projectionMatrixWithCorr * ctx.viewMatrix * mWorldMatrix;
+		blocks["Transform"]->setParamValue("M", QVariant::fromValue(mWorldMatrix.toGenericMatrix<4, 4>()));
+		blocks["Transform"]->setParamValue("MVP", QVariant::fromValue(MVP.toGenericMatrix<4, 4>()));
+	});
+	mProxy->setOnDraw([this](QRhiCommandBuffer* cmdBuffer) {
+		const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+		// 所有绘制该角色的Pass都读取同一份蒙皮结果，而不是在各自的顶点着色器中重复蒙皮
+		if (mSkinningSource == nullptr || mSkinningSource->getSkinnedVertexBuffer() == nullptr || mPose == nullptr)
+			return;
+		const QRhiCommandBuffer::VertexInput vertexBindings(mSkinningSource->getSkinnedVertexBuffer(), quint32(mSlot * mesh.vertices.size() * QGpuSkinningPassBuilder::SkinnedVertexStride));
+		cmdBuffer->setVertexInput(0, 1, &vertexBindings, mIndexBuffer.get(), 0, QRhiCommandBuffer::IndexUInt32);
+		cmdBuffer->drawIndexed(mesh.indices.size());
+	});
+}
 
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, CharacterCount) = 100;
+	Q_PROPERTY_VAR(int, AnimatedCharacterCount) = 100;
+	Q_PROPERTY_VAR(bool, UseDualQuaternion) = false;
+	Q_PROPERTY_VAR(bool, UseCompressedTracks) = false;
+	Q_PROPERTY_VAR(bool, UseSimdSampling) = true;
+	Q_PROPERTY_VAR(bool, MultithreadedAnimation) = true;
+	Q_PROPERTY_VAR(bool, EnableAnimationLod) = true;
+	Q_PROPERTY_VAR(bool, InterpolateThrottledPoses) = true;
+	Q_PROPERTY_VAR(float, AnimationBudgetMs) = 0.5f;
+	Q_PROPERTY_VAR(bool, ShowMotionVectors) = false;
+
+	Q_CLASSINFO("CharacterCount", "Min=0,Max=100")
+	Q_CLASSINFO("AnimatedCharacterCount", "Min=0,Max=100")
+	Q_CLASSINFO("AnimationBudgetMs", "Min=0.01,Max=4")
 private:
+	static const int MaxCharacters = 100;
 	QSkeletalMeshRenderComponent mSkeletonComp;
-	QSharedPointer<QMeshPassBuilder> mMeshPass{ new QMeshPassBuilder };
+	QSkinnedCharacterComponent mCharacterComps[MaxCharacters];
+	QSharedPointer<QPbrMeshPassBuilder> mMeshPass{ new QPbrMeshPassBuilder };		//需要世界坐标与法线生成运动矢量
+	QSharedPointer<QGpuSkinningPassBuilder> mSkinningPass{ new QGpuSkinningPassBuilder };
+	QSharedPointer<QMotionVectorPassBuilder> mMotionVectorPass{ new QMotionVectorPassBuilder };
+	bool mMotionVectorsActive = false;
+	QAnimationSystem mAnimation;
+	QAnimationLodScheduler mLodScheduler;
+	QVector<QAnimationLodScheduler::Character> mCrowd;
+	double mCostPerPoseMs = 0.002;							//整个评估（采样、生成调色板、拷贝）的实测耗时按采样数平滑，用于把毫秒预算换算成可更新的角色数
+	QElapsedTimer mClock;
+	float mLastTime = 0.0f;
+	int mReportFrameCount = 0;
+	qint64 mReportSkinnedCharacters = 0;
+	qint64 mReportReusedCharacters = 0;
+	qint64 mReportSkinnedVertices = 0;
+	qint64 mReportUploadedPalettes = 0;
+	double mReportGpuTime = 0.0;
+	double mReportAnimationCpuTime = 0.0;
+	double mReportAnimationWaitTime = 0.0;
+	qint64 mReportEvaluatedPoses = 0;
+	qint64 mReportBlendedPoses = 0;
+	qint64 mReportDeferredPoses = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
 	{
 		mSkeletonComp.setSkeletalMesh(QSkeletalMesh::CreateFromFile("Resources/Model/Catwalk Walk Turn 180 Tight R.fbx"));
-		
+
 		getCamera()->setPosition(QVector3D(0, 190, -700));
 		getCamera()->setRotation(QVector3D(-5, 265, 0));
 
 		addComponent(&mSkeletonComp);
 
+		QVector<QAnimationClip> clips;
+		for (int i = 0; i < 4; i++)
+			clips << QAnimationClip::bakeSway(i * 1.7f);
+		mAnimation.setClips(clips);
+
+		for (int i = 0; i < MaxCharacters; i++) {
+			mCharacterComps[i].setPosition(QVector3D(((i % 10) - 4.5f) * 60.0f, 0.0f, 200.0f + (i / 10) * 60.0f));
+			addComponent(&mCharacterComps[i]);
+		}
+
 		setCurrentObject(&mSkeletonComp);
+		mClock.start();
+	}
+private:
+	QVector<QSkinnedCharacterComponent*> updateCharacters() {
+		for (QSkinnedCharacterComponent& character : mCharacterComps)
+			character.commitFrame();
+		// 取出上一帧在工作线程中算好的姿势，渲染线程只负责上传
+		mReportAnimationWaitTime += mAnimation.sync();
+		mReportAnimationCpuTime += mAnimation.getLastEvaluateCpuMs();
+		mReportEvaluatedPoses += mAnimation.getLastEvaluatedCount();
+		mReportBlendedPoses += mAnimation.getLastBlendedCount();
+		if (mAnimation.getLastEvaluatedCount() > 0)
+			mCostPerPoseMs = mCostPerPoseMs * 0.9 + mAnimation.getLastEvaluateCpuMs() / mAnimation.getLastEvaluatedCount() * 0.1;
+		QVector<QSkinnedCharacterComponent*> characters;
+		for (int i = 0; i < MaxCharacters; i++) {
+			if (i >= CharacterCount) {
+				mCharacterComps[i].setSkinningSource(nullptr, 0);
+				mCharacterComps[i].setPose(nullptr);
+				continue;
+			}
+			mCharacterComps[i].setPose(mAnimation.getPose(i));
+			characters << &mCharacterComps[i];
+		}
+
+		// 立即开始计算下一帧的姿势，与本帧的渲染并行
+		const float time = mClock.elapsed() / 1000.0f;
+		const float frameDelta = time - mLastTime;
+		const float nextTime = time + frameDelta;
+		mLastTime = time;
+		mCrowd.resize(characters.size());
+		for (int i = 0; i < mCrowd.size(); i++) {
+			QAnimationLodScheduler::Character& character = mCrowd[i];
+			character.center = characters[i]->getWorldMatrix().map(QVector3D(0.0f, QSkinnedTubeMesh::BoneCount * QSkinnedTubeMesh::BoneLength * 0.5f, 0.0f));
+			character.radius = QSkinnedTubeMesh::BoneCount * QSkinnedTubeMesh::BoneLength * 0.5f + QSkinnedTubeMesh::Radius * 4.0f;
+			character.clip = i % mAnimation.getClips().size();
+			character.animated = i < AnimatedCharacterCount;
+			character.time = i * 0.37f + (character.animated ? nextTime : 0.0f);
+		}
+		QVector<QAnimationSystem::Request> requests;
+		if (EnableAnimationLod) {
+			const QMatrix4x4 projection = getCamera()->getProjectionMatrix();
+			const int maxEvaluations = qMax(1, int(AnimationBudgetMs / mCostPerPoseMs));
+			mLodScheduler.setInterpolation(InterpolateThrottledPoses);
+			mLodScheduler.schedule(mCrowd, projection * getCamera()->getViewMatrix(), projection(1, 1), frameDelta, maxEvaluations, requests);
+			mReportDeferredPoses += mLodScheduler.getStats().deferred;
+		}
+		else {
+			requests.resize(mCrowd.size());
+			for (int i = 0; i < requests.size(); i++) {
+				requests[i].clip = mCrowd[i].clip;
+				requests[i].time = mCrowd[i].time;
+				mCrowd[i].hasPose = false;					//重新开启LOD时全部重新调度
+			}
+		}
+		QAnimationSystem::Settings settings;
+		settings.quantized = UseCompressedTracks;
+		settings.simd = UseSimdSampling;
+		settings.multithreaded = MultithreadedAnimation;
+		mAnimation.beginEvaluate(requests, settings);
+		return characters;
+	}
+	void reportSkinningStats(QRhiCommandBuffer* cmdBuffer) {
+		static const int FramesPerReport = 240;
+		const QGpuSkinningPassBuilder::Stats& stats = mSkinningPass->getStats();
+		mReportSkinnedCharacters += stats.skinnedCharacters;
+		mReportReusedCharacters += stats.reusedCharacters;
+		mReportSkinnedVertices += stats.skinnedVertices;
+		mReportUploadedPalettes += stats.uploadedPalettes;
+		mReportGpuTime += cmdBuffer->lastCompletedGpuTime();
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		qDebug().noquote() << QString("[Skinning] %1 characters (%2): %3 skinned / %4 reused per frame, %5 vertices per frame, GPU %6 per frame")
+			.arg(qBound(0, CharacterCount, MaxCharacters))
+			.arg(UseDualQuaternion ? "dual quaternion" : "linear blend")
+			.arg(mReportSkinnedCharacters / double(FramesPerReport), 0, 'f', 1)
+			.arg(mReportReusedCharacters / double(FramesPerReport), 0, 'f', 1)
+			.arg(mReportSkinnedVertices / FramesPerReport)
+			.arg(QFrameTimeBenchmark::formatGpuTime(mReportGpuTime, FramesPerReport));
+		qDebug().noquote() << QString("[Animation] %1 (%2, %3): %4 poses sampled / %5 blended on GPU / %6 palettes uploaded per frame, %7 ms CPU per frame, %8 ms render thread wait per frame")
+			.arg(MultithreadedAnimation ? "thread pool" : "single thread")
+			.arg(UseSimdSampling ? "simd" : "scalar")
+			.arg(UseCompressedTracks ? "quantized tracks" : "float tracks")
+			.arg(mReportEvaluatedPoses / double(FramesPerReport), 0, 'f', 1)
+			.arg(mReportBlendedPoses / double(FramesPerReport), 0, 'f', 1)
+			.arg(mReportUploadedPalettes / double(FramesPerReport), 0, 'f', 1)
+			.arg(mReportAnimationCpuTime / FramesPerReport, 0, 'f', 3)
+			.arg(mReportAnimationWaitTime / FramesPerReport, 0, 'f', 3);
+		if (EnableAnimationLod) {
+			const QAnimationLodScheduler::Stats& lodStats = mLodScheduler.getStats();
+			qDebug().noquote() << QString("[AnimationLod] LOD %1/%2/%3, %4 offscreen, %5 deferred per frame by %6 ms budget (%7 poses)")
+				.arg(lodStats.lodCounts[0])
+				.arg(lodStats.lodCounts[1])
+				.arg(lodStats.lodCounts[2])
+				.arg(lodStats.offscreen)
+				.arg(mReportDeferredPoses / double(FramesPerReport), 0, 'f', 1)
+				.arg(AnimationBudgetMs)
+				.arg(qMax(1, int(AnimationBudgetMs / mCostPerPoseMs)));
+		}
+		mReportFrameCount = 0;
+		mReportSkinnedCharacters = mReportReusedCharacters = mReportSkinnedVertices = mReportUploadedPalettes = 0;
+		mReportEvaluatedPoses = mReportBlendedPoses = mReportDeferredPoses = 0;
+		mReportGpuTime = mReportAnimationCpuTime = mReportAnimationWaitTime = 0.0;
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
-		QMeshPassBuilder::Output meshOut
+		const QVector<QSkinnedCharacterComponent*> characters = updateCharacters();
+
+		QGpuSkinningPassBuilder::Output skinningOut
+			= graphBuilder.addPassBuilder("GpuSkinningPass", mSkinningPass)
+			.setCharacters(characters)
+			.setUseDualQuaternion(UseDualQuaternion)
+			.setPreviousPositions(ShowMotionVectors);
+
+		QPbrMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder("MeshPass", mMeshPass);
 
+		// 蒙皮角色的运动矢量由蒙皮Pass写出的上一帧顶点位置得到；引擎的骨骼网格组件没有上一帧数据，只包含相机运动
+		QRhiTextureRef finalColor = meshOut.BaseColor;
+		if (ShowMotionVectors) {
+			if (!mMotionVectorsActive)
+				mMotionVectorPass->resetHistory();
+			const QSkinnedTubeMesh& mesh = QSkinnedTubeMesh::instance();
+			QVector<QMotionVectorSkinnedDraw> skinnedDraws;
+			for (int i = 0; i < characters.size(); i++) {
+				const QSkinnedCharacterComponent* character = characters[i];
+				if (character->getPose() == nullptr)
+					continue;
+				QMotionVectorSkinnedDraw draw;
+				draw.vertexBuffer = skinningOut.SkinnedVertices;
+				draw.vertexOffset = quint32(i * mesh.vertices.size() * QGpuSkinningPassBuilder::SkinnedVertexStride);		//与蒙皮Pass中的槽位一致
+				draw.indexBuffer = character->getIndexBuffer();
+				draw.indexCount = mesh.indices.size();
+				draw.worldMatrix = character->getWorldMatrix();
+				draw.previousWorldMatrix = character->getPreviousWorldMatrix();
+				skinnedDraws << draw;
+			}
+			QMotionVectorSkinnedLayout skinnedLayout;
+			skinnedLayout.stride = QGpuSkinningPassBuilder::SkinnedVertexStride;
+			skinnedLayout.previousPositionOffset = QGpuSkinningPassBuilder::PreviousPositionOffset;
+			QMotionVectorPassBuilder::Output motionOut
+				= graphBuilder.addPassBuilder("MotionVectorPass", mMotionVectorPass)
+				.setPosition(meshOut.Position)
+				.setNormal(meshOut.Normal)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setSkinnedLayout(skinnedLayout)
+				.setSkinnedDraws(skinnedDraws);
+			finalColor = motionOut.MotionVector;
+		}
+		mMotionVectorsActive = ShowMotionVectors;
+
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(meshOut.BaseColor);
+			.setInitialTexture(finalColor);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportSkinningStats(cmdBuffer);
+		});
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+	if (app.arguments().contains("--animation-benchmark")) {
+		QAnimationSystem::runBenchmark();
+		return 0;
+	}
+	if (app.arguments().contains("--animation-lod-benchmark")) {
+		QAnimationLodScheduler::runBenchmark();
+		return 0;
+	}
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
+
+#include "main.moc"
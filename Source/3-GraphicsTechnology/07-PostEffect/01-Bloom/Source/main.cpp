@@ -1,5 +1,9 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
 #include "QEngineApplication.h"
 #include "QRenderWidget.h"
+#include "QTextureFormatInfo.h"
 #include "QtConcurrent/qtconcurrentrun.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QMeshPassBuilder.h"
@@ -18,6 +22,243 @@
     } \
     Type Name
 
+struct QPixelStage {
+	QByteArray code;				//以 color 为输入输出的逐像素代码，可使用 vUV、PARAMS 和 uAux0..N
+	QVector4D params;
+	bool startsPass = true;			//未融合时该阶段是否是一个独立的Pass（为false时与前一阶段同属一个Pass），用于估算省下的中间纹理
+};
+
+class QFusedPixelPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QFusedPixelPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColorTexture);
+		QRP_INPUT_ATTR(QList<QRhiTextureRef>, AuxTextures);
+		QRP_INPUT_ATTR(QList<QPixelStage>, Stages);
+		QRP_INPUT_ATTR(QRhiTexture::Format, OutputFormat);		//传入 UnknownFormat 时使用RGBA16F
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QFusedPixelPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, FusedResult)
+	QRP_OUTPUT_END()
+public:
+	static const int MaxStageCount = 16;
+	struct BandwidthEstimate {
+		qint64 unfusedBytes = 0;
+		qint64 fusedBytes = 0;
+	};
+	// 未融合时，被替代的Pass之间各有一张全分辨率中间纹理（写一次、读一次），Pass数量由阶段的 startsPass 给出；
+	// 引擎的逐像素Pass沿用输入的格式，中间纹理与最终输出都按底色的格式计算。底色与辅助纹理在两种方式下都读取一次
+	BandwidthEstimate getBandwidthEstimate() const {
+		BandwidthEstimate estimate;
+		if (!mActive)
+			return estimate;
+		auto textureBytes = [](QRhiTexture* texture) {
+			return qint64(texture->pixelSize().width()) * texture->pixelSize().height() * QTextureFormatInfo::bytesPerPixel(texture->format());
+		};
+		qint64 inputBytes = textureBytes(mInput._BaseColorTexture.get());
+		for (const QRhiTextureRef& aux : mInput._AuxTextures)
+			inputBytes += textureBytes(aux.get());
+		qint64 intermediateCount = 0;
+		for (int i = 1; i < mInput._Stages.size(); i++)
+			intermediateCount += mInput._Stages[i].startsPass ? 1 : 0;
+		const qint64 unfusedTextureBytes = textureBytes(mInput._BaseColorTexture.get());
+		estimate.fusedBytes = inputBytes + textureBytes(mColorAttachment.get());
+		estimate.unfusedBytes = inputBytes + unfusedTextureBytes + intermediateCount * unfusedTextureBytes * 2;
+		return estimate;
+	}
+	bool isActive() const { return mActive; }
+private:
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mFragmentShader;
+	QByteArray mShaderKey;
+	bool mActive = false;							//没有阶段或着色器编译失败时直接输出底色，不执行Pass
+
+	static QByteArray generateShader(const QList<QPixelStage>& stages, int stageCount, int auxCount) {
+		QByteArray code = R"(#version 450
+			layout (binding = 0) uniform UniformBlock {
+				vec4 params[16];
+			}UBO;
+			layout (binding = 1) uniform sampler2D uBaseColor;
+		)";
+		for (int i = 0; i < auxCount; i++)
+			code += QString("layout (binding = %1) uniform sampler2D uAux%2;\n").arg(i + 2).arg(i).toLocal8Bit();
+		code += R"(
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+		)";
+		for (int i = 0; i < stageCount; i++) {
+			code += QString("vec4 stage%1(vec4 color, vec4 PARAMS) {\n").arg(i).toLocal8Bit();
+			code += stages[i].code;
+			code += "\nreturn color;\n}\n";
+		}
+		code += "void main() {\n\tvec4 color = texture(uBaseColor, vUV);\n";
+		for (int i = 0; i < stageCount; i++)
+			code += QString("\tcolor = stage%1(color, UBO.params[%1]);\n").arg(i).toLocal8Bit();
+		code += "\toutFragColor = color;\n}\n";
+		return code;
+	}
+public:
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QList<QPixelStage>& stages = mInput._Stages;
+		const QList<QRhiTextureRef>& auxTextures = mInput._AuxTextures;
+		const int stageCount = qMin<int>(stages.size(), MaxStageCount);
+		mActive = false;
+		mOutput.FusedResult = mInput._BaseColorTexture;
+		if (stageCount == 0)
+			return;
+
+		// 整条阶段链生成一个片段着色器，阶段代码变化时才重新编译
+		QByteArray shaderKey = QByteArray::number(auxTextures.size());
+		for (int i = 0; i < stageCount; i++)
+			shaderKey += stages[i].code;
+		if (shaderKey != mShaderKey) {
+			mShaderKey = shaderKey;
+			mFragmentShader = QRhiHelper::newShaderFromCode(QShader::FragmentStage, generateShader(stages, stageCount, auxTextures.size()));
+		}
+		if (!mFragmentShader.isValid()) {
+			qWarning() << "[FusedPixel] shader compilation failed, passing the base color through";
+			return;
+		}
+
+		builder.setupBuffer(mUniformBuffer, "FusedPixelUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QVector4D) * MaxStageCount);
+		builder.setupSampler(mSampler, "FusedPixelSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		const QRhiTexture::Format format = mInput._OutputFormat != QRhiTexture::UnknownFormat ? mInput._OutputFormat : QRhiTexture::RGBA16F;
+		builder.setupTexture(mColorAttachment, "FusedPixel", format, mInput._BaseColorTexture->pixelSize(), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mRenderTarget, "FusedPixelRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		QVector<QRhiShaderResourceBinding> binds = {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColorTexture.get(), mSampler.get()),
+		};
+		for (int j = 0; j < auxTextures.size(); j++)
+			binds << QRhiShaderResourceBinding::sampledTexture(j + 2, QRhiShaderResourceBinding::FragmentStage, auxTextures[j].get(), mSampler.get());
+		builder.setupShaderResourceBindings(mBindings, "FusedPixelBindings", binds);
+
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mFragmentShader)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "FusedPixelPipeline", PSO);
+		mOutput.FusedResult = mColorAttachment;
+		mActive = true;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		if (!mActive)
+			return;
+		QVector4D params[MaxStageCount];
+		for (int i = 0; i < qMin<int>(mInput._Stages.size(), MaxStageCount); i++)
+			params[i] = mInput._Stages[i].params;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(params), params);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+class QImageComparePassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QImageComparePassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, TextureA);
+		QRP_INPUT_ATTR(QRhiTextureRef, TextureB);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QImageComparePassBuilder)
+	QRP_OUTPUT_END()
+public:
+	float getLastMaxDifference() const { return mLastMaxDifference; }
+private:
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mResultBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiComputePipelineRef mPipeline;
+	QShader mCompareCS;
+	QRhiBufferReadbackResult mReadback;
+	float mLastMaxDifference = 0.0f;
+public:
+	QImageComparePassBuilder() {
+		mCompareCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0) uniform sampler2D uTextureA;
+			layout (binding = 1) uniform sampler2D uTextureB;
+			layout (std430, binding = 2) buffer Result {
+				uint maxDifference;
+			};
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(pixel, textureSize(uTextureA, 0))))
+					return;
+				vec3 diff = abs(texelFetch(uTextureA, pixel, 0).rgb - texelFetch(uTextureB, pixel, 0).rgb);	//两条路径对alpha的约定不同，只比较颜色
+				float value = max(max(diff.r, diff.g), diff.b);
+				atomicMax(maxDifference, floatBitsToUint(value));		//非负浮点数的位模式与数值大小顺序一致
+			}
+		)");
+		mReadback.completed = [this]() {
+			if (mReadback.data.size() >= int(sizeof(float)))
+				memcpy(&mLastMaxDifference, mReadback.data.constData(), sizeof(float));
+		};
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		builder.setupBuffer(mResultBuffer, "ImageCompareResult", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(quint32));
+		builder.setupSampler(mSampler, "ImageCompareSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupShaderResourceBindings(mBindings, "ImageCompareBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::ComputeStage, mInput._TextureA.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mInput._TextureB.get(), mSampler.get()),
+			QRhiShaderResourceBinding::bufferLoadStore(2, QRhiShaderResourceBinding::ComputeStage, mResultBuffer.get()),
+		});
+		QRhiComputePipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mCompareCS);
+		builder.setupComputePipeline(mPipeline, "ImageComparePipeline", PSO);
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const quint32 zero = 0;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->uploadStaticBuffer(mResultBuffer.get(), &zero);
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mPipeline.get());
+		cmdBuffer->setShaderResources(mBindings.get());
+		const QSize size = mInput._TextureA->pixelSize();
+		cmdBuffer->dispatch((size.width() + 7) / 8, (size.height() + 7) / 8, 1);
+		QRhiResourceUpdateBatch* readbackBatch = mRhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(mResultBuffer.get(), 0, sizeof(quint32), &mReadback);
+		cmdBuffer->endComputePass(readbackBatch);
+	}
+};
+
+// 回读结果转为8位图像，与屏幕上显示的结果一致（浮点值截断到[0,1]）
+static QImage readbackToImage(const QRhiReadbackResult& result, QRhi* rhi) {
+	QImage::Format format = QImage::Format_Invalid;
+	switch (result.format) {
+	case QRhiTexture::RGBA32F: format = QImage::Format_RGBA32FPx4; break;
+	case QRhiTexture::RGBA16F: format = QImage::Format_RGBA16FPx4; break;
+	case QRhiTexture::RGBA8: format = QImage::Format_RGBA8888; break;
+	case QRhiTexture::BGRA8: format = QImage::Format_ARGB32; break;
+	default: return QImage();
+	}
+	if (result.data.isEmpty())
+		return QImage();
+	const uchar* p = reinterpret_cast<const uchar*>(result.data.constData());
+	QImage image = QImage(p, result.pixelSize.width(), result.pixelSize.height(), format).convertToFormat(QImage::Format_RGBX8888);
+	return rhi->isYUpInFramebuffer() ? image.mirrored() : image;
+}
+
 class MyRenderer : public IRenderer {
 	Q_OBJECT
 	Q_PROPERTY_VAR(int, BlurIterations) = 2;
@@ -31,11 +272,28 @@ class MyRenderer : public IRenderer {
 	Q_CLASSINFO("BlurIterations", "Min=1,Max=8")
 	Q_CLASSINFO("BlurSize", "Min=1,Max=80")
 	Q_CLASSINFO("DownSampleCount", "Min=1,Max=16")
+
+	Q_PROPERTY_VAR(bool, UseFusedPostProcess) = true;
+	Q_PROPERTY_VAR(bool, VerifyFusion) = false;
+	Q_PROPERTY_VAR(float, BloomIntensity) = 1.0f;
 private:
+	static const int GoldenWarmupFrames = 60;
+	static constexpr float FusionTolerance = 2.0f / 255.0f;		//引擎的中间纹理可能是低精度格式，允许量化误差
 	QStaticMeshRenderComponent mStaticComp;
+	QSharedPointer<QFusedPixelPassBuilder> mFusedPass{ new QFusedPixelPassBuilder };
+	QSharedPointer<QImageComparePassBuilder> mComparePass{ new QImageComparePassBuilder };
+	int mReportFrameCounter = 0;
+	QString mGoldenPath;
+	bool mRecordGolden = false;
+	QRhi* mRhi = nullptr;
+	QRhiReadbackResult mGoldenReadback;
+	int mGoldenFrameCounter = 0;
+	bool mGoldenReadbackIssued = false;
 public:
-	MyRenderer()
+	MyRenderer(const QString& goldenPath = QString(), bool recordGolden = false)
 		: IRenderer({ QRhi::Vulkan })
+		, mGoldenPath(goldenPath)
+		, mRecordGolden(recordGolden)
 	{
 		mStaticComp.setStaticMesh(QStaticMesh::CreateFromFile("Resources/Model/mandalorian_ship/scene.gltf"));
 		mStaticComp.setRotation(QVector3D(-90, 0, 0));
@@ -44,9 +302,59 @@ public:
 
 		getCamera()->setPosition(QVector3D(20, 15, 12));
 		getCamera()->setRotation(QVector3D(-30, 145, 0));
+
+		mGoldenReadback.completed = [this]() {
+			const int exitCode = checkGolden(readbackToImage(mGoldenReadback, mRhi));
+			QMetaObject::invokeMethod(qApp, [exitCode]() { qApp->exit(exitCode); }, Qt::QueuedConnection);
+		};
+	}
+private:
+	// 融合结果的回归检查：记录模式下保存基准图，否则逐像素比较；缺少基准图视为失败，避免首次运行时静默通过
+	int checkGolden(const QImage& image) {
+		if (image.isNull()) {
+			qWarning() << "[BloomGolden] readback failed";
+			return 1;
+		}
+		if (mRecordGolden) {
+			QDir().mkpath(QFileInfo(mGoldenPath).absolutePath());
+			const bool saved = image.save(mGoldenPath);
+			qDebug().noquote() << QString("[BloomGolden] recorded %1x%2 to %3: %4")
+				.arg(image.width()).arg(image.height()).arg(mGoldenPath).arg(saved ? "OK" : "FAILED");
+			return saved ? 0 : 1;
+		}
+		if (!QFileInfo::exists(mGoldenPath)) {
+			qWarning().noquote() << QString("[BloomGolden] no golden image at %1, run with --record to create it: FAILED").arg(mGoldenPath);
+			return 1;
+		}
+		const QImage golden = QImage(mGoldenPath).convertToFormat(QImage::Format_RGBX8888);
+		if (golden.size() != image.size()) {
+			qWarning().noquote() << QString("[BloomGolden] size mismatch: golden %1x%2, rendered %3x%4")
+				.arg(golden.width()).arg(golden.height()).arg(image.width()).arg(image.height());
+			return 1;
+		}
+		static const int ChannelTolerance = 2;
+		int maxDifference = 0;
+		qint64 outliers = 0;
+		for (int y = 0; y < image.height(); y++) {
+			const uchar* a = image.constScanLine(y);
+			const uchar* b = golden.constScanLine(y);
+			for (int x = 0; x < image.width(); x++) {
+				int pixelDifference = 0;
+				for (int c = 0; c < 3; c++)
+					pixelDifference = qMax(pixelDifference, qAbs(int(a[x * 4 + c]) - int(b[x * 4 + c])));
+				maxDifference = qMax(maxDifference, pixelDifference);
+				outliers += pixelDifference > ChannelTolerance;
+			}
+		}
+		const qint64 pixelCount = qint64(image.width()) * image.height();
+		const bool passed = outliers * 1000 <= pixelCount;			//允许不超过0.1%的像素超出容差（驱动间的舍入差异）
+		qDebug().noquote() << QString("[BloomGolden] max difference %1/255, %2 of %3 pixels above %4/255: %5")
+			.arg(maxDifference).arg(outliers).arg(pixelCount).arg(ChannelTolerance).arg(passed ? "PASSED" : "FAILED");
+		return passed ? 0 : 1;
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		mRhi = graphBuilder.rhi();
 		QMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder<QMeshPassBuilder>("MeshPass");
 
@@ -67,28 +375,101 @@ protected:
 			.setBlurSize(BlurSize)
 			.setDownSampleCount(DownSampleCount);
 
-		QBloomPassBuilder::Output bloomOut = graphBuilder.addPassBuilder<QBloomPassBuilder>("BloomPass")
-			.setBaseColorTexture(meshOut.BaseColor)
-			.setBlurTexture(blurOut.BlurResult);
+		const bool useFused = UseFusedPostProcess || !mGoldenPath.isEmpty();
+		const bool verifyFusion = useFused && VerifyFusion;
+		QRhiTextureRef resultTexture;
+		QRhiTextureRef referenceTexture;
+		if (!useFused || verifyFusion) {
+			QBloomPassBuilder::Output bloomOut = graphBuilder.addPassBuilder<QBloomPassBuilder>("BloomPass")
+				.setBaseColorTexture(meshOut.BaseColor)
+				.setBlurTexture(blurOut.BlurResult);
+
+			QToneMappingPassBuilder::Output tonemappingOut = graphBuilder.addPassBuilder<QToneMappingPassBuilder>("ToneMappingPass")
+				.setBaseColorTexture(bloomOut.BloomResult)
+				.setExposure(Exposure)
+				.setGamma(Gamma)
+				.setPureWhite(PureWhite);
+			referenceTexture = tonemappingOut.ToneMappingReslut;
+			resultTexture = referenceTexture;
+		}
+		if (useFused) {
+			// Bloom合成与色调映射都是逐像素的，生成一个Pass，省去中间的RGBA32F纹理
+			const QList<QPixelStage> stages = {
+				{ R"(
+					color.rgb += texture(uAux0, vUV).rgb * PARAMS.x;
+				)", QVector4D(verifyFusion ? 1.0f : BloomIntensity, 0, 0, 0) },		//引擎的Bloom Pass没有强度参数，对照时固定为1
+				{ R"(
+					float luminance = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+					float exposed = luminance * PARAMS.x;
+					float mappedLuminance = (exposed * (1.0 + exposed / (PARAMS.z * PARAMS.z))) / (1.0 + exposed);
+					color.rgb *= mappedLuminance / max(luminance, 1e-4);
+				)", QVector4D(Exposure, Gamma, PureWhite, 0) },
+				{ R"(
+					color.rgb = pow(max(color.rgb, vec3(0.0)), vec3(1.0 / PARAMS.y));
+				)", QVector4D(Exposure, Gamma, PureWhite, 0), false },			//引擎在ToneMapping Pass内完成gamma校正，不单独成Pass
+			};
+			QFusedPixelPassBuilder::Output fusedOut = graphBuilder.addPassBuilder("FusedPostProcessPass", mFusedPass)
+				.setBaseColorTexture(meshOut.BaseColor)
+				.setAuxTextures({ blurOut.BlurResult })
+				.setStages(stages)
+				.setOutputFormat(QRhiTexture::RGBA8);			//色调映射与gamma之后的结果在[0,1]内，8位足够
+			resultTexture = fusedOut.FusedResult;
+		}
 
-		QToneMappingPassBuilder::Output tonemappingOut = graphBuilder.addPassBuilder<QToneMappingPassBuilder>("ToneMappingPass")
-			.setBaseColorTexture(bloomOut.BloomResult)
-			.setExposure(Exposure)
-			.setGamma(Gamma)
-			.setPureWhite(PureWhite);
+		if (verifyFusion) {
+			// 与引擎的 Bloom + ToneMapping 两个Pass对照，而不是与自身的拆分版本比较
+			QImageComparePassBuilder::Output compareOut = graphBuilder.addPassBuilder("FusionComparePass", mComparePass)
+				.setTextureA(resultTexture)
+				.setTextureB(referenceTexture);
+
+			if (++mReportFrameCounter % 240 == 0) {
+				const QFusedPixelPassBuilder::BandwidthEstimate estimate = mFusedPass->getBandwidthEstimate();
+				const float difference = mComparePass->getLastMaxDifference();
+				qDebug().noquote() << QString("[FusedPostProcess] max difference against Bloom + ToneMapping: %1 (%2), render target traffic: %3 MB -> %4 MB per frame")
+					.arg(difference)
+					.arg(difference <= FusionTolerance ? "PASSED" : "FAILED")
+					.arg(estimate.unfusedBytes / 1048576.0, 0, 'f', 2)
+					.arg(estimate.fusedBytes / 1048576.0, 0, 'f', 2);
+			}
+		}
+
+		if (!mGoldenPath.isEmpty()) {
+			graphBuilder.addPass([this, resultTexture](QRhiCommandBuffer* cmdBuffer) {
+				if (mGoldenReadbackIssued || ++mGoldenFrameCounter < GoldenWarmupFrames)
+					return;
+				mGoldenReadbackIssued = true;
+				QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+				batch->readBackTexture(QRhiReadbackDescription(resultTexture.get()), &mGoldenReadback);
+				cmdBuffer->resourceUpdate(batch);
+			});
+		}
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(tonemappingOut.ToneMappingReslut);
+			.setInitialTexture(resultTexture);
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
+
+	// 用法：01-Bloom --bloom-golden [基准图路径] [--record]，以固定窗口尺寸渲染若干帧后回读融合结果并与基准图比较；
+	// 带 --record 时把结果写为新的基准图
+	const QStringList arguments = app.arguments();
+	const int goldenIndex = arguments.indexOf("--bloom-golden");
+	if (goldenIndex >= 0) {
+		const bool hasPath = goldenIndex + 1 < arguments.size() && !arguments[goldenIndex + 1].startsWith("--");
+		const QString goldenPath = hasPath ? arguments[goldenIndex + 1] : "Resources/Golden/Bloom.png";
+		QRenderWidget widget(new MyRenderer(goldenPath, arguments.contains("--record")));
+		widget.resize(1280, 720);
+		widget.show();
+		return app.exec();
+	}
+
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
 }
 
-#include "main.moc"
\ No newline at end of file
+#include "main.moc"
@@ -4,7 +4,8 @@
 #include "Render/Component/QStaticMeshRenderComponent.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
-#include "Render/RenderGraph/PassBuilder/QOutliningPassBuilder.h"
+#include "QFrameTimeBenchmark.h"
+#include "QRenderTargetFormatPolicy.h"
 
 #define Q_PROPERTY_VAR(Type,Name)\
     Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
@@ -14,6 +15,127 @@
     } \
     Type Name
 
+// 基于深度差的描边：比较周围像素的视空间深度，差值越大描边越明显；采样间隔随距离从 MaxSeparation 过渡到 MinSeparation
+// 输出纹理的格式由格式策略决定，与 03-SSAO 共用同一套对比方式
+class QDepthOutliningPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QDepthOutliningPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColorTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, PositionTexture);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(int, Radius);
+		QRP_INPUT_ATTR(QColor4D, ColorModifier);
+		QRP_INPUT_ATTR(float, MinSeparation);
+		QRP_INPUT_ATTR(float, MaxSeparation);
+		QRP_INPUT_ATTR(float, MinDistance);
+		QRP_INPUT_ATTR(float, MaxDistance);
+		QRP_INPUT_ATTR(float, FarDistance);
+		QRP_INPUT_ATTR(QRenderTargetFormatPolicy*, FormatPolicy);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QDepthOutliningPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, OutliningResult)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float view[16];
+		QVector4D colorModifier;
+		QVector4D separationDistance;			//x：最小间隔  y：最大间隔  z：最小深度差  w：最大深度差
+		int radius;
+		float farDistance;
+		float padding[2];
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mOutliningFS;
+public:
+	QDepthOutliningPassBuilder() {
+		mOutliningFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				vec4 colorModifier;
+				vec4 separationDistance;
+				int radius;
+				float farDistance;
+			} ubo;
+			layout (binding = 1) uniform sampler2D uBaseColor;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			float viewDepth(vec2 uv) {
+				return -(ubo.view * vec4(texture(uPosition, uv).xyz, 1.0)).z;
+			}
+			void main() {
+				vec2 texelSize = 1.0 / vec2(textureSize(uPosition, 0));
+				float depth = viewDepth(vUV);
+				float separation = mix(ubo.separationDistance.y, ubo.separationDistance.x, clamp(depth / ubo.farDistance, 0.0, 1.0));
+				float maxDifference = 0.0;
+				for (int i = -ubo.radius; i <= ubo.radius; i++) {
+					for (int j = -ubo.radius; j <= ubo.radius; j++) {
+						maxDifference = max(maxDifference, abs(depth - viewDepth(vUV + vec2(i, j) * separation * texelSize)));
+					}
+				}
+				float outline = smoothstep(ubo.separationDistance.z, ubo.separationDistance.w, maxDifference);
+				vec4 srcColor = texture(uBaseColor, vUV);
+				outFragColor = vec4(mix(srcColor.rgb, srcColor.rgb * ubo.colorModifier.rgb, outline), srcColor.a);
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize size = mInput._BaseColorTexture->pixelSize();
+		const QRhiTexture::Flags flags = QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource;
+		const QRhiTexture::Format format = mInput._FormatPolicy->selectFormat(mRhi, QRenderTargetFormatPolicy::HdrColor, flags);
+		builder.setupTexture(mColorAttachment, "OutliningResult", format, size, 1, flags);
+		mInput._FormatPolicy->recordTraffic("OutliningResult", format, size, 2);		//写一次，输出Pass读一次
+		builder.setupRenderTarget(mRenderTarget, "OutliningRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+
+		builder.setupBuffer(mUniformBuffer, "OutliningUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mSampler, "OutliningSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupShaderResourceBindings(mBindings, "OutliningBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColorTexture.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._PositionTexture.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mOutliningFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "OutliningPipeline", PSO);
+
+		mOutput.OutliningResult = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		UniformBlock ubo;
+		memcpy(ubo.view, mInput._ViewMatrix.constData(), sizeof(ubo.view));
+		ubo.colorModifier = QVector4D(mInput._ColorModifier.redF(), mInput._ColorModifier.greenF(), mInput._ColorModifier.blueF(), mInput._ColorModifier.alphaF());
+		ubo.separationDistance = QVector4D(mInput._MinSeparation, mInput._MaxSeparation, mInput._MinDistance, mInput._MaxDistance);
+		ubo.radius = qBound(0, mInput._Radius, 8);
+		ubo.farDistance = qMax(mInput._FarDistance, 0.001f);
+		ubo.padding[0] = ubo.padding[1] = 0.0f;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
 class MyRenderer : public IRenderer {
 	Q_OBJECT
 	Q_PROPERTY_VAR(int, Radius) = 2;
@@ -22,8 +144,16 @@ class MyRenderer : public IRenderer {
 	Q_PROPERTY_VAR(float, MaxSeparation) = 3.0f;
 	Q_PROPERTY_VAR(float, MinDistance) = 0.5f;
 	Q_PROPERTY_VAR(float, MaxDistance) = 2.0f;
+	Q_PROPERTY_VAR(float, FarDistance) = 100.0f;
+	Q_PROPERTY_VAR(bool, CompactRenderTargets) = true;
+
+	Q_CLASSINFO("Radius", "Min=0,Max=8")
+	Q_CLASSINFO("FarDistance", "Min=1,Max=500")
 private:
 	QStaticMeshRenderComponent mStaticComp;
+	QFrameTimeBenchmark mBenchmark;
+	QRenderTargetFormatPolicy mFormatPolicy;
+	int mReportFrameCounter = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -38,23 +168,36 @@ public:
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		mFormatPolicy.setMode(CompactRenderTargets ? QRenderTargetFormatPolicy::Compact : QRenderTargetFormatPolicy::Uniform32F);
+		mFormatPolicy.resetTraffic();
+
 		QPbrMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder<QPbrMeshPassBuilder>("MeshPass");
 
-		QOutliningPassBuilder::Output outliningOut = graphBuilder.addPassBuilder<QOutliningPassBuilder>("OutliningPass")
+		QDepthOutliningPassBuilder::Output outliningOut = graphBuilder.addPassBuilder<QDepthOutliningPassBuilder>("OutliningPass")
 			.setBaseColorTexture(meshOut.BaseColor)
 			.setPositionTexture(meshOut.Position)
+			.setViewMatrix(getCamera()->getViewMatrix())
 			.setRadius(Radius)
 			.setColorModifier(ColorModifier)
 			.setMinDistance(MinDistance)
 			.setMaxDistance(MaxDistance)
 			.setMinSeparation(MinSeparation)
 			.setMaxSeparation(MaxSeparation)
-			;
+			.setFarDistance(FarDistance)
+			.setFormatPolicy(&mFormatPolicy);
+
+		// 统计标签不包含格式模式，切换 CompactRenderTargets 后两种模式的流量记在同一个标签下对比
+		mBenchmark.setLabel(QString("Outlining radius %1").arg(Radius));
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			mBenchmark.tick(cmdBuffer);
+			if (++mReportFrameCounter % QFrameTimeBenchmark::SampleFrames == 0)
+				mFormatPolicy.reportTraffic(mBenchmark.getLabel(), "CompactRenderTargets");
+		});
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(outliningOut.OutliningReslut);
+			.setInitialTexture(outliningOut.OutliningResult);
 	}
 };
 
@@ -66,4 +209,4 @@ int main(int argc, char** argv) {
 	return app.exec();
 }
 
-#include "main.moc"
\ No newline at end of file
+#include "main.moc"
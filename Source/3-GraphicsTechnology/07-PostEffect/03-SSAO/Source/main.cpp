@@ -6,11 +6,17 @@
 #include "Render/RenderGraph/PassBuilder/QSsaoPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QBlurPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
+#include "QFrameTimeBenchmark.h"
+#include "QMotionVectorPassBuilder.h"
+#include "QRenderTargetFormatPolicy.h"
+#include <QRandomGenerator>
 
 class QSsaoMergePassBuilder : public IRenderPassBuilder {
 	QRP_INPUT_BEGIN(QSsaoMergePassBuilder)
 		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
 		QRP_INPUT_ATTR(QRhiTextureRef, SsaoTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, BentNormal);		//可选：GTAO输出的弯曲法线，用于沿未遮挡方向取半球环境光
+		QRP_INPUT_ATTR(QRenderTargetFormatPolicy*, FormatPolicy);
 	QRP_INPUT_END()
 
 	QRP_OUTPUT_BEGIN(QSsaoMergePassBuilder)
@@ -20,9 +26,11 @@ private:
 	QRhiTextureRef mColorAttachment;
 	QRhiTextureRenderTargetRef mRenderTarget;
 	QShader mMergeFS;
+	QShader mBentNormalMergeFS;
 	QRhiSamplerRef mSampler;
 	QRhiShaderResourceBindingsRef mMergeBindings;
 	QRhiGraphicsPipelineRef mMergePipeline;
+	QRhiGraphicsPipelineRef mBentNormalMergePipeline;
 public:
 	QSsaoMergePassBuilder() {
 		mMergeFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
@@ -36,16 +44,39 @@ public:
 				outFragColor = vec4(srcColor.rgb * ssaoColor.r,srcColor.a);
 			}
 		)");
+		mBentNormalMergeFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uSrcTexture;
+			layout (binding = 1) uniform sampler2D uSsaoTexture;
+			layout (binding = 2) uniform sampler2D uBentNormal;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			const float GroundAmbient = 0.6;
+			void main() {
+				vec4 srcColor = texture(uSrcTexture, vUV);
+				vec4 ssaoColor = texture(uSsaoTexture, vUV);
+				vec4 bent = texture(uBentNormal, vUV);
+				// 半球环境光：天空与地面的比例沿弯曲法线（未遮挡方向的平均）而不是几何法线计算；alpha为0表示没有几何体
+				float hemisphere = bent.a > 0.0 ? mix(GroundAmbient, 1.0, normalize(bent.xyz * 2.0 - 1.0).y * 0.5 + 0.5) : 1.0;
+				outFragColor = vec4(srcColor.rgb * ssaoColor.r * hemisphere, srcColor.a);
+			}
+		)");
 	}
 	void setup(QRenderGraphBuilder& builder) override {
-		builder.setupTexture(mColorAttachment, "SsaoMerge", QRhiTexture::Format::RGBA32F, mInput._BaseColor->pixelSize(), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		const QRhiTexture::Flags flags = QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource;
+		const QRhiTexture::Format format = mInput._FormatPolicy->selectFormat(builder.rhi(), QRenderTargetFormatPolicy::HdrColor, flags);
+		builder.setupTexture(mColorAttachment, "SsaoMerge", format, mInput._BaseColor->pixelSize(), 1, flags);
+		mInput._FormatPolicy->recordTraffic("SsaoMerge", format, mInput._BaseColor->pixelSize(), 2);
 		builder.setupRenderTarget(mRenderTarget, "SsaoMergeRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
 
 		builder.setupSampler(mSampler, "SsaoMergeSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
 
+		QRhiTexture* bentNormal = mInput._BentNormal.get() != nullptr ? mInput._BentNormal.get() : mInput._SsaoTexture.get();		//不使用弯曲法线时绑定任意纹理占位
+		if (mInput._BentNormal.get() != nullptr)
+			mInput._FormatPolicy->recordTraffic("SsaoMergeBentNormal", mInput._BentNormal.get(), 1);
 		builder.setupShaderResourceBindings(mMergeBindings, "SsaoMergeBindings", {
 			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage,mInput._BaseColor.get() ,mSampler.get()),
 			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage,mInput._SsaoTexture.get() ,mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, bentNormal, mSampler.get()),
 		});
 		QRhiGraphicsPipelineState PSO;
 		PSO.shaderResourceBindings = mMergeBindings.get();
@@ -59,6 +90,11 @@ public:
 			QRhiShaderStage(QRhiShaderStage::Fragment, mMergeFS)
 		};
 		builder.setupGraphicsPipeline(mMergePipeline, "SsaoMergePipeline", PSO);
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mBentNormalMergeFS)
+		};
+		builder.setupGraphicsPipeline(mBentNormalMergePipeline, "SsaoBentNormalMergePipeline", PSO);
 
 		mOutput.SsaoMergeResult = mColorAttachment;
 	}
@@ -66,7 +102,7 @@ public:
 		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
 		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
 		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue);
-		cmdBuffer->setGraphicsPipeline(mMergePipeline.get());
+		cmdBuffer->setGraphicsPipeline(mInput._BentNormal.get() != nullptr ? mBentNormalMergePipeline.get() : mMergePipeline.get());
 		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
 		cmdBuffer->setShaderResources(mMergeBindings.get());
 		cmdBuffer->draw(4);
@@ -74,6 +110,751 @@ public:
 	}
 }; 
 
+class QTemporalSsaoPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QTemporalSsaoPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, NormalTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, PositionTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, MotionVector);			//可选：设置后沿运动矢量取历史，运动物体也能正确重投影
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(float, Radius);
+		QRP_INPUT_ATTR(float, Bias);
+		QRP_INPUT_ATTR(int, SampleSize);
+		QRP_INPUT_ATTR(int, ResolutionDivisor);
+		QRP_INPUT_ATTR(float, HistoryWeight);
+		QRP_INPUT_ATTR(QRenderTargetFormatPolicy*, FormatPolicy);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QTemporalSsaoPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, SsaoResult)
+	QRP_OUTPUT_END()
+private:
+	static const int KernelSize = 64;
+	struct UniformBlock {
+		float view[16];
+		float viewProj[16];
+		float prevViewProj[16];
+		QVector4D kernel[KernelSize];
+		float radius;
+		float bias;
+		int sampleSize;
+		int frameIndex;
+		float historyWeight;
+		int resolutionDivisor;
+		int useMotionVector;
+		float padding;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mNearestSampler;
+	QRhiSamplerRef mLinearSampler;
+
+	QRhiTextureRef mAoTexture;
+	QRhiTextureRenderTargetRef mAoRT;
+	QRhiShaderResourceBindingsRef mAoBindings;
+	QRhiGraphicsPipelineRef mAoPipeline;
+	QShader mAoFS;
+
+	QRhiTextureRef mHistoryTexture[2];
+	QRhiTextureRenderTargetRef mHistoryRT[2];
+	QRhiShaderResourceBindingsRef mAccumulateBindings[2];
+	QRhiGraphicsPipelineRef mAccumulatePipeline;
+	QShader mAccumulateFS;
+
+	QRhiTextureRef mUpsampleTexture;
+	QRhiTextureRenderTargetRef mUpsampleRT;
+	QRhiShaderResourceBindingsRef mUpsampleBindings[2];
+	QRhiGraphicsPipelineRef mUpsamplePipeline;
+	QShader mUpsampleFS;
+
+	QVector4D mKernel[KernelSize];
+	QMatrix4x4 mPrevViewProj;
+	bool mHistoryValid = false;
+	int mFrameIndex = 0;
+	QSize mLowResSize;
+public:
+	void resetHistory() { mHistoryValid = false; }
+	QTemporalSsaoPassBuilder() {
+		QRandomGenerator random(0);
+		for (int i = 0; i < KernelSize; i++) {
+			QVector3D sample(random.generateDouble() * 2.0 - 1.0, random.generateDouble() * 2.0 - 1.0, random.generateDouble());
+			sample = sample.normalized() * random.generateDouble();
+			float scale = float(i) / KernelSize;
+			scale = 0.1f + scale * scale * 0.9f;					//让采样点向中心聚集
+			mKernel[i] = QVector4D(sample * scale, 0.0f);
+		}
+
+		const QByteArray uniformDefine = R"(
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				mat4 viewProj;
+				mat4 prevViewProj;
+				vec4 kernel[64];
+				float radius;
+				float bias;
+				int sampleSize;
+				int frameIndex;
+				float historyWeight;
+				int resolutionDivisor;
+				int useMotionVector;
+			}UBO;
+		)";
+
+		mAoFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformDefine + R"(
+			layout (binding = 1) uniform sampler2D uPosition;
+			layout (binding = 2) uniform sampler2D uNormal;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outAo;
+
+			float interleavedGradientNoise(vec2 pixel) {
+				pixel += float(UBO.frameIndex % 64) * 5.588238;
+				return fract(52.9829189 * fract(0.06711056 * pixel.x + 0.00583715 * pixel.y));
+			}
+
+			void main() {
+				ivec2 lowResPixel = ivec2(gl_FragCoord.xy);
+				ivec2 fullResPixel = lowResPixel * UBO.resolutionDivisor + UBO.resolutionDivisor / 2;
+				vec3 position = texelFetch(uPosition, fullResPixel, 0).xyz;
+				vec3 normal = texelFetch(uNormal, fullResPixel, 0).xyz;
+				float viewDepth = (UBO.view * vec4(position, 1.0)).z;
+				if (dot(normal, normal) < 1e-4) {
+					outAo = vec4(1.0, viewDepth, 0.0, 1.0);
+					return;
+				}
+				normal = normalize(normal);
+
+				// 交错采样：4x4像素块与帧序号共同决定使用的核子集和旋转角
+				int interleaveIndex = (lowResPixel.x & 3) + ((lowResPixel.y & 3) << 2);
+				int kernelOffset = (interleaveIndex + UBO.frameIndex) * UBO.sampleSize;
+				float angle = interleavedGradientNoise(vec2(lowResPixel)) * 6.2831853;
+				vec3 randomVec = vec3(cos(angle), sin(angle), 0.0);
+				vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+				if (any(isnan(tangent)))
+					tangent = normalize(cross(normal, vec3(0.0, 0.0, 1.0)));
+				mat3 TBN = mat3(tangent, cross(normal, tangent), normal);
+
+				float occlusion = 0.0;
+				for (int i = 0; i < UBO.sampleSize; i++) {
+					vec3 samplePos = position + TBN * UBO.kernel[(kernelOffset + i) & 63].xyz * UBO.radius;
+					vec4 offset = UBO.viewProj * vec4(samplePos, 1.0);
+					vec2 sampleUV = offset.xy / offset.w * 0.5 + 0.5;
+					vec3 scenePos = texture(uPosition, sampleUV).xyz;
+					float sceneDepth = (UBO.view * vec4(scenePos, 1.0)).z;
+					float sampleDepth = (UBO.view * vec4(samplePos, 1.0)).z;
+					float rangeCheck = smoothstep(0.0, 1.0, UBO.radius / abs(viewDepth - sceneDepth));
+					occlusion += (sceneDepth >= sampleDepth + UBO.bias ? 1.0 : 0.0) * rangeCheck;
+				}
+				outAo = vec4(1.0 - occlusion / float(UBO.sampleSize), viewDepth, 0.0, 1.0);
+			}
+		)");
+
+		mAccumulateFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformDefine + R"(
+			layout (binding = 1) uniform sampler2D uCurrentAo;
+			layout (binding = 2) uniform sampler2D uHistoryAo;
+			layout (binding = 3) uniform sampler2D uPosition;
+			layout (binding = 4) uniform sampler2D uMotionVector;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outAo;
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec2 current = texelFetch(uCurrentAo, pixel, 0).rg;
+
+				float minAo = current.r;
+				float maxAo = current.r;
+				for (int y = -1; y <= 1; y++) {
+					for (int x = -1; x <= 1; x++) {
+						float ao = texelFetch(uCurrentAo, pixel + ivec2(x, y), 0).r;
+						minAo = min(minAo, ao);
+						maxAo = max(maxAo, ao);
+					}
+				}
+
+				ivec2 fullResPixel = pixel * UBO.resolutionDivisor + UBO.resolutionDivisor / 2;
+				float weight = UBO.historyWeight;
+				vec2 prevUV;
+				float prevDepth;
+				if (UBO.useMotionVector != 0) {
+					// 运动矢量已经包含相机与物体的运动；物体上一帧的深度未知，用当前深度近似做遮挡判断
+					prevUV = (vec2(fullResPixel) + 0.5) / vec2(textureSize(uMotionVector, 0)) - texelFetch(uMotionVector, fullResPixel, 0).xy;
+					prevDepth = -current.g;
+				}
+				else {
+					// 用上一帧的相机矩阵重投影世界坐标，取得历史AO
+					vec3 position = texelFetch(uPosition, fullResPixel, 0).xyz;
+					vec4 prevClip = UBO.prevViewProj * vec4(position, 1.0);
+					prevUV = prevClip.xy / prevClip.w * 0.5 + 0.5;
+					prevDepth = prevClip.w;								//透视投影下 w 即上一帧的视空间深度
+					if (prevClip.w <= 0.0)
+						weight = 0.0;
+				}
+				if (any(lessThan(prevUV, vec2(0.0))) || any(greaterThan(prevUV, vec2(1.0))))
+					weight = 0.0;
+				vec2 history = texture(uHistoryAo, prevUV).rg;
+				if (abs(-history.g - prevDepth) > 0.05 * prevDepth)		//深度不一致说明发生了遮挡变化
+					weight = 0.0;
+				float ao = mix(current.r, clamp(history.r, minAo, maxAo), weight);
+				outAo = vec4(ao, current.g, 0.0, 1.0);
+			}
+		)");
+
+		mUpsampleFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformDefine + R"(
+			layout (binding = 1) uniform sampler2D uLowResAo;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				float depth = (UBO.view * vec4(texelFetch(uPosition, pixel, 0).xyz, 1.0)).z;
+				ivec2 lowResSize = textureSize(uLowResAo, 0);
+				vec2 lowResCoord = (vec2(pixel) + 0.5) / float(UBO.resolutionDivisor) - 0.5;
+				ivec2 base = ivec2(floor(lowResCoord));
+				vec2 f = fract(lowResCoord);
+				float bilinear[4] = float[](
+					(1.0 - f.x) * (1.0 - f.y),
+					f.x * (1.0 - f.y),
+					(1.0 - f.x) * f.y,
+					f.x * f.y
+				);
+				ivec2 offsets[4] = ivec2[](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+				float totalAo = 0.0;
+				float totalWeight = 0.0;
+				for (int i = 0; i < 4; i++) {
+					ivec2 coord = clamp(base + offsets[i], ivec2(0), lowResSize - 1);
+					vec2 aoDepth = texelFetch(uLowResAo, coord, 0).rg;
+					float weight = bilinear[i] / (1e-3 + abs(aoDepth.g - depth));
+					totalAo += aoDepth.r * weight;
+					totalWeight += weight;
+				}
+				outFragColor = vec4(totalWeight > 0.0 ? totalAo / totalWeight : 1.0);
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize fullResSize = mInput._PositionTexture->pixelSize();
+		const int divisor = qBound(1, mInput._ResolutionDivisor, 4);
+		const QSize lowResSize = QSize(qMax(1, fullResSize.width() / divisor), qMax(1, fullResSize.height() / divisor));
+		if (lowResSize != mLowResSize) {
+			mLowResSize = lowResSize;
+			mHistoryValid = false;
+		}
+
+		builder.setupBuffer(mUniformBuffer, "TemporalSsaoUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mNearestSampler, "TemporalSsaoNearestSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mLinearSampler, "TemporalSsaoLinearSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		QRenderTargetFormatPolicy* policy = mInput._FormatPolicy;
+		const QRhiTexture::Format lowResFormat = policy->selectFormat(mRhi, QRenderTargetFormatPolicy::OcclusionWithDepth, QRhiTexture::RenderTarget);
+		const QRhiTexture::Format resultFormat = policy->selectFormat(mRhi, QRenderTargetFormatPolicy::Occlusion, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		policy->recordTraffic("TemporalSsaoRaw", lowResFormat, lowResSize, 1 + 9);			//写一次，累积时3x3邻域读取
+		policy->recordTraffic("TemporalSsaoHistory", lowResFormat, lowResSize, 1 + 1 + 4);		//读历史、写历史、上采样4次读取
+		policy->recordTraffic("TemporalSsaoResult", resultFormat, fullResSize, 2);
+
+		builder.setupTexture(mAoTexture, "TemporalSsaoRaw", lowResFormat, lowResSize, 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mAoRT, "TemporalSsaoRawRT", QRhiTextureRenderTargetDescription(mAoTexture.get()));
+		builder.setupShaderResourceBindings(mAoBindings, "TemporalSsaoRawBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._NormalTexture.get(), mNearestSampler.get()),
+		});
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mAoBindings.get();
+		PSO.sampleCount = mAoRT->sampleCount();
+		PSO.renderPassDesc = mAoRT->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mAoFS)
+		};
+		builder.setupGraphicsPipeline(mAoPipeline, "TemporalSsaoRawPipeline", PSO);
+
+		for (int i = 0; i < 2; i++) {
+			builder.setupTexture(mHistoryTexture[i], "TemporalSsaoHistory" + QByteArray::number(i), lowResFormat, lowResSize, 1, QRhiTexture::RenderTarget);
+			builder.setupRenderTarget(mHistoryRT[i], "TemporalSsaoHistoryRT" + QByteArray::number(i), QRhiTextureRenderTargetDescription(mHistoryTexture[i].get()));
+		}
+		QRhiTexture* motionVector = mInput._MotionVector.get() != nullptr ? mInput._MotionVector.get() : mInput._PositionTexture.get();		//不使用运动矢量时绑定任意纹理占位
+		for (int i = 0; i < 2; i++) {				// i 为本帧写入的历史纹理
+			builder.setupShaderResourceBindings(mAccumulateBindings[i], "TemporalSsaoAccumulateBindings" + QByteArray::number(i), {
+				QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+				QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mAoTexture.get(), mNearestSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mHistoryTexture[1 - i].get(), mLinearSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, motionVector, mNearestSampler.get()),
+			});
+			builder.setupShaderResourceBindings(mUpsampleBindings[i], "TemporalSsaoUpsampleBindings" + QByteArray::number(i), {
+				QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+				QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mHistoryTexture[i].get(), mNearestSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			});
+		}
+		PSO.shaderResourceBindings = mAccumulateBindings[0].get();
+		PSO.sampleCount = mHistoryRT[0]->sampleCount();
+		PSO.renderPassDesc = mHistoryRT[0]->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mAccumulateFS)
+		};
+		builder.setupGraphicsPipeline(mAccumulatePipeline, "TemporalSsaoAccumulatePipeline", PSO);
+
+		builder.setupTexture(mUpsampleTexture, "TemporalSsaoResult", resultFormat, fullResSize, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mUpsampleRT, "TemporalSsaoResultRT", QRhiTextureRenderTargetDescription(mUpsampleTexture.get()));
+		PSO.shaderResourceBindings = mUpsampleBindings[0].get();
+		PSO.sampleCount = mUpsampleRT->sampleCount();
+		PSO.renderPassDesc = mUpsampleRT->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mUpsampleFS)
+		};
+		builder.setupGraphicsPipeline(mUpsamplePipeline, "TemporalSsaoUpsamplePipeline", PSO);
+
+		mOutput.SsaoResult = mUpsampleTexture;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QMatrix4x4 viewProj = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+		UniformBlock ubo;
+		memcpy(ubo.view, mInput._ViewMatrix.constData(), sizeof(ubo.view));
+		memcpy(ubo.viewProj, viewProj.constData(), sizeof(ubo.viewProj));
+		memcpy(ubo.prevViewProj, (mHistoryValid ? mPrevViewProj : viewProj).constData(), sizeof(ubo.prevViewProj));
+		memcpy(ubo.kernel, mKernel, sizeof(ubo.kernel));
+		ubo.radius = mInput._Radius;
+		ubo.bias = mInput._Bias;
+		ubo.sampleSize = qBound(1, mInput._SampleSize, KernelSize);
+		ubo.frameIndex = mFrameIndex;
+		ubo.historyWeight = mHistoryValid ? qBound(0.0f, mInput._HistoryWeight, 0.98f) : 0.0f;
+		ubo.resolutionDivisor = qBound(1, mInput._ResolutionDivisor, 4);
+		ubo.useMotionVector = mInput._MotionVector.get() != nullptr ? 1 : 0;
+		ubo.padding = 0.0f;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		const QColor clearColor = QColor::fromRgbF(1.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mAoRT.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mAoPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mAoRT->pixelSize().width(), mAoRT->pixelSize().height()));
+		cmdBuffer->setShaderResources(mAoBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+
+		const int current = mFrameIndex & 1;
+		cmdBuffer->beginPass(mHistoryRT[current].get(), clearColor, dsClearValue);
+		cmdBuffer->setGraphicsPipeline(mAccumulatePipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mHistoryRT[current]->pixelSize().width(), mHistoryRT[current]->pixelSize().height()));
+		cmdBuffer->setShaderResources(mAccumulateBindings[current].get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+
+		cmdBuffer->beginPass(mUpsampleRT.get(), clearColor, dsClearValue);
+		cmdBuffer->setGraphicsPipeline(mUpsamplePipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mUpsampleRT->pixelSize().width(), mUpsampleRT->pixelSize().height()));
+		cmdBuffer->setShaderResources(mUpsampleBindings[current].get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+
+		mPrevViewProj = viewProj;
+		mHistoryValid = true;
+		mFrameIndex++;
+	}
+};
+
+class QGtaoPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QGtaoPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, NormalTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, PositionTexture);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(float, Radius);
+		QRP_INPUT_ATTR(float, FalloffRange);
+		QRP_INPUT_ATTR(int, SliceCount);
+		QRP_INPUT_ATTR(int, StepsPerSlice);
+		QRP_INPUT_ATTR(QRenderTargetFormatPolicy*, FormatPolicy);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QGtaoPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, GtaoResult)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, BentNormal)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float view[16];
+		float projection[16];
+		float radius;
+		float falloffRange;
+		int sliceCount;
+		int stepsPerSlice;
+		int depthMipCount;
+		float padding[3];
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mNearestSampler;
+	QRhiSamplerRef mDepthSampler;
+
+	QRhiTextureRef mDepthPyramid;
+	QRhiShaderResourceBindingsRef mDepthInitBindings;
+	QRhiComputePipelineRef mDepthInitPipeline;
+	QVector<QRhiShaderResourceBindingsRef> mDepthDownsampleBindings;
+	QRhiComputePipelineRef mDepthDownsamplePipeline;
+	QShader mDepthInitCS;
+	QShader mDepthDownsampleCS;
+
+	QRhiTextureRef mAoTexture;
+	QRhiTextureRef mBentNormalTexture;
+	QRhiShaderResourceBindingsRef mGtaoBindings;
+	QRhiComputePipelineRef mGtaoPipeline;
+	QByteArray mGtaoSource;							//存储图像的格式限定符由格式策略决定，格式变化时重新编译
+	QByteArray mGtaoShaderKey;
+	QShader mGtaoCS;
+	int mDepthMipCount = 1;
+public:
+	QGtaoPassBuilder() {
+		mDepthInitCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				mat4 projection;
+				float radius;
+				float falloffRange;
+				int sliceCount;
+				int stepsPerSlice;
+				int depthMipCount;
+			}UBO;
+			layout (binding = 1) uniform sampler2D uPosition;
+			layout (binding = 2, r32f) uniform writeonly image2D uDepth;
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(pixel, imageSize(uDepth))))
+					return;
+				vec4 position = texelFetch(uPosition, pixel, 0);
+				float depth = position.w > 0.0 ? -(UBO.view * vec4(position.xyz, 1.0)).z : 1e6;	//无几何体的像素视为无限远
+				imageStore(uDepth, pixel, vec4(depth));
+			}
+		)");
+
+		mDepthDownsampleCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0, r32f) uniform readonly image2D uSrcDepth;
+			layout (binding = 1, r32f) uniform writeonly image2D uDstDepth;
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(pixel, imageSize(uDstDepth))))
+					return;
+				ivec2 srcMax = imageSize(uSrcDepth) - 1;
+				ivec2 src = pixel * 2;
+				float d0 = imageLoad(uSrcDepth, min(src, srcMax)).r;
+				float d1 = imageLoad(uSrcDepth, min(src + ivec2(1, 0), srcMax)).r;
+				float d2 = imageLoad(uSrcDepth, min(src + ivec2(0, 1), srcMax)).r;
+				float d3 = imageLoad(uSrcDepth, min(src + ivec2(1, 1), srcMax)).r;
+				imageStore(uDstDepth, pixel, vec4(min(min(d0, d1), min(d2, d3))));		//保守地保留最近的深度，避免远距离采样漏掉遮挡物
+			}
+		)");
+
+		mGtaoSource = R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				mat4 projection;
+				float radius;
+				float falloffRange;
+				int sliceCount;
+				int stepsPerSlice;
+				int depthMipCount;
+			}UBO;
+			layout (binding = 1) uniform sampler2D uDepth;
+			layout (binding = 2) uniform sampler2D uNormal;
+			layout (binding = 3, AO_IMAGE_FORMAT) uniform writeonly image2D uAo;
+			layout (binding = 4, BENT_NORMAL_IMAGE_FORMAT) uniform writeonly image2D uBentNormal;
+
+			const float PI = 3.14159265;
+			const float HALF_PI = 1.57079633;
+
+			vec3 reconstructViewPos(vec2 uv, float depth) {
+				vec2 ndc = uv * 2.0 - 1.0;
+				return vec3(ndc.x * depth / UBO.projection[0][0], ndc.y * depth / UBO.projection[1][1], -depth);
+			}
+
+			float interleavedGradientNoise(vec2 pixel) {
+				return fract(52.9829189 * fract(0.06711056 * pixel.x + 0.00583715 * pixel.y));
+			}
+
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				ivec2 size = imageSize(uAo);
+				if (any(greaterThanEqual(pixel, size)))
+					return;
+				vec2 texelSize = 1.0 / vec2(size);
+				vec2 uv = (vec2(pixel) + 0.5) * texelSize;
+				float depth = texelFetch(uDepth, pixel, 0).r;
+				vec3 worldNormal = texelFetch(uNormal, pixel, 0).xyz;
+				if (depth >= 1e5 || dot(worldNormal, worldNormal) < 1e-4) {
+					imageStore(uAo, pixel, vec4(1.0));
+					imageStore(uBentNormal, pixel, vec4(0.5, 0.5, 1.0, 0.0));		//alpha为0标记没有几何体
+					return;
+				}
+				vec3 P = reconstructViewPos(uv, depth);
+				vec3 V = normalize(-P);
+				vec3 N = normalize(mat3(UBO.view) * worldNormal);
+
+				// 将世界空间半径投影到屏幕，得到步进的像素范围
+				float screenRadius = UBO.radius * abs(UBO.projection[0][0]) / depth * 0.5 * float(size.x);
+				float stepPixels = max(screenRadius, 1.0) / float(UBO.stepsPerSlice + 1);
+				float falloffFrom = UBO.radius * (1.0 - UBO.falloffRange);
+				float falloffMul = -1.0 / max(UBO.radius * UBO.falloffRange, 1e-4);
+				float falloffAdd = falloffFrom / max(UBO.radius * UBO.falloffRange, 1e-4) + 1.0;
+
+				float noise = interleavedGradientNoise(vec2(pixel));
+				float visibility = 0.0;
+				vec3 bentNormal = vec3(0.0);
+				for (int slice = 0; slice < UBO.sliceCount; slice++) {
+					float phi = (float(slice) + noise) / float(UBO.sliceCount) * PI;
+					vec2 omega = vec2(cos(phi), sin(phi));
+					vec3 directionVec = vec3(omega.x * sign(UBO.projection[0][0]), omega.y * sign(UBO.projection[1][1]), 0.0);
+					vec3 orthoDirectionVec = directionVec - dot(directionVec, V) * V;
+					vec3 axisVec = normalize(cross(orthoDirectionVec, V));
+					vec3 projectedNormal = N - axisVec * dot(N, axisVec);
+					float projectedNormalLength = length(projectedNormal);
+					float signNorm = sign(dot(orthoDirectionVec, projectedNormal));
+					float cosNorm = clamp(dot(projectedNormal, V) / max(projectedNormalLength, 1e-4), 0.0, 1.0);
+					float n = signNorm * acos(cosNorm);
+
+					float horizonCos0 = -1.0;
+					float horizonCos1 = -1.0;
+					for (int step = 0; step < UBO.stepsPerSlice; step++) {
+						float offsetPixels = (float(step) + fract(noise + float(step) * 0.618034) + 1.0) * stepPixels;
+						float mipLevel = clamp(log2(offsetPixels) - 3.3, 0.0, float(UBO.depthMipCount - 1));
+						vec2 sampleOffset = omega * offsetPixels * texelSize;
+
+						vec2 uv0 = uv + sampleOffset;
+						vec2 uv1 = uv - sampleOffset;
+						vec3 delta0 = reconstructViewPos(uv0, textureLod(uDepth, uv0, mipLevel).r) - P;
+						vec3 delta1 = reconstructViewPos(uv1, textureLod(uDepth, uv1, mipLevel).r) - P;
+						float dist0 = length(delta0);
+						float dist1 = length(delta1);
+						float weight0 = clamp(dist0 * falloffMul + falloffAdd, 0.0, 1.0);
+						float weight1 = clamp(dist1 * falloffMul + falloffAdd, 0.0, 1.0);
+						horizonCos0 = max(horizonCos0, mix(-1.0, dot(delta0 / max(dist0, 1e-4), V), weight0));
+						horizonCos1 = max(horizonCos1, mix(-1.0, dot(delta1 / max(dist1, 1e-4), V), weight1));
+					}
+
+					float h0 = -acos(clamp(horizonCos1, -1.0, 1.0));
+					float h1 = acos(clamp(horizonCos0, -1.0, 1.0));
+					h0 = n + max(h0 - n, -HALF_PI);
+					h1 = n + min(h1 - n, HALF_PI);
+					float iarc0 = (cosNorm + 2.0 * h0 * sin(n) - cos(2.0 * h0 - n)) / 4.0;
+					float iarc1 = (cosNorm + 2.0 * h1 * sin(n) - cos(2.0 * h1 - n)) / 4.0;
+					visibility += projectedNormalLength * (iarc0 + iarc1);
+
+					// 对切片内可见弧积分得到弯曲法线
+					float t0 = (6.0 * sin(h0 - n) - sin(3.0 * h0 - n) + 6.0 * sin(h1 - n) - sin(3.0 * h1 - n) + 16.0 * sin(n) - 3.0 * (sin(h0 + n) + sin(h1 + n))) / 12.0;
+					float t1 = (-cos(3.0 * h0 - n) - cos(3.0 * h1 - n) + 8.0 * cos(n) - 3.0 * (cos(h0 + n) + cos(h1 + n))) / 12.0;
+					vec3 sliceTangent = normalize(orthoDirectionVec);
+					bentNormal += (sliceTangent * t0 + V * t1) * projectedNormalLength;
+				}
+				visibility = clamp(visibility / float(UBO.sliceCount), 0.0, 1.0);
+				bentNormal = length(bentNormal) > 1e-4 ? normalize(bentNormal) : N;
+				vec3 worldBentNormal = transpose(mat3(UBO.view)) * bentNormal;
+				imageStore(uAo, pixel, vec4(visibility));
+				imageStore(uBentNormal, pixel, vec4(worldBentNormal * 0.5 + 0.5, visibility));
+			}
+		)";
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize size = mInput._PositionTexture->pixelSize();
+		mDepthMipCount = mRhi->mipLevelsForSize(size);
+
+		builder.setupBuffer(mUniformBuffer, "GtaoUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mNearestSampler, "GtaoNearestSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mDepthSampler, "GtaoDepthSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		builder.setupTexture(mDepthPyramid, "GtaoDepthPyramid", QRhiTexture::Format::R32F, size, 1, QRhiTexture::MipMapped | QRhiTexture::UsedWithLoadStore);
+		builder.setupShaderResourceBindings(mDepthInitBindings, "GtaoDepthInitBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::imageStore(2, QRhiShaderResourceBinding::ComputeStage, mDepthPyramid.get(), 0),
+		});
+		QRhiComputePipelineState initPSO;
+		initPSO.shaderResourceBindings = mDepthInitBindings.get();
+		initPSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mDepthInitCS);
+		builder.setupComputePipeline(mDepthInitPipeline, "GtaoDepthInitPipeline", initPSO);
+
+		mDepthDownsampleBindings.resize(mDepthMipCount - 1);
+		for (int level = 1; level < mDepthMipCount; level++) {
+			builder.setupShaderResourceBindings(mDepthDownsampleBindings[level - 1], "GtaoDepthDownsampleBindings" + QByteArray::number(level), {
+				QRhiShaderResourceBinding::imageLoad(0, QRhiShaderResourceBinding::ComputeStage, mDepthPyramid.get(), level - 1),
+				QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, mDepthPyramid.get(), level),
+			});
+		}
+		if (!mDepthDownsampleBindings.isEmpty()) {
+			QRhiComputePipelineState downsamplePSO;
+			downsamplePSO.shaderResourceBindings = mDepthDownsampleBindings.first().get();
+			downsamplePSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mDepthDownsampleCS);
+			builder.setupComputePipeline(mDepthDownsamplePipeline, "GtaoDepthDownsamplePipeline", downsamplePSO);
+		}
+
+		// 深度金字塔保持R32F：深度精度直接影响地平线角度，两种模式下都不压缩
+		QRenderTargetFormatPolicy* policy = mInput._FormatPolicy;
+		const QRhiTexture::Format aoFormat = policy->selectFormat(mRhi, QRenderTargetFormatPolicy::StorageOcclusion, QRhiTexture::UsedWithLoadStore);
+		const QRhiTexture::Format bentNormalFormat = policy->selectFormat(mRhi, QRenderTargetFormatPolicy::StorageDirection, QRhiTexture::UsedWithLoadStore);
+		policy->recordTraffic("GtaoDepthPyramid", QRhiTexture::R32F, size, 2 + 2 * mInput._SliceCount * mInput._StepsPerSlice);
+		policy->recordTraffic("GtaoResult", aoFormat, size, 2);
+		policy->recordTraffic("GtaoBentNormal", bentNormalFormat, size, 1);
+		builder.setupTexture(mAoTexture, "GtaoResult", aoFormat, size, 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupTexture(mBentNormalTexture, "GtaoBentNormal", bentNormalFormat, size, 1, QRhiTexture::UsedWithLoadStore);
+		const QByteArray aoImageFormat = QTextureFormatInfo::glslImageFormat(aoFormat);
+		const QByteArray bentNormalImageFormat = QTextureFormatInfo::glslImageFormat(bentNormalFormat);
+		const QByteArray shaderKey = aoImageFormat + "/" + bentNormalImageFormat;
+		if (shaderKey != mGtaoShaderKey) {
+			mGtaoShaderKey = shaderKey;
+			QByteArray source = mGtaoSource;
+			source.replace("BENT_NORMAL_IMAGE_FORMAT", bentNormalImageFormat).replace("AO_IMAGE_FORMAT", aoImageFormat);
+			mGtaoCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, source);
+		}
+		builder.setupShaderResourceBindings(mGtaoBindings, "GtaoBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mDepthPyramid.get(), mDepthSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::ComputeStage, mInput._NormalTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::imageStore(3, QRhiShaderResourceBinding::ComputeStage, mAoTexture.get(), 0),
+			QRhiShaderResourceBinding::imageStore(4, QRhiShaderResourceBinding::ComputeStage, mBentNormalTexture.get(), 0),
+		});
+		QRhiComputePipelineState gtaoPSO;
+		gtaoPSO.shaderResourceBindings = mGtaoBindings.get();
+		gtaoPSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mGtaoCS);
+		builder.setupComputePipeline(mGtaoPipeline, "GtaoPipeline", gtaoPSO);
+
+		mOutput.GtaoResult = mAoTexture;
+		mOutput.BentNormal = mBentNormalTexture;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QMatrix4x4 projection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix;
+		UniformBlock ubo;
+		memcpy(ubo.view, mInput._ViewMatrix.constData(), sizeof(ubo.view));
+		memcpy(ubo.projection, projection.constData(), sizeof(ubo.projection));
+		ubo.radius = mInput._Radius;
+		ubo.falloffRange = qBound(0.01f, mInput._FalloffRange, 1.0f);
+		ubo.sliceCount = qBound(1, mInput._SliceCount, 8);
+		ubo.stepsPerSlice = qBound(1, mInput._StepsPerSlice, 16);
+		ubo.depthMipCount = mDepthMipCount;
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		const QSize size = mDepthPyramid->pixelSize();
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mDepthInitPipeline.get());
+		cmdBuffer->setShaderResources(mDepthInitBindings.get());
+		cmdBuffer->dispatch((size.width() + 7) / 8, (size.height() + 7) / 8, 1);
+		if (mDepthDownsamplePipeline) {
+			cmdBuffer->setComputePipeline(mDepthDownsamplePipeline.get());
+			for (int level = 1; level < mDepthMipCount; level++) {
+				const int width = qMax(1, size.width() >> level);
+				const int height = qMax(1, size.height() >> level);
+				cmdBuffer->setShaderResources(mDepthDownsampleBindings[level - 1].get());
+				cmdBuffer->dispatch((width + 7) / 8, (height + 7) / 8, 1);
+			}
+		}
+		cmdBuffer->setComputePipeline(mGtaoPipeline.get());
+		cmdBuffer->setShaderResources(mGtaoBindings.get());
+		cmdBuffer->dispatch((size.width() + 7) / 8, (size.height() + 7) / 8, 1);
+		cmdBuffer->endComputePass();
+	}
+};
+
+// 统计AO结果相对参考结果的平均与最大绝对误差，只计入有几何体的像素
+// AO纹理可以是降采样的，按参考纹理的分辨率线性采样后比较
+class QAoErrorPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QAoErrorPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, AoTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, ReferenceTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, PositionTexture);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QAoErrorPassBuilder)
+	QRP_OUTPUT_END()
+public:
+	struct Result {
+		float meanError = 0.0f;
+		float maxError = 0.0f;
+		quint32 pixelCount = 0;
+	};
+	const Result& getLastResult() const { return mLastResult; }
+private:
+	static constexpr float ErrorScale = 256.0f;		//误差按定点数累加，4K分辨率下总和仍不会溢出32位
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mResultBuffer;
+	QRhiSamplerRef mNearestSampler;
+	QRhiSamplerRef mLinearSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiComputePipelineRef mPipeline;
+	QShader mErrorCS;
+	QRhiBufferReadbackResult mReadback;
+	Result mLastResult;
+public:
+	QAoErrorPassBuilder() {
+		mErrorCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0) uniform sampler2D uAo;
+			layout (binding = 1) uniform sampler2D uReference;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (std430, binding = 3) buffer Result {
+				uint errorSum;
+				uint pixelCount;
+				uint maxError;
+			};
+			const float ErrorScale = 256.0;
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				ivec2 size = textureSize(uReference, 0);
+				if (any(greaterThanEqual(pixel, size)) || texelFetch(uPosition, pixel, 0).w <= 0.0)
+					return;
+				vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+				float error = abs(clamp(texture(uAo, uv).r, 0.0, 1.0) - texelFetch(uReference, pixel, 0).r);
+				atomicAdd(errorSum, uint(error * ErrorScale + 0.5));
+				atomicAdd(pixelCount, 1u);
+				atomicMax(maxError, floatBitsToUint(error));		//非负浮点数的位模式与数值大小顺序一致
+			}
+		)");
+		mReadback.completed = [this]() {
+			if (mReadback.data.size() < int(sizeof(quint32) * 3))
+				return;
+			quint32 values[3];
+			memcpy(values, mReadback.data.constData(), sizeof(values));
+			mLastResult.pixelCount = values[1];
+			mLastResult.meanError = values[1] > 0 ? values[0] / ErrorScale / values[1] : 0.0f;
+			memcpy(&mLastResult.maxError, &values[2], sizeof(float));
+		};
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		builder.setupBuffer(mResultBuffer, "AoErrorResult", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(quint32) * 3);
+		builder.setupSampler(mNearestSampler, "AoErrorNearestSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mLinearSampler, "AoErrorLinearSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupShaderResourceBindings(mBindings, "AoErrorBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::ComputeStage, mInput._AoTexture.get(), mLinearSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mInput._ReferenceTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::ComputeStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::bufferLoadStore(3, QRhiShaderResourceBinding::ComputeStage, mResultBuffer.get()),
+		});
+		QRhiComputePipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mErrorCS);
+		builder.setupComputePipeline(mPipeline, "AoErrorPipeline", PSO);
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const quint32 zero[3] = { 0, 0, 0 };
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->uploadStaticBuffer(mResultBuffer.get(), zero);
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mPipeline.get());
+		cmdBuffer->setShaderResources(mBindings.get());
+		const QSize size = mInput._ReferenceTexture->pixelSize();
+		cmdBuffer->dispatch((size.width() + 7) / 8, (size.height() + 7) / 8, 1);
+		QRhiResourceUpdateBatch* readbackBatch = mRhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(mResultBuffer.get(), 0, sizeof(zero), &mReadback);
+		cmdBuffer->endComputePass(readbackBatch);
+	}
+};
+
 #define Q_PROPERTY_VAR(Type, Name)\
     Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
     Type get_##Name(){ return Name; } \
@@ -85,6 +866,15 @@ public:
 
 class MyRenderer : public IRenderer {
 	Q_OBJECT
+public:
+	enum AmbientOcclusionMethod {
+		Ssao,
+		TemporalSsao,
+		Gtao
+	};
+	Q_ENUM(AmbientOcclusionMethod)
+private:
+	Q_PROPERTY_VAR(AmbientOcclusionMethod, Method) = TemporalSsao;
 
 	Q_PROPERTY_VAR(float, Bias) = 0.1f;
 	Q_PROPERTY_VAR(float, Radius) = 2.0f;
@@ -94,12 +884,44 @@ class MyRenderer : public IRenderer {
 	Q_PROPERTY_VAR(int, BlurSize) = 4;
 	Q_PROPERTY_VAR(int, DownSampleCount) = 2;
 
+	Q_PROPERTY_VAR(int, ResolutionDivisor) = 2;
+	Q_PROPERTY_VAR(int, TemporalSampleSize) = 16;
+	Q_PROPERTY_VAR(float, HistoryWeight) = 0.9f;
+	Q_PROPERTY_VAR(bool, UseMotionVectors) = false;
+
+	Q_PROPERTY_VAR(int, GtaoSliceCount) = 2;
+	Q_PROPERTY_VAR(int, GtaoStepsPerSlice) = 4;
+	Q_PROPERTY_VAR(float, GtaoFalloffRange) = 0.6f;
+	Q_PROPERTY_VAR(bool, BentNormalAmbient) = true;
+
+	Q_PROPERTY_VAR(bool, MeasureQuality) = false;			//额外运行高采样数的GTAO作为参考，统计当前方法的误差
+
+	Q_PROPERTY_VAR(bool, CompactRenderTargets) = true;
+
 	Q_CLASSINFO("SampleSize", "Min=1,Max=128")
 	Q_CLASSINFO("BlurIterations", "Min=1,Max=8")
 	Q_CLASSINFO("BlurSize", "Min=1,Max=80")
 	Q_CLASSINFO("DownSampleCount", "Min=1,Max=16")
+	Q_CLASSINFO("ResolutionDivisor", "Min=1,Max=4")
+	Q_CLASSINFO("TemporalSampleSize", "Min=1,Max=64")
+	Q_CLASSINFO("HistoryWeight", "Min=0,Max=0.98")
+	Q_CLASSINFO("GtaoSliceCount", "Min=1,Max=8")
+	Q_CLASSINFO("GtaoStepsPerSlice", "Min=1,Max=16")
+	Q_CLASSINFO("GtaoFalloffRange", "Min=0.01,Max=1")
+private:
+	static constexpr int ReferenceSliceCount = 8;				//参考结果使用GTAO允许的最大采样数
+	static constexpr int ReferenceStepsPerSlice = 16;
 private:
 	QStaticMeshRenderComponent mStaticComp;
+	QFrameTimeBenchmark mBenchmark;
+	QRenderTargetFormatPolicy mFormatPolicy;
+	int mReportFrameCounter = 0;
+	QSharedPointer<QTemporalSsaoPassBuilder> mTemporalSsaoPass{ new QTemporalSsaoPassBuilder };
+	QSharedPointer<QMotionVectorPassBuilder> mMotionVectorPass{ new QMotionVectorPassBuilder };
+	bool mTemporalSsaoActive = false;						//上一帧是否运行了时域SSAO，重新开启时丢弃过期的历史
+	bool mMotionVectorsActive = false;
+	QSharedPointer<QAoErrorPassBuilder> mAoErrorPass{ new QAoErrorPassBuilder };
+	QRenderTargetFormatPolicy mReferenceFormatPolicy;		//参考Pass的流量不计入被测方法
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -112,27 +934,140 @@ public:
 		getCamera()->setPosition(QVector3D(20, 15, 12));
 		getCamera()->setRotation(QVector3D(-30, 145, 0));
 	}
+private:
+	void reportTraffic() {
+		if (++mReportFrameCounter % 240 != 0)
+			return;
+		const QString label = mBenchmark.getLabel();
+		mFormatPolicy.reportTraffic(label, "CompactRenderTargets");
+		if (MeasureQuality) {
+			const QAoErrorPassBuilder::Result& result = mAoErrorPass->getLastResult();
+			qDebug().noquote() << QString("[AoQuality] %1: mean abs error %2, max %3 over %4 pixels against GTAO %5x%6 reference")
+				.arg(label)
+				.arg(result.meanError, 0, 'f', 4)
+				.arg(result.maxError, 0, 'f', 3)
+				.arg(result.pixelCount)
+				.arg(ReferenceSliceCount)
+				.arg(ReferenceStepsPerSlice);
+		}
+	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		mFormatPolicy.setMode(CompactRenderTargets ? QRenderTargetFormatPolicy::Compact : QRenderTargetFormatPolicy::Uniform32F);
+		mFormatPolicy.resetTraffic();
+
 		QPbrMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder<QPbrMeshPassBuilder>("MeshPass");
 
-		QSsaoPassBuilder::Output ssaoOut = graphBuilder.addPassBuilder<QSsaoPassBuilder>("SsaoPass")
-			.setNormalTexture(meshOut.Normal)
-			.setPositionTexture(meshOut.Position)
-			.setBias(Bias)
-			.setRadius(Radius)
-			.setSampleSize(SampleSize);
+		QRhiTextureRef ssaoTexture;
+		QRhiTextureRef bentNormal;
+		QString benchmarkLabel;
+		if (Method == Gtao) {
+			QGtaoPassBuilder::Output gtaoOut = graphBuilder.addPassBuilder<QGtaoPassBuilder>("GtaoPass")
+				.setNormalTexture(meshOut.Normal)
+				.setPositionTexture(meshOut.Position)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setRadius(Radius)
+				.setFalloffRange(GtaoFalloffRange)
+				.setSliceCount(GtaoSliceCount)
+				.setStepsPerSlice(GtaoStepsPerSlice)
+				.setFormatPolicy(&mFormatPolicy);
+			ssaoTexture = gtaoOut.GtaoResult;
+			if (BentNormalAmbient)
+				bentNormal = gtaoOut.BentNormal;
+			benchmarkLabel = QString("Gtao %1 slices x %2 steps%3").arg(GtaoSliceCount).arg(GtaoStepsPerSlice).arg(BentNormalAmbient ? " + bent normal ambient" : "");
+		}
+		else if (Method == TemporalSsao) {
+			// 场景中只有静止的模型，相机矩阵重投影已经准确；运动矢量路径用于验证与 08-BlinnPhong 共用的运动矢量Pass
+			QRhiTextureRef motionVector;
+			if (UseMotionVectors) {
+				if (!mMotionVectorsActive)
+					mMotionVectorPass->resetHistory();
+				QMotionVectorPassBuilder::Output motionOut = graphBuilder.addPassBuilder("MotionVectorPass", mMotionVectorPass)
+					.setPosition(meshOut.Position)
+					.setNormal(meshOut.Normal)
+					.setViewMatrix(getCamera()->getViewMatrix())
+					.setProjectionMatrix(getCamera()->getProjectionMatrix());
+				motionVector = motionOut.MotionVector;
+				graphBuilder.addPass([this, motionOut](QRhiCommandBuffer* cmdBuffer) {
+					mFormatPolicy.recordTraffic("MotionVector", motionOut.MotionVector.get(), 2);		//写一次，累积时读一次
+				});
+			}
+			if (!mTemporalSsaoActive)
+				mTemporalSsaoPass->resetHistory();
+			QTemporalSsaoPassBuilder::Output temporalOut = graphBuilder.addPassBuilder("TemporalSsaoPass", mTemporalSsaoPass)
+				.setNormalTexture(meshOut.Normal)
+				.setPositionTexture(meshOut.Position)
+				.setMotionVector(motionVector)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setBias(Bias)
+				.setRadius(Radius)
+				.setSampleSize(TemporalSampleSize)
+				.setResolutionDivisor(ResolutionDivisor)
+				.setHistoryWeight(HistoryWeight)
+				.setFormatPolicy(&mFormatPolicy);
+			ssaoTexture = temporalOut.SsaoResult;
+			benchmarkLabel = QString("TemporalSsao 1/%1 x%2%3").arg(ResolutionDivisor).arg(TemporalSampleSize).arg(UseMotionVectors ? " + motion vectors" : "");
+		}
+		else {
+			QSsaoPassBuilder::Output ssaoOut = graphBuilder.addPassBuilder<QSsaoPassBuilder>("SsaoPass")
+				.setNormalTexture(meshOut.Normal)
+				.setPositionTexture(meshOut.Position)
+				.setBias(Bias)
+				.setRadius(Radius)
+				.setSampleSize(SampleSize);
+
+			QBlurPassBuilder::Output blurOut = graphBuilder.addPassBuilder<QBlurPassBuilder>("BlurPass")
+				.setBaseColorTexture(ssaoOut.SsaoResult)
+				.setBlurIterations(BlurIterations)
+				.setBlurSize(BlurSize)
+				.setDownSampleCount(DownSampleCount);
+			ssaoTexture = blurOut.BlurResult;
+			benchmarkLabel = QString("Ssao x%1 + Blur").arg(SampleSize);
+
+			// 引擎Pass的纹理格式不受格式策略控制，按实际格式记录；模糊Pass内部的降采样纹理不可见，没有计入
+			graphBuilder.addPass([this, ssaoOut, blurOut](QRhiCommandBuffer* cmdBuffer) {
+				mFormatPolicy.recordTraffic("SsaoResult", ssaoOut.SsaoResult.get(), 2);
+				mFormatPolicy.recordTraffic("BlurResult", blurOut.BlurResult.get(), 2);
+			});
+		}
+
+		mTemporalSsaoActive = Method == TemporalSsao;
+		mMotionVectorsActive = Method == TemporalSsao && UseMotionVectors;
 
-		QBlurPassBuilder::Output blurOut = graphBuilder.addPassBuilder<QBlurPassBuilder>("BlurPass")
-			.setBaseColorTexture(ssaoOut.SsaoResult)
-			.setBlurIterations(BlurIterations)
-			.setBlurSize(BlurSize)
-			.setDownSampleCount(DownSampleCount);
+		// 质量对比：各方法的误差都相对同一个高采样数的GTAO结果计算，再结合帧时间在相近误差下比较开销
+		// 参考Pass本身的开销会计入帧时间，因此统计标签带上后缀，与正常运行的结果分开
+		if (MeasureQuality) {
+			QGtaoPassBuilder::Output referenceOut = graphBuilder.addPassBuilder<QGtaoPassBuilder>("GtaoReferencePass")
+				.setNormalTexture(meshOut.Normal)
+				.setPositionTexture(meshOut.Position)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setRadius(Radius)
+				.setFalloffRange(GtaoFalloffRange)
+				.setSliceCount(ReferenceSliceCount)
+				.setStepsPerSlice(ReferenceStepsPerSlice)
+				.setFormatPolicy(&mReferenceFormatPolicy);
+			graphBuilder.addPassBuilder("AoErrorPass", mAoErrorPass)
+				.setAoTexture(ssaoTexture)
+				.setReferenceTexture(referenceOut.GtaoResult)
+				.setPositionTexture(meshOut.Position);
+			benchmarkLabel += " [quality check]";
+		}
+		mBenchmark.setLabel(benchmarkLabel);
 
 		QSsaoMergePassBuilder::Output merge = graphBuilder.addPassBuilder<QSsaoMergePassBuilder>("SsaoMergePass")
 			.setBaseColor(meshOut.BaseColor)
-			.setSsaoTexture(blurOut.BlurResult);
+			.setSsaoTexture(ssaoTexture)
+			.setBentNormal(bentNormal)
+			.setFormatPolicy(&mFormatPolicy);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			mBenchmark.tick(cmdBuffer);
+			reportTraffic();
+		});
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
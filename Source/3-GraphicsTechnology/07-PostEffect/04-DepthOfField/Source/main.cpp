@@ -7,6 +7,7 @@
 #include "Render/Component/QParticlesRenderComponent.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QDepthOfFieldPassBuilder.h"
+#include "QFrameTimeBenchmark.h"
 
 #define Q_PROPERTY_VAR(Type,Name)\
     Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
@@ -62,6 +63,379 @@ public:
 	}
 };
 
+class QTiledDepthOfFieldPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QTiledDepthOfFieldPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColorTexture);
+		QRP_INPUT_ATTR(QRhiTextureRef, PositionTexture);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(float, Focus);
+		QRP_INPUT_ATTR(float, FocalLength);
+		QRP_INPUT_ATTR(float, Aperture);
+		QRP_INPUT_ATTR(float, MaxCoC);
+		QRP_INPUT_ATTR(int, ApertureBlades);
+		QRP_INPUT_ATTR(int, Iterations);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QTiledDepthOfFieldPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, DepthOfFieldResult)
+	QRP_OUTPUT_END()
+public:
+	enum TileClass {
+		InFocus = 0,
+		FarOnly = 1,
+		NearAndFar = 2,
+		TileClassCount = 3
+	};
+	struct TileStats {
+		int tileCount[TileClassCount] = {};
+		int totalTiles() const { return tileCount[InFocus] + tileCount[FarOnly] + tileCount[NearAndFar]; }
+		float gatherCoverage() const { return totalTiles() > 0 ? float(tileCount[FarOnly] + tileCount[NearAndFar]) / totalTiles() : 0.0f; }
+	};
+	TileStats getLastTileStats() const { return mLastTileStats; }
+private:
+	static const int TileSize = 8;			//半分辨率下的Tile尺寸，对应全分辨率16x16
+	struct UniformBlock {
+		float view[16];
+		float focusDistance;
+		float cocScale;
+		float maxCoC;
+		int apertureBlades;
+		int iterations;
+		float padding[3];
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mTileCounterBuffer;
+	QRhiSamplerRef mNearestSampler;
+	QRhiSamplerRef mLinearSampler;
+
+	QRhiTextureRef mHalfResTexture;
+	QRhiShaderResourceBindingsRef mPrepareBindings;
+	QRhiComputePipelineRef mPreparePipeline;
+	QShader mPrepareCS;
+
+	QRhiTextureRef mTileTexture;
+	QRhiShaderResourceBindingsRef mTileBindings;
+	QRhiComputePipelineRef mTilePipeline;
+	QShader mTileCS;
+
+	QRhiTextureRef mClassifiedTileTexture;
+	QRhiShaderResourceBindingsRef mClassifyBindings;
+	QRhiComputePipelineRef mClassifyPipeline;
+	QShader mClassifyCS;
+
+	QRhiTextureRef mGatherTexture;
+	QRhiShaderResourceBindingsRef mGatherBindings;
+	QRhiComputePipelineRef mGatherPipeline;
+	QShader mGatherCS;
+
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiShaderResourceBindingsRef mCompositeBindings;
+	QRhiGraphicsPipelineRef mCompositePipeline;
+	QShader mCompositeFS;
+
+	QSize mHalfResSize;
+	QSize mTileCount;
+	QRhiBufferReadbackResult mTileCounterReadback;
+	TileStats mLastTileStats;
+public:
+	QTiledDepthOfFieldPassBuilder() {
+		const QByteArray uniformDefine = R"(
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				float focusDistance;
+				float cocScale;
+				float maxCoC;
+				int apertureBlades;
+				int iterations;
+			}UBO;
+			float computeCoC(vec3 worldPos) {		//薄透镜模型下有符号的弥散圆半径（全分辨率像素），负值为前景，超出采样预算的部分截断
+				float depth = max(-(UBO.view * vec4(worldPos, 1.0)).z, 1e-4);
+				return clamp(UBO.cocScale * (depth - UBO.focusDistance) / depth, -UBO.maxCoC, UBO.maxCoC);
+			}
+		)";
+
+		mPrepareCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, "#version 450\n" + uniformDefine + R"(
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 1) uniform sampler2D uBaseColor;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (binding = 3, rgba16f) uniform writeonly image2D uHalfRes;
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				if (any(greaterThanEqual(pixel, imageSize(uHalfRes))))
+					return;
+				ivec2 fullResMax = textureSize(uBaseColor, 0) - 1;
+				vec3 color = vec3(0.0);
+				float coc = 0.0;
+				float maxAbsCoC = -1.0;
+				for (int i = 0; i < 4; i++) {
+					ivec2 src = min(pixel * 2 + ivec2(i & 1, i >> 1), fullResMax);
+					color += texelFetch(uBaseColor, src, 0).rgb;
+					float sampleCoC = computeCoC(texelFetch(uPosition, src, 0).xyz);
+					if (abs(sampleCoC) > maxAbsCoC) {				//保留绝对值最大的CoC，避免前景边缘被稀释
+						maxAbsCoC = abs(sampleCoC);
+						coc = sampleCoC;
+					}
+				}
+				imageStore(uHalfRes, pixel, vec4(color * 0.25, coc));
+			}
+		)");
+
+		mTileCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0) uniform sampler2D uHalfRes;
+			layout (binding = 1, rgba16f) uniform writeonly image2D uTile;
+			shared float sMinCoC[64];
+			shared float sMaxCoC[64];
+			void main() {
+				ivec2 pixel = min(ivec2(gl_GlobalInvocationID.xy), textureSize(uHalfRes, 0) - 1);
+				float coc = texelFetch(uHalfRes, pixel, 0).a;
+				uint index = gl_LocalInvocationIndex;
+				sMinCoC[index] = coc;
+				sMaxCoC[index] = coc;
+				barrier();
+				for (uint stride = 32; stride > 0; stride >>= 1) {
+					if (index < stride) {
+						sMinCoC[index] = min(sMinCoC[index], sMinCoC[index + stride]);
+						sMaxCoC[index] = max(sMaxCoC[index], sMaxCoC[index + stride]);
+					}
+					barrier();
+				}
+				if (index == 0)
+					imageStore(uTile, ivec2(gl_WorkGroupID.xy), vec4(sMinCoC[0], sMaxCoC[0], 0.0, 0.0));
+			}
+		)");
+
+		mClassifyCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, R"(#version 450
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 0, rgba16f) uniform readonly image2D uTile;
+			layout (binding = 1, rgba16f) uniform writeonly image2D uClassifiedTile;
+			layout (std430, binding = 2) buffer TileCounter {
+				int tileCount[3];
+			};
+			void main() {
+				ivec2 tile = ivec2(gl_GlobalInvocationID.xy);
+				ivec2 tileCount = imageSize(uTile);
+				if (any(greaterThanEqual(tile, tileCount)))
+					return;
+				// 膨胀到相邻Tile，使大弥散圆能扩散到邻居Tile中
+				float minCoC = 1e4;
+				float maxCoC = -1e4;
+				for (int y = -1; y <= 1; y++) {
+					for (int x = -1; x <= 1; x++) {
+						vec2 minMax = imageLoad(uTile, clamp(tile + ivec2(x, y), ivec2(0), tileCount - 1)).rg;
+						minCoC = min(minCoC, minMax.r);
+						maxCoC = max(maxCoC, minMax.g);
+					}
+				}
+				int tileClass = 0;
+				if (minCoC < -1.0)
+					tileClass = 2;
+				else if (maxCoC > 1.0)
+					tileClass = 1;
+				atomicAdd(tileCount[tileClass], 1);
+				imageStore(uClassifiedTile, tile, vec4(minCoC, maxCoC, float(tileClass), 0.0));
+			}
+		)");
+
+		mGatherCS = QRhiHelper::newShaderFromCode(QShader::ComputeStage, "#version 450\n" + uniformDefine + R"(
+			layout (local_size_x = 8, local_size_y = 8) in;
+			layout (binding = 1) uniform sampler2D uHalfRes;
+			layout (binding = 2) uniform sampler2D uClassifiedTile;
+			layout (binding = 3, rgba16f) uniform writeonly image2D uGather;
+			const float GOLDEN_ANGLE = 2.39996323;
+			const float PI = 3.14159265;
+
+			vec2 bladeShape(float angle) {						//将圆盘映射为多边形光圈
+				float blades = float(max(UBO.apertureBlades, 3));
+				float segment = 2.0 * PI / blades;
+				float local = mod(angle, segment) - segment * 0.5;
+				return vec2(cos(angle), sin(angle)) * cos(segment * 0.5) / cos(local);
+			}
+
+			void main() {
+				ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+				ivec2 size = imageSize(uGather);
+				vec4 tile = texelFetch(uClassifiedTile, ivec2(gl_WorkGroupID.xy), 0);
+				if (int(tile.b) == 0)					//整个Tile都在焦内，跳过昂贵的收集
+					return;
+				if (any(greaterThanEqual(pixel, size)))
+					return;
+				vec2 texelSize = 1.0 / vec2(size);
+				vec4 center = texelFetch(uHalfRes, pixel, 0);
+				float centerSize = abs(center.a) * 0.5;
+				float maxRadius = max(abs(tile.r), abs(tile.g)) * 0.5;		//转换到半分辨率像素
+				vec3 color = center.rgb;
+				float total = 1.0;
+				int iterations = max(UBO.iterations, 1);
+				for (int i = 1; i <= iterations; i++) {
+					float radius = sqrt(float(i) / float(iterations)) * maxRadius;
+					vec2 offset = bladeShape(float(i) * GOLDEN_ANGLE) * radius;
+					vec4 sampleValue = textureLod(uHalfRes, (vec2(pixel) + 0.5 + offset) * texelSize, 0.0);
+					float sampleSize = abs(sampleValue.a) * 0.5;
+					if (sampleValue.a > center.a)			//位于中心像素之后的样本不能比中心更模糊
+						sampleSize = clamp(sampleSize, 0.0, centerSize * 2.0);
+					float m = smoothstep(radius - 0.5, radius + 0.5, sampleSize);
+					color += mix(color / total, sampleValue.rgb, m);
+					total += 1.0;
+				}
+				imageStore(uGather, pixel, vec4(color / total, 1.0));
+			}
+		)");
+
+		mCompositeFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformDefine + R"(
+			layout (binding = 1) uniform sampler2D uBaseColor;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (binding = 3) uniform sampler2D uGather;
+			layout (binding = 4) uniform sampler2D uClassifiedTile;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec4 color = texelFetch(uBaseColor, pixel, 0);
+				ivec2 tile = min(pixel / 16, textureSize(uClassifiedTile, 0) - 1);
+				if (int(texelFetch(uClassifiedTile, tile, 0).b) == 0) {
+					outFragColor = color;
+					return;
+				}
+				float coc = computeCoC(texelFetch(uPosition, pixel, 0).xyz);
+				vec3 blurred = texture(uGather, vUV).rgb;
+				outFragColor = vec4(mix(color.rgb, blurred, smoothstep(1.0, 2.0, abs(coc))), color.a);
+			}
+		)");
+
+		mTileCounterReadback.completed = [this]() {
+			if (mTileCounterReadback.data.size() >= int(sizeof(mLastTileStats.tileCount)))
+				memcpy(mLastTileStats.tileCount, mTileCounterReadback.data.constData(), sizeof(mLastTileStats.tileCount));
+		};
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize fullResSize = mInput._BaseColorTexture->pixelSize();
+		mHalfResSize = QSize((fullResSize.width() + 1) / 2, (fullResSize.height() + 1) / 2);
+		mTileCount = QSize((mHalfResSize.width() + TileSize - 1) / TileSize, (mHalfResSize.height() + TileSize - 1) / TileSize);
+
+		builder.setupBuffer(mUniformBuffer, "TiledDofUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mTileCounterBuffer, "TiledDofTileCounter", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(int) * TileClassCount);
+		builder.setupSampler(mNearestSampler, "TiledDofNearestSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mLinearSampler, "TiledDofLinearSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		builder.setupTexture(mHalfResTexture, "TiledDofHalfRes", QRhiTexture::Format::RGBA16F, mHalfResSize, 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupShaderResourceBindings(mPrepareBindings, "TiledDofPrepareBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mInput._BaseColorTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::ComputeStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::imageStore(3, QRhiShaderResourceBinding::ComputeStage, mHalfResTexture.get(), 0),
+		});
+		QRhiComputePipelineState PSO;
+		PSO.shaderResourceBindings = mPrepareBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mPrepareCS);
+		builder.setupComputePipeline(mPreparePipeline, "TiledDofPreparePipeline", PSO);
+
+		builder.setupTexture(mTileTexture, "TiledDofTile", QRhiTexture::Format::RGBA16F, mTileCount, 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupShaderResourceBindings(mTileBindings, "TiledDofTileBindings", {
+			QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::ComputeStage, mHalfResTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, mTileTexture.get(), 0),
+		});
+		PSO.shaderResourceBindings = mTileBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mTileCS);
+		builder.setupComputePipeline(mTilePipeline, "TiledDofTilePipeline", PSO);
+
+		builder.setupTexture(mClassifiedTileTexture, "TiledDofClassifiedTile", QRhiTexture::Format::RGBA16F, mTileCount, 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupShaderResourceBindings(mClassifyBindings, "TiledDofClassifyBindings", {
+			QRhiShaderResourceBinding::imageLoad(0, QRhiShaderResourceBinding::ComputeStage, mTileTexture.get(), 0),
+			QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, mClassifiedTileTexture.get(), 0),
+			QRhiShaderResourceBinding::bufferLoadStore(2, QRhiShaderResourceBinding::ComputeStage, mTileCounterBuffer.get()),
+		});
+		PSO.shaderResourceBindings = mClassifyBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mClassifyCS);
+		builder.setupComputePipeline(mClassifyPipeline, "TiledDofClassifyPipeline", PSO);
+
+		builder.setupTexture(mGatherTexture, "TiledDofGather", QRhiTexture::Format::RGBA16F, mHalfResSize, 1, QRhiTexture::UsedWithLoadStore);
+		builder.setupShaderResourceBindings(mGatherBindings, "TiledDofGatherBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::ComputeStage, mHalfResTexture.get(), mLinearSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::ComputeStage, mClassifiedTileTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::imageStore(3, QRhiShaderResourceBinding::ComputeStage, mGatherTexture.get(), 0),
+		});
+		PSO.shaderResourceBindings = mGatherBindings.get();
+		PSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mGatherCS);
+		builder.setupComputePipeline(mGatherPipeline, "TiledDofGatherPipeline", PSO);
+
+		builder.setupTexture(mColorAttachment, "TiledDof", QRhiTexture::Format::RGBA16F, fullResSize, 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mRenderTarget, "TiledDofRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupShaderResourceBindings(mCompositeBindings, "TiledDofCompositeBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColorTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._PositionTexture.get(), mNearestSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mGatherTexture.get(), mLinearSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, mClassifiedTileTexture.get(), mNearestSampler.get()),
+		});
+		QRhiGraphicsPipelineState compositePSO;
+		compositePSO.shaderResourceBindings = mCompositeBindings.get();
+		compositePSO.sampleCount = mRenderTarget->sampleCount();
+		compositePSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		compositePSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCompositeFS)
+		};
+		builder.setupGraphicsPipeline(mCompositePipeline, "TiledDofCompositePipeline", compositePSO);
+
+		mOutput.DepthOfFieldResult = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		UniformBlock ubo;
+		memcpy(ubo.view, mInput._ViewMatrix.constData(), sizeof(ubo.view));
+		// 与 QDepthOfFieldPassBuilder 使用同一组镜头参数：Focus 为对焦距离，FocalLength 为焦距（毫米），Aperture 为光圈值
+		// 弥散圆直径 = (f / N) * f / (S - f) * |z - S| / z，按 35mm 画幅的 24mm 底片高度换算为像素半径
+		static const float SensorHeight = 0.024f;
+		const float focalLength = qMax(mInput._FocalLength, 1.0f) / 1000.0f;
+		const float focusDistance = qMax(mInput._Focus, focalLength * 1.01f);
+		const float fNumber = qMax(mInput._Aperture, 0.5f);
+		ubo.focusDistance = focusDistance;
+		ubo.cocScale = 0.5f * focalLength * focalLength / (fNumber * (focusDistance - focalLength)) / SensorHeight * mInput._BaseColorTexture->pixelSize().height();
+		ubo.maxCoC = qBound(1.0f, mInput._MaxCoC, 64.0f);
+		ubo.apertureBlades = mInput._ApertureBlades;
+		ubo.iterations = qBound(1, mInput._Iterations, 256);
+
+		const int zeroCounter[TileClassCount] = {};
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		batch->uploadStaticBuffer(mTileCounterBuffer.get(), zeroCounter);
+
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mPreparePipeline.get());
+		cmdBuffer->setShaderResources(mPrepareBindings.get());
+		cmdBuffer->dispatch(mTileCount.width(), mTileCount.height(), 1);
+
+		cmdBuffer->setComputePipeline(mTilePipeline.get());
+		cmdBuffer->setShaderResources(mTileBindings.get());
+		cmdBuffer->dispatch(mTileCount.width(), mTileCount.height(), 1);
+
+		cmdBuffer->setComputePipeline(mClassifyPipeline.get());
+		cmdBuffer->setShaderResources(mClassifyBindings.get());
+		cmdBuffer->dispatch((mTileCount.width() + 7) / 8, (mTileCount.height() + 7) / 8, 1);
+
+		cmdBuffer->setComputePipeline(mGatherPipeline.get());
+		cmdBuffer->setShaderResources(mGatherBindings.get());
+		cmdBuffer->dispatch(mTileCount.width(), mTileCount.height(), 1);		//每个工作组对应一个Tile，焦内Tile直接退出
+
+		QRhiResourceUpdateBatch* readbackBatch = mRhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(mTileCounterBuffer.get(), 0, sizeof(int) * TileClassCount, &mTileCounterReadback);
+		cmdBuffer->endComputePass(readbackBatch);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue);
+		cmdBuffer->setGraphicsPipeline(mCompositePipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mCompositeBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
 class MyRenderer : public IRenderer {
 	Q_OBJECT
 	Q_PROPERTY_VAR(float, Focus) = 0.05f;
@@ -71,8 +445,16 @@ class MyRenderer : public IRenderer {
 	Q_PROPERTY_VAR(float, BokehSqueeze) = 0.0f;
 	Q_PROPERTY_VAR(float, BokehSqueezeFalloff) = 1.0f;
 	Q_PROPERTY_VAR(int, Iterations) = 64;
+
+	Q_PROPERTY_VAR(bool, UseTiledDepthOfField) = true;
+	Q_PROPERTY_VAR(float, MaxCoC) = 16.0f;				//分块景深的采样半径上限（像素）
+
+	Q_CLASSINFO("Iterations", "Min=1,Max=256")
+	Q_CLASSINFO("MaxCoC", "Min=1,Max=64")
 private:
 	QParticlesRenderComponent mParticlesComp;
+	QSharedPointer<QTiledDepthOfFieldPassBuilder> mTiledDofPass{ new QTiledDepthOfFieldPassBuilder };
+	QFrameTimeBenchmark mBenchmark;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -111,20 +493,51 @@ protected:
 		QPbrMeshPassBuilder::Output meshOut
 			= graphBuilder.addPassBuilder<QPbrMeshPassBuilder>("MeshPass");
 
-		QDepthOfFieldPassBuilder::Output dofOut = graphBuilder.addPassBuilder<QDepthOfFieldPassBuilder>("DepthOfFieldPass")
-			.setBaseColorTexture(meshOut.BaseColor)
-			.setPositionTexture(meshOut.Position)
-			.setFocus(Focus)
-			.setFocalLength(FocalLength)
-			.setAperture(Aperture)
-			.setApertureBlades(ApertureBlades)
-			.setBokehSqueeze(BokehSqueeze)
-			.setBokehSqueezeFalloff(BokehSqueezeFalloff)
-			.setIterations(Iterations);
+		QRhiTextureRef dofTexture;
+		if (UseTiledDepthOfField) {
+			QTiledDepthOfFieldPassBuilder::Output dofOut = graphBuilder.addPassBuilder("TiledDepthOfFieldPass", mTiledDofPass)
+				.setBaseColorTexture(meshOut.BaseColor)
+				.setPositionTexture(meshOut.Position)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setFocus(Focus)
+				.setFocalLength(FocalLength)
+				.setAperture(Aperture)
+				.setMaxCoC(MaxCoC)
+				.setApertureBlades(ApertureBlades)
+				.setIterations(Iterations);
+			dofTexture = dofOut.DepthOfFieldResult;
+
+			const QTiledDepthOfFieldPassBuilder::TileStats stats = mTiledDofPass->getLastTileStats();
+			mBenchmark.setLabel(QString("TiledDof x%1").arg(Iterations));
+			mBenchmark.setDetail(QString("coverage: %1% (in focus %2, far %3, near %4)")
+				.arg(stats.gatherCoverage() * 100.0f, 0, 'f', 1)
+				.arg(stats.tileCount[QTiledDepthOfFieldPassBuilder::InFocus])
+				.arg(stats.tileCount[QTiledDepthOfFieldPassBuilder::FarOnly])
+				.arg(stats.tileCount[QTiledDepthOfFieldPassBuilder::NearAndFar]));
+		}
+		else {
+			QDepthOfFieldPassBuilder::Output dofOut = graphBuilder.addPassBuilder<QDepthOfFieldPassBuilder>("DepthOfFieldPass")
+				.setBaseColorTexture(meshOut.BaseColor)
+				.setPositionTexture(meshOut.Position)
+				.setFocus(Focus)
+				.setFocalLength(FocalLength)
+				.setAperture(Aperture)
+				.setApertureBlades(ApertureBlades)
+				.setBokehSqueeze(BokehSqueeze)
+				.setBokehSqueezeFalloff(BokehSqueezeFalloff)
+				.setIterations(Iterations);
+			dofTexture = dofOut.DepthOfFieldResult;
+			mBenchmark.setLabel(QString("Dof x%1").arg(Iterations));
+			mBenchmark.setDetail(QString());
+		}
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			mBenchmark.tick(cmdBuffer);
+		});
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(dofOut.DepthOfFieldResult);
+			.setInitialTexture(dofTexture);
 	}
 };
 
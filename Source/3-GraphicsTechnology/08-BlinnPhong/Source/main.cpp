@@ -1,19 +1,1021 @@
 #include <QApplication>
+#include <QElapsedTimer>
 #include "QtConcurrent/qtconcurrentrun.h"
 #include "QRenderWidget.h"
+#include "Render/IRenderComponent.h"
 #include "Render/Component/QStaticMeshRenderComponent.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrLightingPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QSkyPassBuilder.h"
 #include "QEngineApplication.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
+#include "QMotionVectorPassBuilder.h"
+#include "QMeshGeometry.h"
+
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+static float CubeVertexData[] = {
+	//position(xyz)		normal(xyz)
+	-0.5f,-0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,	 0.5f,-0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,	 0.5f, 0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,
+	-0.5f,-0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,	 0.5f, 0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,	-0.5f, 0.5f, 0.5f,	 0.0f, 0.0f, 1.0f,
+	 0.5f,-0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,	-0.5f,-0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,	-0.5f, 0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,
+	 0.5f,-0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,	-0.5f, 0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,	 0.5f, 0.5f,-0.5f,	 0.0f, 0.0f,-1.0f,
+	 0.5f,-0.5f, 0.5f,	 1.0f, 0.0f, 0.0f,	 0.5f,-0.5f,-0.5f,	 1.0f, 0.0f, 0.0f,	 0.5f, 0.5f,-0.5f,	 1.0f, 0.0f, 0.0f,
+	 0.5f,-0.5f, 0.5f,	 1.0f, 0.0f, 0.0f,	 0.5f, 0.5f,-0.5f,	 1.0f, 0.0f, 0.0f,	 0.5f, 0.5f, 0.5f,	 1.0f, 0.0f, 0.0f,
+	-0.5f,-0.5f,-0.5f,	-1.0f, 0.0f, 0.0f,	-0.5f,-0.5f, 0.5f,	-1.0f, 0.0f, 0.0f,	-0.5f, 0.5f, 0.5f,	-1.0f, 0.0f, 0.0f,
+	-0.5f,-0.5f,-0.5f,	-1.0f, 0.0f, 0.0f,	-0.5f, 0.5f, 0.5f,	-1.0f, 0.0f, 0.0f,	-0.5f, 0.5f,-0.5f,	-1.0f, 0.0f, 0.0f,
+	-0.5f, 0.5f, 0.5f,	 0.0f, 1.0f, 0.0f,	 0.5f, 0.5f, 0.5f,	 0.0f, 1.0f, 0.0f,	 0.5f, 0.5f,-0.5f,	 0.0f, 1.0f, 0.0f,
+	-0.5f, 0.5f, 0.5f,	 0.0f, 1.0f, 0.0f,	 0.5f, 0.5f,-0.5f,	 0.0f, 1.0f, 0.0f,	-0.5f, 0.5f,-0.5f,	 0.0f, 1.0f, 0.0f,
+	-0.5f,-0.5f,-0.5f,	 0.0f,-1.0f, 0.0f,	 0.5f,-0.5f,-0.5f,	 0.0f,-1.0f, 0.0f,	 0.5f,-0.5f, 0.5f,	 0.0f,-1.0f, 0.0f,
+	-0.5f,-0.5f,-0.5f,	 0.0f,-1.0f, 0.0f,	 0.5f,-0.5f, 0.5f,	 0.0f,-1.0f, 0.0f,	-0.5f,-0.5f, 0.5f,	 0.0f,-1.0f, 0.0f,
+};
+static const int CubeVertexCount = 36;
+
+class QShadowBoxComponent : public IRenderComponent {
+	Q_OBJECT
+	Q_PROPERTY(QColor Color READ getColor WRITE setColor)
+public:
+	QColor getColor() const { return mColor; }
+	void setColor(QColor val) { mColor = val; }
+
+	// 变换使用组件自身的 Position/Rotation/Scale，编辑器中的修改同样生效；这里只保存每帧的快照
+	const QMatrix4x4& getWorldMatrix() const { return mWorldMatrix; }
+	const QMatrix4x4& getPreviousWorldMatrix() const { return mPreviousWorldMatrix; }
+	void commitFrame() { mPreviousWorldMatrix = mWorldMatrix; }		//每帧更新变换前调用，保留上一帧的矩阵用于运动矢量
+	void updateWorldMatrix() {										//每帧更新变换后调用
+		const QMatrix4x4 matrix = calculateWorldMatrix();
+		if (matrix == mWorldMatrix)
+			return;
+		mWorldMatrix = matrix;
+		mRevision++;
+	}
+	bool isStaticCaster() const { return mStaticCaster; }
+	void setStaticCaster(bool val) {
+		if (val == mStaticCaster)
+			return;
+		mStaticCaster = val;
+		mRevision++;
+	}
+	quint64 getRevision() const { return mRevision; }		//变换或静态标记改变时递增，用于判断静态缓存是否失效
+private:
+	QScopedPointer<QRhiBuffer> mVertexBuffer;
+	QSharedPointer<QPrimitiveRenderProxy> mProxy;
+	QColor mColor = QColor::fromRgbF(0.8f, 0.8f, 0.8f, 1.0f);
+	QMatrix4x4 mWorldMatrix;
+	QMatrix4x4 mPreviousWorldMatrix;
+	bool mStaticCaster = true;
+	quint64 mRevision = 0;
+protected:
+	void onRebuildResource() override {
+		mVertexBuffer.reset(mRhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(CubeVertexData)));
+		mVertexBuffer->create();
+
+		mProxy = newPrimitiveRenderProxy();
+
+		mProxy->addUniformBlock(QRhiShaderStage::Vertex, "Transform")
+			->addParam("M", QGenericMatrix<4, 4, float>())
+			->addParam("MVP", QGenericMatrix<4, 4, float>());
+
+		mProxy->addUniformBlock(QRhiShaderStage::Fragment, "UBO")
+			->addParam("Color", mColor);
+
+		mProxy->setInputBindings({
+			QRhiVertexInputBindingEx(mVertexBuffer.get(), 6 * sizeof(float))
+		});
+
+		mProxy->setInputAttribute({
+			QRhiVertexInputAttributeEx("inPosition", 0, 0, QRhiVertexInputAttribute::Float3, 0),
+			QRhiVertexInputAttributeEx("inNormal", 0, 1, QRhiVertexInputAttribute::Float3, 3 * sizeof(float)),
+		});
+		mProxy->setShaderMainCode(QRhiShaderStage::Vertex, R"(
+			layout (location = 0) out vec3 vWorldPosition;
+			layout (location = 1) out vec3 vWorldNormal;
+			void main(){
+				vWorldPosition = (Transform.M * vec4(inPosition, 1.0f)).xyz;
+				vWorldNormal = transpose(inverse(mat3(Transform.M))) * inNormal;
+				gl_Position = Transform.MVP * vec4(inPosition, 1.0f);
+			}
+		)");
+		mProxy->setShaderMainCode(QRhiShaderStage::Fragment, QString(R"(
+			layout (location = 0) in vec3 vWorldPosition;
+			layout (location = 1) in vec3 vWorldNormal;
+			void main(){
+				%1
+				%2
+				%3
+				%4
+				%5
+			})")
+			.arg(hasColorAttachment("BaseColor") ? "BaseColor = UBO.Color;" : "")
+			.arg(hasColorAttachment("Position") ? "Position = vec4(vWorldPosition, 1.0f);" : "")
+			.arg(hasColorAttachment("Normal") ? "Normal = vec4(normalize(vWorldNormal), 1.0f);" : "")
+			.arg(hasColorAttachment("Metallic") ? "Metallic = vec4(0.0f);" : "")
+			.arg(hasColorAttachment("Roughness") ? "Roughness = vec4(0.7f);" : "")
+			.toLocal8Bit()
+		);
+		mProxy->setOnUpload([this](QRhiResourceUpdateBatch* batch) {
+			batch->uploadStaticBuffer(mVertexBuffer.get(), CubeVertexData);
+		});
+		mProxy->setOnUpdate([this](QRhiResourceUpdateBatch* batch, const QPrimitiveRenderProxy::UniformBlocks& blocks, const QPrimitiveRenderProxy::UpdateContext& ctx) {
+			const QMatrix4x4 MVP = ctx.projectionMatrixWithCorr * ctx.viewMatrix * mWorldMatrix;
+			blocks["Transform"]->setParamValue("M", QVariant::fromValue(mWorldMatrix.toGenericMatrix<4, 4>()));
+			blocks["Transform"]->setParamValue("MVP", QVariant::fromValue(MVP.toGenericMatrix<4, 4>()));
+			blocks["UBO"]->setParamValue("Color", QVariant::fromValue(mColor));
+		});
+		mProxy->setOnDraw([this](QRhiCommandBuffer* cmdBuffer) {
+			const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+			cmdBuffer->setVertexInput(0, 1, &vertexBindings);
+			cmdBuffer->draw(CubeVertexCount);
+		});
+	}
+};
+
+struct QShadowCascadeSet {
+	static const int CascadeCount = 4;
+	QMatrix4x4 lightView[CascadeCount];					//光源空间，原点位于对齐到纹素的级联中心
+	QMatrix4x4 lightViewProjection[CascadeCount];		//已经乘上 clipSpaceCorrMatrix
+	QVector3D lightSpaceCenter[CascadeCount];
+	float radius[CascadeCount] = {};
+	float splitFar[CascadeCount] = {};
+	bool refitted[CascadeCount] = {};					//本帧是否重新拟合了级联（重新拟合后静态缓存失效）
+	float casterMargin = 0.0f;
+	QVector3D lightDirection;
+	int resolution = 0;
+
+	// 按 practical split scheme 划分视锥，每级用包围球拟合正交投影并对齐到纹素网格，避免相机移动时阴影边缘闪烁
+	// 拟合时把包围球放大 refitPadding 倍：只要当前切片的包围球仍在上一帧的级联内，就沿用上一帧的矩阵，
+	// 级联在光源空间中保持不动，静态投射体的缓存也就不会因为相机的小幅移动而失效，只有移出范围时才重新拟合
+	static QShadowCascadeSet compute(const QMatrix4x4& view, const QMatrix4x4& projection, const QMatrix4x4& clipSpaceCorr, QVector3D lightDirection, float shadowDistance, float casterMargin, int resolution, float splitLambda, float refitPadding, const QShadowCascadeSet* previous) {
+		QShadowCascadeSet set;
+		set.lightDirection = lightDirection.normalized();
+		set.casterMargin = casterMargin;
+		set.resolution = resolution;
+		const float nearPlane = projection(2, 3) / (projection(2, 2) - 1.0f);
+		const float farPlane = qMin(projection(2, 3) / (projection(2, 2) + 1.0f), shadowDistance);
+		const float tanHalfX = 1.0f / projection(0, 0);
+		const float tanHalfY = 1.0f / projection(1, 1);
+		const QMatrix4x4 inverseView = view.inverted();
+
+		QMatrix4x4 lightRotation;
+		const QVector3D up = qAbs(set.lightDirection.y()) > 0.99f ? QVector3D(0.0f, 0.0f, 1.0f) : QVector3D(0.0f, 1.0f, 0.0f);
+		lightRotation.lookAt(QVector3D(0.0f, 0.0f, 0.0f), set.lightDirection, up);
+		const bool previousUsable = previous != nullptr
+			&& previous->resolution == resolution
+			&& previous->casterMargin == casterMargin
+			&& previous->lightDirection == set.lightDirection;
+
+		float sliceNear = nearPlane;
+		for (int i = 0; i < CascadeCount; i++) {
+			const float t = float(i + 1) / CascadeCount;
+			const float sliceFar = splitLambda * nearPlane * qPow(farPlane / nearPlane, t) + (1.0f - splitLambda) * (nearPlane + (farPlane - nearPlane) * t);
+			QVector3D corners[8];
+			QVector3D center;
+			for (int c = 0; c < 8; c++) {
+				const float depth = (c & 4) ? sliceFar : sliceNear;
+				const QVector3D viewCorner(((c & 1) ? 1.0f : -1.0f) * tanHalfX * depth, ((c & 2) ? 1.0f : -1.0f) * tanHalfY * depth, -depth);
+				corners[c] = inverseView.map(viewCorner);
+				center += corners[c] / 8.0f;
+			}
+			float sliceRadius = 0.0f;
+			for (const QVector3D& corner : corners)
+				sliceRadius = qMax(sliceRadius, (corner - center).length());
+			const QVector3D sliceCenter = lightRotation.map(center);
+			const float radius = qCeil(sliceRadius * (1.0f + qMax(0.0f, refitPadding)) * 16.0f) / 16.0f;
+
+			set.splitFar[i] = sliceFar;
+			sliceNear = sliceFar;
+			if (previousUsable
+				&& previous->radius[i] >= sliceRadius && previous->radius[i] <= radius		//切片尺寸变化（投影或划分参数改变）时重新拟合
+				&& (sliceCenter - previous->lightSpaceCenter[i]).length() + sliceRadius <= previous->radius[i]) {
+				set.lightView[i] = previous->lightView[i];
+				set.lightViewProjection[i] = previous->lightViewProjection[i];
+				set.lightSpaceCenter[i] = previous->lightSpaceCenter[i];
+				set.radius[i] = previous->radius[i];
+				continue;
+			}
+
+			const float texelSize = 2.0f * radius / resolution;
+			QVector3D lightSpaceCenter = sliceCenter;
+			lightSpaceCenter.setX(qFloor(lightSpaceCenter.x() / texelSize) * texelSize);
+			lightSpaceCenter.setY(qFloor(lightSpaceCenter.y() / texelSize) * texelSize);
+
+			QMatrix4x4 lightView;
+			lightView.translate(-lightSpaceCenter);
+			lightView *= lightRotation;
+			QMatrix4x4 lightProjection;
+			lightProjection.ortho(-radius, radius, -radius, radius, -(radius + casterMargin), radius);
+
+			set.lightView[i] = lightView;
+			set.lightViewProjection[i] = clipSpaceCorr * lightProjection * lightView;
+			set.lightSpaceCenter[i] = lightSpaceCenter;
+			set.radius[i] = radius;
+			set.refitted[i] = true;
+		}
+		return set;
+	}
+
+	bool intersects(int cascade, const QMatrix4x4& worldMatrix) const {		//单位立方体经 worldMatrix 变换后的包围盒与级联的正交体积求交
+		QVector3D boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		QVector3D boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		const QMatrix4x4 toLight = lightView[cascade] * worldMatrix;
+		for (int c = 0; c < 8; c++) {
+			const QVector3D corner = toLight.map(QVector3D((c & 1) ? 0.5f : -0.5f, (c & 2) ? 0.5f : -0.5f, (c & 4) ? 0.5f : -0.5f));
+			boundsMin = QVector3D(qMin(boundsMin.x(), corner.x()), qMin(boundsMin.y(), corner.y()), qMin(boundsMin.z(), corner.z()));
+			boundsMax = QVector3D(qMax(boundsMax.x(), corner.x()), qMax(boundsMax.y(), corner.y()), qMax(boundsMax.z(), corner.z()));
+		}
+		const float r = radius[cascade];
+		return boundsMax.x() >= -r && boundsMin.x() <= r
+			&& boundsMax.y() >= -r && boundsMin.y() <= r
+			&& boundsMax.z() >= -r && boundsMin.z() <= r + casterMargin;
+	}
+};
+
+class QShadowPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QShadowPassBuilder)
+		QRP_INPUT_ATTR(QShadowCascadeSet, Cascades);
+		QRP_INPUT_ATTR(QVector<QShadowBoxComponent*>, Casters);
+		QRP_INPUT_ATTR(QSharedPointer<const QMeshGeometry>, MeshCaster);		//可选：作为静态投射体的网格（飞船），加载完成前为空
+		QRP_INPUT_ATTR(QMatrix4x4, MeshCasterWorldMatrix);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QShadowPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, ShadowAtlas)		//2x2 排布的级联深度图（深度纹理，采样 .r 得到深度）
+	QRP_OUTPUT_END()
+public:
+	struct CascadeStats {
+		int staticCasters = 0;
+		int dynamicCasters = 0;
+		int culledCasters = 0;
+		bool staticRedrawn = false;
+		int staticRedrawCount = 0;
+		int refitCount = 0;
+	};
+private:
+	struct CascadeCache {
+		QMatrix4x4 lightViewProjection;
+		quint64 staticRevision = ~0ull;
+		QRhiTexture* texture = nullptr;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mCubeBuffer;
+	QRhiBufferRef mInstanceBuffer;
+	QRhiBufferRef mMeshVertexBuffer;
+	QRhiBufferRef mMeshIndexBuffer;
+	QRhiGraphicsPipelineRef mMeshCasterPipeline;
+	const QMeshGeometry* mUploadedMesh = nullptr;
+	QRhiTextureRef mStaticMaps[QShadowCascadeSet::CascadeCount];
+	QRhiTextureRenderTargetRef mStaticRenderTargets[QShadowCascadeSet::CascadeCount];
+	QRhiTextureRef mAtlas;
+	QRhiTextureRenderTargetRef mAtlasRenderTarget;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mCasterBindings;
+	QRhiGraphicsPipelineRef mCasterPipeline;
+	QRhiShaderResourceBindingsRef mCopyBindings[QShadowCascadeSet::CascadeCount];
+	QRhiGraphicsPipelineRef mCopyPipeline;
+	QShader mCasterVS;
+	QShader mCasterFS;
+	QShader mCopyFS;
+	int mInstanceCapacity = 0;
+	bool mCubeUploaded = false;
+	CascadeCache mCaches[QShadowCascadeSet::CascadeCount];
+	CascadeStats mStats[QShadowCascadeSet::CascadeCount];
+public:
+	QShadowPassBuilder() {
+		mCasterVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inPosition;
+			layout (location = 1) in vec4 inMatrix0;			//逐实例：lightViewProjection * model
+			layout (location = 2) in vec4 inMatrix1;
+			layout (location = 3) in vec4 inMatrix2;
+			layout (location = 4) in vec4 inMatrix3;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				gl_Position = mat4(inMatrix0, inMatrix1, inMatrix2, inMatrix3) * vec4(inPosition, 1.0);
+			}
+		)");
+		mCasterFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			void main() {
+			}
+		)");
+		mCopyFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform sampler2D uStaticMap;
+			layout (location = 0) in vec2 vUV;
+			void main() {
+				gl_FragDepth = texture(uStaticMap, vUV).r;
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QShadowCascadeSet& cascades = mInput._Cascades;
+		const QSize mapSize(cascades.resolution, cascades.resolution);
+		const QMeshGeometry* meshCaster = mInput._MeshCaster.get();
+		mInstanceCapacity = qMax(mInstanceCapacity, (int(mInput._Casters.size()) * 2 + 1) * QShadowCascadeSet::CascadeCount);
+
+		builder.setupBuffer(mCubeBuffer, "ShadowCubeBuffer", QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(CubeVertexData));
+		builder.setupBuffer(mInstanceBuffer, "ShadowInstanceBuffer", QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, sizeof(float) * 16 * qMax(1, mInstanceCapacity));
+		if (meshCaster) {
+			builder.setupBuffer(mMeshVertexBuffer, "ShadowMeshVertexBuffer", QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(QMeshGeometry::Vertex) * meshCaster->vertices.size());
+			builder.setupBuffer(mMeshIndexBuffer, "ShadowMeshIndexBuffer", QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer, sizeof(quint32) * meshCaster->indices.size());
+		}
+		builder.setupSampler(mSampler, "ShadowCopySampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		// 使用深度附件保留最近的深度，而不是在颜色附件上做Min混合：R32F的混合在Vulkan中是可选特性
+		const QRhiTexture::Format depthFormat = mRhi->isTextureFormatSupported(QRhiTexture::D32F, QRhiTexture::RenderTarget) ? QRhiTexture::D32F : QRhiTexture::D24;
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++) {
+			builder.setupTexture(mStaticMaps[i], QString("ShadowStaticMap%1").arg(i).toLocal8Bit(), depthFormat, mapSize, 1, QRhiTexture::RenderTarget);
+			QRhiTextureRenderTargetDescription staticDesc;
+			staticDesc.setDepthTexture(mStaticMaps[i].get());
+			builder.setupRenderTarget(mStaticRenderTargets[i], QString("ShadowStaticRT%1").arg(i).toLocal8Bit(), staticDesc);
+			builder.setupShaderResourceBindings(mCopyBindings[i], QString("ShadowCopyBindings%1").arg(i).toLocal8Bit(), {
+				QRhiShaderResourceBinding::sampledTexture(0, QRhiShaderResourceBinding::FragmentStage, mStaticMaps[i].get(), mSampler.get()),
+			});
+		}
+		builder.setupTexture(mAtlas, "ShadowAtlas", depthFormat, mapSize * 2, 1, QRhiTexture::RenderTarget);
+		QRhiTextureRenderTargetDescription atlasDesc;
+		atlasDesc.setDepthTexture(mAtlas.get());
+		builder.setupRenderTarget(mAtlasRenderTarget, "ShadowAtlasRT", atlasDesc);
+
+		builder.setupShaderResourceBindings(mCasterBindings, "ShadowCasterBindings", {});
+		QRhiGraphicsPipelineState casterPSO;
+		casterPSO.shaderResourceBindings = mCasterBindings.get();
+		casterPSO.sampleCount = mAtlasRenderTarget->sampleCount();
+		casterPSO.renderPassDesc = mAtlasRenderTarget->renderPassDescriptor();
+		casterPSO.depthTest = true;
+		casterPSO.depthWrite = true;
+		casterPSO.depthOp = QRhiGraphicsPipeline::Less;
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({
+			QRhiVertexInputBinding(6 * sizeof(float)),
+			QRhiVertexInputBinding(16 * sizeof(float), QRhiVertexInputBinding::PerInstance),
+		});
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, 0),
+			QRhiVertexInputAttribute(1, 1, QRhiVertexInputAttribute::Float4, 0),
+			QRhiVertexInputAttribute(1, 2, QRhiVertexInputAttribute::Float4, 4 * sizeof(float)),
+			QRhiVertexInputAttribute(1, 3, QRhiVertexInputAttribute::Float4, 8 * sizeof(float)),
+			QRhiVertexInputAttribute(1, 4, QRhiVertexInputAttribute::Float4, 12 * sizeof(float)),
+		});
+		casterPSO.vertexInputLayout = inputLayout;
+		casterPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mCasterVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCasterFS)
+		};
+		builder.setupGraphicsPipeline(mCasterPipeline, "ShadowCasterPipeline", casterPSO);
+
+		if (meshCaster) {								//网格投射体只用到顶点位置，与立方体共用着色器与逐实例矩阵
+			QRhiVertexInputLayout meshInputLayout = inputLayout;
+			meshInputLayout.setBindings({
+				QRhiVertexInputBinding(sizeof(QMeshGeometry::Vertex)),
+				QRhiVertexInputBinding(16 * sizeof(float), QRhiVertexInputBinding::PerInstance),
+			});
+			casterPSO.vertexInputLayout = meshInputLayout;
+			builder.setupGraphicsPipeline(mMeshCasterPipeline, "ShadowMeshCasterPipeline", casterPSO);
+		}
+
+		QRhiGraphicsPipelineState copyPSO;				//拷贝到图集中已清除的区域，之后动态投射体再做深度测试
+		copyPSO.shaderResourceBindings = mCopyBindings[0].get();
+		copyPSO.sampleCount = mAtlasRenderTarget->sampleCount();
+		copyPSO.renderPassDesc = mAtlasRenderTarget->renderPassDescriptor();
+		copyPSO.depthTest = true;
+		copyPSO.depthWrite = true;
+		copyPSO.depthOp = QRhiGraphicsPipeline::Always;
+		copyPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCopyFS)
+		};
+		builder.setupGraphicsPipeline(mCopyPipeline, "ShadowCopyPipeline", copyPSO);
+
+		mOutput.ShadowAtlas = mAtlas;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QShadowCascadeSet& cascades = mInput._Cascades;
+		const QVector<QShadowBoxComponent*>& casters = mInput._Casters;
+		const QMeshGeometry* meshCaster = mInput._MeshCaster.get();
+		quint64 staticRevision = 0;
+		for (QShadowBoxComponent* caster : casters) {
+			if (caster->isStaticCaster())
+				staticRevision = staticRevision * 31 + caster->getRevision() + 1;
+		}
+		QMatrix4x4 meshBounds;							//把单位立方体变换为网格的包围盒，复用立方体的级联求交
+		if (meshCaster) {
+			staticRevision = staticRevision * 31 + quintptr(meshCaster);
+			staticRevision = staticRevision * 31 + qHashBits(mInput._MeshCasterWorldMatrix.constData(), sizeof(float) * 16);
+			meshBounds = mInput._MeshCasterWorldMatrix;
+			meshBounds.translate(meshCaster->boundsCenter);
+			meshBounds.scale(2.0f * meshCaster->boundsRadius);
+		}
+
+		QVector<QGenericMatrix<4, 4, float>> instances;
+		instances.reserve(mInstanceCapacity);
+		struct DrawRange { int first = 0; int count = 0; };
+		DrawRange staticRanges[QShadowCascadeSet::CascadeCount];
+		DrawRange meshRanges[QShadowCascadeSet::CascadeCount];
+		DrawRange dynamicRanges[QShadowCascadeSet::CascadeCount];
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++) {
+			CascadeStats& stats = mStats[i];
+			CascadeCache& cache = mCaches[i];
+			stats.staticCasters = stats.dynamicCasters = stats.culledCasters = 0;
+			if (cascades.refitted[i])
+				stats.refitCount++;
+			stats.staticRedrawn = cache.staticRevision != staticRevision
+				|| cache.texture != mStaticMaps[i].get()
+				|| !qFuzzyCompare(cache.lightViewProjection, cascades.lightViewProjection[i]);
+
+			staticRanges[i].first = instances.size();
+			for (QShadowBoxComponent* caster : casters) {
+				if (!caster->isStaticCaster())
+					continue;
+				if (!cascades.intersects(i, caster->getWorldMatrix())) {
+					stats.culledCasters++;
+					continue;
+				}
+				stats.staticCasters++;
+				if (stats.staticRedrawn)
+					instances << (cascades.lightViewProjection[i] * caster->getWorldMatrix()).toGenericMatrix<4, 4>();
+			}
+			staticRanges[i].count = instances.size() - staticRanges[i].first;
+
+			meshRanges[i].first = instances.size();
+			if (meshCaster) {
+				if (!cascades.intersects(i, meshBounds)) {
+					stats.culledCasters++;
+				}
+				else {
+					stats.staticCasters++;
+					if (stats.staticRedrawn)
+						instances << (cascades.lightViewProjection[i] * mInput._MeshCasterWorldMatrix).toGenericMatrix<4, 4>();
+				}
+			}
+			meshRanges[i].count = instances.size() - meshRanges[i].first;
+
+			dynamicRanges[i].first = instances.size();
+			for (QShadowBoxComponent* caster : casters) {
+				if (caster->isStaticCaster())
+					continue;
+				if (!cascades.intersects(i, caster->getWorldMatrix())) {
+					stats.culledCasters++;
+					continue;
+				}
+				stats.dynamicCasters++;
+				instances << (cascades.lightViewProjection[i] * caster->getWorldMatrix()).toGenericMatrix<4, 4>();
+			}
+			dynamicRanges[i].count = instances.size() - dynamicRanges[i].first;
+
+			if (stats.staticRedrawn) {
+				stats.staticRedrawCount++;
+				cache.staticRevision = staticRevision;
+				cache.texture = mStaticMaps[i].get();
+				cache.lightViewProjection = cascades.lightViewProjection[i];
+			}
+		}
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		if (!mCubeUploaded) {
+			batch->uploadStaticBuffer(mCubeBuffer.get(), CubeVertexData);
+			mCubeUploaded = true;
+		}
+		if (meshCaster && mUploadedMesh != meshCaster) {
+			batch->uploadStaticBuffer(mMeshVertexBuffer.get(), meshCaster->vertices.constData());
+			batch->uploadStaticBuffer(mMeshIndexBuffer.get(), meshCaster->indices.constData());
+			mUploadedMesh = meshCaster;
+		}
+		if (!instances.isEmpty())
+			batch->updateDynamicBuffer(mInstanceBuffer.get(), 0, instances.size() * sizeof(float) * 16, instances.constData());
+
+		const QColor farDepth = QColor::fromRgbF(1.0f, 1.0f, 1.0f, 1.0f);			//没有颜色附件，只有深度清除值生效
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		auto drawCasters = [&](const DrawRange& range) {
+			if (range.count == 0)
+				return;
+			cmdBuffer->setGraphicsPipeline(mCasterPipeline.get());
+			cmdBuffer->setShaderResources(mCasterBindings.get());
+			const QRhiCommandBuffer::VertexInput vertexInputs[] = {
+				{ mCubeBuffer.get(), 0 },
+				{ mInstanceBuffer.get(), quint32(range.first * sizeof(float) * 16) },
+			};
+			cmdBuffer->setVertexInput(0, 2, vertexInputs);
+			cmdBuffer->draw(CubeVertexCount, range.count);
+		};
+		auto drawMeshCaster = [&](const DrawRange& range) {
+			if (range.count == 0)
+				return;
+			cmdBuffer->setGraphicsPipeline(mMeshCasterPipeline.get());
+			cmdBuffer->setShaderResources(mCasterBindings.get());
+			const QRhiCommandBuffer::VertexInput vertexInputs[] = {
+				{ mMeshVertexBuffer.get(), 0 },
+				{ mInstanceBuffer.get(), quint32(range.first * sizeof(float) * 16) },
+			};
+			cmdBuffer->setVertexInput(0, 2, vertexInputs, mMeshIndexBuffer.get(), 0, QRhiCommandBuffer::IndexUInt32);
+			cmdBuffer->drawIndexed(meshCaster->indices.size(), range.count);
+		};
+
+		// 静态投射体只在级联矩阵或静态物体变化时重绘
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++) {
+			if (!mStats[i].staticRedrawn)
+				continue;
+			cmdBuffer->beginPass(mStaticRenderTargets[i].get(), farDepth, dsClearValue, batch);
+			batch = nullptr;
+			cmdBuffer->setViewport(QRhiViewport(0, 0, cascades.resolution, cascades.resolution));
+			drawCasters(staticRanges[i]);
+			drawMeshCaster(meshRanges[i]);
+			cmdBuffer->endPass();
+		}
+
+		// 每帧只需拷贝静态结果并叠加动态投射体，开销与动态物体数量相关而与场景规模无关
+		cmdBuffer->beginPass(mAtlasRenderTarget.get(), farDepth, dsClearValue, batch);
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++) {
+			cmdBuffer->setViewport(QRhiViewport((i % 2) * cascades.resolution, (i / 2) * cascades.resolution, cascades.resolution, cascades.resolution));
+			cmdBuffer->setGraphicsPipeline(mCopyPipeline.get());
+			cmdBuffer->setShaderResources(mCopyBindings[i].get());
+			cmdBuffer->draw(4);
+			drawCasters(dynamicRanges[i]);
+		}
+		cmdBuffer->endPass();
+	}
+	const CascadeStats& getCascadeStats(int cascade) const { return mStats[cascade]; }
+};
+
+// 阴影采样需要的Uniform，位于阴影遮罩Pass和太阳光照Pass的UniformBlock开头，两者的着色器共用 glslFunctions() 中的采样函数
+struct QShadowSamplingUniforms {
+	float cascadeMatrices[QShadowCascadeSet::CascadeCount][16];
+	float view[16];
+	QVector4D cascadeSplits;
+	QVector4D cascadeTexelSizes;							//每级阴影图一个纹素对应的世界空间尺寸，用于法线偏移
+	QVector4D params;										//y：深度偏移 z：裁剪空间深度是否为[0,1]
+
+	void set(const QShadowCascadeSet& cascades, const QMatrix4x4& viewMatrix, float depthBias, bool clipDepthZeroToOne) {
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++)
+			memcpy(cascadeMatrices[i], cascades.lightViewProjection[i].constData(), sizeof(cascadeMatrices[i]));
+		memcpy(view, viewMatrix.constData(), sizeof(view));
+		cascadeSplits = QVector4D(cascades.splitFar[0], cascades.splitFar[1], cascades.splitFar[2], cascades.splitFar[3]);
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++)
+			cascadeTexelSizes[i] = 2.0f * cascades.radius[i] / cascades.resolution;
+		params = QVector4D(0.0f, depthBias, clipDepthZeroToOne ? 1.0f : 0.0f, 0.0f);
+	}
+
+	static QByteArray glslMembers() {
+		return R"(
+				mat4 cascadeMatrices[4];
+				mat4 view;
+				vec4 cascadeSplits;
+				vec4 cascadeTexelSizes;
+				vec4 params;
+		)";
+	}
+
+	// sampleShadow 为固定的3x3 PCF；sampleShadowRotated 每帧旋转4个采样点，需要时域累积才能收敛
+	static QByteArray glslFunctions() {
+		return R"(
+			bool lookupShadow(vec3 position, vec3 N, out vec2 uv, out float receiverDepth, out vec2 tileMin, out vec2 tileMax, out vec2 texelSize) {
+				float depth = -(UBO.view * vec4(position, 1.0)).z;
+				int cascade = 0;
+				while (cascade < 3 && depth > UBO.cascadeSplits[cascade])
+					cascade++;
+				if (depth > UBO.cascadeSplits[3])
+					return false;
+				vec4 clip = UBO.cascadeMatrices[cascade] * vec4(position + N * UBO.cascadeTexelSizes[cascade], 1.0);
+				vec3 ndc = clip.xyz / clip.w;
+				receiverDepth = UBO.params.z > 0.5 ? ndc.z : ndc.z * 0.5 + 0.5;
+				uv = (ndc.xy * 0.5 + 0.5 + vec2(cascade % 2, cascade / 2)) * 0.5;
+				texelSize = 1.0 / vec2(textureSize(uShadowAtlas, 0));
+				tileMin = vec2(cascade % 2, cascade / 2) * 0.5 + texelSize;
+				tileMax = tileMin + 0.5 - 2.0 * texelSize;
+				return true;
+			}
+			float sampleShadow(vec3 position, vec3 N) {
+				vec2 uv, tileMin, tileMax, texelSize;
+				float receiverDepth;
+				if (!lookupShadow(position, N, uv, receiverDepth, tileMin, tileMax, texelSize))
+					return 1.0;
+				float visibility = 0.0;
+				for (int y = -1; y <= 1; y++) {
+					for (int x = -1; x <= 1; x++) {
+						float occluder = texture(uShadowAtlas, clamp(uv + vec2(x, y) * texelSize, tileMin, tileMax)).r;
+						visibility += receiverDepth - UBO.params.y <= occluder ? 1.0 : 0.0;
+					}
+				}
+				return visibility / 9.0;
+			}
+			float sampleShadowRotated(vec3 position, vec3 N, float angle) {
+				vec2 uv, tileMin, tileMax, texelSize;
+				float receiverDepth;
+				if (!lookupShadow(position, N, uv, receiverDepth, tileMin, tileMax, texelSize))
+					return 1.0;
+				const vec2 taps[4] = vec2[](vec2(-0.7, -0.3), vec2(0.3, -0.7), vec2(0.7, 0.3), vec2(-0.3, 0.7));
+				mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+				float visibility = 0.0;
+				for (int i = 0; i < 4; i++) {
+					float occluder = texture(uShadowAtlas, clamp(uv + rotation * taps[i] * 1.5 * texelSize, tileMin, tileMax)).r;
+					visibility += receiverDepth - UBO.params.y <= occluder ? 1.0 : 0.0;
+				}
+				return visibility / 4.0;
+			}
+		)";
+	}
+};
+
+// 时域阴影过滤的第一步：只计算太阳光的可见度，每帧旋转4个采样点，由 QTemporalAccumulatePassBuilder 累积后交给太阳光照Pass
+class QShadowMaskPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QShadowMaskPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, Normal);
+		QRP_INPUT_ATTR(QRhiTextureRef, Position);
+		QRP_INPUT_ATTR(QRhiTextureRef, ShadowAtlas);
+		QRP_INPUT_ATTR(QShadowCascadeSet, Cascades);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(float, DepthBias);
+		QRP_INPUT_ATTR(int, FrameIndex);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QShadowMaskPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, ShadowMask)			//r：太阳光可见度
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		QShadowSamplingUniforms shadow;
+		QVector4D temporalParams;							//x：帧序号
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mShadowMask;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mMaskFS;
+public:
+	QShadowMaskPassBuilder() {
+		mMaskFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n"
+			"layout (binding = 0) uniform UniformBlock {" + QShadowSamplingUniforms::glslMembers() + R"(
+				vec4 temporalParams;
+			}UBO;
+			layout (binding = 1) uniform sampler2D uNormal;
+			layout (binding = 2) uniform sampler2D uPosition;
+			layout (binding = 3) uniform sampler2D uShadowAtlas;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outShadowMask;
+		)" + QShadowSamplingUniforms::glslFunctions() + R"(
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec3 normal = texelFetch(uNormal, pixel, 0).xyz;
+				if (dot(normal, normal) < 1e-4) {
+					outShadowMask = vec4(1.0);
+					return;
+				}
+				float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+				float angle = 6.2831853 * fract(noise + UBO.temporalParams.x * 0.618034);
+				outShadowMask = vec4(sampleShadowRotated(texelFetch(uPosition, pixel, 0).xyz, normalize(normal), angle));
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		builder.setupTexture(mShadowMask, "ShadowMask", QRhiTexture::R16F, mInput._Position->pixelSize(), 1, QRhiTexture::RenderTarget);
+		builder.setupRenderTarget(mRenderTarget, "ShadowMaskRT", QRhiTextureRenderTargetDescription(mShadowMask.get()));
+		builder.setupBuffer(mUniformBuffer, "ShadowMaskUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mSampler, "ShadowMaskSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupShaderResourceBindings(mBindings, "ShadowMaskBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._Normal.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._Position.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._ShadowAtlas.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mMaskFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "ShadowMaskPipeline", PSO);
+
+		mOutput.ShadowMask = mShadowMask;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		UniformBlock ubo;
+		ubo.shadow.set(mInput._Cascades, mInput._ViewMatrix, mInput._DepthBias, mRhi->isClipDepthZeroToOne());
+		ubo.temporalParams = QVector4D(mInput._FrameIndex % 1024, 0.0f, 0.0f, 0.0f);
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		const QColor clearColor = QColor::fromRgbF(1.0f, 1.0f, 1.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+class QSunLightingPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QSunLightingPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, LightingResult);
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QRhiTextureRef, Metallic);
+		QRP_INPUT_ATTR(QRhiTextureRef, Normal);
+		QRP_INPUT_ATTR(QRhiTextureRef, Position);
+		QRP_INPUT_ATTR(QRhiTextureRef, Roughness);
+		QRP_INPUT_ATTR(QRhiTextureRef, ShadowAtlas);
+		QRP_INPUT_ATTR(QRhiTextureRef, ShadowMask);			//可选：时域过滤后的可见度，设置后不再采样阴影图
+		QRP_INPUT_ATTR(QShadowCascadeSet, Cascades);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QVector3D, CameraPosition);
+		QRP_INPUT_ATTR(QColor, SunColor);
+		QRP_INPUT_ATTR(float, SunIntensity);
+		QRP_INPUT_ATTR(float, DepthBias);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QSunLightingPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, SunLightingResult)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		QShadowSamplingUniforms shadow;
+		QVector4D lightDirection;
+		QVector4D lightColor;
+		QVector4D cameraPosition;
+		QVector4D maskParams;								//x：是否读取阴影遮罩
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mLightingFS;
+public:
+	QSunLightingPassBuilder() {
+		mLightingFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n"
+			"layout (binding = 0) uniform UniformBlock {" + QShadowSamplingUniforms::glslMembers() + R"(
+				vec4 lightDirection;
+				vec4 lightColor;
+				vec4 cameraPosition;
+				vec4 maskParams;
+			}UBO;
+			layout (binding = 1) uniform sampler2D uLightingResult;
+			layout (binding = 2) uniform sampler2D uBaseColor;
+			layout (binding = 3) uniform sampler2D uMetallic;
+			layout (binding = 4) uniform sampler2D uNormal;
+			layout (binding = 5) uniform sampler2D uPosition;
+			layout (binding = 6) uniform sampler2D uRoughness;
+			layout (binding = 7) uniform sampler2D uShadowAtlas;
+			layout (binding = 8) uniform sampler2D uShadowMask;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+		)" + QShadowSamplingUniforms::glslFunctions() + R"(
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec4 lighting = texelFetch(uLightingResult, pixel, 0);
+				vec3 normal = texelFetch(uNormal, pixel, 0).xyz;
+				if (dot(normal, normal) < 1e-4) {
+					outFragColor = lighting;
+					return;
+				}
+				vec3 position = texelFetch(uPosition, pixel, 0).xyz;
+				vec3 baseColor = texelFetch(uBaseColor, pixel, 0).rgb;
+				float metallic = texelFetch(uMetallic, pixel, 0).r;
+				float roughness = texelFetch(uRoughness, pixel, 0).r;
+				vec3 N = normalize(normal);
+				vec3 L = -UBO.lightDirection.xyz;
+				vec3 V = normalize(UBO.cameraPosition.xyz - position);
+				vec3 H = normalize(L + V);
+				float NdotL = max(dot(N, L), 0.0);
+				float shininess = mix(256.0, 4.0, roughness);
+				vec3 diffuse = baseColor * (1.0 - metallic) * NdotL;
+				vec3 specular = mix(vec3(0.04), baseColor, metallic) * pow(max(dot(N, H), 0.0), shininess) * (NdotL > 0.0 ? 1.0 : 0.0);
+				float visibility = UBO.maskParams.x > 0.5 ? texelFetch(uShadowMask, pixel, 0).r : sampleShadow(position, N);
+				vec3 sun = (diffuse + specular) * UBO.lightColor.rgb * UBO.lightColor.a * visibility;
+				outFragColor = vec4(lighting.rgb + sun, lighting.a);
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		builder.setupTexture(mColorAttachment, "SunLighting", QRhiTexture::RGBA16F, mInput._LightingResult->pixelSize(), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mRenderTarget, "SunLightingRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupBuffer(mUniformBuffer, "SunLightingUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mSampler, "SunLightingSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		QRhiTexture* shadowMask = mInput._ShadowMask.get() != nullptr ? mInput._ShadowMask.get() : mInput._ShadowAtlas.get();		//不使用遮罩时绑定任意纹理占位
+		builder.setupShaderResourceBindings(mBindings, "SunLightingBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._LightingResult.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._Metallic.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, mInput._Normal.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(5, QRhiShaderResourceBinding::FragmentStage, mInput._Position.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(6, QRhiShaderResourceBinding::FragmentStage, mInput._Roughness.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(7, QRhiShaderResourceBinding::FragmentStage, mInput._ShadowAtlas.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(8, QRhiShaderResourceBinding::FragmentStage, shadowMask, mSampler.get()),
+		});
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mLightingFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "SunLightingPipeline", PSO);
+
+		mOutput.SunLightingResult = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QShadowCascadeSet& cascades = mInput._Cascades;
+		UniformBlock ubo;
+		ubo.shadow.set(cascades, mInput._ViewMatrix, mInput._DepthBias, mRhi->isClipDepthZeroToOne());
+		ubo.lightDirection = QVector4D(cascades.lightDirection, 0.0f);
+		ubo.lightColor = QVector4D(mInput._SunColor.redF(), mInput._SunColor.greenF(), mInput._SunColor.blueF(), mInput._SunIntensity);
+		ubo.cameraPosition = QVector4D(mInput._CameraPosition, 1.0f);
+		ubo.maskParams = QVector4D(mInput._ShadowMask.get() != nullptr ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+// 沿运动矢量重投影历史，只累积单通道的阴影可见度：光照、高光和天空不经过历史，不会拖影
+class QTemporalAccumulatePassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QTemporalAccumulatePassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, Current);
+		QRP_INPUT_ATTR(QRhiTextureRef, MotionVector);
+		QRP_INPUT_ATTR(float, HistoryWeight);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QTemporalAccumulatePassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Result)
+	QRP_OUTPUT_END()
+private:
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mResult;
+	QRhiTextureRef mHistoryTexture[2];
+	QRhiTextureRenderTargetRef mRenderTarget[2];			//同时写入结果和本帧的历史纹理，结果纹理固定，下游的绑定不需要每帧切换
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mNearestSampler;
+	QRhiSamplerRef mLinearSampler;
+	QRhiShaderResourceBindingsRef mBindings[2];
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mAccumulateFS;
+	QSize mSize;
+	bool mHistoryValid = false;
+	int mFrameIndex = 0;
+public:
+	QTemporalAccumulatePassBuilder() {
+		mAccumulateFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, R"(#version 450
+			layout (binding = 0) uniform UniformBlock {
+				vec4 params;										//x：历史权重
+			}UBO;
+			layout (binding = 1) uniform sampler2D uCurrent;
+			layout (binding = 2) uniform sampler2D uHistory;
+			layout (binding = 3) uniform sampler2D uMotionVector;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outResult;
+			layout (location = 1) out vec4 outHistory;
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				ivec2 size = textureSize(uCurrent, 0);
+				float current = texelFetch(uCurrent, pixel, 0).r;
+				float neighborhoodMin = current;
+				float neighborhoodMax = current;
+				for (int y = -1; y <= 1; y++) {
+					for (int x = -1; x <= 1; x++) {
+						float neighbor = texelFetch(uCurrent, clamp(pixel + ivec2(x, y), ivec2(0), size - 1), 0).r;
+						neighborhoodMin = min(neighborhoodMin, neighbor);
+						neighborhoodMax = max(neighborhoodMax, neighbor);
+					}
+				}
+				vec2 historyUV = gl_FragCoord.xy / vec2(size) - texelFetch(uMotionVector, pixel, 0).xy;
+				float weight = UBO.params.x;
+				if (any(lessThan(historyUV, vec2(0.0))) || any(greaterThan(historyUV, vec2(1.0))))
+					weight = 0.0;
+				float history = clamp(texture(uHistory, historyUV).r, neighborhoodMin, neighborhoodMax);
+				outResult = vec4(mix(current, history, weight));
+				outHistory = outResult;
+			}
+		)");
+	}
+	void resetHistory() { mHistoryValid = false; }
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize size = mInput._Current->pixelSize();
+		if (size != mSize) {
+			mSize = size;
+			mHistoryValid = false;
+		}
+		builder.setupTexture(mResult, "TemporalAccumulateResult", QRhiTexture::R16F, size, 1, QRhiTexture::RenderTarget);
+		for (int i = 0; i < 2; i++) {
+			builder.setupTexture(mHistoryTexture[i], "TemporalAccumulateHistory" + QByteArray::number(i), QRhiTexture::R16F, size, 1, QRhiTexture::RenderTarget);
+		}
+		for (int i = 0; i < 2; i++) {				// i 为本帧写入的历史纹理
+			QRhiTextureRenderTargetDescription rtDesc;
+			rtDesc.setColorAttachments({ QRhiColorAttachment(mResult.get()), QRhiColorAttachment(mHistoryTexture[i].get()) });
+			builder.setupRenderTarget(mRenderTarget[i], "TemporalAccumulateRT" + QByteArray::number(i), rtDesc);
+		}
+		builder.setupBuffer(mUniformBuffer, "TemporalAccumulateUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(QVector4D));
+		builder.setupSampler(mNearestSampler, "TemporalAccumulateNearestSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mLinearSampler, "TemporalAccumulateLinearSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		for (int i = 0; i < 2; i++) {				// i 为本帧写入的历史纹理
+			builder.setupShaderResourceBindings(mBindings[i], "TemporalAccumulateBindings" + QByteArray::number(i), {
+				QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+				QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._Current.get(), mNearestSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mHistoryTexture[1 - i].get(), mLinearSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._MotionVector.get(), mNearestSampler.get()),
+			});
+		}
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings[0].get();
+		PSO.sampleCount = mRenderTarget[0]->sampleCount();
+		PSO.renderPassDesc = mRenderTarget[0]->renderPassDescriptor();
+		PSO.targetBlends = { QRhiGraphicsPipeline::TargetBlend(), QRhiGraphicsPipeline::TargetBlend() };
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mAccumulateFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "TemporalAccumulatePipeline", PSO);
+
+		mOutput.Result = mResult;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QVector4D params(mHistoryValid ? qBound(0.0f, mInput._HistoryWeight, 0.98f) : 0.0f, 0.0f, 0.0f, 0.0f);
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(QVector4D), &params);
+
+		const int current = mFrameIndex & 1;
+		const QColor clearColor = QColor::fromRgbF(1.0f, 1.0f, 1.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget[current].get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mSize.width(), mSize.height()));
+		cmdBuffer->setShaderResources(mBindings[current].get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+
+		mHistoryValid = true;
+		mFrameIndex++;
+	}
+};
 
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, MovingCasterCount) = 4;
+	Q_PROPERTY_VAR(float, ShadowDistance) = 80.0f;
+	Q_PROPERTY_VAR(float, ShadowCasterMargin) = 16.0f;
+	Q_PROPERTY_VAR(int, ShadowResolution) = 1024;
+	Q_PROPERTY_VAR(float, CascadeSplitLambda) = 0.75f;
+	Q_PROPERTY_VAR(float, CascadeRefitPadding) = 0.2f;
+	Q_PROPERTY_VAR(float, DepthBias) = 0.0005f;
+	Q_PROPERTY_VAR(QVector3D, SunDirection) = QVector3D(-0.4f, -1.0f, -0.3f);
+	Q_PROPERTY_VAR(QColor, SunColor) = QColor(255, 244, 214);
+	Q_PROPERTY_VAR(float, SunIntensity) = 2.0f;
+	Q_PROPERTY_VAR(bool, TemporalShadowFilter) = false;
+	Q_PROPERTY_VAR(float, HistoryWeight) = 0.9f;
+	Q_PROPERTY_VAR(bool, ShowMotionVectors) = false;
+
+	Q_CLASSINFO("MovingCasterCount", "Min=0,Max=16")
+	Q_CLASSINFO("ShadowResolution", "Min=256,Max=4096")
+	Q_CLASSINFO("ShadowCasterMargin", "Min=0,Max=80")
+	Q_CLASSINFO("CascadeRefitPadding", "Min=0,Max=1")
+	Q_CLASSINFO("HistoryWeight", "Min=0,Max=0.98")
 private:
+	static const int PillarGridSize = 8;
+	static const int MaxMovingCasters = 16;
 	QStaticMeshRenderComponent mStaticComp;
+	QShadowBoxComponent mGroundComp;
+	QShadowBoxComponent mPillarComps[PillarGridSize * PillarGridSize];
+	QShadowBoxComponent mMovingComps[MaxMovingCasters];
+	QVector<QShadowBoxComponent*> mCasters;
+	QShadowCascadeSet mCascades;							//上一帧的级联，视锥仍在其中时沿用，静态阴影图的缓存才能命中
+	QFuture<QSharedPointer<const QMeshGeometry>> mShipGeometryFuture;
+	QSharedPointer<const QMeshGeometry> mShipGeometry;		//飞船的阴影投射体，与渲染组件读取同一个glTF
 	QSharedPointer<QPbrMeshPassBuilder> mMeshPass{ new QPbrMeshPassBuilder };
 	QSharedPointer<QPbrLightingPassBuilder> mLightingPass{ new QPbrLightingPassBuilder };
 	QSharedPointer<QSkyPassBuilder> mSkyPass{ new QSkyPassBuilder };
+	QSharedPointer<QShadowPassBuilder> mShadowPass{ new QShadowPassBuilder };
+	QSharedPointer<QSunLightingPassBuilder> mSunLightingPass{ new QSunLightingPassBuilder };
+	QSharedPointer<QShadowMaskPassBuilder> mShadowMaskPass{ new QShadowMaskPassBuilder };
+	QSharedPointer<QMotionVectorPassBuilder> mMotionVectorPass{ new QMotionVectorPassBuilder };
+	QSharedPointer<QTemporalAccumulatePassBuilder> mTemporalAccumulatePass{ new QTemporalAccumulatePassBuilder };
+	int mFrameIndex = 0;
+	bool mMotionVectorsActive = false;						//上一帧是否生成了运动矢量，重新开启时丢弃过期的历史
+	bool mTemporalShadowActive = false;
+	QElapsedTimer mClock;
+	int mReportFrameCount = 0;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -21,13 +1023,98 @@ public:
 		QtConcurrent::run([this]() {
 			mStaticComp.setStaticMesh(QStaticMesh::CreateFromFile("Resources/Model/mandalorian_ship/scene.gltf"));
 		});
+		mShipGeometryFuture = QtConcurrent::run([]() -> QSharedPointer<const QMeshGeometry> {
+			QString error;
+			QSharedPointer<QMeshGeometry> geometry(new QMeshGeometry(QMeshGeometry::loadGltf("Resources/Model/mandalorian_ship/scene.gltf", &error)));
+			if (geometry->vertices.isEmpty()) {
+				qWarning() << "[Shadow] ship casts no shadow:" << error;
+				return nullptr;
+			}
+			return geometry;
+		});
 
 		mSkyPass->setSkyBoxImageByPath("Resources/Image/environment.hdr");
 
 		addComponent(&mStaticComp);
+
+		mGroundComp.setPosition(QVector3D(0.0f, -6.0f, 0.0f));
+		mGroundComp.setScale(QVector3D(120.0f, 0.5f, 120.0f));
+		mGroundComp.setColor(QColor::fromRgbF(0.6f, 0.6f, 0.6f, 1.0f));
+		addComponent(&mGroundComp);
+		mCasters << &mGroundComp;
+
+		for (int y = 0; y < PillarGridSize; y++) {
+			for (int x = 0; x < PillarGridSize; x++) {
+				const float height = 2.0f + ((x * 7 + y * 13) % 5) * 1.5f;
+				QShadowBoxComponent& pillar = mPillarComps[y * PillarGridSize + x];
+				pillar.setPosition(QVector3D((x - (PillarGridSize - 1) * 0.5f) * 12.0f, -5.75f + height * 0.5f, (y - (PillarGridSize - 1) * 0.5f) * 12.0f));
+				pillar.setScale(QVector3D(1.5f, height, 1.5f));
+				addComponent(&pillar);
+				mCasters << &pillar;
+			}
+		}
+		for (QShadowBoxComponent& box : mMovingComps) {
+			box.setColor(QColor::fromRgbF(0.9f, 0.4f, 0.2f, 1.0f));
+			addComponent(&box);
+			mCasters << &box;
+		}
+		mClock.start();
+	}
+private:
+	void updateMovingCasters() {
+		for (QShadowBoxComponent* caster : mCasters)
+			caster->commitFrame();
+		const float time = mClock.elapsed() / 1000.0f;
+		for (int i = 0; i < MaxMovingCasters; i++) {
+			QShadowBoxComponent& box = mMovingComps[i];
+			const bool moving = i < MovingCasterCount;
+			box.setStaticCaster(!moving);
+			const float phase = i * 2.0f * M_PI / MaxMovingCasters;
+			const float angle = phase + (moving ? time * 0.5f : 0.0f);
+			box.setPosition(QVector3D(qCos(angle) * 18.0f, -2.0f + qSin(phase * 3.0f) * 1.5f, qSin(angle) * 18.0f));
+			box.setRotation(QVector3D(0.0f, qRadiansToDegrees(angle), 0.0f));
+			box.setScale(QVector3D(2.0f, 2.0f, 2.0f));
+		}
+		for (QShadowBoxComponent* caster : mCasters)
+			caster->updateWorldMatrix();
+	}
+	void reportCascadeStats() {
+		static const int FramesPerReport = 240;
+		if (++mReportFrameCount < FramesPerReport)
+			return;
+		mReportFrameCount = 0;
+		for (int i = 0; i < QShadowCascadeSet::CascadeCount; i++) {
+			const QShadowPassBuilder::CascadeStats& stats = mShadowPass->getCascadeStats(i);
+			qDebug().noquote() << QString("[Shadow] cascade %1: %2 static (%3 redraws, %4 refits), %5 dynamic, %6 culled")
+				.arg(i)
+				.arg(stats.staticCasters)
+				.arg(stats.staticRedrawCount)
+				.arg(stats.refitCount)
+				.arg(stats.dynamicCasters)
+				.arg(stats.culledCasters);
+		}
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
+		updateMovingCasters();
+
+		if (!mShipGeometry && mShipGeometryFuture.isFinished())
+			mShipGeometry = mShipGeometryFuture.result();
+
+		mCascades = QShadowCascadeSet::compute(
+			getCamera()->getViewMatrix(),
+			getCamera()->getProjectionMatrix(),
+			graphBuilder.rhi()->clipSpaceCorrMatrix(),
+			SunDirection,
+			ShadowDistance,
+			ShadowCasterMargin,							//只需覆盖级联包围球朝向光源一侧、场景中最高的投影物，过大会浪费深度精度
+			ShadowResolution,
+			CascadeSplitLambda,
+			CascadeRefitPadding,							//级联半径的余量，视锥在余量内移动时级联矩阵保持不变
+			&mCascades
+		);
+		const QShadowCascadeSet& cascades = mCascades;
+
 		QSkyPassBuilder::Output skyOut
 			= graphBuilder.addPassBuilder("SkyPass", mSkyPass);
 
@@ -44,9 +1131,87 @@ protected:
 			.setSkyCube(skyOut.SkyCube)
 			.setSkyTexture(skyOut.SkyTexture);
 
+		QShadowPassBuilder::Output shadowOut
+			= graphBuilder.addPassBuilder("ShadowPass", mShadowPass)
+			.setCascades(cascades)
+			.setCasters(mCasters)
+			.setMeshCaster(mShipGeometry)
+			.setMeshCasterWorldMatrix(mStaticComp.calculateWorldMatrix());
+
+		// 运动矢量只在存在消费者时生成：时域阴影过滤，或运动矢量的调试视图
+		const bool motionVectorsActive = TemporalShadowFilter || ShowMotionVectors;
+		if (motionVectorsActive && !mMotionVectorsActive)
+			mMotionVectorPass->resetHistory();
+		if (TemporalShadowFilter && !mTemporalShadowActive)
+			mTemporalAccumulatePass->resetHistory();
+		mMotionVectorsActive = motionVectorsActive;
+		mTemporalShadowActive = TemporalShadowFilter;
+
+		QRhiTextureRef motionVector;
+		if (motionVectorsActive) {
+			QVector<QMotionVectorInstance> movingInstances;
+			for (QShadowBoxComponent* caster : mCasters) {
+				if (!caster->isStaticCaster())
+					movingInstances << QMotionVectorInstance{ caster->getWorldMatrix(), caster->getPreviousWorldMatrix() };
+			}
+			QMotionVectorPassBuilder::Output motionOut
+				= graphBuilder.addPassBuilder("MotionVectorPass", mMotionVectorPass)
+				.setPosition(meshOut.Position)
+				.setNormal(meshOut.Normal)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setMovingMesh({ CubeVertexData, CubeVertexCount, int(6 * sizeof(float)) })
+				.setMovingInstances(movingInstances);
+			motionVector = motionOut.MotionVector;
+		}
+
+		// 时域过滤只作用于阴影可见度：遮罩Pass每帧旋转4个采样点（非时域为9个），沿运动矢量累积后再参与光照
+		QRhiTextureRef shadowMask;
+		if (TemporalShadowFilter) {
+			QShadowMaskPassBuilder::Output maskOut
+				= graphBuilder.addPassBuilder("ShadowMaskPass", mShadowMaskPass)
+				.setNormal(meshOut.Normal)
+				.setPosition(meshOut.Position)
+				.setShadowAtlas(shadowOut.ShadowAtlas)
+				.setCascades(cascades)
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setDepthBias(DepthBias)
+				.setFrameIndex(mFrameIndex++);
+
+			QTemporalAccumulatePassBuilder::Output temporalOut
+				= graphBuilder.addPassBuilder("TemporalAccumulatePass", mTemporalAccumulatePass)
+				.setCurrent(maskOut.ShadowMask)
+				.setMotionVector(motionVector)
+				.setHistoryWeight(HistoryWeight);
+			shadowMask = temporalOut.Result;
+		}
+
+		QSunLightingPassBuilder::Output sunOut
+			= graphBuilder.addPassBuilder("SunLightingPass", mSunLightingPass)
+			.setLightingResult(lightingOut.LightingResult)
+			.setBaseColor(meshOut.BaseColor)
+			.setMetallic(meshOut.Metallic)
+			.setNormal(meshOut.Normal)
+			.setPosition(meshOut.Position)
+			.setRoughness(meshOut.Roughness)
+			.setShadowAtlas(shadowOut.ShadowAtlas)
+			.setShadowMask(shadowMask)
+			.setCascades(cascades)
+			.setViewMatrix(getCamera()->getViewMatrix())
+			.setCameraPosition(getCamera()->getPosition())
+			.setSunColor(SunColor)
+			.setSunIntensity(SunIntensity)
+			.setDepthBias(DepthBias);
+
+		const QRhiTextureRef finalColor = ShowMotionVectors ? motionVector : sunOut.SunLightingResult;
+
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(lightingOut.LightingResult);
+			.setInitialTexture(finalColor);
+
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			reportCascadeStats();
+		});
 	}
 };
 
@@ -56,4 +1221,6 @@ int main(int argc, char** argv) {
 	QRenderWidget widget(new MyRenderer());
 	widget.showMaximized();
 	return app.exec();
-}
\ No newline at end of file
+}
+
+#include "main.moc"
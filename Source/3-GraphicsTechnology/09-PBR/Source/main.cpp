@@ -1,19 +1,1913 @@
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QVulkanInstance>
+#include <QWidget>
+#include <algorithm>
+#include <numeric>
 #include "QtConcurrent/qtconcurrentrun.h"
+#include "QtConcurrent/qtconcurrentmap.h"
 #include "QRenderWidget.h"
+#include "QTextureFormatInfo.h"
 #include "Render/Component/QStaticMeshRenderComponent.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrMeshPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/PBR/QPbrLightingPassBuilder.h"
 #include "Render/RenderGraph/PassBuilder/QSkyPassBuilder.h"
 #include "QEngineApplication.h"
 #include "Render/PassBuilder/QOutputPassBuilder.h"
+#include "QMeshGeometry.h"
+#include "private/qrhivulkan_p.h"
+#include "qvulkanfunctions.h"
+
+#define Q_PROPERTY_VAR(Type,Name)\
+    Q_PROPERTY(Type Name READ get_##Name WRITE set_##Name) \
+    Type get_##Name(){ return Name; } \
+    void set_##Name(Type var){ \
+        Name = var;  \
+    } \
+    Type Name
+
+struct QPunctualLight {
+	QVector3D position;
+	float radius = 1.0f;
+	QVector3D color = QVector3D(1.0f, 1.0f, 1.0f);
+	float intensity = 1.0f;
+	QVector3D spotDirection = QVector3D(0.0f, -1.0f, 0.0f);
+	float spotCosOuter = -2.0f;							//小于-1表示点光源
+};
+
+class QLightClusterGrid {
+public:
+	static const int TileCountX = 16;
+	static const int TileCountY = 9;
+	static const int SliceCount = 24;
+	static const int ClusterCount = TileCountX * TileCountY * SliceCount;
+	static const int InitialLightsPerCluster = 32;			//每个簇的初始光源列表容量，GPU回读到溢出后按需扩容
+
+	struct Camera {
+		QMatrix4x4 view;
+		QMatrix4x4 projection;							//已经乘上 clipSpaceCorrMatrix
+		float nearPlane;
+		float farPlane;
+	};
+
+	static int clusterIndex(int x, int y, int z) {
+		return x + TileCountX * (y + TileCountY * z);
+	}
+
+	static float sliceDepth(const Camera& camera, int slice) {		//按指数划分深度切片
+		return camera.nearPlane * qPow(camera.farPlane / camera.nearPlane, float(slice) / SliceCount);
+	}
+
+	static void clusterBounds(const Camera& camera, int x, int y, int z, QVector3D& outMin, QVector3D& outMax) {
+		const float depths[2] = { sliceDepth(camera, z), sliceDepth(camera, z + 1) };
+		const float ndcX[2] = { float(x) / TileCountX * 2.0f - 1.0f, float(x + 1) / TileCountX * 2.0f - 1.0f };
+		const float ndcY[2] = { float(y) / TileCountY * 2.0f - 1.0f, float(y + 1) / TileCountY * 2.0f - 1.0f };
+		outMin = QVector3D(FLT_MAX, FLT_MAX, FLT_MAX);
+		outMax = QVector3D(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (float depth : depths) {
+			for (float nx : ndcX) {
+				for (float ny : ndcY) {
+					const QVector3D corner(nx * depth / camera.projection(0, 0), ny * depth / camera.projection(1, 1), -depth);
+					outMin = QVector3D(qMin(outMin.x(), corner.x()), qMin(outMin.y(), corner.y()), qMin(outMin.z(), corner.z()));
+					outMax = QVector3D(qMax(outMax.x(), corner.x()), qMax(outMax.y(), corner.y()), qMax(outMax.z(), corner.z()));
+				}
+			}
+		}
+	}
+
+	static bool sphereIntersectsAabb(const QVector3D& center, float radius, const QVector3D& aabbMin, const QVector3D& aabbMax) {
+		float distanceSquared = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			const float v = center[i];
+			if (v < aabbMin[i])
+				distanceSquared += (aabbMin[i] - v) * (aabbMin[i] - v);
+			else if (v > aabbMax[i])
+				distanceSquared += (v - aabbMax[i]) * (v - aabbMax[i]);
+		}
+		return distanceSquared <= radius * radius;
+	}
+
+	// CPU参考实现，与着色器中的分簇算法保持一致，返回不截断的完整光源列表，用于验证GPU结果
+	// radiusScale 用于得到边界附近的容差：缩小半径时一定相交的光源与放大半径时可能相交的光源
+	static QVector<QVector<int>> binLights(const Camera& camera, const QVector<QPunctualLight>& lights, float radiusScale = 1.0f) {
+		QVector<QVector3D> viewSpaceCenters(lights.size());
+		for (int i = 0; i < lights.size(); i++)
+			viewSpaceCenters[i] = camera.view.map(lights[i].position);
+		QVector<QVector<int>> clusters(ClusterCount);
+		for (int z = 0; z < SliceCount; z++) {
+			for (int y = 0; y < TileCountY; y++) {
+				for (int x = 0; x < TileCountX; x++) {
+					QVector3D aabbMin, aabbMax;
+					clusterBounds(camera, x, y, z, aabbMin, aabbMax);
+					QVector<int>& cluster = clusters[clusterIndex(x, y, z)];
+					for (int i = 0; i < lights.size(); i++) {
+						if (sphereIntersectsAabb(viewSpaceCenters[i], lights[i].radius * radiusScale, aabbMin, aabbMax))
+							cluster << i;
+					}
+				}
+			}
+		}
+		return clusters;
+	}
+};
+
+class QCompactGBuffer {
+public:
+	// 法线使用八面体映射压缩到两个分量，位置由深度重建
+	static QByteArray codecFunctions() {
+		return R"(
+			vec2 octWrap(vec2 v) {
+				return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+			}
+			vec2 octEncode(vec3 n) {
+				n /= abs(n.x) + abs(n.y) + abs(n.z);
+				n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+				return n.xy * 0.5 + 0.5;
+			}
+			vec3 octDecode(vec2 encoded) {
+				encoded = encoded * 2.0 - 1.0;
+				vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+				float t = clamp(-n.z, 0.0, 1.0);
+				n.x += n.x >= 0.0 ? -t : t;
+				n.y += n.y >= 0.0 ? -t : t;
+				return normalize(n);
+			}
+			vec3 reconstructPosition(vec2 fragCoord, vec2 size, float depth, mat4 inverseViewProjection) {
+				vec4 position = inverseViewProjection * vec4(fragCoord / size * 2.0 - 1.0, depth, 1.0);
+				return position.xyz / position.w;
+			}
+		)";
+	}
+};
+
+// 紧凑G-Buffer路径自己绘制网格，与引擎的静态网格组件读取同一个glTF
+struct QCompactGBufferMesh {
+	QMeshGeometry geometry;
+	QVector<QImage> baseColorImages;						//与 geometry.materials 一一对应，没有贴图时为1x1的白色图片
+	QVector<QImage> metallicRoughnessImages;
+
+	static QSharedPointer<const QCompactGBufferMesh> load(const QString& path) {
+		QSharedPointer<QCompactGBufferMesh> mesh(new QCompactGBufferMesh);
+		QString error;
+		mesh->geometry = QMeshGeometry::loadGltf(path, &error);
+		if (mesh->geometry.vertices.isEmpty()) {
+			qWarning() << "[CompactGBuffer]" << error;
+			return nullptr;
+		}
+		for (const QMeshGeometry::Material& material : mesh->geometry.materials) {
+			mesh->baseColorImages << loadImage(material.baseColorTexture);
+			mesh->metallicRoughnessImages << loadImage(material.metallicRoughnessTexture);
+		}
+		return mesh;
+	}
+private:
+	static QImage loadImage(const QString& path) {
+		QImage image;
+		if (!path.isEmpty() && !image.load(path))
+			qWarning() << "[CompactGBuffer] cannot load texture" << path;
+		if (image.isNull()) {
+			image = QImage(1, 1, QImage::Format_RGBA8888);
+			image.fill(Qt::white);
+		}
+		return image.convertToFormat(QImage::Format_RGBA8888);
+	}
+};
+
+// 网格Pass直接写出紧凑布局：RGBA8基础色、RG16八面体法线、RGBA8材质参数，不再写世界空间位置，光照阶段由可采样的深度附件重建
+class QCompactGBufferMeshPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QCompactGBufferMeshPassBuilder)
+		QRP_INPUT_ATTR(QSharedPointer<const QCompactGBufferMesh>, Mesh);
+		QRP_INPUT_ATTR(QSize, Size);
+		QRP_INPUT_ATTR(QMatrix4x4, ModelMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QCompactGBufferMeshPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, BaseColor)			//RGBA8
+		QRP_OUTPUT_ATTR(QRhiTextureRef, PackedNormal)		//RG16：八面体法线
+		QRP_OUTPUT_ATTR(QRhiTextureRef, PackedMaterial)		//RGBA8：金属度、粗糙度、AO、覆盖标记
+		QRP_OUTPUT_ATTR(QRhiTextureRef, Depth)				//D32F：深度附件
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float model[16];
+		float viewProjection[16];
+	};
+	struct MaterialBlock {
+		QVector4D baseColorFactor;
+		float metallicFactor;
+		float roughnessFactor;
+		float padding[2];
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mBaseColor;
+	QRhiTextureRef mPackedNormal;
+	QRhiTextureRef mPackedMaterial;
+	QRhiTextureRef mDepth;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mVertexBuffer;
+	QRhiBufferRef mIndexBuffer;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mSampler;
+	QVector<QRhiBufferRef> mMaterialBuffers;
+	QVector<QRhiTextureRef> mBaseColorTextures;
+	QVector<QRhiTextureRef> mMetallicRoughnessTextures;
+	QVector<QRhiShaderResourceBindingsRef> mMaterialBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mVS;
+	QShader mFS;
+	const QCompactGBufferMesh* mUploadedMesh = nullptr;
+	QVector<QRhiResource*> mUploadedResources;
+
+	QVector<QRhiResource*> staticResources() const {
+		QVector<QRhiResource*> resources = { mVertexBuffer.get(), mIndexBuffer.get() };
+		for (int i = 0; i < mBaseColorTextures.size(); i++)
+			resources << mBaseColorTextures[i].get() << mMetallicRoughnessTextures[i].get();
+		return resources;
+	}
+public:
+	QCompactGBufferMeshPassBuilder() {
+		mVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, R"(#version 450
+			layout (location = 0) in vec3 inPosition;
+			layout (location = 1) in vec3 inNormal;
+			layout (location = 2) in vec2 inUV;
+			layout (binding = 0) uniform UniformBlock {
+				mat4 model;
+				mat4 viewProjection;
+			}UBO;
+			layout (location = 0) out vec3 vNormal;
+			layout (location = 1) out vec2 vUV;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				vNormal = mat3(UBO.model) * inNormal;			//模型矩阵只有旋转
+				vUV = inUV;
+				gl_Position = UBO.viewProjection * UBO.model * vec4(inPosition, 1.0);
+			}
+		)");
+		mFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + QCompactGBuffer::codecFunctions() + R"(
+			layout (binding = 1) uniform MaterialBlock {
+				vec4 baseColorFactor;
+				float metallicFactor;
+				float roughnessFactor;
+			}MAT;
+			layout (binding = 2) uniform sampler2D uBaseColor;
+			layout (binding = 3) uniform sampler2D uMetallicRoughness;
+			layout (location = 0) in vec3 vNormal;
+			layout (location = 1) in vec2 vUV;
+			layout (location = 0) out vec4 outBaseColor;
+			layout (location = 1) out vec4 outPackedNormal;
+			layout (location = 2) out vec4 outPackedMaterial;
+			void main() {
+				vec3 N = normalize(gl_FrontFacing ? vNormal : -vNormal);		//模型的材质都是双面的
+				vec4 metallicRoughness = texture(uMetallicRoughness, vUV);		//glTF约定：g为粗糙度，b为金属度
+				outBaseColor = texture(uBaseColor, vUV) * MAT.baseColorFactor;
+				outPackedNormal = vec4(octEncode(N), 0.0, 0.0);
+				outPackedMaterial = vec4(metallicRoughness.b * MAT.metallicFactor, metallicRoughness.g * MAT.roughnessFactor, 1.0, 1.0);
+			}
+		)");
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QCompactGBufferMesh& mesh = *mInput._Mesh;
+		const QMeshGeometry& geometry = mesh.geometry;
+		const QSize size = mInput._Size;
+		builder.setupTexture(mBaseColor, "CompactGBufferBaseColor", QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget);
+		builder.setupTexture(mPackedNormal, "CompactGBufferNormal", QRhiTexture::RG16, size, 1, QRhiTexture::RenderTarget);
+		builder.setupTexture(mPackedMaterial, "CompactGBufferMaterial", QRhiTexture::RGBA8, size, 1, QRhiTexture::RenderTarget);
+		builder.setupTexture(mDepth, "CompactGBufferDepth", QRhiTexture::D32F, size, 1, QRhiTexture::RenderTarget);
+		QRhiTextureRenderTargetDescription rtDesc;
+		rtDesc.setColorAttachments({ QRhiColorAttachment(mBaseColor.get()), QRhiColorAttachment(mPackedNormal.get()), QRhiColorAttachment(mPackedMaterial.get()) });
+		rtDesc.setDepthTexture(mDepth.get());
+		builder.setupRenderTarget(mRenderTarget, "CompactGBufferRT", rtDesc);
+
+		builder.setupBuffer(mVertexBuffer, "CompactGBufferVertexBuffer", QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, sizeof(QMeshGeometry::Vertex) * geometry.vertices.size());
+		builder.setupBuffer(mIndexBuffer, "CompactGBufferIndexBuffer", QRhiBuffer::Immutable, QRhiBuffer::IndexBuffer, sizeof(quint32) * geometry.indices.size());
+		builder.setupBuffer(mUniformBuffer, "CompactGBufferUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mSampler, "CompactGBufferSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Repeat, QRhiSampler::Repeat, QRhiSampler::Repeat);
+
+		const int materialCount = geometry.materials.size();
+		mMaterialBuffers.resize(materialCount);
+		mBaseColorTextures.resize(materialCount);
+		mMetallicRoughnessTextures.resize(materialCount);
+		mMaterialBindings.resize(materialCount);
+		for (int i = 0; i < materialCount; i++) {
+			const QByteArray suffix = QByteArray::number(i);
+			builder.setupBuffer(mMaterialBuffers[i], "CompactGBufferMaterialBuffer" + suffix, QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(MaterialBlock));
+			builder.setupTexture(mBaseColorTextures[i], "CompactGBufferBaseColorTexture" + suffix, QRhiTexture::RGBA8, mesh.baseColorImages[i].size(), 1, QRhiTexture::MipMapped | QRhiTexture::UsedWithGenerateMips);
+			builder.setupTexture(mMetallicRoughnessTextures[i], "CompactGBufferMetallicRoughnessTexture" + suffix, QRhiTexture::RGBA8, mesh.metallicRoughnessImages[i].size(), 1, QRhiTexture::MipMapped | QRhiTexture::UsedWithGenerateMips);
+			builder.setupShaderResourceBindings(mMaterialBindings[i], "CompactGBufferBindings" + suffix, {
+				QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage, mUniformBuffer.get()),
+				QRhiShaderResourceBinding::uniformBuffer(1, QRhiShaderResourceBinding::FragmentStage, mMaterialBuffers[i].get()),
+				QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mBaseColorTextures[i].get(), mSampler.get()),
+				QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mMetallicRoughnessTextures[i].get(), mSampler.get()),
+			});
+		}
+
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mMaterialBindings[0].get();				//各材质的绑定布局相同，共用一条管线
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.targetBlends = { QRhiGraphicsPipeline::TargetBlend(), QRhiGraphicsPipeline::TargetBlend(), QRhiGraphicsPipeline::TargetBlend() };
+		PSO.depthTest = true;
+		PSO.depthWrite = true;
+		PSO.cullMode = QRhiGraphicsPipeline::None;
+		QRhiVertexInputLayout inputLayout;
+		inputLayout.setBindings({ QRhiVertexInputBinding(sizeof(QMeshGeometry::Vertex)) });
+		inputLayout.setAttributes({
+			QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, position)),
+			QRhiVertexInputAttribute(0, 1, QRhiVertexInputAttribute::Float3, offsetof(QMeshGeometry::Vertex, normal)),
+			QRhiVertexInputAttribute(0, 2, QRhiVertexInputAttribute::Float2, offsetof(QMeshGeometry::Vertex, texCoord)),
+		});
+		PSO.vertexInputLayout = inputLayout;
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, mVS),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "CompactGBufferPipeline", PSO);
+
+		mOutput.BaseColor = mBaseColor;
+		mOutput.PackedNormal = mPackedNormal;
+		mOutput.PackedMaterial = mPackedMaterial;
+		mOutput.Depth = mDepth;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QCompactGBufferMesh& mesh = *mInput._Mesh;
+		const QMeshGeometry& geometry = mesh.geometry;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		const QVector<QRhiResource*> resources = staticResources();
+		if (mUploadedMesh != &mesh || mUploadedResources != resources) {		//几何与贴图只需上传一次
+			batch->uploadStaticBuffer(mVertexBuffer.get(), geometry.vertices.constData());
+			batch->uploadStaticBuffer(mIndexBuffer.get(), geometry.indices.constData());
+			for (int i = 0; i < geometry.materials.size(); i++) {
+				batch->uploadTexture(mBaseColorTextures[i].get(), mesh.baseColorImages[i]);
+				batch->generateMips(mBaseColorTextures[i].get());
+				batch->uploadTexture(mMetallicRoughnessTextures[i].get(), mesh.metallicRoughnessImages[i]);
+				batch->generateMips(mMetallicRoughnessTextures[i].get());
+			}
+			mUploadedMesh = &mesh;
+			mUploadedResources = resources;
+		}
+		for (int i = 0; i < geometry.materials.size(); i++) {
+			const QMeshGeometry::Material& material = geometry.materials[i];
+			const MaterialBlock block = { material.baseColorFactor, material.metallicFactor, material.roughnessFactor, { 0.0f, 0.0f } };
+			batch->updateDynamicBuffer(mMaterialBuffers[i].get(), 0, sizeof(MaterialBlock), &block);
+		}
+		UniformBlock ubo;
+		const QMatrix4x4 viewProjection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+		memcpy(ubo.model, mInput._ModelMatrix.constData(), sizeof(ubo.model));
+		memcpy(ubo.viewProjection, viewProjection.constData(), sizeof(ubo.viewProjection));
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 0.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		const QRhiCommandBuffer::VertexInput vertexBindings(mVertexBuffer.get(), 0);
+		cmdBuffer->setVertexInput(0, 1, &vertexBindings, mIndexBuffer.get(), 0, QRhiCommandBuffer::IndexUInt32);
+		for (const QMeshGeometry::Submesh& submesh : geometry.submeshes) {
+			if (submesh.indexCount == 0)
+				continue;
+			cmdBuffer->setShaderResources(mMaterialBindings[submesh.materialIndex].get());
+			cmdBuffer->drawIndexed(submesh.indexCount, 1, submesh.indexOffset);
+		}
+		cmdBuffer->endPass();
+	}
+};
+
+class QClusteredLightingPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QClusteredLightingPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, LightingResult);
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QRhiTextureRef, Metallic);
+		QRP_INPUT_ATTR(QRhiTextureRef, Normal);
+		QRP_INPUT_ATTR(QRhiTextureRef, Position);
+		QRP_INPUT_ATTR(QRhiTextureRef, Roughness);
+		QRP_INPUT_ATTR(bool, UseCompactGBuffer);
+		QRP_INPUT_ATTR(QRhiTextureRef, PackedNormal);
+		QRP_INPUT_ATTR(QRhiTextureRef, PackedMaterial);
+		QRP_INPUT_ATTR(QRhiTextureRef, Depth);
+		QRP_INPUT_ATTR(QVector<QPunctualLight>, Lights);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(QVector3D, CameraPosition);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QClusteredLightingPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, ClusteredLightingResult)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float view[16];
+		float projection[16];
+		float inverseViewProjection[16];
+		QVector4D cameraPosition;
+		float nearPlane;
+		float farPlane;
+		int lightCount;
+		int lightsPerCluster;
+	};
+	struct GpuLight {
+		QVector4D positionRadius;
+		QVector4D colorIntensity;
+		QVector4D spotDirectionCosOuter;
+	};
+	QRhi* mRhi = nullptr;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mLightBuffer;
+	QRhiBufferRef mClusterBuffer;
+	QRhiBufferRef mStatsBuffer;
+	QRhiSamplerRef mSampler;
+
+	QRhiShaderResourceBindingsRef mCullBindings;
+	QRhiComputePipelineRef mCullPipeline;
+	QShader mCullCS;
+
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiShaderResourceBindingsRef mShadingBindings;
+	QRhiGraphicsPipelineRef mShadingPipeline;
+	QShader mShadingFS;
+	QShader mCompactShadingFS;
+	int mLightCapacity = 0;
+	int mLightsPerCluster = QLightClusterGrid::InitialLightsPerCluster;
+	int mRequiredLightsPerCluster = 0;
+	QLightClusterGrid::Camera mCamera;
+
+	QRhiBufferReadbackResult mStatsReadback;
+	QRhiBufferReadbackResult mClusterReadback;
+	bool mValidationRequested = false;
+	bool mValidationPending = false;
+	QLightClusterGrid::Camera mValidationCamera;
+	QVector<QPunctualLight> mValidationLights;
+	int mValidationLightsPerCluster = 0;
+
+	static QByteArray commonDefine() {
+		return QString(R"(
+			const int TileCountX = %1;
+			const int TileCountY = %2;
+			const int SliceCount = %3;
+			layout (binding = 0) uniform UniformBlock {
+				mat4 view;
+				mat4 projection;
+				mat4 inverseViewProjection;
+				vec4 cameraPosition;
+				float nearPlane;
+				float farPlane;
+				int lightCount;
+				int lightsPerCluster;					//每个簇的光源列表容量
+			}UBO;
+			struct Light {
+				vec4 positionRadius;
+				vec4 colorIntensity;
+				vec4 spotDirectionCosOuter;
+			};
+			layout (std430, binding = 1) readonly buffer LightBuffer {
+				Light lights[];
+			};
+			int clusterIndex(ivec3 cluster) {
+				return cluster.x + TileCountX * (cluster.y + TileCountY * cluster.z);
+			}
+			float sliceDepth(int slice) {
+				return UBO.nearPlane * pow(UBO.farPlane / UBO.nearPlane, float(slice) / float(SliceCount));
+			}
+		)").arg(QLightClusterGrid::TileCountX).arg(QLightClusterGrid::TileCountY).arg(QLightClusterGrid::SliceCount).toLocal8Bit();
+	}
+	static QShader createCullShader() {
+		return QRhiHelper::newShaderFromCode(QShader::ComputeStage, "#version 450\n" + commonDefine() + R"(
+			layout (local_size_x = 16, local_size_y = 9, local_size_z = 1) in;
+			layout (std430, binding = 2) writeonly buffer ClusterBuffer {
+				int clusterData[];						//每个簇：[相交的光源总数, 光源索引 x lightsPerCluster]
+			};
+			layout (std430, binding = 3) buffer StatsBuffer {
+				int maxLightsInCluster;
+				int overflowClusters;
+			};
+			bool sphereIntersectsAabb(vec3 center, float radius, vec3 aabbMin, vec3 aabbMax) {
+				vec3 closest = clamp(center, aabbMin, aabbMax);
+				vec3 delta = center - closest;
+				return dot(delta, delta) <= radius * radius;
+			}
+			void main() {
+				ivec3 cluster = ivec3(gl_GlobalInvocationID.xyz);
+				float depths[2] = float[](sliceDepth(cluster.z), sliceDepth(cluster.z + 1));
+				vec2 ndcMin = vec2(cluster.xy) / vec2(TileCountX, TileCountY) * 2.0 - 1.0;
+				vec2 ndcMax = vec2(cluster.xy + 1) / vec2(TileCountX, TileCountY) * 2.0 - 1.0;
+				vec3 aabbMin = vec3(1e30);
+				vec3 aabbMax = vec3(-1e30);
+				for (int d = 0; d < 2; d++) {
+					for (int i = 0; i < 4; i++) {
+						vec2 ndc = vec2((i & 1) == 0 ? ndcMin.x : ndcMax.x, (i & 2) == 0 ? ndcMin.y : ndcMax.y);
+						vec3 corner = vec3(ndc.x * depths[d] / UBO.projection[0][0], ndc.y * depths[d] / UBO.projection[1][1], -depths[d]);
+						aabbMin = min(aabbMin, corner);
+						aabbMax = max(aabbMax, corner);
+					}
+				}
+				int base = clusterIndex(cluster) * (UBO.lightsPerCluster + 1);
+				int count = 0;
+				for (int i = 0; i < UBO.lightCount; i++) {
+					vec3 center = (UBO.view * vec4(lights[i].positionRadius.xyz, 1.0)).xyz;
+					if (sphereIntersectsAabb(center, lights[i].positionRadius.w, aabbMin, aabbMax)) {
+						if (count < UBO.lightsPerCluster)
+							clusterData[base + 1 + count] = i;
+						count++;
+					}
+				}
+				clusterData[base] = count;				//写入真实数量，超出容量的部分由CPU回读后扩容
+				atomicMax(maxLightsInCluster, count);
+				if (count > UBO.lightsPerCluster)
+					atomicAdd(overflowClusters, 1);
+			}
+		)");
+	}
+	static UniformBlock createUniformBlock(const QLightClusterGrid::Camera& camera, const QVector3D& cameraPosition, int lightCount, int lightsPerCluster) {
+		UniformBlock ubo;
+		memcpy(ubo.view, camera.view.constData(), sizeof(ubo.view));
+		memcpy(ubo.projection, camera.projection.constData(), sizeof(ubo.projection));
+		const QMatrix4x4 inverseViewProjection = (camera.projection * camera.view).inverted();
+		memcpy(ubo.inverseViewProjection, inverseViewProjection.constData(), sizeof(ubo.inverseViewProjection));
+		ubo.cameraPosition = QVector4D(cameraPosition, 1.0f);
+		ubo.nearPlane = camera.nearPlane;
+		ubo.farPlane = camera.farPlane;
+		ubo.lightCount = lightCount;
+		ubo.lightsPerCluster = lightsPerCluster;
+		return ubo;
+	}
+	static QVector<GpuLight> createGpuLights(const QVector<QPunctualLight>& lights, int lightCount) {
+		QVector<GpuLight> gpuLights(qMax(1, lightCount));
+		for (int i = 0; i < lightCount; i++) {
+			const QPunctualLight& light = lights[i];
+			gpuLights[i].positionRadius = QVector4D(light.position, light.radius);
+			gpuLights[i].colorIntensity = QVector4D(light.color, light.intensity);
+			gpuLights[i].spotDirectionCosOuter = QVector4D(light.spotDirection.normalized(), light.spotCosOuter);
+		}
+		return gpuLights;
+	}
+public:
+	QClusteredLightingPassBuilder() {
+		mCullCS = createCullShader();
+
+		const QByteArray shadingCode = R"(
+			layout (std430, binding = 2) readonly buffer ClusterBuffer {
+				int clusterData[];
+			};
+			layout (binding = 3) uniform sampler2D uLightingResult;
+			layout (binding = 4) uniform sampler2D uBaseColor;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			const float PI = 3.14159265;
+
+			float distributionGGX(float NdotH, float roughness) {
+				float a = roughness * roughness;
+				float a2 = a * a;
+				float denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+				return a2 / (PI * denom * denom);
+			}
+			float geometrySmith(float NdotV, float NdotL, float roughness) {
+				float k = (roughness + 1.0) * (roughness + 1.0) / 8.0;
+				return NdotV / (NdotV * (1.0 - k) + k) * NdotL / (NdotL * (1.0 - k) + k);
+			}
+
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec4 lighting = texelFetch(uLightingResult, pixel, 0);
+				vec3 position, normal;
+				float metallic, roughness;
+				if (!fetchSurface(pixel, position, normal, metallic, roughness)) {
+					outFragColor = lighting;
+					return;
+				}
+				vec3 baseColor = texelFetch(uBaseColor, pixel, 0).rgb;
+				roughness = max(roughness, 0.04);
+				vec3 N = normal;
+				vec3 V = normalize(UBO.cameraPosition.xyz - position);
+				float NdotV = max(dot(N, V), 1e-4);
+				vec3 F0 = mix(vec3(0.04), baseColor, metallic);
+
+				float depth = -(UBO.view * vec4(position, 1.0)).z;
+				int slice = clamp(int(log(depth / UBO.nearPlane) / log(UBO.farPlane / UBO.nearPlane) * float(SliceCount)), 0, SliceCount - 1);
+				ivec2 tile = clamp(ivec2(gl_FragCoord.xy / vec2(textureSize(uLightingResult, 0)) * vec2(TileCountX, TileCountY)), ivec2(0), ivec2(TileCountX - 1, TileCountY - 1));
+				int base = clusterIndex(ivec3(tile, slice)) * (UBO.lightsPerCluster + 1);
+				int count = min(clusterData[base], UBO.lightsPerCluster);
+
+				vec3 radiance = vec3(0.0);
+				for (int i = 0; i < count; i++) {
+					Light light = lights[clusterData[base + 1 + i]];
+					vec3 toLight = light.positionRadius.xyz - position;
+					float distance = length(toLight);
+					if (distance >= light.positionRadius.w)
+						continue;
+					vec3 L = toLight / distance;
+					float attenuation = pow(clamp(1.0 - pow(distance / light.positionRadius.w, 4.0), 0.0, 1.0), 2.0) / (distance * distance + 1.0);
+					if (light.spotDirectionCosOuter.w >= -1.0) {
+						float cosAngle = dot(-L, light.spotDirectionCosOuter.xyz);
+						attenuation *= smoothstep(light.spotDirectionCosOuter.w, mix(light.spotDirectionCosOuter.w, 1.0, 0.2), cosAngle);
+					}
+					float NdotL = max(dot(N, L), 0.0);
+					vec3 H = normalize(V + L);
+					vec3 F = F0 + (1.0 - F0) * pow(1.0 - max(dot(H, V), 0.0), 5.0);
+					vec3 specular = distributionGGX(max(dot(N, H), 0.0), roughness) * geometrySmith(NdotV, NdotL, roughness) * F / (4.0 * NdotV * NdotL + 1e-4);
+					vec3 diffuse = (1.0 - F) * (1.0 - metallic) * baseColor / PI;
+					radiance += (diffuse + specular) * light.colorIntensity.rgb * light.colorIntensity.a * attenuation * NdotL;
+				}
+				outFragColor = vec4(lighting.rgb + radiance, lighting.a);
+			}
+)";
+		mShadingFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + commonDefine() + R"(
+			layout (binding = 5) uniform sampler2D uMetallic;
+			layout (binding = 6) uniform sampler2D uNormal;
+			layout (binding = 7) uniform sampler2D uPosition;
+			layout (binding = 8) uniform sampler2D uRoughness;
+			bool fetchSurface(ivec2 pixel, out vec3 position, out vec3 normal, out float metallic, out float roughness) {
+				normal = texelFetch(uNormal, pixel, 0).xyz;
+				if (dot(normal, normal) < 1e-4)
+					return false;
+				normal = normalize(normal);
+				position = texelFetch(uPosition, pixel, 0).xyz;
+				metallic = texelFetch(uMetallic, pixel, 0).r;
+				roughness = texelFetch(uRoughness, pixel, 0).r;
+				return true;
+			}
+		)" + shadingCode);
+
+		mCompactShadingFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + commonDefine() + QCompactGBuffer::codecFunctions() + R"(
+			layout (binding = 5) uniform sampler2D uPackedMaterial;
+			layout (binding = 6) uniform sampler2D uPackedNormal;
+			layout (binding = 7) uniform sampler2D uDepth;
+			bool fetchSurface(ivec2 pixel, out vec3 position, out vec3 normal, out float metallic, out float roughness) {
+				vec4 material = texelFetch(uPackedMaterial, pixel, 0);
+				if (material.a < 0.5)
+					return false;
+				normal = octDecode(texelFetch(uPackedNormal, pixel, 0).xy);
+				position = reconstructPosition(gl_FragCoord.xy, vec2(textureSize(uDepth, 0)), texelFetch(uDepth, pixel, 0).r, UBO.inverseViewProjection);
+				metallic = material.r;
+				roughness = material.g;
+				return true;
+			}
+		)" + shadingCode);
+
+		mStatsReadback.completed = [this]() {
+			if (mStatsReadback.data.size() < int(sizeof(int) * 2))
+				return;
+			const int* stats = reinterpret_cast<const int*>(mStatsReadback.data.constData());
+			mStats.maxLightsInCluster = stats[0];
+			mStats.overflowClusters = stats[1];
+			if (stats[1] > 0 && stats[0] > mRequiredLightsPerCluster) {
+				qWarning().noquote() << QString("[ClusteredLighting] %1 clusters exceeded %2 lights (max %3), growing the per-cluster list")
+					.arg(stats[1]).arg(mLightsPerCluster).arg(stats[0]);
+				mRequiredLightsPerCluster = stats[0];
+			}
+		};
+		mClusterReadback.completed = [this]() {
+			validateClusters();
+			mValidationPending = false;
+		};
+	}
+	struct Stats {
+		int lightsPerCluster = 0;
+		int maxLightsInCluster = 0;
+		int overflowClusters = 0;							//本帧光源列表被截断的簇数
+	};
+	struct Validation {
+		int lightCount = -1;
+		int clusterCount = 0;
+		int mismatchedClusters = 0;							//与CPU参考实现不一致的簇数
+		int truncatedClusters = 0;
+	};
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		mLightCapacity = qMax(mLightCapacity, qMax(1, int(mInput._Lights.size())));
+		while (mLightsPerCluster < mRequiredLightsPerCluster)		//只增不减，避免容量来回抖动
+			mLightsPerCluster *= 2;
+		mStats.lightsPerCluster = mLightsPerCluster;
+
+		builder.setupBuffer(mUniformBuffer, "ClusteredLightingUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupBuffer(mLightBuffer, "ClusteredLightingLightBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(GpuLight) * mLightCapacity);
+		builder.setupBuffer(mClusterBuffer, "ClusteredLightingClusterBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, clusterBufferSize());
+		builder.setupBuffer(mStatsBuffer, "ClusteredLightingStatsBuffer", QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(int) * 2);
+		builder.setupSampler(mSampler, "ClusteredLightingSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		builder.setupShaderResourceBindings(mCullBindings, "ClusteredLightingCullBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, mLightBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(2, QRhiShaderResourceBinding::ComputeStage, mClusterBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoadStore(3, QRhiShaderResourceBinding::ComputeStage, mStatsBuffer.get()),
+		});
+		QRhiComputePipelineState cullPSO;
+		cullPSO.shaderResourceBindings = mCullBindings.get();
+		cullPSO.shaderStage = QRhiShaderStage(QRhiShaderStage::Compute, mCullCS);
+		builder.setupComputePipeline(mCullPipeline, "ClusteredLightingCullPipeline", cullPSO);
+
+		builder.setupTexture(mColorAttachment, "ClusteredLighting", QRhiTexture::RGBA16F, mInput._LightingResult->pixelSize(), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mRenderTarget, "ClusteredLightingRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		QVector<QRhiShaderResourceBinding> shadingBindings = {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::FragmentStage, mLightBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(2, QRhiShaderResourceBinding::FragmentStage, mClusterBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._LightingResult.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mSampler.get()),
+		};
+		if (mInput._UseCompactGBuffer) {
+			shadingBindings << QRhiShaderResourceBinding::sampledTexture(5, QRhiShaderResourceBinding::FragmentStage, mInput._PackedMaterial.get(), mSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(6, QRhiShaderResourceBinding::FragmentStage, mInput._PackedNormal.get(), mSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(7, QRhiShaderResourceBinding::FragmentStage, mInput._Depth.get(), mSampler.get());
+		}
+		else {
+			shadingBindings << QRhiShaderResourceBinding::sampledTexture(5, QRhiShaderResourceBinding::FragmentStage, mInput._Metallic.get(), mSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(6, QRhiShaderResourceBinding::FragmentStage, mInput._Normal.get(), mSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(7, QRhiShaderResourceBinding::FragmentStage, mInput._Position.get(), mSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(8, QRhiShaderResourceBinding::FragmentStage, mInput._Roughness.get(), mSampler.get());
+		}
+		builder.setupShaderResourceBindings(mShadingBindings, "ClusteredLightingShadingBindings", shadingBindings);
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mShadingBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mInput._UseCompactGBuffer ? mCompactShadingFS : mShadingFS)
+		};
+		builder.setupGraphicsPipeline(mShadingPipeline, "ClusteredLightingShadingPipeline", PSO);
+
+		mOutput.ClusteredLightingResult = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		mCamera = createCamera(mRhi, mInput._ViewMatrix, mInput._ProjectionMatrix);
+
+		const QVector<QPunctualLight>& lights = mInput._Lights;
+		const UniformBlock ubo = createUniformBlock(mCamera, mInput._CameraPosition, qMin<int>(lights.size(), mLightCapacity), mLightsPerCluster);
+		const QVector<GpuLight> gpuLights = createGpuLights(lights, ubo.lightCount);
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		batch->uploadStaticBuffer(mLightBuffer.get(), 0, sizeof(GpuLight) * gpuLights.size(), gpuLights.constData());
+		const int stats[2] = { 0, 0 };
+		batch->uploadStaticBuffer(mStatsBuffer.get(), 0, sizeof(stats), stats);
+
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(mCullPipeline.get());
+		cmdBuffer->setShaderResources(mCullBindings.get());
+		cmdBuffer->dispatch(1, 1, QLightClusterGrid::SliceCount);
+		QRhiResourceUpdateBatch* readbackBatch = mRhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(mStatsBuffer.get(), 0, sizeof(stats), &mStatsReadback);
+		if (mValidationRequested && !mValidationPending) {			//完整回读簇缓冲，与本帧相同的相机和光源做CPU比对
+			mValidationRequested = false;
+			mValidationPending = true;
+			mValidationCamera = mCamera;
+			mValidationLights = lights.mid(0, ubo.lightCount);
+			mValidationLightsPerCluster = mLightsPerCluster;
+			readbackBatch->readBackBuffer(mClusterBuffer.get(), 0, clusterBufferSize(), &mClusterReadback);
+		}
+		cmdBuffer->endComputePass(readbackBatch);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue);
+		cmdBuffer->setGraphicsPipeline(mShadingPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mShadingBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+	QLightClusterGrid::Camera getLastCamera() const { return mCamera; }
+	void requestValidation() { mValidationRequested = true; }
+	const Stats& getStats() const { return mStats; }
+	const Validation& getValidation() const { return mValidation; }
+
+	static QLightClusterGrid::Camera createCamera(QRhi* rhi, const QMatrix4x4& view, const QMatrix4x4& projection) {
+		QLightClusterGrid::Camera camera;
+		camera.view = view;
+		camera.projection = rhi->clipSpaceCorrMatrix() * projection;
+		camera.nearPlane = projection(2, 3) / (projection(2, 2) - 1.0f);			//从OpenGL风格的透视矩阵中还原近远平面
+		camera.farPlane = projection(2, 3) / (projection(2, 2) + 1.0f);
+		return camera;
+	}
+
+	// 逐簇比较GPU回读的光源列表与CPU参考实现
+	// GPU与CPU的浮点运算顺序不同，恰好擦过簇边界的光源可能判定不一致，因此列表只需包含半径缩小万分之一时一定相交的光源，
+	// 且不含半径放大万分之一时仍不相交的光源；列表被截断时只检查总数与已写入的部分
+	static Validation compareClusters(const QByteArray& data, int lightsPerCluster, const QLightClusterGrid::Camera& camera, const QVector<QPunctualLight>& lights) {
+		static const float BoundaryTolerance = 1e-4f;
+		Validation validation;
+		const int stride = lightsPerCluster + 1;
+		if (data.size() < int(sizeof(int)) * QLightClusterGrid::ClusterCount * stride)
+			return validation;
+		const int* gpuClusters = reinterpret_cast<const int*>(data.constData());
+		const QVector<QVector<int>> inner = QLightClusterGrid::binLights(camera, lights, 1.0f - BoundaryTolerance);
+		const QVector<QVector<int>> outer = QLightClusterGrid::binLights(camera, lights, 1.0f + BoundaryTolerance);
+		validation.lightCount = lights.size();
+		validation.clusterCount = QLightClusterGrid::ClusterCount;
+		for (int i = 0; i < QLightClusterGrid::ClusterCount; i++) {
+			const int* cluster = gpuClusters + i * stride;
+			const int count = cluster[0];
+			const int stored = qBound(0, count, lightsPerCluster);
+			bool match = count >= inner[i].size() && count <= outer[i].size();
+			for (int j = 0; match && j < stored; j++) {				//GPU与CPU都按光源索引升序写入
+				match = (j == 0 || cluster[1 + j] > cluster[j])
+					&& std::binary_search(outer[i].begin(), outer[i].end(), cluster[1 + j]);
+			}
+			if (match && count <= lightsPerCluster) {
+				for (int light : inner[i])
+					match &= std::binary_search(cluster + 1, cluster + 1 + stored, light);
+			}
+			if (!match)
+				validation.mismatchedClusters++;
+			if (count > lightsPerCluster)
+				validation.truncatedClusters++;
+		}
+		return validation;
+	}
+
+	// 不经过渲染图，在离屏帧中运行一次与渲染时相同的分簇剔除并回读簇缓冲，供 --cluster-check 使用
+	static QByteArray cullOffscreen(QRhi* rhi, const QLightClusterGrid::Camera& camera, const QVector<QPunctualLight>& lights, int lightsPerCluster, int* outMaxLightsInCluster) {
+		const UniformBlock ubo = createUniformBlock(camera, QVector3D(), lights.size(), lightsPerCluster);
+		const QVector<GpuLight> gpuLights = createGpuLights(lights, lights.size());
+		const int clusterBytes = sizeof(int) * QLightClusterGrid::ClusterCount * (lightsPerCluster + 1);
+		QScopedPointer<QRhiBuffer> uniformBuffer(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock)));
+		QScopedPointer<QRhiBuffer> lightBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(GpuLight) * gpuLights.size()));
+		QScopedPointer<QRhiBuffer> clusterBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, clusterBytes));
+		QScopedPointer<QRhiBuffer> statsBuffer(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(int) * 2));
+		if (!uniformBuffer->create() || !lightBuffer->create() || !clusterBuffer->create() || !statsBuffer->create())
+			return {};
+		QScopedPointer<QRhiShaderResourceBindings> bindings(rhi->newShaderResourceBindings());
+		bindings->setBindings({
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, uniformBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::ComputeStage, lightBuffer.get()),
+			QRhiShaderResourceBinding::bufferStore(2, QRhiShaderResourceBinding::ComputeStage, clusterBuffer.get()),
+			QRhiShaderResourceBinding::bufferLoadStore(3, QRhiShaderResourceBinding::ComputeStage, statsBuffer.get()),
+		});
+		if (!bindings->create())
+			return {};
+		QScopedPointer<QRhiComputePipeline> pipeline(rhi->newComputePipeline());
+		pipeline->setShaderStage(QRhiShaderStage(QRhiShaderStage::Compute, createCullShader()));
+		pipeline->setShaderResourceBindings(bindings.get());
+		if (!pipeline->create())
+			return {};
+
+		QRhiCommandBuffer* cmdBuffer;
+		if (rhi->beginOffscreenFrame(&cmdBuffer) != QRhi::FrameOpSuccess)
+			return {};
+		QRhiResourceUpdateBatch* batch = rhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(uniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		batch->uploadStaticBuffer(lightBuffer.get(), 0, sizeof(GpuLight) * gpuLights.size(), gpuLights.constData());
+		const int stats[2] = { 0, 0 };
+		batch->uploadStaticBuffer(statsBuffer.get(), 0, sizeof(stats), stats);
+		cmdBuffer->beginComputePass(batch);
+		cmdBuffer->setComputePipeline(pipeline.get());
+		cmdBuffer->setShaderResources(bindings.get());
+		cmdBuffer->dispatch(1, 1, QLightClusterGrid::SliceCount);
+		QRhiBufferReadbackResult clusterReadback;
+		QRhiBufferReadbackResult statsReadback;
+		QRhiResourceUpdateBatch* readbackBatch = rhi->nextResourceUpdateBatch();
+		readbackBatch->readBackBuffer(clusterBuffer.get(), 0, clusterBytes, &clusterReadback);
+		readbackBatch->readBackBuffer(statsBuffer.get(), 0, sizeof(stats), &statsReadback);
+		cmdBuffer->endComputePass(readbackBatch);
+		rhi->endOffscreenFrame();				//离屏帧结束时会等待GPU完成，回读数据此时已经可用
+
+		if (outMaxLightsInCluster)
+			*outMaxLightsInCluster = statsReadback.data.size() >= int(sizeof(int)) ? reinterpret_cast<const int*>(statsReadback.data.constData())[0] : -1;
+		return clusterReadback.data;
+	}
+private:
+	int clusterBufferSize() const {
+		return sizeof(int) * QLightClusterGrid::ClusterCount * (mLightsPerCluster + 1);
+	}
+	void validateClusters() {
+		mValidation = compareClusters(mClusterReadback.data, mValidationLightsPerCluster, mValidationCamera, mValidationLights);
+	}
+	Stats mStats;
+	Validation mValidation;
+};
+
+struct QEquirectImage {
+	int width = 0;
+	int height = 0;
+	QVector<QVector3D> pixels;
+
+	bool isValid() const { return width > 0 && height > 0; }
+
+	static QVector3D direction(float u, float v) {
+		const float phi = (u - 0.5f) * 2.0f * M_PI;
+		const float theta = v * M_PI;
+		return QVector3D(qSin(theta) * qCos(phi), qCos(theta), qSin(theta) * qSin(phi));
+	}
+
+	QVector3D sample(const QVector3D& dir) const {				//双线性采样，U方向环绕
+		const float u = qAtan2(dir.z(), dir.x()) / (2.0f * M_PI) + 0.5f;
+		const float v = qAcos(qBound(-1.0f, dir.y(), 1.0f)) / M_PI;
+		const float x = u * width - 0.5f;
+		const float y = qBound(0.0f, v * height - 0.5f, height - 1.0f);
+		const int x0 = qFloor(x);
+		const int y0 = qFloor(y);
+		const float fx = x - x0;
+		const float fy = y - y0;
+		auto texel = [this](int tx, int ty) {
+			tx = ((tx % width) + width) % width;
+			ty = qMin(ty, height - 1);
+			return pixels[ty * width + tx];
+		};
+		return (texel(x0, y0) * (1.0f - fx) + texel(x0 + 1, y0) * fx) * (1.0f - fy)
+			+ (texel(x0, y0 + 1) * (1.0f - fx) + texel(x0 + 1, y0 + 1) * fx) * fy;
+	}
+
+	QEquirectImage downsample() const {
+		QEquirectImage result;
+		result.width = qMax(1, width / 2);
+		result.height = qMax(1, height / 2);
+		result.pixels.resize(result.width * result.height);
+		for (int y = 0; y < result.height; y++) {
+			for (int x = 0; x < result.width; x++) {
+				const int sx = qMin(x * 2, width - 1), sx1 = qMin(sx + 1, width - 1);
+				const int sy = qMin(y * 2, height - 1), sy1 = qMin(sy + 1, height - 1);
+				result.pixels[y * result.width + x] = (pixels[sy * width + sx] + pixels[sy * width + sx1] + pixels[sy1 * width + sx] + pixels[sy1 * width + sx1]) * 0.25f;
+			}
+		}
+		return result;
+	}
+
+	static QEquirectImage loadRadianceHdr(const QString& path) {		//解析 Radiance RGBE (.hdr)，支持新式行程编码
+		QEquirectImage image;
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly))
+			return image;
+		const QByteArray data = file.readAll();
+		int offset = 0;
+		auto readLine = [&]() {
+			const int end = data.indexOf('\n', offset);
+			if (end < 0) {
+				offset = data.size();
+				return QByteArray();
+			}
+			const QByteArray line = data.mid(offset, end - offset);
+			offset = end + 1;
+			return line;
+		};
+		if (!readLine().startsWith("#?"))
+			return image;
+		while (offset < data.size() && !readLine().isEmpty()) {}
+		const QList<QByteArray> resolution = readLine().simplified().split(' ');
+		if (resolution.size() != 4 || resolution[0] != "-Y" || resolution[2] != "+X")
+			return image;
+		const int width = resolution[3].toInt();
+		const int height = resolution[1].toInt();
+		if (width <= 0 || height <= 0)
+			return image;
+
+		const uchar* bytes = reinterpret_cast<const uchar*>(data.constData());
+		QVector<uchar> scanline(width * 4);
+		QVector<QVector3D> pixels(width * height);
+		for (int y = 0; y < height; y++) {
+			if (offset + 4 > data.size())
+				return image;
+			const bool rle = width >= 8 && width < 0x8000 && bytes[offset] == 2 && bytes[offset + 1] == 2 && ((bytes[offset + 2] << 8) | bytes[offset + 3]) == width;
+			if (rle) {
+				offset += 4;
+				for (int channel = 0; channel < 4; channel++) {
+					int x = 0;
+					while (x < width) {
+						if (offset >= data.size())
+							return image;
+						int count = bytes[offset++];
+						if (count > 128) {
+							count -= 128;
+							if (x + count > width || offset >= data.size())
+								return image;
+							const uchar value = bytes[offset++];
+							for (int i = 0; i < count; i++)
+								scanline[(x++) * 4 + channel] = value;
+						}
+						else {
+							if (count == 0 || x + count > width || offset + count > data.size())
+								return image;
+							for (int i = 0; i < count; i++)
+								scanline[(x++) * 4 + channel] = bytes[offset++];
+						}
+					}
+				}
+			}
+			else {
+				if (offset + width * 4 > data.size())
+					return image;
+				memcpy(scanline.data(), bytes + offset, width * 4);
+				offset += width * 4;
+			}
+			for (int x = 0; x < width; x++) {
+				const uchar* rgbe = scanline.constData() + x * 4;
+				const float scale = rgbe[3] == 0 ? 0.0f : std::ldexp(1.0f, int(rgbe[3]) - 136);
+				pixels[y * width + x] = QVector3D(rgbe[0], rgbe[1], rgbe[2]) * scale;
+			}
+		}
+		image.width = width;
+		image.height = height;
+		image.pixels = std::move(pixels);
+		return image;
+	}
+};
+
+struct QIblData {
+	static const int SHCoefficientCount = 9;
+	QVector3D irradianceSH[SHCoefficientCount];				//已与余弦核卷积并除以PI，着色器直接乘以反照率
+	QSize prefilterSize;
+	QVector<QVector<QVector4D>> prefilterLevels;			//GGX预过滤的等距柱状贴图，每级mip对应一个粗糙度
+	QSize backgroundSize;
+	QVector<QVector4D> background;							//未滤波的环境贴图，用于绘制背景，不再需要引擎的天空Pass
+	int brdfLutSize = 0;
+	QVector<QVector4D> brdfLut;								//rg：split-sum 的 scale 与 bias
+
+	bool isValid() const { return !prefilterLevels.isEmpty() && !background.isEmpty() && !brdfLut.isEmpty(); }
+
+	QVector3D evaluateSH(const QVector3D& d) const {
+		return irradianceSH[0] * 0.282095f
+			+ irradianceSH[1] * (0.488603f * d.y())
+			+ irradianceSH[2] * (0.488603f * d.z())
+			+ irradianceSH[3] * (0.488603f * d.x())
+			+ irradianceSH[4] * (1.092548f * d.x() * d.y())
+			+ irradianceSH[5] * (1.092548f * d.y() * d.z())
+			+ irradianceSH[6] * (0.315392f * (3.0f * d.z() * d.z() - 1.0f))
+			+ irradianceSH[7] * (1.092548f * d.x() * d.z())
+			+ irradianceSH[8] * (0.546274f * (d.x() * d.x() - d.y() * d.y()));
+	}
+
+	// 预计算完成之前使用的占位数据：没有环境光，背景为黑色
+	static QSharedPointer<const QIblData> placeholder() {
+		static QSharedPointer<const QIblData> data = []() {
+			QSharedPointer<QIblData> placeholder(new QIblData);
+			placeholder->prefilterSize = placeholder->backgroundSize = QSize(1, 1);
+			placeholder->prefilterLevels = { { QVector4D(0.0f, 0.0f, 0.0f, 1.0f) } };
+			placeholder->background = { QVector4D(0.0f, 0.0f, 0.0f, 1.0f) };
+			placeholder->brdfLutSize = 1;
+			placeholder->brdfLut = { QVector4D() };
+			return placeholder;
+		}();
+		return data;
+	}
+};
+
+// 纯CPU实现，不依赖QRhi，可以在无窗口环境下运行
+class QIblPrecompute {
+public:
+	static const quint32 CacheMagic = 0x49424C43;
+	static const quint32 CacheVersion = 2;
+	static const int PrefilterWidth = 256;
+	static const int PrefilterLevelCount = 6;
+	static const int PrefilterSampleCount = 128;
+	static const int BrdfLutSize = 128;
+	static const int BrdfSampleCount = 256;
+	static const int BackgroundWidth = 1024;
+
+	static QString cacheDirectory() {
+		return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/IBL";
+	}
+
+	static QVector2D hammersley(quint32 i, quint32 count) {
+		quint32 bits = i;
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return QVector2D(float(i) / count, bits * 2.3283064365386963e-10f);
+	}
+
+	static QVector3D importanceSampleGGX(const QVector2D& xi, const QVector3D& N, float roughness) {
+		const float a = roughness * roughness;
+		const float phi = 2.0f * M_PI * xi.x();
+		const float cosTheta = qSqrt((1.0f - xi.y()) / (1.0f + (a * a - 1.0f) * xi.y()));
+		const float sinTheta = qSqrt(1.0f - cosTheta * cosTheta);
+		const QVector3D up = qAbs(N.y()) < 0.999f ? QVector3D(0.0f, 1.0f, 0.0f) : QVector3D(1.0f, 0.0f, 0.0f);
+		const QVector3D tangent = QVector3D::crossProduct(up, N).normalized();
+		const QVector3D bitangent = QVector3D::crossProduct(N, tangent);
+		return (tangent * (sinTheta * qCos(phi)) + bitangent * (sinTheta * qSin(phi)) + N * cosTheta).normalized();
+	}
+
+	static void projectIrradianceSH(const QEquirectImage& image, QVector3D outSH[QIblData::SHCoefficientCount]) {
+		QVector<int> rows(image.height);
+		std::iota(rows.begin(), rows.end(), 0);
+		QVector<std::array<QVector3D, QIblData::SHCoefficientCount>> rowSums(image.height);
+		QtConcurrent::blockingMap(rows, [&](int y) {
+			std::array<QVector3D, QIblData::SHCoefficientCount>& sum = rowSums[y];
+			sum.fill(QVector3D());
+			const float v = (y + 0.5f) / image.height;
+			const float solidAngle = (2.0f * M_PI / image.width) * (M_PI / image.height) * qSin(v * M_PI);
+			for (int x = 0; x < image.width; x++) {
+				const QVector3D d = QEquirectImage::direction((x + 0.5f) / image.width, v);
+				const QVector3D radiance = image.pixels[y * image.width + x] * solidAngle;
+				sum[0] += radiance * 0.282095f;
+				sum[1] += radiance * (0.488603f * d.y());
+				sum[2] += radiance * (0.488603f * d.z());
+				sum[3] += radiance * (0.488603f * d.x());
+				sum[4] += radiance * (1.092548f * d.x() * d.y());
+				sum[5] += radiance * (1.092548f * d.y() * d.z());
+				sum[6] += radiance * (0.315392f * (3.0f * d.z() * d.z() - 1.0f));
+				sum[7] += radiance * (1.092548f * d.x() * d.z());
+				sum[8] += radiance * (0.546274f * (d.x() * d.x() - d.y() * d.y()));
+			}
+		});
+		const float bandScale[3] = { 1.0f, 2.0f / 3.0f, 0.25f };		//余弦卷积系数 A_l / PI
+		for (int i = 0; i < QIblData::SHCoefficientCount; i++) {
+			outSH[i] = QVector3D();
+			for (const auto& sum : rowSums)
+				outSH[i] += sum[i];
+			outSH[i] *= bandScale[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+		}
+	}
+
+	static QVector<QVector<QVector4D>> prefilterGGX(const QEquirectImage& image, QSize& outSize) {
+		QVector<QEquirectImage> pyramid = { image };
+		while (pyramid.back().width > 8)
+			pyramid << pyramid.back().downsample();
+		const float texelSolidAngle = 4.0f * M_PI / (image.width * image.height);
+
+		outSize = QSize(PrefilterWidth, PrefilterWidth / 2);
+		QVector<QVector<QVector4D>> levels(PrefilterLevelCount);
+		for (int level = 0; level < PrefilterLevelCount; level++) {
+			const int width = qMax(1, PrefilterWidth >> level);
+			const int height = qMax(1, width / 2);
+			const float roughness = float(level) / (PrefilterLevelCount - 1);
+			QVector<QVector4D>& texels = levels[level];
+			texels.resize(width * height);
+			QVector<int> rows(height);
+			std::iota(rows.begin(), rows.end(), 0);
+			QtConcurrent::blockingMap(rows, [&](int y) {
+				for (int x = 0; x < width; x++) {
+					const QVector3D N = QEquirectImage::direction((x + 0.5f) / width, (y + 0.5f) / height);
+					if (level == 0) {
+						texels[y * width + x] = QVector4D(image.sample(N), 1.0f);
+						continue;
+					}
+					QVector3D color;
+					float weight = 0.0f;
+					for (int i = 0; i < PrefilterSampleCount; i++) {
+						const QVector3D H = importanceSampleGGX(hammersley(i, PrefilterSampleCount), N, roughness);
+						const float NdotH = qMax(QVector3D::dotProduct(N, H), 0.0f);
+						const QVector3D L = H * (2.0f * NdotH) - N;
+						const float NdotL = QVector3D::dotProduct(N, L);
+						if (NdotL <= 0.0f)
+							continue;
+						const float a2 = roughness * roughness * roughness * roughness;
+						const float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+						const float pdf = a2 / (M_PI * denom * denom) / 4.0f;			//N=V 时 pdf = D / 4
+						const float sampleSolidAngle = 1.0f / (PrefilterSampleCount * pdf + 1e-4f);
+						const int mip = qBound(0, qRound(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f), int(pyramid.size()) - 1);
+						color += pyramid[mip].sample(L) * NdotL;
+						weight += NdotL;
+					}
+					texels[y * width + x] = QVector4D(color / qMax(weight, 1e-4f), 1.0f);
+				}
+			});
+		}
+		return levels;
+	}
+
+	static QVector<QVector4D> bakeBrdfLut() {
+		QVector<QVector4D> lut(BrdfLutSize * BrdfLutSize);
+		QVector<int> rows(BrdfLutSize);
+		std::iota(rows.begin(), rows.end(), 0);
+		QtConcurrent::blockingMap(rows, [&](int y) {
+			const float roughness = (y + 0.5f) / BrdfLutSize;
+			const float k = roughness * roughness / 2.0f;
+			for (int x = 0; x < BrdfLutSize; x++) {
+				const float NdotV = (x + 0.5f) / BrdfLutSize;
+				const QVector3D V(qSqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+				const QVector3D N(0.0f, 0.0f, 1.0f);
+				float scale = 0.0f;
+				float bias = 0.0f;
+				for (int i = 0; i < BrdfSampleCount; i++) {
+					const QVector3D H = importanceSampleGGX(hammersley(i, BrdfSampleCount), N, roughness);
+					const float VdotH = qMax(QVector3D::dotProduct(V, H), 0.0f);
+					const QVector3D L = H * (2.0f * VdotH) - V;
+					const float NdotL = qMax(L.z(), 0.0f);
+					const float NdotH = qMax(H.z(), 0.0f);
+					if (NdotL <= 0.0f)
+						continue;
+					const float G = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+					const float visibility = G * VdotH / (NdotH * NdotV + 1e-6f);
+					const float fresnel = qPow(1.0f - VdotH, 5.0f);
+					scale += (1.0f - fresnel) * visibility;
+					bias += fresnel * visibility;
+				}
+				lut[y * BrdfLutSize + x] = QVector4D(scale / BrdfSampleCount, bias / BrdfSampleCount, 0.0f, 1.0f);
+			}
+		});
+		return lut;
+	}
+
+	static bool readCache(const QString& path, const QByteArray& key, const std::function<void(QDataStream&)>& reader) {
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+		QDataStream stream(&file);
+		stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+		quint32 magic = 0, version = 0;
+		QByteArray storedKey;
+		stream >> magic >> version >> storedKey;
+		if (magic != CacheMagic || version != CacheVersion || storedKey != key)
+			return false;
+		reader(stream);
+		return stream.status() == QDataStream::Ok;
+	}
+
+	static void writeCache(const QString& path, const QByteArray& key, const std::function<void(QDataStream&)>& writer) {
+		QDir().mkpath(QFileInfo(path).absolutePath());
+		QSaveFile file(path);
+		if (!file.open(QIODevice::WriteOnly))
+			return;
+		QDataStream stream(&file);
+		stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+		stream << CacheMagic << CacheVersion << key;
+		writer(stream);
+		file.commit();
+	}
+
+	// 数量必须与预期一致，截断或损坏的缓存会让流进入错误状态，从而触发重新计算
+	static void readVectors(QDataStream& stream, QVector<QVector4D>& data, qint32 expectedCount) {
+		qint32 count = 0;
+		stream >> count;
+		if (stream.status() != QDataStream::Ok)
+			return;
+		if (count != expectedCount) {
+			stream.setStatus(QDataStream::ReadCorruptData);
+			return;
+		}
+		data.resize(count);
+		const int bytes = count * sizeof(QVector4D);
+		if (stream.readRawData(reinterpret_cast<char*>(data.data()), bytes) != bytes)
+			stream.setStatus(QDataStream::ReadPastEnd);
+	}
+
+	static void writeVectors(QDataStream& stream, const QVector<QVector4D>& data) {
+		stream << qint32(data.size());
+		stream.writeRawData(reinterpret_cast<const char*>(data.constData()), data.size() * sizeof(QVector4D));
+	}
+
+	static QVector<QVector4D> resample(const QEquirectImage& image, const QSize& size) {
+		QVector<QVector4D> texels(size.width() * size.height());
+		QVector<int> rows(size.height());
+		std::iota(rows.begin(), rows.end(), 0);
+		QtConcurrent::blockingMap(rows, [&](int y) {
+			for (int x = 0; x < size.width(); x++)
+				texels[y * size.width() + x] = QVector4D(image.sample(QEquirectImage::direction((x + 0.5f) / size.width(), (y + 0.5f) / size.height())), 1.0f);
+		});
+		return texels;
+	}
+
+	static void computeEnvironment(const QEquirectImage& image, QIblData& data) {
+		projectIrradianceSH(image, data.irradianceSH);
+		data.prefilterLevels = prefilterGGX(image, data.prefilterSize);
+		data.backgroundSize = QSize(BackgroundWidth, BackgroundWidth / 2);
+		data.background = resample(image, data.backgroundSize);
+	}
+
+	static bool isFinite(const QVector4D& v) {
+		return qIsFinite(v.x()) && qIsFinite(v.y()) && qIsFinite(v.z()) && qIsFinite(v.w());
+	}
+
+	// 检查尺寸与数值范围，返回空字符串表示数据可用
+	static QString validateBrdfLut(const QIblData& data) {
+		if (data.brdfLutSize != BrdfLutSize || data.brdfLut.size() != BrdfLutSize * BrdfLutSize)
+			return "BRDF LUT size mismatch";
+		for (const QVector4D& texel : data.brdfLut) {
+			if (!isFinite(texel) || texel.x() < 0.0f || texel.y() < 0.0f || texel.x() + texel.y() > 1.05f)
+				return "BRDF LUT value out of range";
+		}
+		return QString();
+	}
+
+	static QString validateEnvironment(const QIblData& data) {
+		for (const QVector3D& coefficient : data.irradianceSH) {
+			if (!isFinite(QVector4D(coefficient, 0.0f)))
+				return "irradiance SH is not finite";
+		}
+		if (data.prefilterSize != QSize(PrefilterWidth, PrefilterWidth / 2) || data.prefilterLevels.size() != PrefilterLevelCount)
+			return "prefilter size mismatch";
+		for (int level = 0; level < PrefilterLevelCount; level++) {
+			const int width = qMax(1, PrefilterWidth >> level);
+			if (data.prefilterLevels[level].size() != width * qMax(1, width / 2))
+				return QString("prefilter level %1 size mismatch").arg(level);
+			for (const QVector4D& texel : data.prefilterLevels[level]) {
+				if (!isFinite(texel) || texel.x() < 0.0f || texel.y() < 0.0f || texel.z() < 0.0f)
+					return QString("prefilter level %1 value out of range").arg(level);
+			}
+		}
+		if (data.backgroundSize != QSize(BackgroundWidth, BackgroundWidth / 2) || data.background.size() != BackgroundWidth * (BackgroundWidth / 2))
+			return "background size mismatch";
+		for (const QVector4D& texel : data.background) {
+			if (!isFinite(texel))
+				return "background is not finite";
+		}
+		return QString();
+	}
+
+	static QString validate(const QIblData& data) {
+		const QString error = validateBrdfLut(data);
+		return error.isEmpty() ? validateEnvironment(data) : error;
+	}
+
+	struct LoadReport {
+		bool lutCached = false;
+		bool envCached = false;
+		qint64 elapsedMs = 0;
+	};
+
+	// 以HDR文件内容的哈希作为缓存键，热启动时直接读取磁盘结果
+	static QIblData loadOrCompute(const QString& hdrPath, const QString& cacheDir = cacheDirectory(), LoadReport* report = nullptr) {
+		QIblData data;
+		QElapsedTimer timer;
+		timer.start();
+
+		const QByteArray lutKey = QString("BrdfLut:%1x%2").arg(BrdfLutSize).arg(BrdfSampleCount).toLocal8Bit();
+		const QString lutPath = cacheDir + "/BrdfLut.bin";
+		const bool lutCached = readCache(lutPath, lutKey, [&data](QDataStream& stream) {
+			stream >> data.brdfLutSize;
+			readVectors(stream, data.brdfLut, BrdfLutSize * BrdfLutSize);
+		}) && validateBrdfLut(data).isEmpty();
+		if (!lutCached) {
+			data.brdfLutSize = BrdfLutSize;
+			data.brdfLut = bakeBrdfLut();
+			writeCache(lutPath, lutKey, [&data](QDataStream& stream) {
+				stream << data.brdfLutSize;
+				writeVectors(stream, data.brdfLut);
+			});
+		}
+
+		QFile file(hdrPath);
+		if (!file.open(QIODevice::ReadOnly))
+			return QIblData();
+		const QByteArray hash = QCryptographicHash::hash(file.readAll(), QCryptographicHash::Sha1).toHex();
+		file.close();
+		const QByteArray envKey = hash + QString(":%1:%2:%3:%4").arg(PrefilterWidth).arg(PrefilterLevelCount).arg(PrefilterSampleCount).arg(BackgroundWidth).toLocal8Bit();
+		const QString envPath = cacheDir + "/" + hash + ".bin";
+		bool envCached = readCache(envPath, envKey, [&data](QDataStream& stream) {
+			for (QVector3D& coefficient : data.irradianceSH)
+				stream >> coefficient;
+			stream >> data.prefilterSize;
+			if (data.prefilterSize != QSize(PrefilterWidth, PrefilterWidth / 2)) {
+				stream.setStatus(QDataStream::ReadCorruptData);
+				return;
+			}
+			data.prefilterLevels.resize(PrefilterLevelCount);
+			for (int level = 0; level < PrefilterLevelCount; level++) {
+				const int width = qMax(1, PrefilterWidth >> level);
+				readVectors(stream, data.prefilterLevels[level], width * qMax(1, width / 2));
+			}
+			stream >> data.backgroundSize;
+			readVectors(stream, data.background, BackgroundWidth * (BackgroundWidth / 2));
+		});
+		const QString error = envCached ? validateEnvironment(data) : QString();
+		if (!error.isEmpty()) {
+			qWarning().noquote() << "[IBL] discarding cache" << envPath << ":" << error;
+			envCached = false;
+		}
+		if (!envCached) {
+			const QEquirectImage image = QEquirectImage::loadRadianceHdr(hdrPath);
+			if (!image.isValid()) {
+				qWarning() << "[IBL] failed to decode" << hdrPath;
+				return QIblData();
+			}
+			computeEnvironment(image, data);
+			writeCache(envPath, envKey, [&data](QDataStream& stream) {
+				for (const QVector3D& coefficient : data.irradianceSH)
+					stream << coefficient;
+				stream << data.prefilterSize;
+				for (const QVector<QVector4D>& level : data.prefilterLevels)
+					writeVectors(stream, level);
+				stream << data.backgroundSize;
+				writeVectors(stream, data.background);
+			});
+		}
+		if (report) {
+			report->lutCached = lutCached;
+			report->envCached = envCached;
+			report->elapsedMs = timer.elapsed();
+		}
+		qDebug().noquote() << QString("[IBL] environment %1, BRDF LUT %2, %3 ms")
+			.arg(envCached ? "loaded from cache" : "precomputed")
+			.arg(lutCached ? "loaded from cache" : "baked")
+			.arg(timer.elapsed());
+		return data;
+	}
+};
+
+class QCachedIblLightingPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QCachedIblLightingPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, BaseColor);
+		QRP_INPUT_ATTR(QRhiTextureRef, Metallic);
+		QRP_INPUT_ATTR(QRhiTextureRef, Normal);
+		QRP_INPUT_ATTR(QRhiTextureRef, Position);
+		QRP_INPUT_ATTR(QRhiTextureRef, Roughness);
+		QRP_INPUT_ATTR(bool, UseCompactGBuffer);
+		QRP_INPUT_ATTR(QRhiTextureRef, PackedNormal);
+		QRP_INPUT_ATTR(QRhiTextureRef, PackedMaterial);
+		QRP_INPUT_ATTR(QRhiTextureRef, Depth);
+		QRP_INPUT_ATTR(QSharedPointer<const QIblData>, IblData);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(QVector3D, CameraPosition);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QCachedIblLightingPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, LightingResult)
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float inverseViewProjection[16];
+		QVector4D cameraPosition;
+		QVector4D irradianceSH[QIblData::SHCoefficientCount];
+		float maxLod;
+		float padding[3];
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mPrefilterTexture;
+	QRhiTextureRef mBackgroundTexture;
+	QRhiTextureRef mBrdfLutTexture;
+	QRhiTextureRef mColorAttachment;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mUniformBuffer;
+	QRhiSamplerRef mPointSampler;
+	QRhiSamplerRef mLinearSampler;
+	QRhiSamplerRef mEnvironmentSampler;
+	QRhiShaderResourceBindingsRef mBindings;
+	QRhiGraphicsPipelineRef mPipeline;
+	QShader mLightingFS;
+	QShader mCompactLightingFS;
+	QRhiTexture* mUploadedPrefilter = nullptr;
+	QRhiTexture* mUploadedBackground = nullptr;
+	QRhiTexture* mUploadedBrdfLut = nullptr;
+	const QIblData* mUploadedData = nullptr;
+public:
+	QCachedIblLightingPassBuilder() {
+		const QByteArray uniformCode = R"(
+			layout (binding = 0) uniform UniformBlock {
+				mat4 inverseViewProjection;
+				vec4 cameraPosition;
+				vec4 irradianceSH[9];
+				float maxLod;
+			}UBO;
+			layout (binding = 1) uniform sampler2D uBaseColor;
+)";
+		const QByteArray lightingCode = R"(
+			layout (binding = 6) uniform sampler2D uBackground;
+			layout (binding = 7) uniform sampler2D uPrefilter;
+			layout (binding = 8) uniform sampler2D uBrdfLut;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outFragColor;
+			const float PI = 3.14159265;
+
+			vec3 evaluateSH(vec3 d) {
+				return UBO.irradianceSH[0].rgb * 0.282095
+					+ UBO.irradianceSH[1].rgb * 0.488603 * d.y
+					+ UBO.irradianceSH[2].rgb * 0.488603 * d.z
+					+ UBO.irradianceSH[3].rgb * 0.488603 * d.x
+					+ UBO.irradianceSH[4].rgb * 1.092548 * d.x * d.y
+					+ UBO.irradianceSH[5].rgb * 1.092548 * d.y * d.z
+					+ UBO.irradianceSH[6].rgb * 0.315392 * (3.0 * d.z * d.z - 1.0)
+					+ UBO.irradianceSH[7].rgb * 1.092548 * d.x * d.z
+					+ UBO.irradianceSH[8].rgb * 0.546274 * (d.x * d.x - d.y * d.y);
+			}
+			vec2 equirectUV(vec3 d) {
+				return vec2(atan(d.z, d.x) / (2.0 * PI) + 0.5, acos(clamp(d.y, -1.0, 1.0)) / PI);
+			}
+
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec3 position, normal;
+				float metallic, roughness;
+				if (!fetchSurface(pixel, position, normal, metallic, roughness)) {
+					vec4 farPoint = UBO.inverseViewProjection * vec4(gl_FragCoord.xy / vec2(textureSize(uBaseColor, 0)) * 2.0 - 1.0, 1.0, 1.0);
+					vec3 direction = normalize(farPoint.xyz / farPoint.w - UBO.cameraPosition.xyz);
+					outFragColor = vec4(textureLod(uBackground, equirectUV(direction), 0.0).rgb, 1.0);
+					return;
+				}
+				vec3 baseColor = texelFetch(uBaseColor, pixel, 0).rgb;
+				vec3 N = normal;
+				vec3 V = normalize(UBO.cameraPosition.xyz - position);
+				vec3 R = reflect(-V, N);
+				float NdotV = max(dot(N, V), 1e-4);
+				vec3 F0 = mix(vec3(0.04), baseColor, metallic);
+				vec3 F = F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - NdotV, 5.0);
+				vec3 diffuse = (1.0 - F) * (1.0 - metallic) * baseColor * max(evaluateSH(N), vec3(0.0));
+				vec3 prefiltered = textureLod(uPrefilter, equirectUV(R), roughness * UBO.maxLod).rgb;
+				vec2 brdf = texture(uBrdfLut, vec2(NdotV, roughness)).rg;
+				vec3 specular = prefiltered * (F0 * brdf.x + brdf.y);
+				outFragColor = vec4(diffuse + specular, 1.0);
+			}
+)";
+		mLightingFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformCode + R"(
+			layout (binding = 2) uniform sampler2D uMetallic;
+			layout (binding = 3) uniform sampler2D uNormal;
+			layout (binding = 4) uniform sampler2D uPosition;
+			layout (binding = 5) uniform sampler2D uRoughness;
+			bool fetchSurface(ivec2 pixel, out vec3 position, out vec3 normal, out float metallic, out float roughness) {
+				normal = texelFetch(uNormal, pixel, 0).xyz;
+				if (dot(normal, normal) < 1e-4)
+					return false;
+				normal = normalize(normal);
+				position = texelFetch(uPosition, pixel, 0).xyz;
+				metallic = texelFetch(uMetallic, pixel, 0).r;
+				roughness = texelFetch(uRoughness, pixel, 0).r;
+				return true;
+			}
+		)" + lightingCode);
+
+		mCompactLightingFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformCode + QCompactGBuffer::codecFunctions() + R"(
+			layout (binding = 2) uniform sampler2D uPackedMaterial;
+			layout (binding = 3) uniform sampler2D uPackedNormal;
+			layout (binding = 4) uniform sampler2D uDepth;
+			bool fetchSurface(ivec2 pixel, out vec3 position, out vec3 normal, out float metallic, out float roughness) {
+				vec4 material = texelFetch(uPackedMaterial, pixel, 0);
+				if (material.a < 0.5)
+					return false;
+				normal = octDecode(texelFetch(uPackedNormal, pixel, 0).xy);
+				position = reconstructPosition(gl_FragCoord.xy, vec2(textureSize(uDepth, 0)), texelFetch(uDepth, pixel, 0).r, UBO.inverseViewProjection);
+				metallic = material.r;
+				roughness = material.g;
+				return true;
+			}
+		)" + lightingCode);
+	}
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QIblData& data = *mInput._IblData;
+		builder.setupTexture(mPrefilterTexture, "CachedIblPrefilter", QRhiTexture::RGBA32F, data.prefilterSize, 1, QRhiTexture::MipMapped);
+		builder.setupTexture(mBackgroundTexture, "CachedIblBackground", QRhiTexture::RGBA32F, data.backgroundSize, 1);
+		builder.setupTexture(mBrdfLutTexture, "CachedIblBrdfLut", QRhiTexture::RGBA32F, QSize(data.brdfLutSize, data.brdfLutSize), 1);
+		builder.setupTexture(mColorAttachment, "CachedIblLighting", QRhiTexture::RGBA16F, mInput._BaseColor->pixelSize(), 1, QRhiTexture::RenderTarget | QRhiTexture::UsedAsTransferSource);
+		builder.setupRenderTarget(mRenderTarget, "CachedIblLightingRT", QRhiTextureRenderTargetDescription(mColorAttachment.get()));
+		builder.setupBuffer(mUniformBuffer, "CachedIblUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mPointSampler, "CachedIblPointSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mLinearSampler, "CachedIblLinearSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		builder.setupSampler(mEnvironmentSampler, "CachedIblEnvironmentSampler", QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Linear, QRhiSampler::Repeat, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+		QVector<QRhiShaderResourceBinding> bindings = {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._BaseColor.get(), mPointSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(6, QRhiShaderResourceBinding::FragmentStage, mBackgroundTexture.get(), mEnvironmentSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(7, QRhiShaderResourceBinding::FragmentStage, mPrefilterTexture.get(), mEnvironmentSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(8, QRhiShaderResourceBinding::FragmentStage, mBrdfLutTexture.get(), mLinearSampler.get()),
+		};
+		if (mInput._UseCompactGBuffer) {
+			bindings << QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._PackedMaterial.get(), mPointSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._PackedNormal.get(), mPointSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, mInput._Depth.get(), mPointSampler.get());
+		}
+		else {
+			bindings << QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._Metallic.get(), mPointSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(3, QRhiShaderResourceBinding::FragmentStage, mInput._Normal.get(), mPointSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(4, QRhiShaderResourceBinding::FragmentStage, mInput._Position.get(), mPointSampler.get())
+				<< QRhiShaderResourceBinding::sampledTexture(5, QRhiShaderResourceBinding::FragmentStage, mInput._Roughness.get(), mPointSampler.get());
+		}
+		builder.setupShaderResourceBindings(mBindings, "CachedIblBindings", bindings);
+		QRhiGraphicsPipelineState PSO;
+		PSO.shaderResourceBindings = mBindings.get();
+		PSO.sampleCount = mRenderTarget->sampleCount();
+		PSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		PSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mInput._UseCompactGBuffer ? mCompactLightingFS : mLightingFS)
+		};
+		builder.setupGraphicsPipeline(mPipeline, "CachedIblPipeline", PSO);
+
+		mOutput.LightingResult = mColorAttachment;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QIblData& data = *mInput._IblData;
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		if (mUploadedData != &data || mUploadedPrefilter != mPrefilterTexture.get() || mUploadedBackground != mBackgroundTexture.get() || mUploadedBrdfLut != mBrdfLutTexture.get()) {		//预计算结果只需上传一次
+			QVector<QRhiTextureUploadEntry> entries;
+			const int levelCount = qMin<int>(data.prefilterLevels.size(), mRhi->mipLevelsForSize(data.prefilterSize));
+			for (int level = 0; level < levelCount; level++) {
+				const QVector<QVector4D>& texels = data.prefilterLevels[level];
+				QRhiTextureSubresourceUploadDescription desc(texels.constData(), texels.size() * sizeof(QVector4D));
+				desc.setSourceSize(mRhi->sizeForMipLevel(level, data.prefilterSize));
+				entries << QRhiTextureUploadEntry(0, level, desc);
+			}
+			batch->uploadTexture(mPrefilterTexture.get(), QRhiTextureUploadDescription(entries.begin(), entries.end()));
+			batch->uploadTexture(mBackgroundTexture.get(), QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(data.background.constData(), data.background.size() * sizeof(QVector4D)))));
+			batch->uploadTexture(mBrdfLutTexture.get(), QRhiTextureUploadDescription(QRhiTextureUploadEntry(0, 0, QRhiTextureSubresourceUploadDescription(data.brdfLut.constData(), data.brdfLut.size() * sizeof(QVector4D)))));
+			mUploadedData = &data;
+			mUploadedPrefilter = mPrefilterTexture.get();
+			mUploadedBackground = mBackgroundTexture.get();
+			mUploadedBrdfLut = mBrdfLutTexture.get();
+		}
+		UniformBlock ubo;
+		const QMatrix4x4 inverseViewProjection = (mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix).inverted();
+		memcpy(ubo.inverseViewProjection, inverseViewProjection.constData(), sizeof(ubo.inverseViewProjection));
+		ubo.cameraPosition = QVector4D(mInput._CameraPosition, 1.0f);
+		for (int i = 0; i < QIblData::SHCoefficientCount; i++)
+			ubo.irradianceSH[i] = QVector4D(data.irradianceSH[i], 0.0f);
+		ubo.maxLod = data.prefilterLevels.size() - 1;
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setGraphicsPipeline(mPipeline.get());
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setShaderResources(mBindings.get());
+		cmdBuffer->draw(4);
+		cmdBuffer->endPass();
+	}
+};
+
+// 写出不压缩的 Radiance RGBE 文件，自检时用来构造已知内容的环境贴图
+static bool writeRadianceHdr(const QString& path, const QEquirectImage& image) {
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	QByteArray data = QString("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %1 +X %2\n").arg(image.height).arg(image.width).toLocal8Bit();
+	for (const QVector3D& pixel : image.pixels) {
+		const float maxComponent = qMax(pixel.x(), qMax(pixel.y(), pixel.z()));
+		uchar rgbe[4] = { 0, 0, 0, 0 };
+		if (maxComponent > 1e-32f) {
+			int exponent = 0;
+			const float scale = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+			rgbe[0] = uchar(pixel.x() * scale);
+			rgbe[1] = uchar(pixel.y() * scale);
+			rgbe[2] = uchar(pixel.z() * scale);
+			rgbe[3] = uchar(exponent + 128);
+		}
+		data.append(reinterpret_cast<const char*>(rgbe), 4);
+	}
+	return file.write(data) == data.size();
+}
+
+// 无窗口自检：常量环境下与解析解比较，冷/热启动结果逐字节一致，损坏的缓存会被丢弃并重新计算
+static int runIblCheck() {
+	bool passed = true;
+	auto check = [&passed](bool condition, const QString& message) {
+		qDebug().noquote() << (condition ? "[IBL check] ok  " : "[IBL check] FAIL") << message;
+		passed &= condition;
+	};
+	auto isClose = [](const QVector3D& value, const QVector3D& expected, float tolerance) {
+		return (value - expected).length() <= tolerance * expected.length();
+	};
+
+	const QVector3D radiance(0.5f, 1.0f, 2.0f);
+	QEquirectImage constant;
+	constant.width = 128;
+	constant.height = 64;
+	constant.pixels.fill(radiance, constant.width * constant.height);
+	QIblData data;
+	data.brdfLutSize = QIblPrecompute::BrdfLutSize;
+	data.brdfLut = QIblPrecompute::bakeBrdfLut();
+	QIblPrecompute::computeEnvironment(constant, data);
+	const QString error = QIblPrecompute::validate(data);
+	check(error.isEmpty(), "constant environment passes validation " + error);
+
+	bool irradianceMatches = true;			//常量辐射率L下，E/PI 在任何方向上都等于L
+	for (int i = 0; i < 64; i++) {
+		const QVector2D xi = QIblPrecompute::hammersley(i, 64);
+		irradianceMatches &= isClose(data.evaluateSH(QEquirectImage::direction(xi.x(), xi.y())), radiance, 0.01f);
+	}
+	check(irradianceMatches, "SH irradiance of a constant environment equals its radiance");
+	bool prefilterMatches = true;
+	for (const QVector<QVector4D>& level : data.prefilterLevels) {
+		for (const QVector4D& texel : level)
+			prefilterMatches &= isClose(texel.toVector3D(), radiance, 0.01f);
+	}
+	check(prefilterMatches, "every prefiltered level of a constant environment equals its radiance");
+	const QVector4D smoothHeadOn = data.brdfLut[QIblPrecompute::BrdfLutSize - 1];
+	check(smoothHeadOn.x() + smoothHeadOn.y() > 0.9f, QString("BRDF LUT directional albedo for a smooth surface at normal incidence is %1").arg(smoothHeadOn.x() + smoothHeadOn.y()));
+
+	QTemporaryDir tempDir;
+	QEquirectImage gradient;							//带方向变化的环境，用来比较缓存往返
+	gradient.width = 128;
+	gradient.height = 64;
+	gradient.pixels.resize(gradient.width * gradient.height);
+	for (int y = 0; y < gradient.height; y++) {
+		for (int x = 0; x < gradient.width; x++)
+			gradient.pixels[y * gradient.width + x] = QVector3D(1.0f + 4.0f * x / gradient.width, 0.25f + y / float(gradient.height), 0.5f);
+	}
+	const QString hdrPath = tempDir.filePath("gradient.hdr");
+	const QString cacheDir = tempDir.filePath("Cache");
+	check(writeRadianceHdr(hdrPath, gradient), "write test environment " + hdrPath);
+
+	QIblPrecompute::LoadReport coldReport, warmReport, repairedReport;
+	const QIblData cold = QIblPrecompute::loadOrCompute(hdrPath, cacheDir, &coldReport);
+	check(QIblPrecompute::validate(cold).isEmpty() && !coldReport.envCached && !coldReport.lutCached, "cold start precomputes valid data");
+	const QIblData warm = QIblPrecompute::loadOrCompute(hdrPath, cacheDir, &warmReport);
+	bool identical = warmReport.envCached && warmReport.lutCached && warm.brdfLut == cold.brdfLut && warm.background == cold.background && warm.prefilterLevels == cold.prefilterLevels;
+	for (int i = 0; i < QIblData::SHCoefficientCount; i++)
+		identical &= warm.irradianceSH[i] == cold.irradianceSH[i];
+	check(identical, QString("warm start reads identical data from cache (%1 ms cold, %2 ms warm)").arg(coldReport.elapsedMs).arg(warmReport.elapsedMs));
+
+	const QFileInfoList cacheFiles = QDir(cacheDir).entryInfoList({ "*.bin" }, QDir::Files);
+	for (const QFileInfo& info : cacheFiles) {
+		QFile file(info.filePath());
+		if (file.open(QIODevice::ReadWrite))
+			file.resize(file.size() / 2);
+	}
+	const QIblData repaired = QIblPrecompute::loadOrCompute(hdrPath, cacheDir, &repairedReport);
+	check(!repairedReport.envCached && !repairedReport.lutCached && repaired.prefilterLevels == cold.prefilterLevels, "truncated cache files are discarded and recomputed");
+
+	const QString resourcePath = "Resources/Image/environment.hdr";
+	if (QFileInfo::exists(resourcePath)) {
+		const QIblData resourceData = QIblPrecompute::loadOrCompute(resourcePath, cacheDir);
+		const QString resourceError = QIblPrecompute::validate(resourceData);
+		check(resourceError.isEmpty(), resourcePath + " passes validation " + resourceError);
+	}
+	qDebug().noquote() << (passed ? "[IBL check] passed" : "[IBL check] failed");
+	return passed ? 0 : 1;
+}
+
+// 无窗口自检：GPU分簇剔除回读的光源列表必须与CPU参考实现一致，任意一项不一致时返回非零
+// 每种光源数量先用初始容量运行一次（光源多时会截断，检查总数与已写入部分），再按回读的最大值扩容后检查完整列表
+static int runClusterCheck() {
+	QVulkanInstance vulkanInstance;
+	vulkanInstance.setExtensions(QRhiVulkanInitParams::preferredInstanceExtensions());
+	if (!vulkanInstance.create()) {
+		qWarning() << "[Cluster check] FAIL cannot create a Vulkan instance";
+		return 1;
+	}
+	QRhiVulkanInitParams initParams;
+	initParams.inst = &vulkanInstance;
+	QSharedPointer<QRhi> rhi(QRhi::create(QRhi::Vulkan, &initParams));
+	if (!rhi || !rhi->isFeatureSupported(QRhi::Compute)) {
+		qWarning() << "[Cluster check] FAIL no Vulkan device with compute support";
+		return 1;
+	}
+
+	QMatrix4x4 view;
+	view.lookAt(QVector3D(20.0f, 15.0f, 12.0f), QVector3D(0.0f, 2.0f, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+	QMatrix4x4 projection;
+	projection.perspective(60.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+	const QLightClusterGrid::Camera camera = QClusteredLightingPassBuilder::createCamera(rhi.get(), view, projection);
+
+	bool passed = true;
+	auto check = [&passed](bool condition, const QString& message) {
+		qDebug().noquote() << (condition ? "[Cluster check] ok  " : "[Cluster check] FAIL") << message;
+		passed &= condition;
+	};
+	auto checkRun = [&](const QVector<QPunctualLight>& lights, int lightsPerCluster, int* outMaxLightsInCluster) {
+		const QByteArray data = QClusteredLightingPassBuilder::cullOffscreen(rhi.get(), camera, lights, lightsPerCluster, outMaxLightsInCluster);
+		const QClusteredLightingPassBuilder::Validation validation = QClusteredLightingPassBuilder::compareClusters(data, lightsPerCluster, camera, lights);
+		check(validation.lightCount == lights.size() && validation.mismatchedClusters == 0,
+			QString("%1 lights, capacity %2: %3/%4 clusters match the CPU binning, %5 truncated")
+			.arg(lights.size())
+			.arg(lightsPerCluster)
+			.arg(validation.clusterCount - validation.mismatchedClusters)
+			.arg(validation.clusterCount)
+			.arg(validation.truncatedClusters));
+		return validation;
+	};
+
+	for (int lightCount : { 0, 1, 100, 1000, 4000 }) {
+		QRandomGenerator random(lightCount);
+		QVector<QPunctualLight> lights(lightCount);
+		for (QPunctualLight& light : lights) {			//分布在相机前方，半径从很小到覆盖多个簇
+			light.position = QVector3D(random.bounded(40.0) - 20.0, random.bounded(12.0) - 2.0, random.bounded(40.0) - 20.0);
+			light.radius = 0.25f + random.bounded(6.0);
+		}
+		int maxLightsInCluster = 0;
+		checkRun(lights, QLightClusterGrid::InitialLightsPerCluster, &maxLightsInCluster);
+		if (maxLightsInCluster > QLightClusterGrid::InitialLightsPerCluster) {
+			int lightsPerCluster = QLightClusterGrid::InitialLightsPerCluster;
+			while (lightsPerCluster < maxLightsInCluster)			//与渲染时相同的扩容方式
+				lightsPerCluster *= 2;
+			const QClusteredLightingPassBuilder::Validation grown = checkRun(lights, lightsPerCluster, nullptr);
+			check(grown.truncatedClusters == 0, QString("%1 lights: growing to %2 removes all truncation").arg(lightCount).arg(lightsPerCluster));
+		}
+	}
+	qDebug().noquote() << (passed ? "[Cluster check] passed" : "[Cluster check] failed");
+	return passed ? 0 : 1;
+}
+
+// 在渲染图的Pass之间写入Vulkan时间戳，测量单个Pass在GPU上的耗时
+// QRhi只提供整帧的GPU时间，这里通过 beginExternal 直接录制 vkCmdWriteTimestamp；每个在途帧使用查询池中独立的一段，结果在几帧后无等待地取回
+class QGpuPassTimer {
+public:
+	static const int SlotCount = 4;							//大于 QRhi 的在途帧数，取回结果时该段查询已经完成
+	static const int MaxTimestamps = 8;
+	~QGpuPassTimer() {				//渲染器的成员先于 IRenderer 析构，此时设备仍然有效
+		if (mQueryPool != VK_NULL_HANDLE)
+			mDevFunc->vkDestroyQueryPool(mDevice, mQueryPool, nullptr);
+	}
+	bool create(QRhi* rhi) {
+		if (mQueryPool != VK_NULL_HANDLE || mUnsupported)
+			return mQueryPool != VK_NULL_HANDLE;
+		QRhiVulkanNativeHandles* vkHandles = (QRhiVulkanNativeHandles*)rhi->nativeHandles();
+		VkPhysicalDeviceProperties properties;
+		vkHandles->inst->functions()->vkGetPhysicalDeviceProperties(vkHandles->physDev, &properties);
+		if (!properties.limits.timestampComputeAndGraphics) {
+			qWarning() << "[GpuPassTimer] the device does not support timestamps in graphics and compute queues";
+			mUnsupported = true;
+			return false;
+		}
+		mTimestampPeriod = properties.limits.timestampPeriod;
+		mDevice = vkHandles->dev;
+		mDevFunc = vkHandles->inst->deviceFunctions(mDevice);
+		VkQueryPoolCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		info.queryCount = SlotCount * MaxTimestamps;
+		if (mDevFunc->vkCreateQueryPool(mDevice, &info, nullptr, &mQueryPool) != VK_SUCCESS) {
+			mQueryPool = VK_NULL_HANDLE;
+			mUnsupported = true;
+		}
+		return mQueryPool != VK_NULL_HANDLE;
+	}
+	// 每帧第一个时间戳之前调用（必须在渲染通道之外）：取回该段上一轮的结果并重置
+	void beginFrame(QRhiCommandBuffer* cmdBuffer) {
+		if (mQueryPool == VK_NULL_HANDLE)
+			return;
+		mSlot = (mSlot + 1) % SlotCount;
+		collect(mSlot);
+		cmdBuffer->beginExternal();
+		const VkCommandBuffer vkCmdBuffer = ((QRhiVulkanCommandBufferNativeHandles*)cmdBuffer->nativeHandles())->commandBuffer;
+		mDevFunc->vkCmdResetQueryPool(vkCmdBuffer, mQueryPool, mSlot * MaxTimestamps, MaxTimestamps);
+		cmdBuffer->endExternal();
+		mWrittenCount[mSlot] = 0;
+	}
+	void writeTimestamp(QRhiCommandBuffer* cmdBuffer) {
+		if (mQueryPool == VK_NULL_HANDLE || mWrittenCount[mSlot] >= MaxTimestamps)
+			return;
+		cmdBuffer->beginExternal();
+		const VkCommandBuffer vkCmdBuffer = ((QRhiVulkanCommandBufferNativeHandles*)cmdBuffer->nativeHandles())->commandBuffer;
+		mDevFunc->vkCmdWriteTimestamp(vkCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mQueryPool, mSlot * MaxTimestamps + mWrittenCount[mSlot]);
+		cmdBuffer->endExternal();
+		mWrittenCount[mSlot]++;
+	}
+	bool isAvailable() const { return mQueryPool != VK_NULL_HANDLE; }
+	// 第 index 个区间（时间戳 index 到 index + 1）在已取回的帧上的平均耗时，单位毫秒
+	double averageIntervalMs(int index) const {
+		return mIntervalFrames[index] > 0 ? mIntervalMs[index] / mIntervalFrames[index] : 0.0;
+	}
+	void resetAverages() {
+		std::fill(std::begin(mIntervalMs), std::end(mIntervalMs), 0.0);
+		std::fill(std::begin(mIntervalFrames), std::end(mIntervalFrames), 0);
+	}
+private:
+	void collect(int slot) {
+		const int count = mWrittenCount[slot];
+		if (count < 2)
+			return;
+		quint64 results[MaxTimestamps * 2];				//每个查询：时间戳、可用标记
+		const VkResult result = mDevFunc->vkGetQueryPoolResults(mDevice, mQueryPool, slot * MaxTimestamps, count, sizeof(quint64) * 2 * count, results, sizeof(quint64) * 2,
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+			return;
+		for (int i = 0; i + 1 < count; i++) {
+			if (results[i * 2 + 1] == 0 || results[i * 2 + 3] == 0)
+				continue;
+			mIntervalMs[i] += double(results[i * 2 + 2] - results[i * 2]) * mTimestampPeriod / 1e6;
+			mIntervalFrames[i]++;
+		}
+	}
+	VkDevice mDevice = VK_NULL_HANDLE;
+	QVulkanDeviceFunctions* mDevFunc = nullptr;
+	VkQueryPool mQueryPool = VK_NULL_HANDLE;
+	bool mUnsupported = false;
+	float mTimestampPeriod = 1.0f;							//每个时间戳计数对应的纳秒数
+	int mSlot = 0;
+	int mWrittenCount[SlotCount] = {};
+	double mIntervalMs[MaxTimestamps - 1] = {};
+	int mIntervalFrames[MaxTimestamps - 1] = {};
+};
 
 class MyRenderer : public IRenderer {
+	Q_OBJECT
+	Q_PROPERTY_VAR(int, LightCount) = 100;
+	Q_PROPERTY_VAR(float, LightRadius) = 4.0f;
+	Q_PROPERTY_VAR(float, LightIntensity) = 20.0f;
+	Q_PROPERTY_VAR(bool, RunLightScalingBenchmark) = false;
+	Q_PROPERTY_VAR(bool, UseCompactGBuffer) = false;
+	Q_PROPERTY_VAR(bool, UseCachedIbl) = true;
+
+	Q_CLASSINFO("LightCount", "Min=0,Max=4096")
 private:
 	QStaticMeshRenderComponent mStaticComp;
 	QSharedPointer<QPbrMeshPassBuilder> mMeshPass{ new QPbrMeshPassBuilder };
 	QSharedPointer<QPbrLightingPassBuilder> mLightingPass{ new QPbrLightingPassBuilder };
 	QSharedPointer<QSkyPassBuilder> mSkyPass{ new QSkyPassBuilder };
+	QSharedPointer<QClusteredLightingPassBuilder> mClusteredLightingPass{ new QClusteredLightingPassBuilder };
+	QSharedPointer<QCompactGBufferMeshPassBuilder> mCompactGBufferPass{ new QCompactGBufferMeshPassBuilder };
+	QSharedPointer<QCachedIblLightingPassBuilder> mCachedIblPass{ new QCachedIblLightingPassBuilder };
+	QFuture<QIblData> mIblFuture;
+	QSharedPointer<const QIblData> mIblData;
+	QFuture<QSharedPointer<const QCompactGBufferMesh>> mCompactMeshFuture;
+	QSharedPointer<const QCompactGBufferMesh> mCompactMesh;
+	bool mCompactMeshRequested = false;
+	QPointer<QWidget> mViewport;
+	bool mSkyBoxLoaded = false;
+	QVector<QPunctualLight> mLights;
+	QVector<QVector3D> mLightOrbits;
+	QElapsedTimer mClock;
+	QElapsedTimer mBenchmarkTimer;
+	int mBenchmarkStep = -1;
+	int mBenchmarkFrameCount = 0;
+	int mGBufferReportFrameCount = 0;
+	bool mGBufferReportCompact = false;
+	QGpuPassTimer mGpuPassTimer;
 public:
 	MyRenderer()
 		: IRenderer({ QRhi::Vulkan })
@@ -21,7 +1915,9 @@ public:
 		mStaticComp.setStaticMesh(QStaticMesh::CreateFromFile("Resources/Model/mandalorian_ship/scene.gltf"));
 		mStaticComp.setRotation(QVector3D(-90, 0, 0));
 
-		mSkyPass->setSkyBoxImageByPath("Resources/Image/environment.hdr");
+		mIblFuture = QtConcurrent::run([]() {
+			return QIblPrecompute::loadOrCompute("Resources/Image/environment.hdr");
+		});
 
 		addComponent(&mStaticComp);
 
@@ -29,35 +1925,257 @@ public:
 
 		getCamera()->setPosition(QVector3D(20, 15, 12));
 		getCamera()->setRotation(QVector3D(-30, 145, 0));
+
+		mClock.start();
+	}
+	void setViewport(QWidget* viewport) { mViewport = viewport; }		//紧凑G-Buffer路径不经过引擎的网格Pass，需要自己确定渲染尺寸
+private:
+	QSize framebufferSize() const {
+		if (!mViewport)
+			return QSize(1280, 720);
+		const qreal dpr = mViewport->devicePixelRatioF();
+		return QSize(qMax(1, qRound(mViewport->width() * dpr)), qMax(1, qRound(mViewport->height() * dpr)));
+	}
+	void updateLights() {
+		if (mLights.size() != LightCount) {
+			QRandomGenerator random(LightCount);
+			mLights.resize(LightCount);
+			mLightOrbits.resize(LightCount);
+			for (int i = 0; i < LightCount; i++) {
+				QPunctualLight& light = mLights[i];
+				light.color = QVector3D(random.bounded(1.0), random.bounded(1.0), random.bounded(1.0));
+				if (i % 4 == 3) {					//每四个光源中有一个是聚光灯
+					light.spotDirection = QVector3D(0.0f, -1.0f, 0.0f);
+					light.spotCosOuter = qCos(qDegreesToRadians(35.0f));
+				}
+				mLightOrbits[i] = QVector3D(random.bounded(2.0 * M_PI), 2.0 + random.bounded(14.0), -2.0 + random.bounded(10.0));	//相位、半径、高度
+			}
+		}
+		const float time = mClock.elapsed() / 1000.0f;
+		for (int i = 0; i < mLights.size(); i++) {
+			const QVector3D& orbit = mLightOrbits[i];
+			const float angle = orbit.x() + time * (0.2f + 0.3f * (i % 7) / 7.0f);
+			mLights[i].position = QVector3D(qCos(angle) * orbit.y(), orbit.z(), qSin(angle) * orbit.y());
+			mLights[i].radius = LightRadius;
+			mLights[i].intensity = LightIntensity;
+		}
+	}
+	void tickBenchmark() {
+		static const int BenchmarkLightCounts[] = { 10, 100, 1000, 4000 };
+		static const int FramesPerStep = 240;
+		if (!RunLightScalingBenchmark) {
+			mBenchmarkStep = -1;
+			return;
+		}
+		if (mBenchmarkStep < 0) {
+			mBenchmarkStep = 0;
+			mBenchmarkFrameCount = 0;
+			LightCount = BenchmarkLightCounts[0];
+			mBenchmarkTimer.start();
+			return;
+		}
+		if (++mBenchmarkFrameCount == FramesPerStep / 2)
+			mClusteredLightingPass->requestValidation();
+		if (mBenchmarkFrameCount < FramesPerStep)
+			return;
+		const QVector<QVector<int>> clusters = QLightClusterGrid::binLights(mClusteredLightingPass->getLastCamera(), mLights);
+		int maxLightsInCluster = 0;
+		qint64 totalLightRefs = 0;
+		for (const QVector<int>& cluster : clusters) {
+			maxLightsInCluster = qMax(maxLightsInCluster, int(cluster.size()));
+			totalLightRefs += cluster.size();
+		}
+		const QClusteredLightingPassBuilder::Stats& stats = mClusteredLightingPass->getStats();
+		const QClusteredLightingPassBuilder::Validation& validation = mClusteredLightingPass->getValidation();
+		QString gpuCheck = "GPU readback pending";
+		if (validation.lightCount == LightCount) {
+			gpuCheck = QString("GPU clusters matching CPU: %1/%2, truncated %3")
+				.arg(validation.clusterCount - validation.mismatchedClusters)
+				.arg(validation.clusterCount)
+				.arg(validation.truncatedClusters);
+		}
+		qDebug().noquote() << QString("[ClusteredLighting] %1 lights: %2 ms/frame, avg %3 lights/cluster, max %4, capacity %5, %6")
+			.arg(LightCount)
+			.arg(mBenchmarkTimer.nsecsElapsed() / 1e6 / mBenchmarkFrameCount, 0, 'f', 3)
+			.arg(double(totalLightRefs) / clusters.size(), 0, 'f', 2)
+			.arg(maxLightsInCluster)
+			.arg(stats.lightsPerCluster)
+			.arg(gpuCheck);
+		mBenchmarkStep = (mBenchmarkStep + 1) % std::size(BenchmarkLightCounts);
+		mBenchmarkFrameCount = 0;
+		LightCount = BenchmarkLightCounts[mBenchmarkStep];
+		mBenchmarkTimer.restart();
+	}
+	// G-Buffer每帧的总流量：网格Pass写入一次，IBL光照与分簇光照各完整读取一次；按覆盖像素计，不考虑过度绘制
+	// 耗时取自网格Pass与光照Pass前后的GPU时间戳，不包含输出Pass和CPU开销；切换布局后重新统计
+	void reportGBuffer(bool compact, const QPbrMeshPassBuilder::Output& meshOut, const QCompactGBufferMeshPassBuilder::Output& compactOut) {
+		static const int FramesPerReport = 240;
+		static const int DepthAttachmentBytes = 4;				//引擎网格Pass的深度附件不对外暴露，按32位计
+		if (compact != mGBufferReportCompact) {
+			mGBufferReportCompact = compact;
+			mGBufferReportFrameCount = 0;
+			mGpuPassTimer.resetAverages();
+		}
+		if (++mGBufferReportFrameCount < FramesPerReport)
+			return;
+		int gbufferBytes = 0;
+		int writeBytesPerPixel = 0;
+		if (compact) {
+			gbufferBytes = QTextureFormatInfo::bytesPerPixel(compactOut.BaseColor->format())
+				+ QTextureFormatInfo::bytesPerPixel(compactOut.PackedNormal->format())
+				+ QTextureFormatInfo::bytesPerPixel(compactOut.PackedMaterial->format())
+				+ QTextureFormatInfo::bytesPerPixel(compactOut.Depth->format());
+			writeBytesPerPixel = gbufferBytes;
+		}
+		else {
+			gbufferBytes = QTextureFormatInfo::bytesPerPixel(meshOut.BaseColor->format())
+				+ QTextureFormatInfo::bytesPerPixel(meshOut.Metallic->format())
+				+ QTextureFormatInfo::bytesPerPixel(meshOut.Normal->format())
+				+ QTextureFormatInfo::bytesPerPixel(meshOut.Position->format())
+				+ QTextureFormatInfo::bytesPerPixel(meshOut.Roughness->format());
+			writeBytesPerPixel = gbufferBytes + DepthAttachmentBytes;
+		}
+		const int readBytesPerPixel = gbufferBytes * 2;
+		const QString gpuTime = mGpuPassTimer.isAvailable()
+			? QString("GPU mesh pass %1 ms, lighting passes %2 ms")
+				.arg(mGpuPassTimer.averageIntervalMs(0), 0, 'f', 3)
+				.arg(mGpuPassTimer.averageIntervalMs(1), 0, 'f', 3)
+			: QString("GPU pass times n/a (no timestamp queries)");
+		qDebug().noquote() << QString("[GBuffer] %1 layout: %2 bytes/pixel written + %3 bytes/pixel read = %4 bytes/pixel, %5")
+			.arg(compact ? "compact" : "full")
+			.arg(writeBytesPerPixel)
+			.arg(readBytesPerPixel)
+			.arg(writeBytesPerPixel + readBytesPerPixel)
+			.arg(gpuTime);
+		mGBufferReportFrameCount = 0;
+		mGpuPassTimer.resetAverages();
 	}
 protected:
 	void setupGraph(QRenderGraphBuilder& graphBuilder) override {
-		QSkyPassBuilder::Output skyOut
-			= graphBuilder.addPassBuilder("SkyPass", mSkyPass);
+		tickBenchmark();
+		updateLights();
+
+		if (!mIblData && mIblFuture.isFinished()) {
+			QIblData data = mIblFuture.result();
+			if (data.isValid())
+				mIblData.reset(new QIblData(std::move(data)));
+		}
+		// 引擎的 QStaticMesh 不向示例暴露顶点与材质数据，紧凑路径只能自己解析glTF；只在第一次开启时加载，默认路径不会读取两次
+		if (UseCompactGBuffer && !mCompactMeshRequested) {
+			mCompactMeshRequested = true;
+			mCompactMeshFuture = QtConcurrent::run([]() {
+				return QCompactGBufferMesh::load("Resources/Model/mandalorian_ship/scene.gltf");
+			});
+		}
+		if (!mCompactMesh && mCompactMeshRequested && mCompactMeshFuture.isFinished())
+			mCompactMesh = mCompactMeshFuture.result();
+		mGpuPassTimer.create(graphBuilder.rhi());
+
+		// 紧凑布局由网格Pass直接写出，引擎的光照Pass无法解码，因此紧凑路径总是使用缓存的IBL光照；网格加载完成前先使用完整布局
+		const bool compact = UseCompactGBuffer && mCompactMesh;
+		QRhiTextureRef baseColor;
+		QPbrMeshPassBuilder::Output meshOut;
+		QCompactGBufferMeshPassBuilder::Output compactOut;
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			mGpuPassTimer.beginFrame(cmdBuffer);
+			mGpuPassTimer.writeTimestamp(cmdBuffer);
+		});
+		if (compact) {
+			compactOut = graphBuilder.addPassBuilder("CompactGBufferPass", mCompactGBufferPass)
+				.setMesh(mCompactMesh)
+				.setSize(framebufferSize())
+				.setModelMatrix(mStaticComp.calculateWorldMatrix())			//与引擎路径使用同一个组件变换，编辑器中的修改对两条路径都生效
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix());
+			baseColor = compactOut.BaseColor;
+		}
+		else {
+			meshOut = graphBuilder.addPassBuilder("PbrMeshPass", mMeshPass);
+			baseColor = meshOut.BaseColor;
+		}
+		graphBuilder.addPass([this](QRhiCommandBuffer* cmdBuffer) {
+			mGpuPassTimer.writeTimestamp(cmdBuffer);
+		});
 
-		QPbrMeshPassBuilder::Output meshOut
-			= graphBuilder.addPassBuilder("PbrMeshPass",mMeshPass);
+		QRhiTextureRef lightingResult;
+		if (UseCachedIbl || compact) {				//缓存路径自己绘制背景，不再运行引擎的天空与光照Pass；预计算完成前使用占位数据
+			QCachedIblLightingPassBuilder::Output iblOut
+				= graphBuilder.addPassBuilder("CachedIblLightingPass", mCachedIblPass)
+				.setBaseColor(baseColor)
+				.setMetallic(meshOut.Metallic)
+				.setNormal(meshOut.Normal)
+				.setPosition(meshOut.Position)
+				.setRoughness(meshOut.Roughness)
+				.setUseCompactGBuffer(compact)
+				.setPackedNormal(compactOut.PackedNormal)
+				.setPackedMaterial(compactOut.PackedMaterial)
+				.setDepth(compactOut.Depth)
+				.setIblData(mIblData ? mIblData : QIblData::placeholder())
+				.setViewMatrix(getCamera()->getViewMatrix())
+				.setProjectionMatrix(getCamera()->getProjectionMatrix())
+				.setCameraPosition(getCamera()->getPosition());
+			lightingResult = iblOut.LightingResult;
+		}
+		else {
+			if (!mSkyBoxLoaded) {
+				mSkyPass->setSkyBoxImageByPath("Resources/Image/environment.hdr");
+				mSkyBoxLoaded = true;
+			}
+			QSkyPassBuilder::Output skyOut
+				= graphBuilder.addPassBuilder("SkyPass", mSkyPass);
 
-		QPbrLightingPassBuilder::Output lightingOut
-			= graphBuilder.addPassBuilder("LightingPass", mLightingPass)
-			.setBaseColor(meshOut.BaseColor)
+			QPbrLightingPassBuilder::Output lightingOut
+				= graphBuilder.addPassBuilder("LightingPass", mLightingPass)
+				.setBaseColor(meshOut.BaseColor)
+				.setMetallic(meshOut.Metallic)
+				.setNormal(meshOut.Normal)
+				.setPosition(meshOut.Position)
+				.setRoughness(meshOut.Roughness)
+				.setSkyCube(skyOut.SkyCube)
+				.setSkyTexture(skyOut.SkyTexture);
+			lightingResult = lightingOut.LightingResult;
+		}
+
+		QClusteredLightingPassBuilder::Output clusteredOut
+			= graphBuilder.addPassBuilder("ClusteredLightingPass", mClusteredLightingPass)
+			.setLightingResult(lightingResult)
+			.setBaseColor(baseColor)
 			.setMetallic(meshOut.Metallic)
 			.setNormal(meshOut.Normal)
 			.setPosition(meshOut.Position)
 			.setRoughness(meshOut.Roughness)
-			.setSkyCube(skyOut.SkyCube)
-			.setSkyTexture(skyOut.SkyTexture);
+			.setUseCompactGBuffer(compact)
+			.setPackedNormal(compactOut.PackedNormal)
+			.setPackedMaterial(compactOut.PackedMaterial)
+			.setDepth(compactOut.Depth)
+			.setLights(mLights)
+			.setViewMatrix(getCamera()->getViewMatrix())
+			.setProjectionMatrix(getCamera()->getProjectionMatrix())
+			.setCameraPosition(getCamera()->getPosition());
+
+		graphBuilder.addPass([this, compact, meshOut, compactOut](QRhiCommandBuffer* cmdBuffer) {
+			mGpuPassTimer.writeTimestamp(cmdBuffer);
+			reportGBuffer(compact, meshOut, compactOut);
+		});
 
 		QOutputPassBuilder::Output cout
 			= graphBuilder.addPassBuilder<QOutputPassBuilder>("OutputPass")
-			.setInitialTexture(lightingOut.LightingResult);
+			.setInitialTexture(clusteredOut.ClusteredLightingResult);
 	}
 };
 
 int main(int argc, char** argv) {
 	qputenv("QSG_INFO", "1");
 	QEngineApplication app(argc, argv);
-	QRenderWidget widget(new MyRenderer());
+	if (app.arguments().contains("--ibl-check"))
+		return runIblCheck();
+	if (app.arguments().contains("--cluster-check"))
+		return runClusterCheck();
+	MyRenderer* renderer = new MyRenderer();
+	QRenderWidget widget(renderer);
+	renderer->setViewport(&widget);
 	widget.showMaximized();
 	return app.exec();
-}
\ No newline at end of file
+}
+
+#include "main.moc"
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef QFrameTimeBenchmark_h__
+#define QFrameTimeBenchmark_h__
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QString>
+#include "Render/RHI/QRhiHelper.h"
+
+// 按固定帧数统计平均帧时间与GPU时间，每个统计周期输出一行日志
+// GPU时间来自 QRhiCommandBuffer::lastCompletedGpuTime()，只有创建QRhi时带上 QRhi::EnableTimestamps 才有数值，
+// 否则整个周期都为0，此时输出 n/a 而不是 0 ms
+class QFrameTimeBenchmark {
+public:
+	static const int SampleFrames = 240;
+
+	static QString formatGpuTime(double gpuSeconds, int frameCount) {
+		if (gpuSeconds <= 0.0 || frameCount <= 0)
+			return "n/a (no QRhi::EnableTimestamps)";
+		return QString("%1 ms").arg(gpuSeconds * 1000.0 / frameCount, 0, 'f', 3);
+	}
+
+	void setLabel(const QString& label) {
+		if (mLabel != label) {
+			mLabel = label;
+			reset();
+		}
+	}
+	const QString& getLabel() const { return mLabel; }
+	void setDetail(const QString& detail) {
+		mDetail = detail;
+	}
+	void tick(QRhiCommandBuffer* cmdBuffer) {
+		const double cpuTime = mTimer.isValid() ? mTimer.nsecsElapsed() / 1e9 : 0.0;
+		mTimer.restart();
+		mGpuSeconds += cmdBuffer->lastCompletedGpuTime();
+		mFrameSeconds += cpuTime;
+		if (++mFrameCount == SampleFrames) {
+			qDebug().noquote() << QString("[%1] frame: %2 ms, gpu: %3 %4").arg(mLabel)
+				.arg(mFrameSeconds * 1000.0 / mFrameCount, 0, 'f', 3)
+				.arg(formatGpuTime(mGpuSeconds, mFrameCount))
+				.arg(mDetail);
+			reset();
+		}
+	}
+private:
+	void reset() {
+		mFrameCount = 0;
+		mGpuSeconds = 0.0;
+		mFrameSeconds = 0.0;
+	}
+	QString mLabel;
+	QString mDetail;
+	QElapsedTimer mTimer;
+	int mFrameCount = 0;
+	double mGpuSeconds = 0.0;
+	double mFrameSeconds = 0.0;
+};
+
+#endif // QFrameTimeBenchmark_h__
@@ -0,0 +1,231 @@
+#ifndef QMeshGeometry_h__
+#define QMeshGeometry_h__
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <cfloat>
+#include <functional>
+
+// 直接从glTF读取的几何数据，节点变换已经烘焙到顶点中
+struct QMeshGeometry {
+	struct Vertex {
+		QVector3D position;
+		QVector3D normal;
+		QVector2D texCoord;
+	};
+	struct Submesh {
+		quint32 indexOffset = 0;
+		quint32 indexCount = 0;
+		quint32 materialIndex = 0;
+	};
+	struct Material {											//glTF的金属度/粗糙度材质，贴图路径为空时只使用系数
+		QVector4D baseColorFactor = QVector4D(1.0f, 1.0f, 1.0f, 1.0f);
+		float metallicFactor = 1.0f;
+		float roughnessFactor = 1.0f;
+		QString baseColorTexture;
+		QString metallicRoughnessTexture;
+	};
+	QVector<Vertex> vertices;
+	QVector<quint32> indices;
+	QVector<Submesh> submeshes;
+	QVector<Material> materials;
+	QVector3D boundsCenter;
+	float boundsRadius = 0.0f;
+
+	int triangleCount() const { return indices.size() / 3; }
+
+	static QMeshGeometry loadGltf(const QString& path, QString* error) {
+		QMeshGeometry geometry;
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly)) {
+			*error = "cannot open " + path;
+			return geometry;
+		}
+		const QJsonObject gltf = QJsonDocument::fromJson(file.readAll()).object();
+		const QJsonArray buffers = gltf["buffers"].toArray();
+		if (buffers.isEmpty()) {
+			*error = "no buffers in " + path;
+			return geometry;
+		}
+		QFile binFile(QFileInfo(path).dir().filePath(buffers[0].toObject()["uri"].toString()));
+		if (!binFile.open(QIODevice::ReadOnly)) {
+			*error = "cannot open " + binFile.fileName();
+			return geometry;
+		}
+		const QByteArray bin = binFile.readAll();
+		const QJsonArray nodes = gltf["nodes"].toArray();
+		const QJsonArray meshes = gltf["meshes"].toArray();
+		const QJsonArray textures = gltf["textures"].toArray();
+		const QJsonArray images = gltf["images"].toArray();
+		auto texturePath = [&](const QJsonObject& textureInfo) {
+			const int textureIndex = textureInfo["index"].toInt(-1);
+			if (textureIndex < 0 || textureIndex >= textures.size())
+				return QString();
+			const int imageIndex = textures[textureIndex].toObject()["source"].toInt(-1);
+			if (imageIndex < 0 || imageIndex >= images.size())
+				return QString();
+			const QString uri = images[imageIndex].toObject()["uri"].toString();
+			return uri.isEmpty() ? QString() : QFileInfo(path).dir().filePath(uri);
+		};
+		for (const QJsonValue& materialValue : gltf["materials"].toArray()) {
+			const QJsonObject pbr = materialValue.toObject()["pbrMetallicRoughness"].toObject();
+			Material material;
+			const QJsonArray factor = pbr["baseColorFactor"].toArray();
+			if (factor.size() == 4)
+				material.baseColorFactor = QVector4D(factor[0].toDouble(), factor[1].toDouble(), factor[2].toDouble(), factor[3].toDouble());
+			material.metallicFactor = pbr["metallicFactor"].toDouble(1.0);
+			material.roughnessFactor = pbr["roughnessFactor"].toDouble(1.0);
+			material.baseColorTexture = texturePath(pbr["baseColorTexture"].toObject());
+			material.metallicRoughnessTexture = texturePath(pbr["metallicRoughnessTexture"].toObject());
+			geometry.materials << material;
+		}
+		const int defaultMaterial = geometry.materials.size();			//没有指定材质的图元使用追加在末尾的默认材质
+		bool useDefaultMaterial = false;
+
+		std::function<void(int, const QMatrix4x4&)> visitNode = [&](int nodeIndex, const QMatrix4x4& parentMatrix) {
+			const QJsonObject node = nodes[nodeIndex].toObject();
+			QMatrix4x4 local;
+			if (node.contains("matrix")) {
+				const QJsonArray m = node["matrix"].toArray();
+				for (int i = 0; i < 16; i++)
+					local(i % 4, i / 4) = m[i].toDouble();			//glTF矩阵按列存储
+			}
+			else {
+				const QJsonArray t = node["translation"].toArray();
+				const QJsonArray r = node["rotation"].toArray();
+				const QJsonArray s = node["scale"].toArray();
+				if (t.size() == 3)
+					local.translate(t[0].toDouble(), t[1].toDouble(), t[2].toDouble());
+				if (r.size() == 4)
+					local.rotate(QQuaternion(r[3].toDouble(), r[0].toDouble(), r[1].toDouble(), r[2].toDouble()));
+				if (s.size() == 3)
+					local.scale(s[0].toDouble(), s[1].toDouble(), s[2].toDouble());
+			}
+			const QMatrix4x4 world = parentMatrix * local;
+			if (node.contains("mesh")) {
+				const QMatrix3x3 normalMatrix = world.normalMatrix();
+				for (const QJsonValue& primitiveValue : meshes[node["mesh"].toInt()].toObject()["primitives"].toArray()) {
+					const QJsonObject primitive = primitiveValue.toObject();
+					if (primitive["mode"].toInt(4) != 4 || !primitive.contains("indices"))
+						continue;
+					const QJsonObject attributes = primitive["attributes"].toObject();
+					const QVector<float> positions = readFloats(gltf, bin, attributes["POSITION"].toInt(-1), 3);
+					const QVector<float> normals = readFloats(gltf, bin, attributes["NORMAL"].toInt(-1), 3);
+					const QVector<float> texCoords = readFloats(gltf, bin, attributes["TEXCOORD_0"].toInt(-1), 2);
+					const QVector<quint32> indices = readIndices(gltf, bin, primitive["indices"].toInt());
+					const int vertexCount = positions.size() / 3;
+					const quint32 baseVertex = geometry.vertices.size();
+					for (int i = 0; i < vertexCount; i++) {
+						Vertex vertex;
+						vertex.position = world.map(QVector3D(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]));
+						if (normals.size() == positions.size()) {
+							const QVector3D normal(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+							vertex.normal = QVector3D(
+								normalMatrix(0, 0) * normal.x() + normalMatrix(0, 1) * normal.y() + normalMatrix(0, 2) * normal.z(),
+								normalMatrix(1, 0) * normal.x() + normalMatrix(1, 1) * normal.y() + normalMatrix(1, 2) * normal.z(),
+								normalMatrix(2, 0) * normal.x() + normalMatrix(2, 1) * normal.y() + normalMatrix(2, 2) * normal.z()).normalized();
+						}
+						if (texCoords.size() == vertexCount * 2)
+							vertex.texCoord = QVector2D(texCoords[i * 2], texCoords[i * 2 + 1]);
+						geometry.vertices << vertex;
+					}
+					Submesh submesh;
+					submesh.indexOffset = geometry.indices.size();
+					const int materialIndex = primitive["material"].toInt(-1);
+					submesh.materialIndex = materialIndex >= 0 && materialIndex < defaultMaterial ? materialIndex : defaultMaterial;
+					useDefaultMaterial |= int(submesh.materialIndex) == defaultMaterial;
+					for (quint32 index : indices) {
+						if (index < quint32(vertexCount))
+							geometry.indices << baseVertex + index;
+					}
+					geometry.indices.resize(submesh.indexOffset + (geometry.indices.size() - submesh.indexOffset) / 3 * 3);
+					submesh.indexCount = geometry.indices.size() - submesh.indexOffset;
+					geometry.submeshes << submesh;
+				}
+			}
+			for (const QJsonValue& child : node["children"].toArray())
+				visitNode(child.toInt(), world);
+		};
+		const QJsonArray scenes = gltf["scenes"].toArray();
+		const QJsonArray rootNodes = scenes[gltf["scene"].toInt()].toObject()["nodes"].toArray();
+		for (const QJsonValue& root : rootNodes)
+			visitNode(root.toInt(), QMatrix4x4());
+		if (useDefaultMaterial)
+			geometry.materials << Material();
+		if (geometry.vertices.isEmpty()) {
+			*error = "no triangle primitives in " + path;
+			return geometry;
+		}
+		geometry.updateBounds();
+		return geometry;
+	}
+	void updateBounds() {
+		QVector3D boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+		QVector3D boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const Vertex& vertex : vertices) {
+			boundsMin = QVector3D(qMin(boundsMin.x(), vertex.position.x()), qMin(boundsMin.y(), vertex.position.y()), qMin(boundsMin.z(), vertex.position.z()));
+			boundsMax = QVector3D(qMax(boundsMax.x(), vertex.position.x()), qMax(boundsMax.y(), vertex.position.y()), qMax(boundsMax.z(), vertex.position.z()));
+		}
+		boundsCenter = (boundsMin + boundsMax) * 0.5f;
+		boundsRadius = 0.0f;
+		for (const Vertex& vertex : vertices)
+			boundsRadius = qMax(boundsRadius, (vertex.position - boundsCenter).length());
+	}
+private:
+	static QJsonObject accessorView(const QJsonObject& gltf, int accessorIndex, int* offset, int* stride, int elementSize) {
+		const QJsonObject accessor = gltf["accessors"].toArray()[accessorIndex].toObject();
+		const QJsonObject view = gltf["bufferViews"].toArray()[accessor["bufferView"].toInt()].toObject();
+		*offset = view["byteOffset"].toInt() + accessor["byteOffset"].toInt();
+		*stride = view["byteStride"].toInt(elementSize);
+		return accessor;
+	}
+	static QVector<float> readFloats(const QJsonObject& gltf, const QByteArray& bin, int accessorIndex, int components) {
+		QVector<float> result;
+		if (accessorIndex < 0)
+			return result;
+		int offset = 0;
+		int stride = 0;
+		const QJsonObject accessor = accessorView(gltf, accessorIndex, &offset, &stride, components * sizeof(float));
+		const int count = accessor["count"].toInt();
+		if (accessor["componentType"].toInt() != 5126 || offset + qint64(stride) * (count - 1) + components * sizeof(float) > bin.size())
+			return result;
+		result.resize(count * components);
+		for (int i = 0; i < count; i++)
+			memcpy(result.data() + i * components, bin.constData() + offset + i * stride, components * sizeof(float));
+		return result;
+	}
+	static QVector<quint32> readIndices(const QJsonObject& gltf, const QByteArray& bin, int accessorIndex) {
+		QVector<quint32> result;
+		const QJsonObject accessor = gltf["accessors"].toArray()[accessorIndex].toObject();
+		const int componentType = accessor["componentType"].toInt();
+		const int elementSize = componentType == 5125 ? 4 : componentType == 5123 ? 2 : 1;
+		int offset = 0;
+		int stride = 0;
+		accessorView(gltf, accessorIndex, &offset, &stride, elementSize);
+		const int count = accessor["count"].toInt();
+		if (offset + qint64(stride) * (count - 1) + elementSize > bin.size())
+			return result;
+		result.resize(count);
+		for (int i = 0; i < count; i++) {
+			const char* src = bin.constData() + offset + i * stride;
+			if (elementSize == 4)
+				result[i] = *reinterpret_cast<const quint32*>(src);
+			else if (elementSize == 2)
+				result[i] = *reinterpret_cast<const quint16*>(src);
+			else
+				result[i] = *reinterpret_cast<const quint8*>(src);
+		}
+		return result;
+	}
+};
+
+#endif // QMeshGeometry_h__
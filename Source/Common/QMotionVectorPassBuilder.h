@@ -0,0 +1,330 @@
+#ifndef QMotionVectorPassBuilder_h__
+#define QMotionVectorPassBuilder_h__
+
+#include <QMatrix4x4>
+#include <QVector>
+#include "Render/RHI/QRhiHelper.h"
+#include "Render/PassBuilder/QOutputPassBuilder.h"			//IRenderPassBuilder 与 QRenderGraphBuilder 的声明
+
+// 运动物体的几何：只读取每个顶点开头的 vec3 位置，数据需要在整个程序运行期间有效
+struct QMotionVectorMesh {
+	const float* vertices = nullptr;
+	int vertexCount = 0;
+	int stride = 0;
+};
+
+struct QMotionVectorInstance {
+	QMatrix4x4 worldMatrix;
+	QMatrix4x4 previousWorldMatrix;
+};
+
+// 蒙皮网格：顶点缓冲由蒙皮Pass写出，每个顶点同时带有本帧和上一帧的模型空间位置
+struct QMotionVectorSkinnedLayout {
+	int stride = 0;
+	int previousPositionOffset = 0;							//本帧位置位于顶点开头
+};
+
+struct QMotionVectorSkinnedDraw {
+	QRhiBufferRef vertexBuffer;								//可以是其他Pass的输出，执行时才取出
+	quint32 vertexOffset = 0;
+	QRhiBuffer* indexBuffer = nullptr;						//32位索引
+	int indexCount = 0;
+	QMatrix4x4 worldMatrix;
+	QMatrix4x4 previousWorldMatrix;
+};
+
+// 逐像素运动矢量：先由G-Buffer的世界坐标重投影得到相机运动，同时把场景深度写入深度附件，
+// 再在深度测试下绘制运动物体（刚体实例与蒙皮网格）覆盖其真实位移，被遮挡的部分不会写入
+// 只应在存在消费者时加入渲染图；中断若干帧后再次加入前调用 resetHistory()，否则会用过期的上一帧矩阵
+class QMotionVectorPassBuilder : public IRenderPassBuilder {
+	QRP_INPUT_BEGIN(QMotionVectorPassBuilder)
+		QRP_INPUT_ATTR(QRhiTextureRef, Position);
+		QRP_INPUT_ATTR(QRhiTextureRef, Normal);
+		QRP_INPUT_ATTR(QMatrix4x4, ViewMatrix);
+		QRP_INPUT_ATTR(QMatrix4x4, ProjectionMatrix);
+		QRP_INPUT_ATTR(QMotionVectorMesh, MovingMesh);
+		QRP_INPUT_ATTR(QVector<QMotionVectorInstance>, MovingInstances);
+		QRP_INPUT_ATTR(QMotionVectorSkinnedLayout, SkinnedLayout);
+		QRP_INPUT_ATTR(QVector<QMotionVectorSkinnedDraw>, SkinnedDraws);
+	QRP_INPUT_END()
+
+	QRP_OUTPUT_BEGIN(QMotionVectorPassBuilder)
+		QRP_OUTPUT_ATTR(QRhiTextureRef, MotionVector)		//xy：当前帧UV - 上一帧UV
+	QRP_OUTPUT_END()
+private:
+	struct UniformBlock {
+		float viewProjection[16];
+		float previousViewProjection[16];
+		float inverseViewProjection[16];
+		QVector4D params;									//x：运动物体朝相机的深度偏移 y：裁剪空间深度是否为[0,1]
+	};
+	QRhi* mRhi = nullptr;
+	QRhiTextureRef mMotionVector;
+	QRhiTextureRef mDepth;
+	QRhiTextureRenderTargetRef mRenderTarget;
+	QRhiBufferRef mUniformBuffer;
+	QRhiBufferRef mMeshBuffer;
+	QRhiBufferRef mInstanceBuffer;
+	QRhiSamplerRef mSampler;
+	QRhiShaderResourceBindingsRef mCameraBindings;
+	QRhiGraphicsPipelineRef mCameraPipeline;
+	QRhiShaderResourceBindingsRef mObjectBindings;
+	QRhiGraphicsPipelineRef mObjectPipeline;
+	QRhiGraphicsPipelineRef mSkinnedPipeline;
+	QShader mCameraFS;
+	QShader mObjectVS;
+	QShader mSkinnedVS;
+	QShader mObjectFS;
+	QMatrix4x4 mPreviousViewProjection;
+	bool mHasPrevious = false;
+	bool mHasObjects = false;
+	bool mHasSkinned = false;
+	QRhiBuffer* mUploadedMeshBuffer = nullptr;
+	int mInstanceCapacity = 0;
+public:
+	QMotionVectorPassBuilder() {
+		const QByteArray uniformBlock = R"(
+			layout (binding = 0) uniform UniformBlock {
+				mat4 viewProjection;
+				mat4 previousViewProjection;
+				mat4 inverseViewProjection;
+				vec4 params;
+			}UBO;
+			vec2 toUV(vec4 clip) {
+				return clip.xy / clip.w * 0.5 + 0.5;
+			}
+		)";
+		// 相机运动：由G-Buffer中的世界坐标重投影得到，覆盖所有静止的物体和天空
+		mCameraFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformBlock + R"(
+			layout (binding = 1) uniform sampler2D uPosition;
+			layout (binding = 2) uniform sampler2D uNormal;
+			layout (location = 0) in vec2 vUV;
+			layout (location = 0) out vec4 outMotionVector;
+			void main() {
+				ivec2 pixel = ivec2(gl_FragCoord.xy);
+				vec2 uv = gl_FragCoord.xy / vec2(textureSize(uPosition, 0));
+				vec3 normal = texelFetch(uNormal, pixel, 0).xyz;
+				vec4 world;
+				if (dot(normal, normal) < 1e-4) {				//天空取远平面上的点
+					vec4 farPoint = UBO.inverseViewProjection * vec4(uv * 2.0 - 1.0, 1.0, 1.0);
+					world = vec4(farPoint.xyz / farPoint.w, 1.0);
+					gl_FragDepth = 1.0;
+				}
+				else {
+					world = vec4(texelFetch(uPosition, pixel, 0).xyz, 1.0);
+					vec4 clip = UBO.viewProjection * world;		//由G-Buffer重建场景深度，供运动物体做深度测试
+					float depth = clip.z / clip.w;
+					gl_FragDepth = UBO.params.y != 0.0 ? depth : depth * 0.5 + 0.5;
+				}
+				outMotionVector = vec4(uv - toUV(UBO.previousViewProjection * world), 0.0, 1.0);
+			}
+		)");
+		// 物体运动：只绘制运动的物体，用上一帧的模型矩阵（蒙皮网格还有上一帧的顶点位置）得到真实位移
+		// 深度朝相机偏移一点，抵消重建深度与光栅化深度之间的误差，可见的表面与G-Buffer中的自身比较时能通过测试
+		const QByteArray objectVS = R"(
+			layout (location = 0) in vec3 inPosition;
+			layout (location = 1) in vec4 inModel0;
+			layout (location = 2) in vec4 inModel1;
+			layout (location = 3) in vec4 inModel2;
+			layout (location = 4) in vec4 inModel3;
+			layout (location = 5) in vec4 inPreviousModel0;
+			layout (location = 6) in vec4 inPreviousModel1;
+			layout (location = 7) in vec4 inPreviousModel2;
+			layout (location = 8) in vec4 inPreviousModel3;
+		#ifdef SKINNED
+			layout (location = 9) in vec3 inPreviousPosition;
+		#else
+			#define inPreviousPosition inPosition
+		#endif
+			layout (location = 0) out vec4 vCurrentClip;
+			layout (location = 1) out vec4 vPreviousClip;
+			out gl_PerVertex { vec4 gl_Position; };
+			void main() {
+				vec4 world = mat4(inModel0, inModel1, inModel2, inModel3) * vec4(inPosition, 1.0);
+				vCurrentClip = UBO.viewProjection * world;
+				vPreviousClip = UBO.previousViewProjection * mat4(inPreviousModel0, inPreviousModel1, inPreviousModel2, inPreviousModel3) * vec4(inPreviousPosition, 1.0);
+				gl_Position = vCurrentClip;
+				gl_Position.z -= UBO.params.x * gl_Position.w;
+			}
+		)";
+		mObjectVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, "#version 450\n" + uniformBlock + objectVS);
+		mSkinnedVS = QRhiHelper::newShaderFromCode(QShader::VertexStage, "#version 450\n#define SKINNED\n" + uniformBlock + objectVS);
+		mObjectFS = QRhiHelper::newShaderFromCode(QShader::FragmentStage, "#version 450\n" + uniformBlock + R"(
+			layout (location = 0) in vec4 vCurrentClip;
+			layout (location = 1) in vec4 vPreviousClip;
+			layout (location = 0) out vec4 outMotionVector;
+			void main() {
+				outMotionVector = vec4(toUV(vCurrentClip) - toUV(vPreviousClip), 0.0, 1.0);
+			}
+		)");
+	}
+	void resetHistory() { mHasPrevious = false; }
+	void setup(QRenderGraphBuilder& builder) override {
+		mRhi = builder.rhi();
+		const QSize size = mInput._Position->pixelSize();
+		builder.setupTexture(mMotionVector, "MotionVector", QRhiTexture::RGBA16F, size, 1, QRhiTexture::RenderTarget);
+		const QRhiTexture::Format depthFormat = mRhi->isTextureFormatSupported(QRhiTexture::D32F, QRhiTexture::RenderTarget) ? QRhiTexture::D32F : QRhiTexture::D24;
+		builder.setupTexture(mDepth, "MotionVectorDepth", depthFormat, size, 1, QRhiTexture::RenderTarget);
+		QRhiTextureRenderTargetDescription renderTargetDesc(mMotionVector.get());
+		renderTargetDesc.setDepthTexture(mDepth.get());
+		builder.setupRenderTarget(mRenderTarget, "MotionVectorRT", renderTargetDesc);
+		builder.setupBuffer(mUniformBuffer, "MotionVectorUniformBuffer", QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(UniformBlock));
+		builder.setupSampler(mSampler, "MotionVectorSampler", QRhiSampler::Nearest, QRhiSampler::Nearest, QRhiSampler::None, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge, QRhiSampler::ClampToEdge);
+
+		builder.setupShaderResourceBindings(mCameraBindings, "MotionVectorCameraBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+			QRhiShaderResourceBinding::sampledTexture(1, QRhiShaderResourceBinding::FragmentStage, mInput._Position.get(), mSampler.get()),
+			QRhiShaderResourceBinding::sampledTexture(2, QRhiShaderResourceBinding::FragmentStage, mInput._Normal.get(), mSampler.get()),
+		});
+		QRhiGraphicsPipelineState cameraPSO;
+		cameraPSO.shaderResourceBindings = mCameraBindings.get();
+		cameraPSO.sampleCount = mRenderTarget->sampleCount();
+		cameraPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		cameraPSO.depthTest = true;
+		cameraPSO.depthWrite = true;
+		cameraPSO.depthOp = QRhiGraphicsPipeline::Always;
+		cameraPSO.shaderStages = {
+			QRhiShaderStage(QRhiShaderStage::Vertex, builder.getFullScreenVS()),
+			QRhiShaderStage(QRhiShaderStage::Fragment, mCameraFS)
+		};
+		builder.setupGraphicsPipeline(mCameraPipeline, "MotionVectorCameraPipeline", cameraPSO);
+
+		const QMotionVectorMesh& mesh = mInput._MovingMesh;
+		const QMotionVectorSkinnedLayout& skinnedLayout = mInput._SkinnedLayout;
+		mHasObjects = mesh.vertices != nullptr && mesh.vertexCount > 0;
+		mHasSkinned = skinnedLayout.stride > 0;
+		if (!mHasObjects && !mHasSkinned) {
+			mOutput.MotionVector = mMotionVector;
+			return;
+		}
+		mInstanceCapacity = qMax(mInstanceCapacity, qMax(1, int(mInput._MovingInstances.size() + mInput._SkinnedDraws.size())));
+		builder.setupBuffer(mInstanceBuffer, "MotionVectorInstanceBuffer", QRhiBuffer::Dynamic, QRhiBuffer::VertexBuffer, sizeof(float) * 32 * mInstanceCapacity);
+		builder.setupShaderResourceBindings(mObjectBindings, "MotionVectorObjectBindings", {
+			QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, mUniformBuffer.get()),
+		});
+		QRhiGraphicsPipelineState objectPSO;
+		objectPSO.shaderResourceBindings = mObjectBindings.get();
+		objectPSO.sampleCount = mRenderTarget->sampleCount();
+		objectPSO.renderPassDesc = mRenderTarget->renderPassDescriptor();
+		objectPSO.depthTest = true;
+		objectPSO.depthWrite = true;							//运动物体之间也按深度取最近的一个
+		objectPSO.depthOp = QRhiGraphicsPipeline::LessOrEqual;
+		QVector<QRhiVertexInputAttribute> attributes = { QRhiVertexInputAttribute(0, 0, QRhiVertexInputAttribute::Float3, 0) };
+		for (int i = 0; i < 8; i++)
+			attributes << QRhiVertexInputAttribute(1, i + 1, QRhiVertexInputAttribute::Float4, i * 4 * sizeof(float));
+		if (mHasObjects) {
+			builder.setupBuffer(mMeshBuffer, "MotionVectorMeshBuffer", QRhiBuffer::Immutable, QRhiBuffer::VertexBuffer, mesh.vertexCount * mesh.stride);
+			QRhiVertexInputLayout inputLayout;
+			inputLayout.setBindings({
+				QRhiVertexInputBinding(mesh.stride),
+				QRhiVertexInputBinding(32 * sizeof(float), QRhiVertexInputBinding::PerInstance),
+			});
+			inputLayout.setAttributes(attributes.begin(), attributes.end());
+			objectPSO.vertexInputLayout = inputLayout;
+			objectPSO.shaderStages = {
+				QRhiShaderStage(QRhiShaderStage::Vertex, mObjectVS),
+				QRhiShaderStage(QRhiShaderStage::Fragment, mObjectFS)
+			};
+			builder.setupGraphicsPipeline(mObjectPipeline, "MotionVectorObjectPipeline", objectPSO);
+		}
+		if (mHasSkinned) {
+			QRhiVertexInputLayout inputLayout;
+			inputLayout.setBindings({
+				QRhiVertexInputBinding(skinnedLayout.stride),
+				QRhiVertexInputBinding(32 * sizeof(float), QRhiVertexInputBinding::PerInstance),
+			});
+			QVector<QRhiVertexInputAttribute> skinnedAttributes = attributes;
+			skinnedAttributes << QRhiVertexInputAttribute(0, 9, QRhiVertexInputAttribute::Float3, skinnedLayout.previousPositionOffset);
+			inputLayout.setAttributes(skinnedAttributes.begin(), skinnedAttributes.end());
+			objectPSO.vertexInputLayout = inputLayout;
+			objectPSO.shaderStages = {
+				QRhiShaderStage(QRhiShaderStage::Vertex, mSkinnedVS),
+				QRhiShaderStage(QRhiShaderStage::Fragment, mObjectFS)
+			};
+			builder.setupGraphicsPipeline(mSkinnedPipeline, "MotionVectorSkinnedPipeline", objectPSO);
+		}
+
+		mOutput.MotionVector = mMotionVector;
+	}
+	void execute(QRhiCommandBuffer* cmdBuffer) override {
+		const QMatrix4x4 viewProjection = mRhi->clipSpaceCorrMatrix() * mInput._ProjectionMatrix * mInput._ViewMatrix;
+		if (!mHasPrevious)
+			mPreviousViewProjection = viewProjection;
+		UniformBlock ubo;
+		memcpy(ubo.viewProjection, viewProjection.constData(), sizeof(ubo.viewProjection));
+		memcpy(ubo.previousViewProjection, mPreviousViewProjection.constData(), sizeof(ubo.previousViewProjection));
+		memcpy(ubo.inverseViewProjection, viewProjection.inverted().constData(), sizeof(ubo.inverseViewProjection));
+		ubo.params = QVector4D(1e-4f, mRhi->isClipDepthZeroToOne() ? 1.0f : 0.0f, 0.0f, 0.0f);
+
+		// 刚体实例在前，每个蒙皮网格占一个实例
+		QVector<QGenericMatrix<4, 4, float>> instances;
+		auto appendInstance = [&](const QMatrix4x4& worldMatrix, const QMatrix4x4& previousWorldMatrix) {
+			if (instances.size() / 2 >= mInstanceCapacity)
+				return false;
+			instances << worldMatrix.toGenericMatrix<4, 4>() << (mHasPrevious ? previousWorldMatrix : worldMatrix).toGenericMatrix<4, 4>();
+			return true;
+		};
+		int objectCount = 0;
+		if (mHasObjects) {
+			for (const QMotionVectorInstance& instance : mInput._MovingInstances) {
+				if (!appendInstance(instance.worldMatrix, instance.previousWorldMatrix))
+					break;
+				objectCount++;
+			}
+		}
+		QVector<const QMotionVectorSkinnedDraw*> skinnedDraws;
+		if (mHasSkinned) {
+			for (const QMotionVectorSkinnedDraw& draw : mInput._SkinnedDraws) {
+				if (draw.vertexBuffer.get() == nullptr || draw.indexBuffer == nullptr || !appendInstance(draw.worldMatrix, draw.previousWorldMatrix))
+					continue;
+				skinnedDraws << &draw;
+			}
+		}
+
+		QRhiResourceUpdateBatch* batch = mRhi->nextResourceUpdateBatch();
+		batch->updateDynamicBuffer(mUniformBuffer.get(), 0, sizeof(UniformBlock), &ubo);
+		if (mHasObjects && mUploadedMeshBuffer != mMeshBuffer.get()) {
+			batch->uploadStaticBuffer(mMeshBuffer.get(), 0, mInput._MovingMesh.vertexCount * mInput._MovingMesh.stride, mInput._MovingMesh.vertices);
+			mUploadedMeshBuffer = mMeshBuffer.get();
+		}
+		if (!instances.isEmpty())
+			batch->updateDynamicBuffer(mInstanceBuffer.get(), 0, instances.size() * sizeof(float) * 16, instances.constData());
+
+		const QColor clearColor = QColor::fromRgbF(0.0f, 0.0f, 0.0f, 1.0f);
+		const QRhiDepthStencilClearValue dsClearValue = { 1.0f,0 };
+		cmdBuffer->beginPass(mRenderTarget.get(), clearColor, dsClearValue, batch);
+		cmdBuffer->setViewport(QRhiViewport(0, 0, mRenderTarget->pixelSize().width(), mRenderTarget->pixelSize().height()));
+		cmdBuffer->setGraphicsPipeline(mCameraPipeline.get());
+		cmdBuffer->setShaderResources(mCameraBindings.get());
+		cmdBuffer->draw(4);
+		if (objectCount > 0) {
+			cmdBuffer->setGraphicsPipeline(mObjectPipeline.get());
+			cmdBuffer->setShaderResources(mObjectBindings.get());
+			const QRhiCommandBuffer::VertexInput vertexInputs[] = {
+				{ mMeshBuffer.get(), 0 },
+				{ mInstanceBuffer.get(), 0 },
+			};
+			cmdBuffer->setVertexInput(0, 2, vertexInputs);
+			cmdBuffer->draw(mInput._MovingMesh.vertexCount, objectCount);
+		}
+		if (!skinnedDraws.isEmpty()) {
+			cmdBuffer->setGraphicsPipeline(mSkinnedPipeline.get());
+			cmdBuffer->setShaderResources(mObjectBindings.get());
+			for (int i = 0; i < skinnedDraws.size(); i++) {
+				const QMotionVectorSkinnedDraw& draw = *skinnedDraws[i];
+				const QRhiCommandBuffer::VertexInput vertexInputs[] = {
+					{ draw.vertexBuffer.get(), draw.vertexOffset },
+					{ mInstanceBuffer.get(), quint32((objectCount + i) * sizeof(float) * 32) },
+				};
+				cmdBuffer->setVertexInput(0, 2, vertexInputs, draw.indexBuffer, 0, QRhiCommandBuffer::IndexUInt32);
+				cmdBuffer->drawIndexed(draw.indexCount);
+			}
+		}
+		cmdBuffer->endPass();
+
+		mPreviousViewProjection = viewProjection;
+		mHasPrevious = true;
+	}
+};
+
+#endif // QMotionVectorPassBuilder_h__
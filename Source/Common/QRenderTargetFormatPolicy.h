@@ -0,0 +1,92 @@
+#ifndef QRenderTargetFormatPolicy_h__
+#define QRenderTargetFormatPolicy_h__
+
+#include <QDebug>
+#include <QList>
+#include <QMap>
+#include <QSize>
+#include <QString>
+#include "Render/RHI/QRhiHelper.h"
+#include "QTextureFormatInfo.h"
+
+// 按用途选择中间渲染目标的格式，并记录每张纹理每帧的读写次数以估算带宽
+// 示例中的Pass通过输入拿到同一个策略对象，切换模式即可对比统一使用RGBA32F与紧凑格式的流量
+class QRenderTargetFormatPolicy {
+public:
+	enum Mode {
+		Uniform32F,				//所有中间纹理统一使用RGBA32F（原先的做法）
+		Compact					//根据用途选择最紧凑的可用格式
+	};
+	enum Usage {
+		HdrColor,
+		Occlusion,
+		OcclusionWithDepth,
+		StorageOcclusion,		//计算着色器写入的单通道遮蔽，需要支持存储图像
+		StorageDirection		//计算着色器写入的方向（xyz）加一个标量（w）
+	};
+	void setMode(Mode mode) { mMode = mode; }
+	Mode getMode() const { return mMode; }
+
+	QRhiTexture::Format selectFormat(QRhi* rhi, Usage usage, QRhiTexture::Flags flags = {}) const {
+		if (mMode == Uniform32F)
+			return QRhiTexture::RGBA32F;
+		// QRhi没有暴露 R11G11B10F 和 RG16F，HDR颜色与双通道数据退化为 RGBA16F
+		// 存储图像的 r8 需要扩展格式支持，isTextureFormatSupported 无法查询，只使用 r16f 与 rgba16f
+		static const QMap<Usage, QList<QRhiTexture::Format>> Candidates = {
+			{ HdrColor, { QRhiTexture::RGBA16F } },
+			{ Occlusion, { QRhiTexture::R8, QRhiTexture::R16F } },
+			{ OcclusionWithDepth, { QRhiTexture::RGBA16F } },
+			{ StorageOcclusion, { QRhiTexture::R16F } },
+			{ StorageDirection, { QRhiTexture::RGBA16F } },
+		};
+		for (QRhiTexture::Format format : Candidates.value(usage)) {
+			if (rhi->isTextureFormatSupported(format, flags))
+				return format;
+		}
+		return QRhiTexture::RGBA32F;
+	}
+
+	// 记录一张渲染目标每帧的读写次数，用于估算带宽
+	void recordTraffic(const QByteArray& name, QRhiTexture::Format format, const QSize& size, int accessesPerFrame) {
+		mTraffic[name] = { format, size, accessesPerFrame };
+	}
+	void recordTraffic(const QByteArray& name, QRhiTexture* texture, int accessesPerFrame) {
+		if (texture)
+			recordTraffic(name, texture->format(), texture->pixelSize(), accessesPerFrame);
+	}
+	void resetTraffic() { mTraffic.clear(); }
+	qint64 getTrafficBytes() const {
+		qint64 bytes = 0;
+		for (const TrafficRecord& record : mTraffic)
+			bytes += qint64(record.size.width()) * record.size.height() * QTextureFormatInfo::bytesPerPixel(record.format) * record.accessesPerFrame;
+		return bytes;
+	}
+
+	// 按"配置 + 格式模式"保存本帧测得的流量并输出一行日志，两种模式都跑过后附上另一种模式的结果
+	void reportTraffic(const QString& label, const char* toggleName) {
+		const bool compact = mMode == Compact;
+		const qint64 bytes = getTrafficBytes();
+		mMeasuredTraffic[label + (compact ? "|Compact" : "|Uniform32F")] = bytes;
+		const QString otherKey = label + (compact ? "|Uniform32F" : "|Compact");
+		const QString otherName = compact ? "all RGBA32F" : "compact";
+		const QString other = mMeasuredTraffic.contains(otherKey)
+			? QString("%1: %2 MB").arg(otherName).arg(mMeasuredTraffic[otherKey] / 1048576.0, 0, 'f', 2)
+			: QString("%1: toggle %2 to measure").arg(otherName).arg(toggleName);
+		qDebug().noquote() << QString("[RenderTargetTraffic] %1, %2: %3 MB per frame (%4)")
+			.arg(label)
+			.arg(compact ? "compact" : "all RGBA32F")
+			.arg(bytes / 1048576.0, 0, 'f', 2)
+			.arg(other);
+	}
+private:
+	struct TrafficRecord {
+		QRhiTexture::Format format;
+		QSize size;
+		int accessesPerFrame;
+	};
+	Mode mMode = Compact;
+	QMap<QByteArray, TrafficRecord> mTraffic;
+	QMap<QString, qint64> mMeasuredTraffic;
+};
+
+#endif // QRenderTargetFormatPolicy_h__
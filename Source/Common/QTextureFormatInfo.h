@@ -0,0 +1,67 @@
+#ifndef QTextureFormatInfo_h__
+#define QTextureFormatInfo_h__
+
+#include <QByteArray>
+#include <QDebug>
+#include <QSet>
+#include "Render/RHI/QRhiHelper.h"
+
+// 示例之间共用的纹理格式信息：估算带宽用的每像素字节数，以及计算着色器中存储图像的格式限定符
+// 未列出的格式会输出一次警告，而不是静默地按某个默认值计算
+class QTextureFormatInfo {
+public:
+	static int bytesPerPixel(QRhiTexture::Format format) {
+		switch (format) {
+		case QRhiTexture::R8:
+		case QRhiTexture::RED_OR_ALPHA8:
+			return 1;
+		case QRhiTexture::RG8:
+		case QRhiTexture::R16:
+		case QRhiTexture::R16F:
+		case QRhiTexture::D16:
+			return 2;
+		case QRhiTexture::RGBA8:
+		case QRhiTexture::BGRA8:
+		case QRhiTexture::RG16:
+		case QRhiTexture::R32F:
+		case QRhiTexture::RGB10A2:
+		case QRhiTexture::D24:
+		case QRhiTexture::D24S8:
+		case QRhiTexture::D32F:
+			return 4;
+		case QRhiTexture::RGBA16F:
+			return 8;
+		case QRhiTexture::RGBA32F:
+			return 16;
+		default:
+			warnUnknown(format, "byte size");
+			return 4;
+		}
+	}
+
+	static QByteArray glslImageFormat(QRhiTexture::Format format) {
+		switch (format) {
+		case QRhiTexture::R8: return "r8";
+		case QRhiTexture::R16F: return "r16f";
+		case QRhiTexture::R32F: return "r32f";
+		case QRhiTexture::RGBA8: return "rgba8";
+		case QRhiTexture::RGBA16F: return "rgba16f";
+		case QRhiTexture::RGBA32F: return "rgba32f";
+		default:
+			warnUnknown(format, "GLSL image format");
+			return "rgba32f";
+		}
+	}
+private:
+	// 只在渲染线程调用
+	static void warnUnknown(QRhiTexture::Format format, const char* what) {
+		static QSet<QByteArray> warned;
+		const QByteArray key = QByteArray(what) + "/" + QByteArray::number(int(format));
+		if (warned.contains(key))
+			return;
+		warned.insert(key);
+		qWarning().noquote() << QString("[QTextureFormatInfo] no %1 for texture format %2").arg(what).arg(int(format));
+	}
+};
+
+#endif // QTextureFormatInfo_h__